@@ -0,0 +1,134 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator asset slots
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include "asset.h"
+#include <pico/time.h>
+#include <hardware/sync.h>
+
+#define INDICATOR_SIZE			(240 * 135 * 2)
+#define FONT_SIZE				(96 * 8)
+
+static uint16_t slot_indicator[ INDICATOR_SIZE / 2 ];
+static uint8_t slot_font[ FONT_SIZE ];
+
+static uint8_t * const slot_address[ ASSET_SLOT_NUM ] = {
+	(uint8_t*) slot_indicator,
+	slot_font,
+};
+
+static const int slot_size[ ASSET_SLOT_NUM ] = {
+	INDICATOR_SIZE,
+	FONT_SIZE,
+};
+
+static volatile bool is_slot_valid[ ASSET_SLOT_NUM ] = {};
+static uint64_t begin_time[ ASSET_SLOT_NUM ];
+static int received_size[ ASSET_SLOT_NUM ] = {};		//	Bytes 0 ... received_size - 1 are written
+
+// --------------------------------------------------------------------
+int asset_get_slot_size( int slot ) {
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM ) {
+		return 0;
+	}
+	return slot_size[ slot ];
+}
+
+// --------------------------------------------------------------------
+bool asset_begin( int slot ) {
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM ) {
+		return false;
+	}
+	asset_invalidate( slot );
+	begin_time[ slot ] = to_us_since_boot( get_absolute_time() );
+	received_size[ slot ] = 0;
+	return true;
+}
+
+// --------------------------------------------------------------------
+bool asset_write( int slot, int offset, const uint8_t *p_data, int length ) {
+	int i;
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM || offset < 0 || length < 0 || (offset + length) > slot_size[ slot ] ) {
+		return false;
+	}
+	if( offset > received_size[ slot ] ) {
+		//	The previous chunk is missing.
+		return false;
+	}
+	for( i = 0; i < length; i++ ) {
+		slot_address[ slot ][ offset + i ] = p_data[i];
+	}
+	if( received_size[ slot ] < offset + length ) {
+		received_size[ slot ] = offset + length;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------
+int asset_commit( int slot ) {
+	uint64_t elapsed, throughput;
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM || received_size[ slot ] < slot_size[ slot ] ) {
+		return 0;
+	}
+	elapsed = to_us_since_boot( get_absolute_time() ) - begin_time[ slot ];
+	if( elapsed == 0 ) {
+		elapsed = 1;
+	}
+	//	The renderer must see all bytes of the slot before the valid flag.
+	__dmb();
+	is_slot_valid[ slot ] = true;
+	throughput = (uint64_t) slot_size[ slot ] * 1000000 / elapsed;
+	if( throughput == 0 ) {
+		//	0 is the error.
+		throughput = 1;
+	}
+	else if( throughput > INT32_MAX ) {
+		throughput = INT32_MAX;
+	}
+	return (int) throughput;
+}
+
+// --------------------------------------------------------------------
+void asset_invalidate( int slot ) {
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM ) {
+		return;
+	}
+	is_slot_valid[ slot ] = false;
+	__dmb();
+}
+
+// --------------------------------------------------------------------
+const void *asset_get( int slot, const void *p_rom ) {
+
+	if( slot < 0 || slot >= ASSET_SLOT_NUM || !is_slot_valid[ slot ] ) {
+		return p_rom;
+	}
+	__dmb();
+	return slot_address[ slot ];
+}
@@ -0,0 +1,108 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator asset slots
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __ASSET_H__
+#define __ASSET_H__
+
+#include <cstdint>
+
+//	Asset slots in RAM
+//		They replace the graphics in ROM at run time. (Upload by u2p, 0xE2...0xE5)
+//		RAM usage: 64800 + 768 bytes
+enum {
+	ASSET_SLOT_INDICATOR = 0,		//	240x135 RGB565, same format as grp_indicator
+	ASSET_SLOT_FONT,				//	96 characters x 8 bytes, same format as grp_font
+	ASSET_SLOT_NUM,
+};
+
+// --------------------------------------------------------------------
+//	Get the size of slot
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//	output:
+//		Size in bytes. 0 is an invalid slot.
+// --------------------------------------------------------------------
+int asset_get_slot_size( int slot );
+
+// --------------------------------------------------------------------
+//	Begin the upload
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//	output:
+//		true ............ Success.
+//		false ........... Invalid slot.
+//	comment:
+//		The slot becomes invalid until asset_commit(), so the renderer uses the ROM asset.
+// --------------------------------------------------------------------
+bool asset_begin( int slot );
+
+// --------------------------------------------------------------------
+//	Write a chunk into the slot
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//		offset .......... Offset in bytes
+//		p_data .......... Address of the data
+//		length .......... Size of the data in bytes
+//	output:
+//		true ............ Success.
+//		false ........... Out of the slot, or a gap after the received bytes.
+//	comment:
+//		The chunks are written in order of offset. A chunk may overlap the received
+//		bytes (sent again), but it must not leave a gap after them.
+// --------------------------------------------------------------------
+bool asset_write( int slot, int offset, const uint8_t *p_data, int length );
+
+// --------------------------------------------------------------------
+//	Commit the upload
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//	output:
+//		Achieved throughput from asset_begin() [bytes/sec]. 
+//		0 is an invalid slot, or the slot is not received up to the end. (The slot stays invalid.)
+// --------------------------------------------------------------------
+int asset_commit( int slot );
+
+// --------------------------------------------------------------------
+//	Invalidate the slot (back to the ROM asset)
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//	output:
+//		none
+// --------------------------------------------------------------------
+void asset_invalidate( int slot );
+
+// --------------------------------------------------------------------
+//	Get the asset
+//	input:
+//		slot ............ ASSET_SLOT_xxx
+//		p_rom ........... Asset in ROM
+//	output:
+//		Address of the uploaded asset if the slot is valid, otherwise p_rom.
+//	comment:
+//		It can be called from the other core.
+// --------------------------------------------------------------------
+const void *asset_get( int slot, const void *p_rom );
+
+#endif
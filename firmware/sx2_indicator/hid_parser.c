@@ -0,0 +1,309 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator HID report descriptor parser
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include <string.h>
+#include "hid_parser.h"
+
+//	Item type
+#define ITEM_MAIN				0
+#define ITEM_GLOBAL				1
+#define ITEM_LOCAL				2
+#define ITEM_LONG				0xFE
+
+//	Main items
+#define MAIN_INPUT				0x8
+#define MAIN_COLLECTION			0xA
+#define MAIN_END_COLLECTION		0xC
+
+//	Global items
+#define GLOBAL_USAGE_PAGE		0x0
+#define GLOBAL_LOGICAL_MIN		0x1
+#define GLOBAL_REPORT_SIZE		0x7
+#define GLOBAL_REPORT_ID		0x8
+#define GLOBAL_REPORT_COUNT		0x9
+#define GLOBAL_PUSH				0xA
+#define GLOBAL_POP				0xB
+
+//	Local items
+#define LOCAL_USAGE				0x0
+#define LOCAL_USAGE_MIN			0x1
+#define LOCAL_USAGE_MAX			0x2
+
+#define PAGE_DESKTOP			0x01
+#define PAGE_BUTTON				0x09
+#define USAGE_POINTER			0x01
+#define USAGE_MOUSE				0x02
+#define USAGE_X					0x30
+#define USAGE_Y					0x31
+#define USAGE_WHEEL				0x38
+
+#define INPUT_CONSTANT			0x01
+#define COLLECTION_APPLICATION	0x01
+
+#define MAX_USAGES				16
+#define MAX_REPORT_IDS			8
+#define MAX_PUSH				2
+#define MAX_BUTTONS				5
+#define MAX_FIELD_SIZE			24
+
+typedef struct {
+	uint16_t	usage_page;
+	int32_t		logical_min;
+	uint32_t	report_size;
+	uint32_t	report_count;
+	uint8_t		report_id;
+} GLOBAL_STATE_T;
+
+typedef struct {
+	uint32_t	usage[ MAX_USAGES ];	//	(usage page << 16) | usage, if the size is 4 bytes
+	int			usage_count;
+	uint32_t	usage_min;
+	uint32_t	usage_max;
+	bool		has_range;
+} LOCAL_STATE_T;
+
+// --------------------------------------------------------------------
+static uint32_t get_item_data( const uint8_t *p, int size ) {
+	uint32_t data = 0;
+
+	if( size >= 1 ) data = p[0];
+	if( size >= 2 ) data |= (uint32_t) p[1] << 8;
+	if( size >= 4 ) data |= ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+	return data;
+}
+
+// --------------------------------------------------------------------
+static int32_t get_signed_item_data( const uint8_t *p, int size ) {
+
+	if( size == 1 ) return (int8_t) p[0];
+	if( size == 2 ) return (int16_t)( p[0] | (p[1] << 8) );
+	return (int32_t) get_item_data( p, size );
+}
+
+// --------------------------------------------------------------------
+static uint32_t get_usage( const GLOBAL_STATE_T *p_global, const LOCAL_STATE_T *p_local, uint32_t index ) {
+	uint32_t usage;
+
+	if( p_local->has_range ) {
+		usage = p_local->usage_min + index;
+		if( usage > p_local->usage_max ) {
+			usage = p_local->usage_max;
+		}
+	}
+	else if( p_local->usage_count == 0 ) {
+		return 0;
+	}
+	else if( index < (uint32_t) p_local->usage_count ) {
+		usage = p_local->usage[ index ];
+	}
+	else {
+		//	The last usage is used for the rest.
+		usage = p_local->usage[ p_local->usage_count - 1 ];
+	}
+	if( usage <= 0xFFFF ) {
+		usage |= (uint32_t) p_global->usage_page << 16;
+	}
+	return usage;
+}
+
+// --------------------------------------------------------------------
+static void set_field( HID_FIELD_T *p_field, uint32_t bit_offset, uint32_t bit_size, int32_t logical_min ) {
+
+	if( p_field->bit_size != 0 || bit_size == 0 || bit_size > MAX_FIELD_SIZE ) {
+		return;
+	}
+	p_field->bit_offset = (uint16_t) bit_offset;
+	p_field->bit_size = (uint8_t) bit_size;
+	p_field->is_signed = (logical_min < 0) ? 1 : 0;
+}
+
+// --------------------------------------------------------------------
+bool hid_parse_mouse_descriptor( const uint8_t *p_desc, uint16_t desc_len, HID_MOUSE_PLAN_T *p_plan ) {
+	GLOBAL_STATE_T global, global_stack[ MAX_PUSH ];
+	LOCAL_STATE_T local;
+	uint8_t report_ids[ MAX_REPORT_IDS ];
+	uint32_t report_offsets[ MAX_REPORT_IDS ];
+	int report_id_count = 1;
+	int current = 0;
+	int push_level = 0;
+	int collection_level = 0;
+	int mouse_collection_level = 0;			//	0: out of the mouse collection
+	int target_report = -1;					//	Index of report_ids[] used by the plan
+	int buttons = 0;
+	int pos = 0;
+	uint32_t i, usage, bit_offset;
+
+	memset( p_plan, 0, sizeof(*p_plan) );
+	memset( &global, 0, sizeof(global) );
+	memset( &local, 0, sizeof(local) );
+	report_ids[0] = 0;
+	report_offsets[0] = 0;
+
+	while( pos < desc_len ) {
+		uint8_t prefix = p_desc[ pos ];
+		int size, type, tag;
+		const uint8_t *p_data;
+		uint32_t data;
+
+		if( prefix == ITEM_LONG ) {
+			if( pos + 1 >= desc_len ) {
+				break;
+			}
+			pos += 3 + p_desc[ pos + 1 ];
+			continue;
+		}
+		size = prefix & 3;
+		if( size == 3 ) {
+			size = 4;
+		}
+		type = (prefix >> 2) & 3;
+		tag = prefix >> 4;
+		if( pos + 1 + size > desc_len ) {
+			break;
+		}
+		p_data = &p_desc[ pos + 1 ];
+		data = get_item_data( p_data, size );
+		pos += 1 + size;
+
+		if( type == ITEM_GLOBAL ) {
+			switch( tag ) {
+			case GLOBAL_USAGE_PAGE:		global.usage_page = (uint16_t) data;							break;
+			case GLOBAL_LOGICAL_MIN:	global.logical_min = get_signed_item_data( p_data, size );	break;
+			case GLOBAL_REPORT_SIZE:	global.report_size = data;									break;
+			case GLOBAL_REPORT_COUNT:	global.report_count = data;									break;
+			case GLOBAL_REPORT_ID:
+				global.report_id = (uint8_t) data;
+				for( current = 0; current < report_id_count; current++ ) {
+					if( report_ids[ current ] == global.report_id ) {
+						break;
+					}
+				}
+				if( current == report_id_count ) {
+					if( report_id_count == MAX_REPORT_IDS ) {
+						return false;
+					}
+					//	The report ID byte is at the top of report.
+					report_ids[ current ] = global.report_id;
+					report_offsets[ current ] = 8;
+					report_id_count++;
+				}
+				break;
+			case GLOBAL_PUSH:
+				if( push_level < MAX_PUSH ) {
+					global_stack[ push_level++ ] = global;
+				}
+				break;
+			case GLOBAL_POP:
+				if( push_level > 0 ) {
+					global = global_stack[ --push_level ];
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		else if( type == ITEM_LOCAL ) {
+			if( size == 4 ) {
+				usage = data;
+			}
+			else {
+				usage = data & 0xFFFF;
+			}
+			switch( tag ) {
+			case LOCAL_USAGE:
+				if( local.usage_count < MAX_USAGES ) {
+					local.usage[ local.usage_count++ ] = usage;
+				}
+				break;
+			case LOCAL_USAGE_MIN:
+				local.usage_min = usage;
+				local.has_range = true;
+				break;
+			case LOCAL_USAGE_MAX:
+				local.usage_max = usage;
+				local.has_range = true;
+				break;
+			default:
+				break;
+			}
+		}
+		else if( type == ITEM_MAIN ) {
+			if( tag == MAIN_COLLECTION ) {
+				collection_level++;
+				usage = get_usage( &global, &local, 0 );
+				if( mouse_collection_level == 0 && data == COLLECTION_APPLICATION && 
+						(usage == ((PAGE_DESKTOP << 16) | USAGE_MOUSE) || usage == ((PAGE_DESKTOP << 16) | USAGE_POINTER)) ) {
+					mouse_collection_level = collection_level;
+				}
+			}
+			else if( tag == MAIN_END_COLLECTION ) {
+				if( collection_level == mouse_collection_level ) {
+					mouse_collection_level = 0;
+				}
+				if( collection_level > 0 ) {
+					collection_level--;
+				}
+			}
+			else if( tag == MAIN_INPUT ) {
+				bit_offset = report_offsets[ current ];
+				if( mouse_collection_level != 0 && (target_report < 0 || target_report == current) && !(data & INPUT_CONSTANT) ) {
+					for( i = 0; i < global.report_count; i++ ) {
+						usage = get_usage( &global, &local, i );
+						if( usage == ((PAGE_DESKTOP << 16) | USAGE_X) ) {
+							set_field( &p_plan->field[ HID_MOUSE_X ], bit_offset, global.report_size, global.logical_min );
+							target_report = current;
+						}
+						else if( usage == ((PAGE_DESKTOP << 16) | USAGE_Y) ) {
+							set_field( &p_plan->field[ HID_MOUSE_Y ], bit_offset, global.report_size, global.logical_min );
+							target_report = current;
+						}
+						else if( usage == ((PAGE_DESKTOP << 16) | USAGE_WHEEL) ) {
+							set_field( &p_plan->field[ HID_MOUSE_WHEEL ], bit_offset, global.report_size, global.logical_min );
+						}
+						else if( usage == ((PAGE_BUTTON << 16) | (buttons + 1)) && buttons < MAX_BUTTONS && global.report_size == 1 ) {
+							//	Buttons must be contiguous from button 1.
+							if( buttons == 0 ) {
+								p_plan->field[ HID_MOUSE_BUTTONS ].bit_offset = (uint16_t) bit_offset;
+							}
+							buttons++;
+							p_plan->field[ HID_MOUSE_BUTTONS ].bit_size = (uint8_t) buttons;
+							target_report = current;
+						}
+						bit_offset += global.report_size;
+					}
+				}
+				report_offsets[ current ] += global.report_size * global.report_count;
+			}
+			//	Local items are cleared by each main item.
+			memset( &local, 0, sizeof(local) );
+		}
+	}
+
+	if( target_report < 0 || p_plan->field[ HID_MOUSE_X ].bit_size == 0 || p_plan->field[ HID_MOUSE_Y ].bit_size == 0 ) {
+		return false;
+	}
+	p_plan->report_id = report_ids[ target_report ];
+	return true;
+}
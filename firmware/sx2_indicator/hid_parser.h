@@ -0,0 +1,108 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator HID report descriptor parser
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __HID_PARSER_H__
+#define __HID_PARSER_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		//	Position of a field in the input report
+		typedef struct {
+			uint16_t	bit_offset;		//	Bit offset from the top of report (includes the report ID byte)
+			uint8_t		bit_size;		//	0: The field does not exist. (1 ... 24)
+			uint8_t		is_signed;		//	1: Logical Minimum is negative
+		} HID_FIELD_T;
+
+		enum {
+			HID_MOUSE_X = 0,
+			HID_MOUSE_Y,
+			HID_MOUSE_WHEEL,
+			HID_MOUSE_BUTTONS,			//	Button 1 ... 5 as one field (bit_size is the number of buttons)
+			HID_MOUSE_FIELDS,
+		};
+
+		//	Field extraction plan of a mouse
+		typedef struct {
+			uint8_t		report_id;		//	0: The report has no report ID
+			HID_FIELD_T	field[ HID_MOUSE_FIELDS ];
+		} HID_MOUSE_PLAN_T;
+
+		// --------------------------------------------------------------------
+		//	Build the mouse plan from the report descriptor
+		//	input:
+		//		p_desc .......... Report descriptor
+		//		desc_len ........ Size of p_desc
+		//		p_plan .......... Address of buffer to return the plan.
+		//	output:
+		//		true ............ Success. The report has X and Y at least.
+		//		false ........... It is not a mouse.
+		//	comment:
+		//		The first report which has X and Y in a Mouse (or Pointer) collection is used.
+		// --------------------------------------------------------------------
+		bool hid_parse_mouse_descriptor( const uint8_t *p_desc, uint16_t desc_len, HID_MOUSE_PLAN_T *p_plan );
+
+		// --------------------------------------------------------------------
+		//	Extract a field
+		//	input:
+		//		p_report ........ Input report (includes the report ID byte)
+		//		len ............. Size of p_report
+		//		p_field ......... Field
+		//	output:
+		//		Value of the field. It is sign extended if the field is signed.
+		//		0 if the field does not exist, or it is out of the report.
+		// --------------------------------------------------------------------
+		static inline int32_t hid_extract_field( const uint8_t *p_report, uint16_t len, const HID_FIELD_T *p_field ) {
+			uint32_t value;
+			int index, shift, last;
+
+			if( p_field->bit_size == 0 ) {
+				return 0;
+			}
+			index = p_field->bit_offset >> 3;
+			shift = p_field->bit_offset & 7;
+			last = (p_field->bit_offset + p_field->bit_size - 1) >> 3;
+			if( last >= len ) {
+				return 0;
+			}
+			//	bit_size <= 24 and shift <= 7, so 4 bytes are enough.
+			value = p_report[ index ];
+			if( index + 1 <= last ) value |= (uint32_t) p_report[ index + 1 ] << 8;
+			if( index + 2 <= last ) value |= (uint32_t) p_report[ index + 2 ] << 16;
+			if( index + 3 <= last ) value |= (uint32_t) p_report[ index + 3 ] << 24;
+			value = (value >> shift) & ((1u << p_field->bit_size) - 1);
+			if( p_field->is_signed && (value & (1u << (p_field->bit_size - 1))) ) {
+				value |= ~((1u << p_field->bit_size) - 1);
+			}
+			return (int32_t) value;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
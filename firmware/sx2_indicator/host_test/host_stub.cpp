@@ -0,0 +1,172 @@
+// --------------------------------------------------------------------
+//	Host test stub of ps2dev_driver and usb_host_driver
+// --------------------------------------------------------------------
+
+#include "host_stub.h"
+#include "ps2dev_driver.h"
+#include "usb_host_driver.h"
+#include <pico/time.h>
+#include <deque>
+
+volatile uint64_t host_time_us = 1000000;
+
+static std::deque<uint8_t> receive_fifo;		//	host -> u2p
+static std::deque<uint8_t> send_fifo;			//	u2p -> host
+static uint32_t send_push_count;
+static int calibration_count[2];
+
+static bool is_mouse_connected;
+static bool is_mouse_moved;
+static int mouse_x, mouse_y, mouse_wheel;
+static int32_t mouse_button;
+
+// --------------------------------------------------------------------
+void host_advance_us( uint64_t us ) {
+	host_time_us = host_time_us + us;
+}
+
+// --------------------------------------------------------------------
+void host_reset( void ) {
+
+	receive_fifo.clear();
+	send_fifo.clear();
+	calibration_count[0] = 0;
+	calibration_count[1] = 0;
+	is_mouse_connected = false;
+	is_mouse_moved = false;
+	mouse_x = 0;
+	mouse_y = 0;
+	mouse_wheel = 0;
+	mouse_button = 0;
+}
+
+// --------------------------------------------------------------------
+void host_ps2_put( uint8_t data ) {
+	receive_fifo.push_back( data );
+}
+
+// --------------------------------------------------------------------
+int host_ps2_get( uint8_t *p_data, int max_length ) {
+	int length = 0;
+
+	while( length < max_length && !send_fifo.empty() ) {
+		p_data[ length++ ] = send_fifo.front();
+		send_fifo.pop_front();
+	}
+	return length;
+}
+
+// --------------------------------------------------------------------
+int host_ps2_calibration_count( bool success ) {
+	return calibration_count[ success ? 1 : 0 ];
+}
+
+// --------------------------------------------------------------------
+void host_mouse_move( int delta_x, int delta_y, int delta_wheel, int32_t button ) {
+
+	is_mouse_connected = true;
+	is_mouse_moved = true;
+	mouse_x += delta_x;
+	mouse_y += delta_y;
+	mouse_wheel += delta_wheel;
+	mouse_button = button;
+}
+
+// --------------------------------------------------------------------
+//	ps2dev_driver
+// --------------------------------------------------------------------
+bool ps2dev_get_receive_data( int port, uint8_t *p_data ) {
+
+	if( port != PS2DEV_PORT_MOUSE || receive_fifo.empty() ) {
+		return false;
+	}
+	*p_data = receive_fifo.front();
+	receive_fifo.pop_front();
+	return true;
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_send_data( int port, uint8_t data ) {
+
+	if( port != PS2DEV_PORT_MOUSE ) {
+		return false;
+	}
+	send_fifo.push_back( data );
+	send_push_count++;
+	return true;
+}
+
+// --------------------------------------------------------------------
+//	The bytes are on the wire as soon as they are sent.
+//
+bool ps2dev_is_send_fifo_empty( int port ) {
+	(void) port;
+	return true;
+}
+
+// --------------------------------------------------------------------
+uint32_t ps2dev_get_send_push_count( int port ) {
+	(void) port;
+	return send_push_count;
+}
+
+// --------------------------------------------------------------------
+void ps2dev_calibration_report( bool success ) {
+	calibration_count[ success ? 1 : 0 ]++;
+}
+
+// --------------------------------------------------------------------
+//	usb_host_driver
+// --------------------------------------------------------------------
+static int take( int *p_remain, int limit ) {
+	int value = *p_remain;
+
+	if( value > limit ) {
+		value = limit;
+	}
+	else if( value < -limit ) {
+		value = -limit;
+	}
+	*p_remain -= value;
+	return value;
+}
+
+// --------------------------------------------------------------------
+bool is_mouse_active( void ) {
+	return is_mouse_connected;
+}
+
+// --------------------------------------------------------------------
+bool is_gamepad_active( void ) {
+	return false;
+}
+
+// --------------------------------------------------------------------
+uint8_t get_gamepad_state( void ) {
+	return 0;
+}
+
+// --------------------------------------------------------------------
+bool is_mouse_updated( void ) {
+	return is_mouse_moved;
+}
+
+// --------------------------------------------------------------------
+int32_t get_mouse_button( void ) {
+	return mouse_button;
+}
+
+// --------------------------------------------------------------------
+void get_mouse_position( int16_t *p_delta_x, int16_t *p_delta_y, int16_t *p_delta_wheel, int32_t *p_button, int16_t limit ) {
+
+	*p_delta_x = (int16_t) take( &mouse_x, limit );
+	*p_delta_y = (int16_t) take( &mouse_y, limit );
+	*p_delta_wheel = (int16_t) take( &mouse_wheel, 7 );
+	*p_button = mouse_button;
+	is_mouse_moved = (mouse_x != 0 || mouse_y != 0 || mouse_wheel != 0);
+}
+
+// --------------------------------------------------------------------
+void usb_set_mouse_resolution( int resolution ) {
+	(void) resolution;
+}
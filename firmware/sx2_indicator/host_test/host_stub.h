@@ -0,0 +1,71 @@
+// --------------------------------------------------------------------
+//	Host test stub of ps2dev_driver and usb_host_driver
+//		ps2dev is a byte FIFO in each direction. The bytes of the host are
+//		received by u2p, and the bytes sent by u2p are read by the test.
+//		usb_host_driver is one mouse whose movement is set by the test.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_H__
+#define __HOST_STUB_H__
+
+#include <cstdint>
+
+// --------------------------------------------------------------------
+//	Advance the time
+//	input:
+//		us .............. [usec]
+//	output:
+//		none
+// --------------------------------------------------------------------
+void host_advance_us( uint64_t us );
+
+// --------------------------------------------------------------------
+//	Clear the FIFOs and the mouse
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void host_reset( void );
+
+// --------------------------------------------------------------------
+//	Send a byte from the PS/2 host (OCM) to u2p
+//	input:
+//		data ............ Byte
+//	output:
+//		none
+// --------------------------------------------------------------------
+void host_ps2_put( uint8_t data );
+
+// --------------------------------------------------------------------
+//	Receive the bytes sent by u2p
+//	input:
+//		p_data .......... Address of buffer to return the bytes.
+//		max_length ...... Size of p_data
+//	output:
+//		Number of bytes
+// --------------------------------------------------------------------
+int host_ps2_get( uint8_t *p_data, int max_length );
+
+// --------------------------------------------------------------------
+//	Number of ps2dev_calibration_report() calls
+//	input:
+//		success ......... true: success, false: failure
+//	output:
+//		Number of calls
+// --------------------------------------------------------------------
+int host_ps2_calibration_count( bool success );
+
+// --------------------------------------------------------------------
+//	Move the USB mouse
+//	input:
+//		delta_x, delta_y, delta_wheel .. Movement (added to the remaining movement)
+//		button .......................... Button state
+//	output:
+//		none
+//	comment:
+//		The mouse becomes active.
+// --------------------------------------------------------------------
+void host_mouse_move( int delta_x, int delta_y, int delta_wheel, int32_t button );
+
+#endif
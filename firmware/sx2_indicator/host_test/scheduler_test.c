@@ -0,0 +1,224 @@
+// --------------------------------------------------------------------
+//	Host test of scheduler (deadline and urgent preemption)
+//		The tasks of core0 are modeled with a fake time: each task advances
+//		the time by its runtime, and ps2dev is urgent while a frame is clocked.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include "scheduler.h"
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Model
+static uint32_t now_us = 0;
+static uint32_t frame_start_us = 0;			//	Start of the frame being clocked
+static uint32_t frame_length_us = 0;		//	0: no frame
+static int usb_in_frame_count = 0;			//	tuh_task() started while the frame is clocked
+static int u2p_run_count = 0;
+static int usb_run_count = 0;
+
+static uint32_t get_time( void ) {
+	return now_us;
+}
+
+static bool is_in_frame( void ) {
+	return( frame_length_us != 0 && (now_us - frame_start_us) < frame_length_us );
+}
+
+static void ps2dev_task( void ) {
+	now_us += 5;
+}
+
+static void u2p_task( void ) {
+	u2p_run_count++;
+	now_us += 20;
+}
+
+static void usb_task( void ) {
+	if( is_in_frame() ) {
+		usb_in_frame_count++;
+	}
+	usb_run_count++;
+	now_us += 150;
+}
+
+static SCHED_TASK_T tasks[] = {
+	//	name		task			is_urgent		deadline	budget
+	{ "ps2dev",		ps2dev_task,	is_in_frame,	0,			20		},
+	{ "u2p",		u2p_task,		NULL,			2000,		50		},
+	{ "usb",		usb_task,		NULL,			4000,		200		},
+};
+
+// --------------------------------------------------------------------
+static void reset( void ) {
+
+	now_us = 0x10000;
+	frame_length_us = 0;
+	usb_in_frame_count = 0;
+	u2p_run_count = 0;
+	usb_run_count = 0;
+	sched_init( tasks, sizeof(tasks) / sizeof(tasks[0]), get_time );
+}
+
+// --------------------------------------------------------------------
+static void run_until( uint32_t end_us ) {
+
+	while( (int32_t)(end_us - now_us) > 0 ) {
+		sched_run();
+	}
+}
+
+// --------------------------------------------------------------------
+//	Nothing is urgent: every task runs on every pass.
+static void test_round_robin( void ) {
+	int i;
+
+	reset();
+	for( i = 0; i < 10; i++ ) {
+		sched_run();
+	}
+	CHECK( tasks[0].run_count == 10 );
+	CHECK( u2p_run_count == 10 );
+	CHECK( usb_run_count == 10 );
+	CHECK( tasks[1].late_count == 0 );
+	CHECK( tasks[2].late_count == 0 );
+}
+
+// --------------------------------------------------------------------
+//	A frame (about 1.1 msec) is shorter than the deadlines: the other tasks
+//	wait until the frame ends, and never run in the frame.
+static void test_frame_defers_tasks( void ) {
+	uint32_t end_us;
+
+	reset();
+	sched_run();
+	sched_reset_statistics();
+	usb_run_count = 0;
+	u2p_run_count = 0;
+
+	frame_start_us = now_us;
+	frame_length_us = 1100;
+	end_us = now_us + 1100;
+	while( (int32_t)(end_us - now_us) > 0 ) {
+		sched_run();
+		CHECK( usb_run_count == 0 );
+		CHECK( u2p_run_count == 0 );
+	}
+	CHECK( tasks[0].run_count > 100 );
+	CHECK( tasks[0].max_interval_us <= 5 );
+
+	//	The first pass after the frame runs all tasks.
+	sched_run();
+	CHECK( usb_run_count == 1 );
+	CHECK( u2p_run_count == 1 );
+	CHECK( usb_in_frame_count == 0 );
+	CHECK( tasks[1].late_count == 0 );
+	CHECK( tasks[2].late_count == 0 );
+}
+
+// --------------------------------------------------------------------
+//	Back-to-back frames with a short gap (the bytes of a packet in send fifo):
+//	tuh_task() runs in the gaps, and never starts in a frame.
+static void test_frames_with_gap( void ) {
+	uint32_t end_us;
+	int i;
+
+	reset();
+	for( i = 0; i < 50; i++ ) {
+		frame_start_us = now_us;
+		frame_length_us = 1100;
+		end_us = now_us + 1100 + 200;
+		run_until( end_us );
+	}
+	CHECK( usb_in_frame_count == 0 );
+	CHECK( usb_run_count >= 50 );
+	CHECK( tasks[2].late_count == 0 );
+	CHECK( tasks[2].max_interval_us < tasks[2].deadline_us );
+}
+
+// --------------------------------------------------------------------
+//	A stuck frame (e.g. the host stopped PS2CLK): the deadline is the
+//	starvation limit, and late_count shows the runs in the urgent state.
+static void test_starvation_limit( void ) {
+
+	reset();
+	sched_run();
+	usb_run_count = 0;
+	u2p_run_count = 0;
+
+	frame_start_us = now_us;
+	frame_length_us = 20000;
+	run_until( frame_start_us + 20000 );
+
+	//	u2p: every 2000 usec, usb: every 4000 usec (+ the runtime of the pass)
+	CHECK( u2p_run_count >= 9 && u2p_run_count <= 10 );
+	CHECK( usb_run_count >= 4 && usb_run_count <= 5 );
+	CHECK( tasks[1].late_count == (uint32_t) u2p_run_count );
+	CHECK( tasks[2].late_count == (uint32_t) usb_run_count );
+	CHECK( tasks[1].max_interval_us < 2000 + 200 );
+	CHECK( tasks[2].max_interval_us < 4000 + 200 );
+}
+
+// --------------------------------------------------------------------
+//	The table order is the priority of the urgent tasks.
+static bool urgent_a = false;
+static bool urgent_b = false;
+static int run_a = 0;
+static int run_b = 0;
+static bool is_urgent_a( void ) { return urgent_a; }
+static bool is_urgent_b( void ) { return urgent_b; }
+static void task_a( void ) { run_a++; now_us += 10; }
+static void task_b( void ) { run_b++; now_us += 10; }
+
+static void test_priority( void ) {
+	SCHED_TASK_T table[] = {
+		{ "a",	task_a,	is_urgent_a,	1000,	0 },
+		{ "b",	task_b,	is_urgent_b,	1000,	0 },
+	};
+	int i;
+
+	now_us = 0;
+	sched_init( table, 2, get_time );
+	urgent_a = true;
+	urgent_b = true;
+	for( i = 0; i < 10; i++ ) {
+		sched_run();
+	}
+	CHECK( run_a == 10 );
+	CHECK( run_b == 0 );
+
+	urgent_a = false;
+	for( i = 0; i < 10; i++ ) {
+		sched_run();
+	}
+	CHECK( run_a == 10 );
+	CHECK( run_b == 10 );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	test_round_robin();
+	test_frame_defers_tasks();
+	test_frames_with_gap();
+	test_starvation_limit();
+	test_priority();
+
+	if( error_count ) {
+		printf( "scheduler_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "scheduler_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,139 @@
+// --------------------------------------------------------------------
+//	Host test of status_history
+//		The memory budget written in status_history.h, and the seqlock
+//		between status_history_append() and status_history_query().
+// --------------------------------------------------------------------
+
+#include "host_stub.h"
+#include "status_history.h"
+#include "u2p.h"
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+static uint8_t status[ U2P_STATUS_MAX_LENGTH ];
+static uint8_t counter = 0;
+
+// --------------------------------------------------------------------
+//	Change data2 (the master volume) every interval_us for duration_ms
+//
+static void change_volume( uint32_t interval_us, uint32_t duration_ms ) {
+	uint64_t t;
+
+	for( t = 0; t < (uint64_t) duration_ms * 1000; t += interval_us ) {
+		host_advance_us( interval_us );
+		counter++;
+		status[ U2P_DATA2 ] = counter;
+		status_history_append( status, 7 );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Age of the oldest record [msec]
+//
+static uint32_t get_retention( void ) {
+	STATUS_HISTORY_SAMPLE_T samples[2];
+
+	//	The period is longer than the history, so p_samples[0] is the value before the oldest record.
+	status_history_query( U2P_DATA2, 0xFFFFFFFF, samples, 2 );
+	return samples[0].age;
+}
+
+// --------------------------------------------------------------------
+static void test_memory_budget( void ) {
+	uint32_t retention;
+	int i;
+
+	status_history_init();
+
+	//	Volume drag at 60 frames/sec: 3 bytes per record, 180 bytes/sec.
+	change_volume( 16667, 60000 );
+	retention = get_retention();
+	printf( "drag at 60fps: %u msec (%u bytes/sec)\n", retention, (unsigned)(STATUS_HISTORY_SIZE * 1000ull / retention) );
+	CHECK( retention >= 22000 && retention <= 23000 );
+
+	//	Idle: No record.
+	for( i = 0; i < 3600; i++ ) {
+		host_advance_us( 1000000 );
+		status_history_append( status, 7 );
+	}
+	CHECK( get_retention() == retention + 3600000 );
+
+	//	Typical use: 3 changes per minute, 5 bytes per record, 900 bytes/hour.
+	change_volume( 20000000, 6 * 3600000 );
+	retention = get_retention();
+	printf( "typical: %u sec (%u bytes/hour)\n", retention / 1000, (unsigned)(STATUS_HISTORY_SIZE * 3600000ull / retention) );
+	CHECK( retention >= 4 * 3600000 && retention <= 5 * 3600000 );
+
+	//	4 bytes per record within 16 seconds
+	change_volume( 16000000, 24 * 3600000 );
+	retention = get_retention();
+	CHECK( retention / 16000 >= (STATUS_HISTORY_SIZE - 16) / 4 && retention / 16000 <= STATUS_HISTORY_SIZE / 4 );
+}
+
+// --------------------------------------------------------------------
+//	The writer changes data2 to 1, 2, 3, ... every 1 msec. Every query must see the
+//	consecutive values with the consecutive times.
+//
+static void test_seqlock( void ) {
+	std::atomic<bool> is_running( true );
+	STATUS_HISTORY_SAMPLE_T samples[ 8 ];
+	int queries = 0, failures = 0, torn = 0;
+	int count, i;
+
+	//	The newest records are 1 msec apart before the reader starts.
+	change_volume( 1000, 16 );
+	std::thread writer( [&]() {
+		int n;
+		for( n = 0; n < 2000000; n++ ) {
+			change_volume( 1000, 1 );
+		}
+		is_running = false;
+	} );
+
+	while( is_running ) {
+		count = status_history_query( U2P_DATA2, 0xFFFFFFFF, samples, 8 );
+		queries++;
+		if( count == 0 ) {
+			failures++;
+			continue;
+		}
+		for( i = 2; i < count; i++ ) {
+			if( (uint8_t)(samples[i - 1].value + 1) != samples[i].value || samples[i - 1].age != samples[i].age + 1 ) {
+				torn++;
+				break;
+			}
+		}
+	}
+	writer.join();
+	printf( "seqlock: %d queries, %d retry failures, %d torn\n", queries, failures, torn );
+	CHECK( torn == 0 );
+	CHECK( failures < queries );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	host_reset();
+	test_memory_budget();
+	test_seqlock();
+
+	if( error_count ) {
+		printf( "status_history_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "status_history_test: OK\n" );
+	return 0;
+}
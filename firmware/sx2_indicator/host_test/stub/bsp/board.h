@@ -0,0 +1,21 @@
+// --------------------------------------------------------------------
+//	Host test stub of bsp/board.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_BSP_BOARD_H__
+#define __HOST_STUB_BSP_BOARD_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		static inline void board_led_write( bool state ) {
+			(void) state;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
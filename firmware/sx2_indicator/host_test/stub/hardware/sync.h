@@ -0,0 +1,60 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/sync.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_SYNC_H__
+#define __HOST_STUB_HARDWARE_SYNC_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+		#include <sched.h>
+
+		static inline void __dmb( void ) {
+			__sync_synchronize();
+		}
+
+		static inline uint32_t save_and_disable_interrupts( void ) {
+			return 0;
+		}
+
+		static inline void restore_interrupts( uint32_t status ) {
+			(void) status;
+		}
+
+		//	Hardware spinlock: a test-and-set lock between the host threads
+		typedef volatile uint32_t spin_lock_t;
+
+		static inline int spin_lock_claim_unused( bool required ) {
+			static int next_lock = 0;
+
+			(void) required;
+			return next_lock++ & 31;
+		}
+
+		static inline spin_lock_t *spin_lock_init( unsigned int lock_num ) {
+			static spin_lock_t locks[ 32 ];
+
+			locks[ lock_num & 31 ] = 0;
+			return &locks[ lock_num & 31 ];
+		}
+
+		static inline uint32_t spin_lock_blocking( spin_lock_t *p_lock ) {
+			while( __sync_lock_test_and_set( p_lock, 1 ) ) {
+				//	The owner may be preempted on a single CPU host
+				sched_yield();
+			}
+			return 0;
+		}
+
+		static inline void spin_unlock( spin_lock_t *p_lock, uint32_t saved_irq ) {
+			(void) saved_irq;
+			__sync_lock_release( p_lock );
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
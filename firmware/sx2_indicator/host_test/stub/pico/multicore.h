@@ -0,0 +1,8 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/multicore.h (the cores are the host threads)
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_MULTICORE_H__
+#define __HOST_STUB_PICO_MULTICORE_H__
+	#include <pico/sync.h>
+#endif
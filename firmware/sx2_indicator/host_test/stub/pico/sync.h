@@ -0,0 +1,54 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/sync.h
+//		The semaphore is a spin lock, so it works between the host threads.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_SYNC_H__
+#define __HOST_STUB_PICO_SYNC_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+		#include <hardware/sync.h>
+
+		typedef struct {
+			volatile int16_t	permits;
+			int16_t				max_permits;
+		} semaphore_t;
+
+		static inline void sem_init( semaphore_t *p_sem, int16_t initial_permits, int16_t max_permits ) {
+			p_sem->permits = initial_permits;
+			p_sem->max_permits = max_permits;
+		}
+
+		static inline void sem_acquire_blocking( semaphore_t *p_sem ) {
+			int16_t permits;
+
+			for(;;) {
+				permits = p_sem->permits;
+				if( permits > 0 && __sync_bool_compare_and_swap( &p_sem->permits, permits, permits - 1 ) ) {
+					return;
+				}
+			}
+		}
+
+		static inline bool sem_release( semaphore_t *p_sem ) {
+			int16_t permits;
+
+			for(;;) {
+				permits = p_sem->permits;
+				if( permits >= p_sem->max_permits ) {
+					return false;
+				}
+				if( __sync_bool_compare_and_swap( &p_sem->permits, permits, permits + 1 ) ) {
+					return true;
+				}
+			}
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
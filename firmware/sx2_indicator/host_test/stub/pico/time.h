@@ -0,0 +1,42 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/time.h
+//		The time is host_time_us, and it is advanced by the test.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_TIME_H__
+#define __HOST_STUB_PICO_TIME_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stddef.h>
+		#include <stdint.h>
+
+		typedef uint64_t absolute_time_t;
+
+		extern volatile uint64_t host_time_us;
+
+		static inline absolute_time_t get_absolute_time( void ) {
+			return host_time_us;
+		}
+
+		static inline uint64_t to_us_since_boot( absolute_time_t t ) {
+			return t;
+		}
+
+		static inline uint32_t to_ms_since_boot( absolute_time_t t ) {
+			return (uint32_t)(t / 1000);
+		}
+
+		static inline uint32_t time_us_32( void ) {
+			return (uint32_t) host_time_us;
+		}
+
+		static inline uint64_t time_us_64( void ) {
+			return host_time_us;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,104 @@
+// --------------------------------------------------------------------
+//	Host test stub of tusb.h (TinyUSB 0.13 HID host)
+//		Only the types and the functions used by usb_host_driver.c.
+//		The functions are in usb_mouse_test.c, and the callbacks are in
+//		usb_host_driver.c.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_TUSB_H__
+#define __HOST_STUB_TUSB_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+		#include <pico/time.h>
+
+		//	tusb_config.h
+		#define OPT_MCU_RP2040				2000
+		#define OPT_MCU_LPC43XX				-1
+		#define OPT_MCU_LPC18XX				-2
+		#define OPT_MCU_MIMXRT10XX			-3
+		#define OPT_MODE_HOST				0x0002
+		#define OPT_MODE_HIGH_SPEED			0x0400
+		#define OPT_OS_NONE					1
+		#define CFG_TUSB_MCU				OPT_MCU_RP2040
+
+		#define TU_ATTR_PACKED				__attribute__((packed))
+
+		typedef struct TU_ATTR_PACKED {
+			uint8_t		buttons;
+			int8_t		x;
+			int8_t		y;
+			int8_t		wheel;
+			int8_t		pan;
+		} hid_mouse_report_t;
+
+		typedef struct TU_ATTR_PACKED {
+			uint8_t		modifier;
+			uint8_t		reserved;
+			uint8_t		keycode[6];
+		} hid_keyboard_report_t;
+
+		enum {
+			KEYBOARD_LED_NUMLOCK	= 1 << 0,
+			KEYBOARD_LED_CAPSLOCK	= 1 << 1,
+			KEYBOARD_LED_SCROLLLOCK	= 1 << 2,
+		};
+
+		typedef struct TU_ATTR_PACKED {
+			int8_t		x;
+			int8_t		y;
+			int8_t		z;
+			int8_t		rz;
+			int8_t		rx;
+			int8_t		ry;
+			uint8_t		hat;
+			uint32_t	buttons;
+		} hid_gamepad_report_t;
+
+		typedef struct {
+			uint8_t		report_id;
+			uint8_t		usage;
+			uint16_t	usage_page;
+		} tuh_hid_report_info_t;
+
+		enum { HID_ITF_PROTOCOL_NONE = 0, HID_ITF_PROTOCOL_KEYBOARD = 1, HID_ITF_PROTOCOL_MOUSE = 2 };
+		enum { HID_PROTOCOL_BOOT = 0, HID_PROTOCOL_REPORT = 1 };
+		enum { HID_REPORT_TYPE_INPUT = 1, HID_REPORT_TYPE_OUTPUT = 2 };
+		enum { HID_USAGE_PAGE_DESKTOP = 0x01 };
+		enum { HID_USAGE_DESKTOP_JOYSTICK = 0x04, HID_USAGE_DESKTOP_GAMEPAD = 0x05 };
+		enum {
+			MOUSE_BUTTON_LEFT = 1, MOUSE_BUTTON_RIGHT = 2, MOUSE_BUTTON_MIDDLE = 4,
+			MOUSE_BUTTON_BACKWARD = 8, MOUSE_BUTTON_FORWARD = 16,
+		};
+		enum {
+			GAMEPAD_BUTTON_A = 1u << 0, GAMEPAD_BUTTON_B = 1u << 1, GAMEPAD_BUTTON_C = 1u << 2,
+			GAMEPAD_BUTTON_TR = 1u << 7,
+		};
+
+		static inline bool tusb_init( void ) {
+			return true;
+		}
+
+		static inline void tuh_task( void ) {
+		}
+
+		uint8_t tuh_hid_interface_protocol( uint8_t dev_addr, uint8_t instance );
+		bool tuh_hid_receive_report( uint8_t dev_addr, uint8_t instance );
+		bool tuh_hid_set_protocol( uint8_t dev_addr, uint8_t instance, uint8_t protocol );
+		bool tuh_hid_set_report( uint8_t dev_addr, uint8_t instance, uint8_t report_id, uint8_t report_type, void *p_report, uint16_t len );
+		bool tuh_vid_pid_get( uint8_t dev_addr, uint16_t *p_vid, uint16_t *p_pid );
+		uint8_t tuh_hid_parse_report_descriptor( tuh_hid_report_info_t *p_info, uint8_t arr_count, uint8_t const *p_desc, uint16_t desc_len );
+
+		//	Callbacks (usb_host_driver.c)
+		void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len );
+		void tuh_hid_umount_cb( uint8_t dev_addr, uint8_t instance );
+		void tuh_hid_set_protocol_complete_cb( uint8_t dev_addr, uint8_t instance, uint8_t protocol );
+		void tuh_hid_report_received_cb( uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,357 @@
+// --------------------------------------------------------------------
+//	Host test of u2k (USB keyboard to PS/2 keyboard)
+//		The USB keyboard reports are received by usb_host_driver.c, and u2k
+//		sends the scancodes to the stub of the PS/2 keyboard port. It checks
+//		the scancode set 2 of the HID usages, the key events of the 6KRO
+//		bitmap diff, the typematic timing and the latency statistics.
+// --------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <tusb.h>
+#include "usb_host_driver.h"
+#include "ps2dev_driver.h"
+#include "u2k.h"
+
+#define KEYBOARD_ADDR		1
+#define TASK_STEP_US		100
+
+#define USAGE_A				0x04
+#define USAGE_B				0x05
+#define USAGE_C				0x06
+#define USAGE_ERROR_ROLL	0x01
+#define MODIFIER_LSHIFT		0x02
+#define MODIFIER_RGUI		0x80
+
+volatile uint64_t host_time_us = 1000000;
+
+static int error_count = 0;
+static std::deque<uint8_t> command_fifo;		//	host -> u2k
+static std::vector<uint8_t> sent_bytes;			//	u2k -> host
+static std::vector<uint64_t> sent_times;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	TinyUSB
+// --------------------------------------------------------------------
+extern "C" uint8_t tuh_hid_interface_protocol( uint8_t dev_addr, uint8_t instance ) {
+	(void) dev_addr;
+	(void) instance;
+	return HID_ITF_PROTOCOL_KEYBOARD;
+}
+
+extern "C" bool tuh_hid_receive_report( uint8_t dev_addr, uint8_t instance ) {
+	(void) dev_addr;
+	(void) instance;
+	return true;
+}
+
+extern "C" bool tuh_hid_set_protocol( uint8_t dev_addr, uint8_t instance, uint8_t protocol ) {
+	(void) dev_addr;
+	(void) instance;
+	(void) protocol;
+	return true;
+}
+
+extern "C" bool tuh_hid_set_report( uint8_t dev_addr, uint8_t instance, uint8_t report_id, uint8_t report_type, void *p_report, uint16_t len ) {
+	(void) dev_addr;
+	(void) instance;
+	(void) report_id;
+	(void) report_type;
+	(void) p_report;
+	(void) len;
+	return true;
+}
+
+extern "C" bool tuh_vid_pid_get( uint8_t dev_addr, uint16_t *p_vid, uint16_t *p_pid ) {
+	(void) dev_addr;
+	*p_vid = 0x04D9;
+	*p_pid = 0x1503;
+	return true;
+}
+
+extern "C" uint8_t tuh_hid_parse_report_descriptor( tuh_hid_report_info_t *p_info, uint8_t arr_count, uint8_t const *p_desc, uint16_t desc_len ) {
+	(void) p_info;
+	(void) arr_count;
+	(void) p_desc;
+	(void) desc_len;
+	return 0;
+}
+
+// --------------------------------------------------------------------
+//	PS/2 keyboard port: the bytes are on the wire as soon as they are sent.
+// --------------------------------------------------------------------
+bool ps2dev_get_receive_data( int port, uint8_t *p_data ) {
+
+	if( port != PS2DEV_PORT_KEYBOARD || command_fifo.empty() ) {
+		return false;
+	}
+	*p_data = command_fifo.front();
+	command_fifo.pop_front();
+	return true;
+}
+
+bool ps2dev_send_data( int port, uint8_t data ) {
+
+	CHECK( port == PS2DEV_PORT_KEYBOARD );
+	sent_bytes.push_back( data );
+	sent_times.push_back( (uint64_t) host_time_us );
+	return true;
+}
+
+bool ps2dev_is_send_fifo_empty( int port ) {
+	(void) port;
+	return true;
+}
+
+int ps2dev_get_send_fifo_free( int port ) {
+	(void) port;
+	return 15;
+}
+
+// --------------------------------------------------------------------
+//	Run u2k for the time, and return the bytes sent
+//
+static std::vector<uint8_t> run( uint32_t us ) {
+	std::vector<uint8_t> bytes;
+	uint32_t t;
+
+	sent_bytes.clear();
+	sent_times.clear();
+	for( t = 0; t < us; t += TASK_STEP_US ) {
+		u2k_task();
+		host_time_us += TASK_STEP_US;
+	}
+	bytes.swap( sent_bytes );
+	return bytes;
+}
+
+// --------------------------------------------------------------------
+static void send_keys( uint8_t modifier, uint8_t k0, uint8_t k1 = 0, uint8_t k2 = 0 ) {
+	hid_keyboard_report_t report;
+
+	memset( &report, 0, sizeof(report) );
+	report.modifier = modifier;
+	report.keycode[0] = k0;
+	report.keycode[1] = k1;
+	report.keycode[2] = k2;
+	tuh_hid_report_received_cb( KEYBOARD_ADDR, 0, (const uint8_t*) &report, sizeof(report) );
+}
+
+// --------------------------------------------------------------------
+static void expect( const std::vector<uint8_t> &response, const std::vector<uint8_t> &expected, int line ) {
+
+	if( response != expected ) {
+		printf( "NG: line %d: sent", line );
+		for( uint8_t d : response ) {
+			printf( " %02X", d );
+		}
+		printf( ", expected" );
+		for( uint8_t d : expected ) {
+			printf( " %02X", d );
+		}
+		printf( "\n" );
+		error_count++;
+	}
+}
+#define EXPECT( response, ... )		expect( response, { __VA_ARGS__ }, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Press and release one key, and check the make and break codes
+//
+static void expect_key( uint8_t usage, const std::vector<uint8_t> &make, const std::vector<uint8_t> &brk, int line ) {
+
+	send_keys( 0, usage );
+	expect( run( 1000 ), make, line );
+	send_keys( 0, 0 );
+	expect( run( 1000 ), brk, line );
+}
+#define EXPECT_KEY( usage, make, brk )	expect_key( usage, make, brk, __LINE__ )
+#define CODE( ... )						std::vector<uint8_t>{ __VA_ARGS__ }
+
+// --------------------------------------------------------------------
+static void reset_keyboard( void ) {
+
+	command_fifo.push_back( 0xFF );
+	EXPECT( run( 1000 ), 0xFA, 0xAA );
+}
+
+// --------------------------------------------------------------------
+//	Scancode set 2 of the HID usages
+//
+static void test_scancode( void ) {
+
+	reset_keyboard();
+	EXPECT_KEY( 0x04, CODE( 0x1C ), CODE( 0xF0, 0x1C ) );						//	A
+	EXPECT_KEY( 0x1D, CODE( 0x1A ), CODE( 0xF0, 0x1A ) );						//	Z
+	EXPECT_KEY( 0x27, CODE( 0x45 ), CODE( 0xF0, 0x45 ) );						//	0
+	EXPECT_KEY( 0x28, CODE( 0x5A ), CODE( 0xF0, 0x5A ) );						//	Enter
+	EXPECT_KEY( 0x3A, CODE( 0x05 ), CODE( 0xF0, 0x05 ) );						//	F1
+	EXPECT_KEY( 0x40, CODE( 0x83 ), CODE( 0xF0, 0x83 ) );						//	F7
+	EXPECT_KEY( 0x4F, CODE( 0xE0, 0x74 ), CODE( 0xE0, 0xF0, 0x74 ) );			//	Right
+	EXPECT_KEY( 0x54, CODE( 0xE0, 0x4A ), CODE( 0xE0, 0xF0, 0x4A ) );			//	KP /
+	EXPECT_KEY( 0x58, CODE( 0xE0, 0x5A ), CODE( 0xE0, 0xF0, 0x5A ) );			//	KP Enter
+	EXPECT_KEY( 0x87, CODE( 0x51 ), CODE( 0xF0, 0x51 ) );						//	Ro
+	EXPECT_KEY( 0x89, CODE( 0x6A ), CODE( 0xF0, 0x6A ) );						//	Yen
+	EXPECT_KEY( 0x46, CODE( 0xE0, 0x12, 0xE0, 0x7C ), CODE( 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12 ) );	//	PrintScreen
+	EXPECT_KEY( 0x48, CODE( 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 ), CODE() );				//	Pause
+	EXPECT_KEY( 0x90, CODE(), CODE() );											//	No scancode
+
+	//	Modifiers
+	send_keys( MODIFIER_LSHIFT | MODIFIER_RGUI, 0 );
+	EXPECT( run( 1000 ), 0x12, 0xE0, 0x27 );
+	send_keys( 0, 0 );
+	EXPECT( run( 1000 ), 0xF0, 0x12, 0xE0, 0xF0, 0x27 );
+}
+
+// --------------------------------------------------------------------
+//	6KRO: only the changed keys make the events, in the order of the usage
+//
+static void test_bitmap_diff( void ) {
+
+	reset_keyboard();
+	send_keys( 0, USAGE_B, USAGE_A );
+	EXPECT( run( 1000 ), 0x1C, 0x32 );
+	//	The same keys in the other slots
+	send_keys( 0, USAGE_A, 0, USAGE_B );
+	EXPECT( run( 1000 ) );
+	//	A is released and C is pressed in one report
+	send_keys( 0, USAGE_C, USAGE_B );
+	EXPECT( run( 1000 ), 0xF0, 0x1C, 0x21 );
+	//	Phantom state: the previous keys are kept
+	send_keys( 0, USAGE_ERROR_ROLL, USAGE_ERROR_ROLL, USAGE_ERROR_ROLL );
+	EXPECT( run( 1000 ) );
+	send_keys( MODIFIER_LSHIFT, USAGE_B, USAGE_C );
+	EXPECT( run( 1000 ), 0x12 );
+	//	Disconnected with the keys pressed: they are released
+	tuh_hid_umount_cb( KEYBOARD_ADDR, 0 );
+	EXPECT( run( 1000 ), 0xF0, 0x32, 0xF0, 0x21, 0xF0, 0x12 );
+	tuh_hid_mount_cb( KEYBOARD_ADDR, 0, nullptr, 0 );
+}
+
+// --------------------------------------------------------------------
+//	Check the times of the repeats of a key pressed at press_time
+//
+static void check_typematic( uint64_t press_time, uint32_t delay_us, uint32_t period_us, int repeats, int line ) {
+	int i;
+
+	if( (int) sent_times.size() != repeats ) {
+		printf( "NG: line %d: %d repeats, expected %d\n", line, (int) sent_times.size(), repeats );
+		error_count++;
+		return;
+	}
+	for( i = 0; i < repeats; i++ ) {
+		uint64_t expected = press_time + delay_us + (uint64_t) period_us * i;
+		if( sent_times[i] < expected || sent_times[i] >= expected + TASK_STEP_US ) {
+			printf( "NG: line %d: repeat %d at %lluus, expected %lluus\n", line, i,
+				(unsigned long long)(sent_times[i] - press_time), (unsigned long long)(expected - press_time) );
+			error_count++;
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Typematic: period = (8 + A) * 2^B * 4.17ms, delay = (1 + D) * 250ms
+//
+static void test_typematic( void ) {
+	uint64_t press_time;
+	std::vector<uint8_t> bytes;
+
+	reset_keyboard();
+
+	//	Default 0x2B: 500ms, 91.674ms (10.9 characters/sec)
+	send_keys( 0, USAGE_A );
+	press_time = host_time_us;
+	EXPECT( run( TASK_STEP_US ), 0x1C );
+	bytes = run( 500000 + 91674 * 3 );
+	check_typematic( press_time, 500000, 91674, 4, __LINE__ );
+	CHECK( bytes == std::vector<uint8_t>( 4, 0x1C ) );
+
+	//	The last pressed key repeats, and a modifier does not change it
+	send_keys( MODIFIER_LSHIFT, USAGE_A, USAGE_B );
+	press_time = host_time_us;
+	EXPECT( run( TASK_STEP_US * 2 ), 0x32, 0x12 );
+	bytes = run( 500000 + 91674 - TASK_STEP_US );
+	check_typematic( press_time, 500000, 91674, 2, __LINE__ );
+	CHECK( bytes == std::vector<uint8_t>( 2, 0x32 ) );
+	//	Released: no more repeat
+	send_keys( MODIFIER_LSHIFT, USAGE_A );
+	EXPECT( run( 1000000 ), 0xF0, 0x32 );
+	send_keys( 0, 0 );
+	EXPECT( run( 1000 ), 0xF0, 0x1C, 0xF0, 0x12 );
+
+	//	0xF3 0x00: 250ms, 33.336ms (30 characters/sec)
+	command_fifo.push_back( 0xF3 );
+	command_fifo.push_back( 0x00 );
+	EXPECT( run( 1000 ), 0xFA, 0xFA );
+	send_keys( 0, USAGE_C );
+	press_time = host_time_us;
+	EXPECT( run( TASK_STEP_US ), 0x21 );
+	bytes = run( 250000 + 33336 * 9 );
+	check_typematic( press_time, 250000, 33336, 10, __LINE__ );
+	send_keys( 0, 0 );
+	EXPECT( run( 1000 ), 0xF0, 0x21 );
+
+	//	0xF3 0x7F: 1000ms, 500.04ms (2 characters/sec)
+	command_fifo.push_back( 0xF3 );
+	command_fifo.push_back( 0x7F );
+	EXPECT( run( 1000 ), 0xFA, 0xFA );
+	send_keys( 0, USAGE_C );
+	press_time = host_time_us;
+	EXPECT( run( TASK_STEP_US ), 0x21 );
+	bytes = run( 1000000 + 500040 );
+	check_typematic( press_time, 1000000, 500040, 2, __LINE__ );
+	send_keys( 0, 0 );
+	EXPECT( run( 1000 ), 0xF0, 0x21 );
+}
+
+// --------------------------------------------------------------------
+//	Latency: from the USB report to the scancode handed to the send FIFO
+//
+static void test_latency( void ) {
+	U2K_LATENCY_T latency;
+
+	reset_keyboard();
+	u2k_reset_latency();
+	send_keys( 0, USAGE_A );
+	host_time_us += 300;
+	EXPECT( run( TASK_STEP_US ), 0x1C );
+	send_keys( 0, 0 );
+	host_time_us += 700;
+	EXPECT( run( TASK_STEP_US ), 0xF0, 0x1C );
+	u2k_get_latency( &latency );
+	printf( "latency: n=%lu min=%luus avg=%luus max=%luus\n", (unsigned long) latency.count,
+		(unsigned long) latency.min_us, (unsigned long) latency.average_us, (unsigned long) latency.max_us );
+	CHECK( latency.count == 2 && latency.min_us == 300 && latency.max_us == 700 && latency.average_us == 500 );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	usb_init();
+	u2k_init();
+	EXPECT( sent_bytes, 0xAA );
+	tuh_hid_mount_cb( KEYBOARD_ADDR, 0, nullptr, 0 );
+	test_scancode();
+	test_bitmap_diff();
+	test_typematic();
+	test_latency();
+
+	if( error_count ) {
+		printf( "u2k_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "u2k_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,145 @@
+// --------------------------------------------------------------------
+//	Replay of the PS/2 transactions against u2p
+//
+//	usage:
+//		u2p_replay <corpus file>			... compare the responses
+//		u2p_replay <corpus file> --print	... print the responses in the corpus format
+//
+//	The corpus is the output of "tools/ps2_capture.py <log file> --corpus".
+//		H> [bytes of the host]
+//		<I [bytes of the indicator]
+//	The host bytes of each transaction are sent to u2p, and the bytes sent by
+//	u2p are compared with the <I line. The stub has no USB device, so the
+//	capture must be taken without the USB mouse and gamepad. (0xEB returns
+//	no movement.)
+// --------------------------------------------------------------------
+
+#include "host_stub.h"
+#include "u2p.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//	Idle time between the transactions [usec] (TRANSACTION_GAP of ps2_capture.py)
+#define TRANSACTION_GAP			5000
+
+//	Time between the host bytes [usec]
+#define BYTE_INTERVAL			100
+
+// --------------------------------------------------------------------
+static bool parse_bytes( const char *p_line, const char *p_prefix, std::vector<uint8_t> *p_bytes ) {
+	char *p_end;
+	long value;
+
+	p_bytes->clear();
+	if( strncmp( p_line, p_prefix, strlen( p_prefix ) ) != 0 ) {
+		return false;
+	}
+	p_line += strlen( p_prefix );
+	for(;;) {
+		value = strtol( p_line, &p_end, 16 );
+		if( p_end == p_line ) {
+			break;
+		}
+		if( value < 0 || value > 0xFF ) {
+			return false;
+		}
+		p_bytes->push_back( (uint8_t) value );
+		p_line = p_end;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------
+static std::string to_string( const std::vector<uint8_t> &bytes ) {
+	std::string s;
+	char s_byte[4];
+
+	for( size_t i = 0; i < bytes.size(); i++ ) {
+		snprintf( s_byte, sizeof(s_byte), (i == 0) ? "%02X" : " %02X", bytes[i] );
+		s += s_byte;
+	}
+	return s;
+}
+
+// --------------------------------------------------------------------
+static std::vector<uint8_t> replay( const std::vector<uint8_t> &host ) {
+	std::vector<uint8_t> device;
+	uint8_t buffer[ 64 ];
+	int i, length;
+
+	for( uint8_t data : host ) {
+		host_ps2_put( data );
+		for( i = 0; i < 4; i++ ) {
+			u2p_task();
+			host_advance_us( BYTE_INTERVAL / 4 );
+		}
+		length = host_ps2_get( buffer, sizeof(buffer) );
+		device.insert( device.end(), buffer, buffer + length );
+	}
+	host_advance_us( TRANSACTION_GAP );
+	u2p_task();
+	length = host_ps2_get( buffer, sizeof(buffer) );
+	device.insert( device.end(), buffer, buffer + length );
+	return device;
+}
+
+// --------------------------------------------------------------------
+int main( int argc, char *argv[] ) {
+	std::vector<uint8_t> host, expected, response;
+	char s_line[ 4096 ];
+	FILE *p_file;
+	bool is_print;
+	int line_number = 0, transactions = 0, errors = 0;
+
+	if( argc < 2 ) {
+		printf( "Usage> u2p_replay <corpus file> [--print]\n" );
+		return 1;
+	}
+	is_print = (argc >= 3 && strcmp( argv[2], "--print" ) == 0);
+	p_file = fopen( argv[1], "rt" );
+	if( p_file == nullptr ) {
+		printf( "ERROR: Cannot read the '%s'.\n", argv[1] );
+		return 1;
+	}
+
+	host_reset();
+	u2p_init();
+	while( fgets( s_line, sizeof(s_line), p_file ) != nullptr ) {
+		line_number++;
+		if( s_line[0] == '#' || s_line[0] == '\n' || s_line[0] == '\r' ) {
+			continue;
+		}
+		if( !parse_bytes( s_line, "H>", &host ) ) {
+			printf( "ERROR: line %d: 'H>' is expected.\n", line_number );
+			fclose( p_file );
+			return 1;
+		}
+		line_number++;
+		if( fgets( s_line, sizeof(s_line), p_file ) == nullptr || !parse_bytes( s_line, "<I", &expected ) ) {
+			printf( "ERROR: line %d: '<I' is expected.\n", line_number );
+			fclose( p_file );
+			return 1;
+		}
+		response = replay( host );
+		transactions++;
+		if( is_print ) {
+			printf( "H> %s\n<I %s\n", to_string( host ).c_str(), to_string( response ).c_str() );
+			continue;
+		}
+		if( response != expected ) {
+			printf( "NG: line %d: H> %s\n", line_number - 1, to_string( host ).c_str() );
+			printf( "    expected <I %s\n", to_string( expected ).c_str() );
+			printf( "    response <I %s\n", to_string( response ).c_str() );
+			errors++;
+		}
+	}
+	fclose( p_file );
+
+	if( !is_print ) {
+		printf( "u2p_replay: %d transactions, %d errors\n", transactions, errors );
+	}
+	return (errors != 0) ? 1 : 0;
+}
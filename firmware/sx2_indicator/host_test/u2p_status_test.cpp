@@ -0,0 +1,113 @@
+// --------------------------------------------------------------------
+//	Host test of the seqlock of u2p_get_status()
+//		The writer (core0) receives the delta mode status frames whose
+//		7 bytes are all the frame number, and the reader (core1) calls
+//		u2p_get_status() at the same time. Every copy must be one frame.
+// --------------------------------------------------------------------
+
+#include "host_stub.h"
+#include "u2p.h"
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+#define STATUS_FRAMES		300000
+#define STATUS_LENGTH		7
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Send a byte of the host, and discard the bytes sent by u2p
+//
+static void send_host( uint8_t data ) {
+	uint8_t buffer[ 16 ];
+	int i;
+
+	host_ps2_put( data );
+	for( i = 0; i < 2; i++ ) {
+		u2p_task();
+		host_advance_us( 100 );
+	}
+	host_ps2_get( buffer, sizeof(buffer) );
+}
+
+// --------------------------------------------------------------------
+//	0xEB and [length][change bitmap][data1...data7] (all changed)
+//	The length counts the change bitmap and the data.
+//
+static void send_frame( uint8_t value ) {
+	int i;
+
+	send_host( 0xEB );
+	send_host( STATUS_LENGTH + 1 );
+	send_host( 0x7F );
+	for( i = 0; i < STATUS_LENGTH; i++ ) {
+		send_host( value );
+	}
+}
+
+// --------------------------------------------------------------------
+static void test_torn_read( void ) {
+	std::atomic<bool> is_running( true );
+	U2P_STATUS_T status;
+	long reads = 0, torn = 0;
+	int i;
+
+	host_reset();
+	u2p_init();
+	send_host( 0xFF );
+	send_host( 0xF3 );
+	send_host( 0x11 );
+	send_frame( 0 );
+
+	std::thread writer( [&]() {
+		int n;
+		for( n = 1; n <= STATUS_FRAMES; n++ ) {
+			send_frame( (uint8_t) n );
+		}
+		is_running = false;
+	} );
+
+	while( is_running ) {
+		u2p_get_status( &status );
+		reads++;
+		if( status.length != STATUS_LENGTH ) {
+			torn++;
+			continue;
+		}
+		for( i = 1; i < STATUS_LENGTH; i++ ) {
+			if( status.data[i] != status.data[0] ) {
+				torn++;
+				break;
+			}
+		}
+	}
+	writer.join();
+	u2p_get_status( &status );
+	printf( "torn read: %d frames, %ld reads, %ld torn\n", STATUS_FRAMES, reads, torn );
+	CHECK( torn == 0 );
+	CHECK( status.data[0] == (uint8_t) STATUS_FRAMES && status.data[ STATUS_LENGTH - 1 ] == (uint8_t) STATUS_FRAMES );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	test_torn_read();
+
+	if( error_count ) {
+		printf( "u2p_status_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "u2p_status_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,249 @@
+// --------------------------------------------------------------------
+//	Host test of u2p (PS/2 mouse command and OCM status frame)
+// --------------------------------------------------------------------
+
+#include "host_stub.h"
+#include "u2p.h"
+#include "asset.h"
+#include <cstdio>
+#include <vector>
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Send the bytes of the host, and return the bytes sent by u2p.
+//	u2p_task() is called for each byte like the main loop.
+//
+static std::vector<uint8_t> transaction( const std::vector<uint8_t> &host ) {
+	std::vector<uint8_t> device;
+	uint8_t buffer[ 64 ];
+	int i, length;
+
+	for( uint8_t data : host ) {
+		host_ps2_put( data );
+		for( i = 0; i < 4; i++ ) {
+			u2p_task();
+			host_advance_us( 100 );
+		}
+		length = host_ps2_get( buffer, sizeof(buffer) );
+		device.insert( device.end(), buffer, buffer + length );
+	}
+	return device;
+}
+
+// --------------------------------------------------------------------
+static void expect( const std::vector<uint8_t> &host, const std::vector<uint8_t> &expected, int line ) {
+	std::vector<uint8_t> response = transaction( host );
+
+	if( response != expected ) {
+		printf( "NG: line %d: response", line );
+		for( uint8_t d : response ) {
+			printf( " %02X", d );
+		}
+		printf( ", expected" );
+		for( uint8_t d : expected ) {
+			printf( " %02X", d );
+		}
+		printf( "\n" );
+		error_count++;
+	}
+}
+#define EXPECT( host, ... )		expect( host, { __VA_ARGS__ }, __LINE__ )
+#define HOST( ... )				{ __VA_ARGS__ }
+
+// --------------------------------------------------------------------
+static void test_reset( void ) {
+
+	host_reset();
+	EXPECT( HOST( 0xFF ), 0xFA, 0xAA, 0x10 );
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x10 );
+	EXPECT( HOST( 0x00 ), 0xFE );
+}
+
+// --------------------------------------------------------------------
+//	0xF3 0x11 (delta mode) and 0xEB: The 3 bytes packet is followed by the status frame.
+//	The frame must not be received as commands.
+//
+static void test_delta_mode_read_data( void ) {
+	U2P_STATUS_T status;
+
+	host_reset();
+	host_mouse_move( 3, -2, 0, 0x01 );
+	EXPECT( HOST( 0xFF ), 0xFA, 0xAA, 0x10 );
+	EXPECT( HOST( 0xF3, 0x11 ), 0xFA, 0xFA );
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x11 );
+
+	//	[length][change bitmap][data1][data3]
+	EXPECT( HOST( 0xEB ), 0xFA, 0x09, 0x03, 0x02 );
+	EXPECT( HOST( 0x03, 0x05, 0x21, 0x23 ) );
+	u2p_get_status( &status );
+	CHECK( status.length == 3 );
+	CHECK( status.data[ U2P_DATA1 ] == 0x21 );
+	CHECK( status.data[ U2P_DATA3 ] == 0x23 );
+	CHECK( host_ps2_calibration_count( true ) == 1 );
+
+	//	Only data2 changes.
+	EXPECT( HOST( 0xEB ), 0xFA, 0x09, 0x00, 0x00 );
+	EXPECT( HOST( 0x02, 0x02, 0x42 ) );
+	u2p_get_status( &status );
+	CHECK( status.data[ U2P_DATA1 ] == 0x21 );
+	CHECK( status.data[ U2P_DATA2 ] == 0x42 );
+	CHECK( status.data[ U2P_DATA3 ] == 0x23 );
+	CHECK( host_ps2_calibration_count( true ) == 2 );
+	CHECK( host_ps2_calibration_count( false ) == 0 );
+
+	//	It is still the delta mode.
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x11 );
+}
+
+// --------------------------------------------------------------------
+//	Delta mode frames whose change bitmap does not match the data are discarded.
+//	The status keeps the last good frame, and the next frame is received.
+//
+static void test_delta_mode_frame_error( void ) {
+	U2P_STATUS_T status;
+
+	host_reset();
+	EXPECT( HOST( 0xFF ), 0xFA, 0xAA, 0x10 );
+	EXPECT( HOST( 0xF3, 0x11 ), 0xFA, 0xFA );
+	EXPECT( HOST( 0xEB ), 0xFA, 0x00, 0x00, 0x00 );
+	EXPECT( HOST( 0x04, 0x07, 0x11, 0x12, 0x13 ) );
+
+	//	More data than the bits: data2 only, but 2 bytes follow
+	EXPECT( HOST( 0xEB ), 0xFA, 0x00, 0x00, 0x00 );
+	EXPECT( HOST( 0x03, 0x02, 0x52, 0x53 ) );
+	//	Less data than the bits: data2 and data3, but 1 byte follows
+	EXPECT( HOST( 0xEB ), 0xFA, 0x00, 0x00, 0x00 );
+	EXPECT( HOST( 0x02, 0x06, 0x62 ) );
+	//	Change bitmap longer than DELTA_BITMAP_MAX_BYTES
+	EXPECT( HOST( 0xEB ), 0xFA, 0x00, 0x00, 0x00 );
+	EXPECT( HOST( 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0x71 ) );
+	u2p_get_status( &status );
+	CHECK( status.length == 3 );
+	CHECK( status.data[ U2P_DATA1 ] == 0x11 );
+	CHECK( status.data[ U2P_DATA2 ] == 0x12 );
+	CHECK( status.data[ U2P_DATA3 ] == 0x13 );
+
+	EXPECT( HOST( 0xEB ), 0xFA, 0x00, 0x00, 0x00 );
+	EXPECT( HOST( 0x02, 0x04, 0x83 ) );
+	u2p_get_status( &status );
+	CHECK( status.data[ U2P_DATA2 ] == 0x12 );
+	CHECK( status.data[ U2P_DATA3 ] == 0x83 );
+	CHECK( host_ps2_calibration_count( false ) == 0 );
+
+	//	It is still the delta mode, and the stream is in sync.
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x11 );
+}
+
+// --------------------------------------------------------------------
+//	IntelliMouse: 0xEB is answered by the 4 bytes packet only.
+//
+static void test_intellimouse_read_data( void ) {
+
+	host_reset();
+	host_mouse_move( 1, 1, 2, 0 );
+	EXPECT( HOST( 0xFF ), 0xFA, 0xAA, 0x10 );
+	EXPECT( HOST( 0xF3, 200, 0xF3, 100, 0xF3, 80 ), 0xFA, 0xFA, 0xFA, 0xFA, 0xFA, 0xFA );
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x03 );
+	EXPECT( HOST( 0xEB ), 0xFA, 0x28, 0x01, 0xFF, 0xFE );
+	EXPECT( HOST( 0xF2 ), 0xFA, 0x03 );
+}
+
+// --------------------------------------------------------------------
+//	[0xE2][sequence][slot][offset L][offset H][length][data x length][checksum]
+//
+static std::vector<uint8_t> asset_chunk( uint8_t sequence, uint8_t slot, int offset, const uint8_t *p_data, int length ) {
+	std::vector<uint8_t> chunk = { 0xE2, sequence, slot, (uint8_t) offset, (uint8_t)(offset >> 8), (uint8_t) length };
+	uint8_t checksum = 0;
+	size_t i;
+
+	chunk.insert( chunk.end(), p_data, p_data + length );
+	for( i = 1; i < chunk.size(); i++ ) {
+		checksum += chunk[i];
+	}
+	chunk.push_back( (uint8_t) -checksum );
+	return chunk;
+}
+
+// --------------------------------------------------------------------
+//	Stop-and-wait upload of the font slot (768 bytes = 255 + 255 + 255 + 3)
+//
+static void test_asset_upload( void ) {
+	static const uint8_t rom[1] = {};
+	uint8_t font[ 768 ];
+	std::vector<uint8_t> chunk;
+	const uint8_t *p_font;
+	int i;
+
+	host_reset();
+	for( i = 0; i < (int) sizeof(font); i++ ) {
+		font[i] = (uint8_t)(i * 7 + 1);
+	}
+	EXPECT( HOST( 0xFF ), 0xFA, 0xAA, 0x10 );
+	EXPECT( HOST( 0xE3, ASSET_SLOT_FONT ), 0xFA, 0xFA );
+	EXPECT( asset_chunk( 0, ASSET_SLOT_FONT, 0, font, 255 ), 0xFA, 0x00 );
+
+	//	Broken checksum: Rejected.
+	chunk = asset_chunk( 1, ASSET_SLOT_FONT, 255, font + 255, 255 );
+	chunk[ 10 ] ^= 0xFF;
+	EXPECT( chunk, 0xFE, 0x01 );
+
+	//	Gap (chunk 2 before chunk 1): Rejected.
+	EXPECT( asset_chunk( 1, ASSET_SLOT_FONT, 510, font + 510, 255 ), 0xFE, 0x01 );
+
+	//	The slot is incomplete, so it is not committed.
+	EXPECT( HOST( 0xE4, ASSET_SLOT_FONT ), 0xFA, 0xFA, 0x00, 0x00 );
+	CHECK( asset_get( ASSET_SLOT_FONT, rom ) == rom );
+
+	EXPECT( asset_chunk( 1, ASSET_SLOT_FONT, 255, font + 255, 255 ), 0xFA, 0x01 );
+
+	//	Broken data over the received bytes: Rejected, and the received bytes are kept.
+	chunk = asset_chunk( 2, ASSET_SLOT_FONT, 0, font, 255 );
+	chunk[ 16 ] ^= 0x55;
+	EXPECT( chunk, 0xFE, 0x02 );
+
+	EXPECT( asset_chunk( 2, ASSET_SLOT_FONT, 510, font + 510, 255 ), 0xFA, 0x02 );
+
+	//	The answer was lost, and the host sends the chunk 2 again.
+	EXPECT( asset_chunk( 2, ASSET_SLOT_FONT, 510, font + 510, 255 ), 0xFE, 0x03 );
+	EXPECT( asset_chunk( 3, ASSET_SLOT_FONT, 765, font + 765, 3 ), 0xFA, 0x03 );
+
+	chunk = transaction( HOST( 0xE4, ASSET_SLOT_FONT ) );
+	CHECK( chunk.size() == 4 && (chunk[2] != 0 || chunk[3] != 0) );
+	p_font = (const uint8_t*) asset_get( ASSET_SLOT_FONT, rom );
+	CHECK( p_font != rom );
+	for( i = 0; p_font != rom && i < (int) sizeof(font); i++ ) {
+		if( p_font[i] != font[i] ) {
+			CHECK( p_font[i] == font[i] );
+			break;
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	u2p_init();
+	test_reset();
+	test_delta_mode_read_data();
+	test_delta_mode_frame_error();
+	test_intellimouse_read_data();
+	test_asset_upload();
+
+	if( error_count ) {
+		printf( "u2p_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "u2p_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,436 @@
+// --------------------------------------------------------------------
+//	Host test of the mouse accumulator of usb_host_driver.c
+//		The USB report traces are replayed into tuh_hid_report_received_cb(),
+//		and get_mouse_position() takes the movement like u2p. The movement
+//		taken (x256) must be the sum of x * gain of the reports, except for
+//		the fraction (less than 1 count) left in each mouse.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <tusb.h>
+#include "usb_host_driver.h"
+
+#define BOOT_MOUSE_ADDR		1			//	Boot protocol, 8-bit X/Y
+#define WIDE_MOUSE_ADDR		2			//	Report protocol, report ID 2, 16-bit X/Y
+#define WIDE_MOUSE_ID		2
+#define MOUSE_LIMIT_MAX		(1023 + 32767)	//	MOUSE_DELTA_MAX + MOUSE_CARRY_MAX
+#define PLAN_CACHE_SIZE		4				//	usb_host_driver.c
+
+volatile uint64_t host_time_us = 1000000;
+
+static int error_count = 0;
+static uint8_t itf_protocol = HID_ITF_PROTOCOL_MOUSE;
+static int parse_count = 0;				//	tuh_hid_parse_report_descriptor()
+static int set_report_protocol_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	TinyUSB
+// --------------------------------------------------------------------
+uint8_t tuh_hid_interface_protocol( uint8_t dev_addr, uint8_t instance ) {
+	(void) dev_addr;
+	(void) instance;
+	return itf_protocol;
+}
+
+bool tuh_hid_receive_report( uint8_t dev_addr, uint8_t instance ) {
+	(void) dev_addr;
+	(void) instance;
+	return true;
+}
+
+bool tuh_hid_set_protocol( uint8_t dev_addr, uint8_t instance, uint8_t protocol ) {
+	(void) dev_addr;
+	(void) instance;
+	if( protocol == HID_PROTOCOL_REPORT ) {
+		set_report_protocol_count++;
+	}
+	return true;
+}
+
+bool tuh_hid_set_report( uint8_t dev_addr, uint8_t instance, uint8_t report_id, uint8_t report_type, void *p_report, uint16_t len ) {
+	(void) dev_addr;
+	(void) instance;
+	(void) report_id;
+	(void) report_type;
+	(void) p_report;
+	(void) len;
+	return true;
+}
+
+bool tuh_vid_pid_get( uint8_t dev_addr, uint16_t *p_vid, uint16_t *p_pid ) {
+	*p_vid = 0x046D;
+	*p_pid = 0xC000 + dev_addr;
+	return true;
+}
+
+uint8_t tuh_hid_parse_report_descriptor( tuh_hid_report_info_t *p_info, uint8_t arr_count, uint8_t const *p_desc, uint16_t desc_len ) {
+	(void) p_info;
+	(void) arr_count;
+	(void) p_desc;
+	(void) desc_len;
+	parse_count++;
+	return 0;
+}
+
+// --------------------------------------------------------------------
+//	Report descriptor of the 16-bit mouse (report ID 2)
+//		[ID][buttons][X L][X H][Y L][Y H][wheel]
+static const uint8_t wide_mouse_descriptor[] = {
+	0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, WIDE_MOUSE_ID, 0x09, 0x01, 0xA1, 0x00,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02,
+	0x95, 0x01, 0x75, 0x03, 0x81, 0x01,
+	0x05, 0x01, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06,
+	0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06,
+	0xC0, 0xC0,
+};
+
+// --------------------------------------------------------------------
+//	Reference model of the acceleration curves (the same as mouse_curves[])
+static USB_MOUSE_CURVE_POINT_T model_curves[ USB_MOUSE_RESOLUTIONS ][ USB_MOUSE_CURVE_POINTS ] = {
+	{ {  0,  64 } },
+	{ {  0, 128 } },
+	{ {  0, 256 } },
+	{ {  0, 256 }, {  6, 384 }, { 16, 512 } },
+};
+static int model_curve_points[ USB_MOUSE_RESOLUTIONS ] = { 1, 1, 1, 3 };
+static int model_resolution = USB_MOUSE_DEFAULT_RESOLUTION;
+
+static int32_t model_gain( int x, int y ) {
+	int speed = (abs( x ) > abs( y )) ? abs( x ) : abs( y );
+	int32_t gain = model_curves[ model_resolution ][0].gain;
+	int i;
+
+	for( i = 1; i < model_curve_points[ model_resolution ]; i++ ) {
+		if( speed < model_curves[ model_resolution ][i].speed ) {
+			break;
+		}
+		gain = model_curves[ model_resolution ][i].gain;
+	}
+	return gain;
+}
+
+static void set_resolution( int resolution ) {
+
+	usb_set_mouse_resolution( resolution );
+	model_resolution = resolution;
+}
+
+static void set_curve( int resolution, const USB_MOUSE_CURVE_POINT_T *p_curve, int count ) {
+
+	usb_set_mouse_curve( resolution, p_curve, count );
+	memcpy( model_curves[ resolution ], p_curve, sizeof(p_curve[0]) * count );
+	model_curve_points[ resolution ] = count;
+}
+
+// --------------------------------------------------------------------
+//	Movement sent (Q8, the sum of x * gain) and taken
+static volatile int64_t sent_q8_x = 0, sent_q8_y = 0;
+static volatile int64_t taken_x = 0, taken_y = 0;
+
+// --------------------------------------------------------------------
+static void send_boot( int x, int y ) {
+	hid_mouse_report_t report = { 0, (int8_t) x, (int8_t) y, 0, 0 };
+	int32_t gain = model_gain( x, y );
+
+	tuh_hid_report_received_cb( BOOT_MOUSE_ADDR, 0, (const uint8_t*) &report, 3 );
+	sent_q8_x += (int64_t) x * gain;
+	sent_q8_y += (int64_t) y * gain;
+}
+
+// --------------------------------------------------------------------
+static void send_wide( int x, int y ) {
+	uint8_t report[7] = { WIDE_MOUSE_ID, 0, (uint8_t) x, (uint8_t)(x >> 8), (uint8_t) y, (uint8_t)(y >> 8), 0 };
+	int32_t gain = model_gain( x, y );
+
+	tuh_hid_report_received_cb( WIDE_MOUSE_ADDR, 0, report, sizeof(report) );
+	sent_q8_x += (int64_t) x * gain;
+	sent_q8_y += (int64_t) y * gain;
+}
+
+// --------------------------------------------------------------------
+//	Take the movement like u2p (limit 127: IntelliMouse, 255: 3 bytes packet)
+//
+static bool take( int16_t limit ) {
+	int16_t x, y, wheel;
+	int32_t button;
+
+	get_mouse_position( &x, &y, &wheel, &button, limit );
+	CHECK( abs( x ) <= limit && abs( y ) <= limit );
+	taken_x += x;
+	taken_y += y;
+	return( x != 0 || y != 0 );
+}
+
+static void drain( void ) {
+	int idle = 0;
+
+	while( idle < 2 ) {
+		idle = take( 255 ) ? 0 : (idle + 1);
+	}
+	CHECK( !is_mouse_updated() );
+}
+
+//	u2p keeps up with the mouse: the movement left is kept under backlog (beyond the
+//	packed field, but under MOUSE_CARRY_MAX). The backlog must be 2 or more, because
+//	the fractions of the 2 mice are not taken. If nothing is left, the movement is
+//	lost (check_conservation() reports it).
+static void catch_up( int16_t limit, int backlog ) {
+
+	while( llabs( sent_q8_x / 256 - taken_x ) > backlog || llabs( sent_q8_y / 256 - taken_y ) > backlog ) {
+		if( !take( limit ) ) {
+			break;
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Only the fraction of each mouse (less than 1 count) may be left
+//
+static void check_conservation( const char *p_name, int mice ) {
+	int64_t rest_x = sent_q8_x - taken_x * 256;
+	int64_t rest_y = sent_q8_y - taken_y * 256;
+
+	printf( "%s: sent (%.2f, %.2f), taken (%lld, %lld)\n", p_name,
+		sent_q8_x / 256.0, sent_q8_y / 256.0, (long long) taken_x, (long long) taken_y );
+	CHECK( llabs( rest_x ) < 256 * mice && llabs( rest_y ) < 256 * mice );
+}
+
+// --------------------------------------------------------------------
+static void mount_mice( void ) {
+
+	tuh_hid_mount_cb( BOOT_MOUSE_ADDR, 0, NULL, 0 );
+	tuh_hid_mount_cb( WIDE_MOUSE_ADDR, 0, wide_mouse_descriptor, sizeof(wide_mouse_descriptor) );
+	tuh_hid_set_protocol_complete_cb( WIDE_MOUSE_ADDR, 0, HID_PROTOCOL_REPORT );
+	CHECK( is_mouse_active() );
+}
+
+// --------------------------------------------------------------------
+//	Mount the mice again, so no fraction is left from the last test
+//
+static void reset_counts( void ) {
+
+	tuh_hid_umount_cb( BOOT_MOUSE_ADDR, 0 );
+	tuh_hid_umount_cb( WIDE_MOUSE_ADDR, 0 );
+	mount_mice();
+	drain();
+	sent_q8_x = 0;
+	sent_q8_y = 0;
+	taken_x = 0;
+	taken_y = 0;
+}
+
+// --------------------------------------------------------------------
+//	Traces: flick (ramp up to the full speed and down), crawl (1 count at x0.25),
+//	and the random movement. u2p takes at random times.
+//
+static void test_traces( void ) {
+	static const USB_MOUSE_CURVE_POINT_T odd_curve[] = { { 0, 77 }, { 3, 300 }, { 40, 700 }, { 200, 1000 } };
+	int resolution, i, step, x, y;
+
+	set_curve( 1, odd_curve, 4 );
+	for( resolution = 0; resolution < USB_MOUSE_RESOLUTIONS; resolution++ ) {
+		set_resolution( resolution );
+		reset_counts();
+
+		//	Flick of the boot mouse
+		for( i = -127; i <= 127; i++ ) {
+			send_boot( 127 - abs( i ), -(127 - abs( i )) / 2 );
+			if( (i & 7) == 0 ) {
+				catch_up( 127, 3000 );
+			}
+		}
+		//	Crawl
+		for( i = 0; i < 1000; i++ ) {
+			send_boot( (i & 1) ? 1 : 0, -1 );
+			if( (rand() % 50) == 0 ) {
+				take( 255 );
+			}
+		}
+		//	Flick of the 16-bit mouse beyond the packed field (1023)
+		for( i = 0; i < 20; i++ ) {
+			send_wide( 3000 - i * 150, -2000 + i * 100 );
+			catch_up( 255, 3000 );
+		}
+		//	Random, both mice
+		for( step = 0; step < 50000; step++ ) {
+			x = (rand() % 255) - 127;
+			y = (rand() % 255) - 127;
+			if( (rand() & 1) == 0 ) {
+				send_boot( x, y );
+			}
+			else {
+				send_wide( x * 2, y * 2 );
+			}
+			if( (rand() % 3) == 0 ) {
+				catch_up( (rand() & 1) ? 127 : 255, 2 + rand() % 2000 );
+			}
+		}
+		drain();
+		printf( "resolution %d ", resolution );
+		check_conservation( "traces", 2 );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Without get_mouse_position(), the movement saturates at MOUSE_CARRY_MAX
+//	(no wrap around)
+//
+static void test_saturation( void ) {
+	int i;
+
+	set_resolution( 2 );
+	reset_counts();
+	for( i = 0; i < 100; i++ ) {
+		send_wide( 2000, -2000 );
+	}
+	drain();
+	CHECK( taken_x == MOUSE_LIMIT_MAX && taken_y == -MOUSE_LIMIT_MAX );
+	printf( "saturation: sent (%lld, %lld), taken (%lld, %lld)\n",
+		(long long)(sent_q8_x / 256), (long long)(sent_q8_y / 256), (long long) taken_x, (long long) taken_y );
+}
+
+// --------------------------------------------------------------------
+//	core0 (USB callbacks) and core1 (u2p) as two threads
+//
+#define THREAD_REPORTS	200000
+
+static volatile bool is_core0_done = false;
+
+static void *core0_thread( void *p_arg ) {
+	int i;
+
+	(void) p_arg;
+	for( i = 0; i < THREAD_REPORTS; i++ ) {
+		//	Keep the movement under MOUSE_CARRY_MAX (the test does not want the saturation)
+		while( (llabs( sent_q8_x / 256 - taken_x ) > 20000 || llabs( sent_q8_y / 256 - taken_y ) > 20000) && is_mouse_updated() ) {
+			sched_yield();
+		}
+		if( i & 1 ) {
+			send_boot( (i % 255) - 127, 127 - ((i / 3) % 255) );
+		}
+		else {
+			send_wide( ((i / 5) % 1001) - 500, 300 - ((i / 7) % 601) );
+		}
+	}
+	__sync_synchronize();
+	is_core0_done = true;
+	return NULL;
+}
+
+static void test_two_cores( void ) {
+	pthread_t thread;
+	long takes = 0;
+
+	set_resolution( 3 );
+	reset_counts();
+	is_core0_done = false;
+	pthread_create( &thread, NULL, core0_thread, NULL );
+	while( !is_core0_done ) {
+		if( !take( 255 ) ) {
+			sched_yield();
+		}
+		takes++;
+	}
+	pthread_join( thread, NULL );
+	drain();
+	printf( "two cores: %d reports, %ld takes\n", THREAD_REPORTS, takes );
+	check_conservation( "two cores", 2 );
+}
+
+// --------------------------------------------------------------------
+//	Mount and unmount the interface, and return true if the parsed report
+//	descriptor was reused
+//
+static bool remount( uint8_t dev_addr, uint8_t protocol, uint16_t desc_len ) {
+	USB_MOUNT_STATISTICS_T before, after;
+
+	itf_protocol = protocol;
+	usb_get_mount_statistics( &before );
+	tuh_hid_mount_cb( dev_addr, 0, wide_mouse_descriptor, desc_len );
+	tuh_hid_umount_cb( dev_addr, 0 );
+	itf_protocol = HID_ITF_PROTOCOL_MOUSE;
+	usb_get_mount_statistics( &after );
+	CHECK( after.mount_count == before.mount_count + 1 );
+	return( after.cache_hit_count != before.cache_hit_count );
+}
+
+// --------------------------------------------------------------------
+//	Cache of the parsed report descriptors: the key is VID, PID (dev_addr in
+//	this test), the interface, the interface protocol and the descriptor length.
+//
+static void test_plan_cache( void ) {
+	static const uint8_t report[7] = { WIDE_MOUSE_ID, 0, 0, 0, 0, 0, 0 };
+	USB_MOUNT_STATISTICS_T statistics;
+	int set_count, parse, i;
+
+	//	Remount: the plan is reused, and the mouse switches to the report protocol
+	CHECK( !remount( 10, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	set_count = set_report_protocol_count;
+	CHECK( remount( 10, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( set_report_protocol_count == set_count + 1 );
+
+	//	Another descriptor length or interface protocol is another entry
+	CHECK( !remount( 10, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) - 2 ) );
+	parse = parse_count;
+	CHECK( !remount( 10, HID_ITF_PROTOCOL_NONE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( parse_count == parse + 1 );
+	CHECK( remount( 10, HID_ITF_PROTOCOL_NONE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( parse_count == parse + 1 );
+
+	//	Eviction: 20 is used again, so 21 is the least recently used one
+	for( i = 20; i < 20 + PLAN_CACHE_SIZE; i++ ) {
+		CHECK( !remount( (uint8_t) i, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	}
+	CHECK( remount( 20, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( !remount( 30, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( remount( 22, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( remount( 23, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( remount( 20, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( remount( 30, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+	CHECK( !remount( 21, HID_ITF_PROTOCOL_MOUSE, sizeof(wide_mouse_descriptor) ) );
+
+	//	Time from the mount to the first report (the mount time has bit0 set)
+	tuh_hid_mount_cb( 10, 0, wide_mouse_descriptor, sizeof(wide_mouse_descriptor) );
+	host_time_us += 1234;
+	tuh_hid_report_received_cb( 10, 0, report, sizeof(report) );
+	host_time_us += 1000;
+	tuh_hid_report_received_cb( 10, 0, report, sizeof(report) );
+	tuh_hid_umount_cb( 10, 0 );
+	usb_get_mount_statistics( &statistics );
+	printf( "plan cache: %lu mounts, %lu hits, first report %luus\n", (unsigned long) statistics.mount_count,
+		(unsigned long) statistics.cache_hit_count, (unsigned long) statistics.last_first_report_us );
+	CHECK( statistics.last_first_report_us == 1234 || statistics.last_first_report_us == 1233 );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	srand( 2024 );
+	usb_init();
+	mount_mice();
+	test_traces();
+	test_saturation();
+	test_two_cores();
+	test_plan_cache();
+
+	if( error_count ) {
+		printf( "usb_mouse_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "usb_mouse_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,154 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator input latency trace
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <pico/time.h>
+#include <hardware/sync.h>
+#include "latency_trace.h"
+
+//	REPORT is called on the core of usb_task(), and the others on the core of ps2dev_task().
+//	They can be different cores (SX2_CORE_LAYOUT), so report_time is published before
+//	is_reported. The sample is only for the statistics, so no lock is used.
+static uint32_t histogram[ LATENCY_TRACE_BUCKETS ];
+static uint32_t sample_count = 0;
+static uint32_t max_us = 0;
+static uint32_t report_time;
+static volatile bool is_reported = false;
+static uint32_t packet_time;
+static uint32_t packet_byte_index;
+static bool is_packet_armed = false;
+
+// --------------------------------------------------------------------
+static int get_bucket( uint32_t us ) {
+	int octave, bucket;
+
+	if( us < 8 ) {
+		return (int) us;
+	}
+	octave = 31 - __builtin_clz( us );
+	bucket = 8 + (octave - 3) * 4 + (int)((us >> (octave - 2)) & 3);
+	if( bucket >= LATENCY_TRACE_BUCKETS ) {
+		bucket = LATENCY_TRACE_BUCKETS - 1;
+	}
+	return bucket;
+}
+
+// --------------------------------------------------------------------
+static uint32_t get_bucket_upper_bound( int bucket ) {
+	int octave, sub;
+
+	if( bucket < 8 ) {
+		return (uint32_t) bucket;
+	}
+	octave = 3 + (bucket - 8) / 4;
+	sub = (bucket - 8) % 4;
+	return ((uint32_t)(5 + sub) << (octave - 2)) - 1;
+}
+
+// --------------------------------------------------------------------
+static uint32_t get_percentile( uint32_t percent ) {
+	uint32_t target, sum = 0;
+	int i;
+
+	if( sample_count == 0 ) {
+		return 0;
+	}
+	target = (uint32_t)(((uint64_t) sample_count * percent + 99) / 100);
+	for( i = 0; i < LATENCY_TRACE_BUCKETS; i++ ) {
+		sum += histogram[i];
+		if( sum >= target ) {
+			break;
+		}
+	}
+	if( i >= LATENCY_TRACE_BUCKETS || get_bucket_upper_bound( i ) > max_us ) {
+		return max_us;
+	}
+	return get_bucket_upper_bound( i );
+}
+
+// --------------------------------------------------------------------
+void latency_trace_report( void ) {
+
+	if( is_reported ) {
+		return;
+	}
+	report_time = time_us_32();
+	__dmb();
+	is_reported = true;
+}
+
+// --------------------------------------------------------------------
+void latency_trace_take( uint32_t byte_index ) {
+
+	if( !is_reported || is_packet_armed ) {
+		return;
+	}
+	__dmb();
+	packet_time = report_time;
+	packet_byte_index = byte_index;
+	is_packet_armed = true;
+	is_reported = false;
+}
+
+// --------------------------------------------------------------------
+void latency_trace_sent( uint32_t byte_index ) {
+	uint32_t us;
+
+	if( !is_packet_armed || byte_index != packet_byte_index ) {
+		return;
+	}
+	us = time_us_32() - packet_time;
+	is_packet_armed = false;
+	histogram[ get_bucket( us ) ]++;
+	sample_count++;
+	if( us > max_us ) {
+		max_us = us;
+	}
+}
+
+// --------------------------------------------------------------------
+void latency_trace_get_summary( LATENCY_TRACE_SUMMARY_T *p_summary ) {
+
+	p_summary->count	= sample_count;
+	p_summary->p50_us	= get_percentile( 50 );
+	p_summary->p99_us	= get_percentile( 99 );
+	p_summary->max_us	= max_us;
+}
+
+// --------------------------------------------------------------------
+void latency_trace_dump( void ) {
+	LATENCY_TRACE_SUMMARY_T summary;
+	int i;
+
+	latency_trace_get_summary( &summary );
+	printf( "LATENCY n=%lu p50=%luus p99=%luus max=%luus\r\n", 
+		(unsigned long) summary.count, (unsigned long) summary.p50_us, 
+		(unsigned long) summary.p99_us, (unsigned long) summary.max_us );
+	for( i = 0; i < LATENCY_TRACE_BUCKETS; i++ ) {
+		if( histogram[i] != 0 ) {
+			printf( "LATENCY %luus %lu\r\n", (unsigned long) get_bucket_upper_bound( i ), (unsigned long) histogram[i] );
+		}
+	}
+}
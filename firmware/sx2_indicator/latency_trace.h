@@ -0,0 +1,123 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator input latency trace
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __LATENCY_TRACE_H__
+#define __LATENCY_TRACE_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		//	1: Measure the latency from the USB mouse report to the PS/2 byte
+		//		A movement is tagged when the USB report arrives (LATENCY_TRACE_REPORT),
+		//		when u2p takes it into a packet (LATENCY_TRACE_TAKE), and when the first
+		//		byte of the packet starts on PS2DAT (LATENCY_TRACE_SENT).
+		//		If it is 0, the tags are removed and nothing is compiled.
+		#ifndef LATENCY_TRACE
+		#define LATENCY_TRACE			0
+		#endif
+
+		//	Interval of latency_trace_dump() called by main() [msec]
+		#define LATENCY_TRACE_DUMP_INTERVAL	10000
+
+		//	Histogram
+		//		0 ... 7usec: 1usec step, and 4 buckets per octave above it (up to 33sec).
+		#define LATENCY_TRACE_BUCKETS	96
+
+		typedef struct {
+			uint32_t	count;
+			uint32_t	p50_us;			//	Upper bound of the bucket
+			uint32_t	p99_us;			//	Upper bound of the bucket
+			uint32_t	max_us;
+		} LATENCY_TRACE_SUMMARY_T;
+
+		#if LATENCY_TRACE
+			#define LATENCY_TRACE_REPORT()				latency_trace_report()
+			#define LATENCY_TRACE_TAKE( byte_index )	latency_trace_take( byte_index )
+			#define LATENCY_TRACE_SENT( byte_index )	latency_trace_sent( byte_index )
+		#else
+			#define LATENCY_TRACE_REPORT()
+			#define LATENCY_TRACE_TAKE( byte_index )
+			#define LATENCY_TRACE_SENT( byte_index )
+		#endif
+
+		// --------------------------------------------------------------------
+		//	Tag: The USB mouse report is received
+		//	input:
+		//		none
+		//	output:
+		//		none
+		//	comment:
+		//		Only the first report after the last take is tagged, so the
+		//		oldest movement in a packet is measured.
+		// --------------------------------------------------------------------
+		void latency_trace_report( void );
+
+		// --------------------------------------------------------------------
+		//	Tag: The movement is taken into a packet
+		//	input:
+		//		byte_index ...... Index of the first byte of the packet in the send FIFO
+		//		                  of the mouse port (ps2dev_get_send_push_count())
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void latency_trace_take( uint32_t byte_index );
+
+		// --------------------------------------------------------------------
+		//	Tag: A byte starts on PS2DAT
+		//	input:
+		//		byte_index ...... Index of the byte in the send FIFO of the mouse port
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void latency_trace_sent( uint32_t byte_index );
+
+		// --------------------------------------------------------------------
+		//	Get summary
+		//	input:
+		//		p_summary ....... Address of buffer to return the summary.
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void latency_trace_get_summary( LATENCY_TRACE_SUMMARY_T *p_summary );
+
+		// --------------------------------------------------------------------
+		//	Print the summary and the histogram to stdio
+		//	input:
+		//		none
+		//	output:
+		//		none
+		//	comment:
+		//		"LATENCY n=... p50=...us p99=...us max=...us", and "LATENCY <upper bound>us <count>"
+		//		for each non-empty bucket.
+		// --------------------------------------------------------------------
+		void latency_trace_dump( void );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -41,6 +41,11 @@ using namespace std;
 #include "usb_host_driver.h"
 #include "ps2dev_driver.h"
 #include "u2p.h"
+#include "u2k.h"
+#include "asset.h"
+#include "status_history.h"
+#include "latency_trace.h"
+#include "scheduler.h"
 
 #define IMAGE_WIDTH		240
 #define IMAGE_HEIGHT	135
@@ -97,8 +102,39 @@ using namespace std;
 #define BIT(d,n)		(((d) >> (n)) & 1)
 #define BITS(d,n,b)		(((d) >> (n)) & ((1 << (b)) - 1) )
 
+//	The volume changed within this period is drawn in VOLUME_HIGHLIGHT_COLOR [msec]
+#define VOLUME_HIGHLIGHT_PERIOD		1500
+#define VOLUME_HIGHLIGHT_COLOR		0xE0FF		//	Yellow (0xFFE0 in the byte order of the TFT)
+#define VOLUME_HIGHLIGHT_SAMPLES	8
+
+//	Core layout
+//		SX2_LAYOUT_RENDER_CORE1 ... core0: USB host, PS/2, u2p, u2k
+//		                            core1: renderer (draws every frame)
+//		SX2_LAYOUT_PS2_CORE0 ...... core0: PS/2, u2p, u2k (nothing else stretches the PS/2 timing)
+//		                            core1: USB host, renderer (draws only when the status changes)
+//		The cores share the data through the hardware spinlock (mouse), the semaphore (key events)
+//		and the seqlock (status). The spinlock and the semaphore are locks: a core waits while the
+//		other copies a mouse packet or a key event (a few words). Only the status reader never
+//		blocks the writer (u2p on core0); it retries instead.
+//		In SX2_LAYOUT_PS2_CORE0, the renderer calls usb_task() between the bands of
+//		RENDER_BAND_LINES lines and while the previous frame is being sent, so tuh_task() is not
+//		delayed by a whole frame.
+#define SX2_LAYOUT_RENDER_CORE1		0
+#define SX2_LAYOUT_PS2_CORE0		1
+
+#ifndef SX2_CORE_LAYOUT
+#define SX2_CORE_LAYOUT				SX2_LAYOUT_RENDER_CORE1
+#endif
+
+//	The change-driven renderer draws at least once in this interval [msec]
+#define RENDER_REFRESH_INTERVAL		1000
+
+//	The renderer copies the background in the bands of this number of lines
+#define RENDER_BAND_LINES			16
+
 static uint16_t buffer1[ IMAGE_SIZE ];
 static uint16_t buffer2[ IMAGE_SIZE ];
+static volatile uint32_t frame_count = 0;
 
 #include "resource/grp_background.h"
 #include "resource/grp_msx.h"
@@ -108,12 +144,50 @@ static uint16_t buffer2[ IMAGE_SIZE ];
 #include "resource/grp_small_led.h"
 #include "resource/grp_font.h"
 
+#if SX2_CORE_LAYOUT == SX2_LAYOUT_PS2_CORE0
+static volatile uint32_t usb_max_interval_us = 0;
+
+// --------------------------------------------------------------------
+//	Run the USB host between the steps of the renderer on core1
+//
+static void render_yield( void ) {
+	static uint32_t last_time = 0;
+	uint32_t now = time_us_32();
+
+	if( last_time != 0 && (now - last_time) > usb_max_interval_us ) {
+		usb_max_interval_us = now - last_time;
+	}
+	last_time = now;
+	usb_task();
+}
+#else
+// --------------------------------------------------------------------
+static void render_yield( void ) {
+}
+#endif
+
+// --------------------------------------------------------------------
+//	Copy the background in the bands of RENDER_BAND_LINES lines
+//
+static void copy_background( uint16_t *p_draw_buffer, const uint16_t *p_background ) {
+	int y, lines;
+
+	for( y = 0; y < IMAGE_HEIGHT; y += RENDER_BAND_LINES ) {
+		lines = IMAGE_HEIGHT - y;
+		if( lines > RENDER_BAND_LINES ) {
+			lines = RENDER_BAND_LINES;
+		}
+		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 0, y, p_background, 240, 135, 0, y, 240, lines );
+		render_yield();
+	}
+}
+
 // --------------------------------------------------------------------
-static void update_leds( uint16_t *p_draw_buffer ) {
+static void update_leds( uint16_t *p_draw_buffer, const U2P_STATUS_T *p_status ) {
 	int d, i;
 
 	//	green LEDs (pLed)
-	d = u2p_get_information( U2P_DATA1 );
+	d = p_status->data[ U2P_DATA1 ];
 	for( i = 0; i < 8; i++ ) {
 		if( BIT( d, 7 ) != 0 ) {
 			tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, GREEN_LED_X + i * GREEN_LED_NEXT, GREEN_LED_Y, grp_led, grp_led_width, grp_led_height, 0, 0, grp_led_width, grp_led_height );
@@ -122,13 +196,13 @@ static void update_leds( uint16_t *p_draw_buffer ) {
 	}
 
 	//	red LED (pLedPwr)
-	d = u2p_get_information( U2P_DATA2 );
+	d = p_status->data[ U2P_DATA2 ];
 	if( BIT( d, 7 ) != 0 ) {
 		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, RED_LED_X, RED_LED_Y, grp_red_led, grp_red_led_width, grp_red_led_height, 0, 0, grp_red_led_width, grp_red_led_height );
 	}
 
 	//	Caps, Kana
-	d = u2p_get_information( U2P_DATA5 );
+	d = p_status->data[ U2P_DATA5 ];
 	if( BIT( d, 4 ) == 0 ) {
 		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, CAPS_LED_X, CAPS_LED_Y, grp_small_led, grp_small_led_width, grp_small_led_height, 0, 0, grp_small_led_width, grp_small_led_height );
 	}
@@ -141,12 +215,12 @@ static void update_leds( uint16_t *p_draw_buffer ) {
 static int update_msx_logo( uint16_t *p_draw_buffer, int y ) {
 
 	if( y < 64 ) {
-		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 0, 0, grp_background, 240, 135, 0, 0, 240, 135 );
+		copy_background( p_draw_buffer, grp_background );
 		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 38, 35 + 64 - y, grp_msx, 164, 64, 0, 0, 164, y );
 		y++;
 	}
 	else {
-		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 0, 0, grp_background, 240, 135, 0, 0, 240, 135 );
+		copy_background( p_draw_buffer, grp_background );
 		tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 38, 35, grp_msx, 164, 64, 0, 0, 164, 64 );
 		y++;
 	}
@@ -154,7 +228,23 @@ static int update_msx_logo( uint16_t *p_draw_buffer, int y ) {
 }
 
 // --------------------------------------------------------------------
-static void update_page1( uint16_t *p_draw_buffer ) {
+//	Color of the volume: Highlighted if the bits changed within VOLUME_HIGHLIGHT_PERIOD
+//
+static uint16_t get_volume_color( int index, int n, int b ) {
+	STATUS_HISTORY_SAMPLE_T samples[ VOLUME_HIGHLIGHT_SAMPLES ];
+	int count, i;
+
+	count = status_history_query( index, VOLUME_HIGHLIGHT_PERIOD, samples, VOLUME_HIGHLIGHT_SAMPLES );
+	for( i = 1; i < count; i++ ) {
+		if( BITS( samples[i].value, n, b ) != BITS( samples[0].value, n, b ) ) {
+			return VOLUME_HIGHLIGHT_COLOR;
+		}
+	}
+	return 0xFFFF;
+}
+
+// --------------------------------------------------------------------
+static void update_page1( uint16_t *p_draw_buffer, const U2P_STATUS_T *p_status ) {
 	static const char *s_slot_type[] = { "EXTERNAL", "ASC8", "SCC+", "ASC16" };
 	static const char *s_volume[] = {
 		"-------", // 0
@@ -171,13 +261,14 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	static const char *s_clock[] = { "5.37MHz", "3.58MHz", "8.06MHz", "6.96MHz", "6.10MHz", "5.39MHz", "4.90MHz", "4.48MHz", "4.10MHz" };
 	static char s_buffer[31] = {};
 	int d2, d3, d4, d5, d6, d7, s;
+	const uint8_t *p_font = (const uint8_t*) asset_get( ASSET_SLOT_FONT, grp_font );
 
-	d2 = u2p_get_information( U2P_DATA2 );
-	d3 = u2p_get_information( U2P_DATA3 );
-	d4 = u2p_get_information( U2P_DATA4 );
-	d5 = u2p_get_information( U2P_DATA5 );
-	d6 = u2p_get_information( U2P_DATA6 );
-	d7 = u2p_get_information( U2P_DATA7 );
+	d2 = p_status->data[ U2P_DATA2 ];
+	d3 = p_status->data[ U2P_DATA3 ];
+	d4 = p_status->data[ U2P_DATA4 ];
+	d5 = p_status->data[ U2P_DATA5 ];
+	d6 = p_status->data[ U2P_DATA6 ];
+	d7 = p_status->data[ U2P_DATA7 ];
 
 	//	SLOT#1
 	s = BITS( d2, 3, 2 );
@@ -187,7 +278,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		sprintf( s_buffer, "S#1 %s", s_slot_type[ s ] );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SLOT1_INFO_X, SLOT1_INFO_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SLOT1_INFO_X, SLOT1_INFO_Y, 0xFFFF, p_font, s_buffer );
 	//	SLOT#2
 	s = BITS( d2, 5, 2 );
 	if( s != 0 && BIT( d6, 1 ) != 0 ) {
@@ -196,23 +287,23 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		sprintf( s_buffer, "S#2 %s", s_slot_type[ s ] );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SLOT2_INFO_X, SLOT2_INFO_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SLOT2_INFO_X, SLOT2_INFO_Y, 0xFFFF, p_font, s_buffer );
 	//	Master Volume
 	s = BITS( d2, 0, 3 ) ^ 7;
 	sprintf( s_buffer, "Vol  %s", s_volume[ s ] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, MASTER_VOL_X, MASTER_VOL_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, MASTER_VOL_X, MASTER_VOL_Y, get_volume_color( U2P_DATA2, 0, 3 ), p_font, s_buffer );
 	//	PSG Volume
 	s = BITS( d3, 2, 3 );
 	sprintf( s_buffer, "PSG  %s", s_volume[ s ] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, PSG_VOL_X, PSG_VOL_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, PSG_VOL_X, PSG_VOL_Y, get_volume_color( U2P_DATA3, 2, 3 ), p_font, s_buffer );
 	//	SCC+ Volume
 	s = BITS( d4, 5, 3 );
 	sprintf( s_buffer, "SCC  %s", s_volume[ s ] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SCC_VOL_X, SCC_VOL_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, SCC_VOL_X, SCC_VOL_Y, get_volume_color( U2P_DATA4, 5, 3 ), p_font, s_buffer );
 	//	OPLL Volume
 	s = BITS( d3, 5, 3 );
 	sprintf( s_buffer, "OPLL %s", s_volume[ s ] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, OPLL_VOL_X, OPLL_VOL_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, OPLL_VOL_X, OPLL_VOL_Y, get_volume_color( U2P_DATA3, 5, 3 ), p_font, s_buffer );
 	//	Autofire
 	s = BIT( d5, 7 );
 	if( s ) {
@@ -221,7 +312,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		strcpy( s_buffer, "AUTOFIRE `" );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, AUTOFIRE_X, AUTOFIRE_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, AUTOFIRE_X, AUTOFIRE_Y, 0xFFFF, p_font, s_buffer );
 	//	VDP mode 1
 	if( BIT( d5, 6 ) == 0 ) {
 		strcpy( s_buffer, "V9938" );
@@ -235,7 +326,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		strcat( s_buffer, "-STD" );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, VDP_MODE1_X, VDP_MODE1_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, VDP_MODE1_X, VDP_MODE1_Y, 0xFFFF, p_font, s_buffer );
 	//	VDP mode 2
 	if( BIT( d6, 5 ) == 0 ) {
 		if( BIT( d6, 4 ) == 0 ) {
@@ -250,7 +341,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	}
 	s = BITS( d5, 0, 2 );
 	strcat( s_buffer, s_scanline[s] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, VDP_MODE2_X, VDP_MODE2_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, VDP_MODE2_X, VDP_MODE2_Y, 0xFFFF, p_font, s_buffer );
 	//	External Clock
 	if( BIT( d6, 6 ) == 0 ) {
 		strcpy( s_buffer, "EXCLK=CPU" );
@@ -258,7 +349,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		strcpy( s_buffer, "EXCLK=3.58MHz" );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, EXT_CLK_X, EXT_CLK_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, EXT_CLK_X, EXT_CLK_Y, 0xFFFF, p_font, s_buffer );
 	//	2nd PSG
 	if( BIT( d5, 2 ) == 0 ) {
 		strcpy( s_buffer, "P2:- " );
@@ -272,7 +363,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		strcat( s_buffer, "KB:NJP" );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, PSG_2ND_X, PSG_2ND_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, PSG_2ND_X, PSG_2ND_Y, 0xFFFF, p_font, s_buffer );
 	//	OPL3
 	if( BIT( d6, 3 ) == 0 ) {
 		strcpy( s_buffer, "OPL3:- " );
@@ -286,7 +377,7 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 	else {
 		strcat( s_buffer, "LR:I" );
 	}
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, OPL3_X, OPL3_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, OPL3_X, OPL3_Y, 0xFFFF, p_font, s_buffer );
 	//	CPU Clock
 	if( BIT( d6, 7 ) == 1 ) {
 		//	Custom speed mode
@@ -307,35 +398,164 @@ static void update_page1( uint16_t *p_draw_buffer ) {
 		s = 1;
 	}
 	sprintf( s_buffer, "CPU:%s", s_clock[s] );
-	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, CPU_CLK_X, CPU_CLK_Y, 0xFFFF, grp_font, s_buffer );
+	tft_puts( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, CPU_CLK_X, CPU_CLK_Y, 0xFFFF, p_font, s_buffer );
 }
 
+// --------------------------------------------------------------------
+static void update_indicator( uint16_t *p_draw_buffer, const U2P_STATUS_T *p_status ) {
+
+	//	The uploaded background is used instead of grp_indicator, if it is valid.
+	copy_background( p_draw_buffer, (const uint16_t*) asset_get( ASSET_SLOT_INDICATOR, grp_indicator ) );
+	update_leds( p_draw_buffer, p_status );
+	render_yield();
+	update_page1( p_draw_buffer, p_status );
+	render_yield();
+}
+
+// --------------------------------------------------------------------
+static uint16_t *send_frame( uint16_t *p_draw_buffer ) {
+
+	while( tft_is_sending() ) {
+		render_yield();
+	}
+	tft_send_framebuffer( p_draw_buffer );
+	frame_count = frame_count + 1;
+	if( p_draw_buffer == buffer1 ) {
+		return buffer2;
+	}
+	return buffer1;
+}
+
+#if SX2_CORE_LAYOUT == SX2_LAYOUT_PS2_CORE0
+// --------------------------------------------------------------------
+//	Check the change of the status and the assets since the last frame
+//
+static bool is_indicator_changed( const U2P_STATUS_T *p_status ) {
+	static U2P_STATUS_T last_status = {};
+	static const void *p_last_background = nullptr;
+	static const void *p_last_font = nullptr;
+	static uint32_t last_render_time = 0;
+	const void *p_background = asset_get( ASSET_SLOT_INDICATOR, grp_indicator );
+	const void *p_font = asset_get( ASSET_SLOT_FONT, grp_font );
+	uint32_t now = to_ms_since_boot( get_absolute_time() );
+
+	if( memcmp( p_status, &last_status, sizeof(last_status) ) == 0 && p_background == p_last_background && 
+	    p_font == p_last_font && (now - last_render_time) < RENDER_REFRESH_INTERVAL ) {
+		return false;
+	}
+	last_status = *p_status;
+	p_last_background = p_background;
+	p_last_font = p_font;
+	last_render_time = now;
+	return true;
+}
+#endif
+
 // --------------------------------------------------------------------
 static void response_core( void ) {
 	int msx_logo_state = 0;
 	uint16_t *p_draw_buffer;
+	U2P_STATUS_T status;
 
 	tft_init();
+	#if SX2_CORE_LAYOUT == SX2_LAYOUT_PS2_CORE0
+		usb_init();
+	#endif
 	p_draw_buffer = buffer1;
 	for(;;) {
+		render_yield();
 		if( msx_logo_state < 128 ) {
 			msx_logo_state = update_msx_logo( p_draw_buffer, msx_logo_state );
+			p_draw_buffer = send_frame( p_draw_buffer );
+			continue;
 		}
-		else {
-			tft_copy( p_draw_buffer, IMAGE_WIDTH, IMAGE_HEIGHT, 0, 0, grp_indicator, 240, 135, 0, 0, 240, 135 );
-			update_leds( p_draw_buffer );
-			update_page1( p_draw_buffer );
-		}
+		//	Take a consistent copy of the status for this frame.
+		u2p_get_status( &status );
+		#if SX2_CORE_LAYOUT == SX2_LAYOUT_PS2_CORE0
+			if( !is_indicator_changed( &status ) ) {
+				continue;
+			}
+		#endif
+		update_indicator( p_draw_buffer, &status );
+		p_draw_buffer = send_frame( p_draw_buffer );
+	}
+}
 
-		tft_send_framebuffer( p_draw_buffer );
-		if( p_draw_buffer == buffer1 ) {
-			p_draw_buffer = buffer2;
-		}
-		else {
-			p_draw_buffer = buffer1;
+#if SCHED_STATISTICS_DUMP
+// --------------------------------------------------------------------
+//	Print the statistics of the core layout
+//
+static void layout_dump( uint32_t interval_ms ) {
+	static uint32_t last_frame_count = 0;
+	uint32_t frames = frame_count - last_frame_count;
+	PS2DEV_JITTER_T jitter;
+	USB_MOUNT_STATISTICS_T mount;
+	#if PS2DEV_KEYBOARD_ENABLE
+		U2K_LATENCY_T key_latency;
+	#endif
+
+	last_frame_count = last_frame_count + frames;
+	sched_dump();
+	printf( "LAYOUT %d fps=%lu.%02lu\r\n", SX2_CORE_LAYOUT, 
+		(unsigned long)(frames * 1000 / interval_ms), (unsigned long)(frames * 100000 / interval_ms % 100) );
+	#if SX2_CORE_LAYOUT == SX2_LAYOUT_PS2_CORE0
+		printf( "USB interval max=%luus\r\n", (unsigned long) usb_max_interval_us );
+		usb_max_interval_us = 0;
+	#endif
+	ps2dev_get_jitter( &jitter );
+	if( jitter.count != 0 ) {
+		printf( "JITTER n=%lu avg=%lu.%02luus max=%luus", (unsigned long) jitter.count, 
+			(unsigned long)(jitter.total_us / jitter.count), (unsigned long)(jitter.total_us * 100ull / jitter.count % 100), 
+			(unsigned long) jitter.max_us );
+		for( int i = 0; i < PS2DEV_JITTER_BINS; i++ ) {
+			printf( " %lu", (unsigned long) jitter.histogram[i] );
 		}
-	}
+		printf( "\r\n" );
+	}
+	ps2dev_reset_jitter();
+	usb_get_mount_statistics( &mount );
+	printf( "MOUNT n=%lu cache_hit=%lu first_report last=%luus max=%luus\r\n", (unsigned long) mount.mount_count, 
+		(unsigned long) mount.cache_hit_count, (unsigned long) mount.last_first_report_us, (unsigned long) mount.max_first_report_us );
+	#if PS2DEV_KEYBOARD_ENABLE
+		u2k_get_latency( &key_latency );
+		printf( "KEY latency n=%lu min=%luus avg=%luus max=%luus (to send FIFO)\r\n", (unsigned long) key_latency.count, 
+			(unsigned long) key_latency.min_us, (unsigned long) key_latency.average_us, (unsigned long) key_latency.max_us );
+		u2k_reset_latency();
+	#endif
 }
+#endif
+
+#if PS2DEV_TIMING_CALIBRATION
+// --------------------------------------------------------------------
+//	Print the result of the calibration, to be copied to PS2DEV_CUSTOM_TIMING
+//
+static void calibration_dump( void ) {
+	PS2DEV_TIMING_T timing;
+
+	ps2dev_get_timing( &timing );
+	printf( "CALIBRATION PS2DEV_CUSTOM_TIMING { %u, %u, %u, %u, %u }\r\n", 
+		timing.clk_low, timing.clk_high, timing.data_setup, timing.ack_setup, timing.ack_clk_high );
+}
+#endif
+
+// --------------------------------------------------------------------
+//	Tasks of core0
+//		ps2dev has the precedence while the bits of a PS/2 frame are clocked, because a long
+//		tuh_task() between two PS2CLK edges stretches the bit. The other tasks wait until the
+//		frame ends. A frame is about 1 msec and the tasks run between the frames, so the
+//		deadline is only the starvation limit (e.g. a broken frame), and late_count shows it.
+//		While the next byte waits in send fifo, the frame has not started, so tuh_task() only
+//		delays the byte (the gap between the bytes is not limited by PS/2).
+//		tuh_task() itself cannot be sliced, so its runtime is only measured (budget).
+static SCHED_TASK_T core0_tasks[] = {
+	//	name		task			is_urgent			deadline	budget
+	{ "ps2dev",		ps2dev_task,	ps2dev_is_in_frame,	0,			20		},
+	{ "u2p",		u2p_task,		nullptr,			2000,		50		},
+	{ "u2k",		u2k_task,		nullptr,			2000,		50		},
+	#if SX2_CORE_LAYOUT == SX2_LAYOUT_RENDER_CORE1
+		{ "usb",	usb_task,		nullptr,			4000,		200		},
+	#endif
+};
 
 // --------------------------------------------------------------------
 int main( void ) {
@@ -343,14 +563,52 @@ int main( void ) {
 	board_init();
 	ps2dev_init();
 	u2p_init();
+	u2k_init();
 
+	#if SX2_CORE_LAYOUT == SX2_LAYOUT_RENDER_CORE1
+		usb_init();
+	#endif
 	multicore_launch_core1( response_core );
 
-	usb_init();
+	#if LATENCY_TRACE
+		uint32_t latency_dump_time = 0;
+	#endif
+	#if SCHED_STATISTICS_DUMP
+		uint32_t sched_dump_time = 0;
+	#endif
+	#if PS2DEV_TIMING_CALIBRATION
+		bool is_calibration_dumped = false;
+	#endif
+
+	sched_init( core0_tasks, sizeof(core0_tasks) / sizeof(core0_tasks[0]), time_us_32 );
 	for( ;; ) {
-		tuh_task();
-		ps2dev_task();
-		u2p_task();
+		sched_run();
+		//	printf() blocks for several msec. The dumps wait until no PS/2 frame is
+		//	in flight, so they do not stretch PS2CLK.
+		#if PS2DEV_CAPTURE
+			if( ps2dev_capture_is_full() && !ps2dev_is_busy() ) {
+				ps2dev_capture_dump();
+			}
+		#endif
+		#if LATENCY_TRACE
+			if( (to_ms_since_boot( get_absolute_time() ) - latency_dump_time) >= LATENCY_TRACE_DUMP_INTERVAL && !ps2dev_is_busy() ) {
+				latency_dump_time = to_ms_since_boot( get_absolute_time() );
+				latency_trace_dump();
+			}
+		#endif
+		#if SCHED_STATISTICS_DUMP
+			if( (to_ms_since_boot( get_absolute_time() ) - sched_dump_time) >= SCHED_DUMP_INTERVAL && !ps2dev_is_busy() ) {
+				sched_dump_time = to_ms_since_boot( get_absolute_time() );
+				layout_dump( SCHED_DUMP_INTERVAL );
+				sched_reset_statistics();
+			}
+		#endif
+		#if PS2DEV_TIMING_CALIBRATION
+			if( !is_calibration_dumped && !ps2dev_is_calibrating() && !ps2dev_is_busy() ) {
+				is_calibration_dumped = true;
+				calibration_dump();
+			}
+		#endif
 	}
 	return 0;
 }
@@ -24,10 +24,13 @@
 // --------------------------------------------------------------------
 
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <pico/multicore.h>
 #include <hardware/gpio.h>
 #include <pico/time.h>
 #include "ps2dev_driver.h"
+#include "latency_trace.h"
 
 using namespace std;
 
@@ -98,86 +101,140 @@ enum {
 };
 typedef int PS2DEV_STATE_T;
 
-static PS2DEV_STATE_T ps2dev_state;
-static uint64_t start_time;
-static uint8_t receive_data;
-static int send_data;
-
 enum {
 	SEND_DATA = 0,
 	SEND_ABORT,
 	SEND_SUCCESS,
 };
-static volatile int send_result;
-static uint8_t parity_check;
+
+#define FIFO_SIZE		64			//	Power of 2
+#define FIFO_MASK		(FIFO_SIZE - 1)
+
+//	Context of each PS/2 port
+typedef struct {
+	uint32_t			clk_pin;
+	uint32_t			dat_pin;
+	PS2DEV_STATE_T		state;
+	uint64_t			start_time;
+	uint8_t				receive_data;
+	int					send_data;
+	volatile int		send_result;
+	uint8_t				parity_check;
+
+	volatile uint8_t	receive_fifo[ FIFO_SIZE ];
+	volatile int		receive_fifo_read_ptr;
+	volatile int		receive_fifo_write_ptr;
+	volatile uint8_t	send_fifo[ FIFO_SIZE ];
+	volatile int		send_fifo_read_ptr;
+	volatile int		send_fifo_write_ptr;
+	#if LATENCY_TRACE
+		uint32_t		send_push_count;	//	Index of the byte in the send FIFO
+		uint32_t		send_pop_count;
+	#endif
+} PS2DEV_PORT_T;
+
+static PS2DEV_PORT_T ports[ PS2DEV_PORT_NUM ];
 static semaphore_t sem;
 
-static volatile uint8_t receive_fifo[ 16 ];
-static volatile int receive_fifo_read_ptr;
-static volatile int receive_fifo_write_ptr;
-static volatile uint8_t send_fifo[ 8 ];
-static volatile int send_fifo_read_ptr;
-static volatile int send_fifo_write_ptr;
+// --------------------------------------------------------------------
+//	Timing profiles [usec]
+//		{ clk_low, clk_high, data_setup, ack_setup, ack_clk_high }
+//
+static const PS2DEV_TIMING_T timing_profiles[] = {
+	//	PS2DEV_TIMING_SX2_FAST
+	//	Info.) Since there are cases where the TinyUSB task takes a long time, we decided to shorten the width of PS2CLK.
+	//	       The SX2 main unit side can accept these values without any problem.
+	{  3,  3,  1,  1,  2 },
+	//	PS2DEV_TIMING_SPEC
+	//	Info.) Values based on the PS/2 specification. (PS2CLK 10.0kHz - 16.7kHz)
+	{ 30, 30, 15,  5, 25 },
+};
+
+static PS2DEV_TIMING_T timing;
+static PS2DEV_TIMING_T custom_timing = PS2DEV_CUSTOM_TIMING;
+static int timing_profile;
+
+// --------------------------------------------------------------------
+//	Calibration
+//		Level 0 is PS2DEV_TIMING_SPEC, level (CALIBRATION_LEVELS - 1) is PS2DEV_TIMING_SX2_FAST.
+//		The level goes up each time CALIBRATION_PASS_COUNT transactions in a row succeed.
+//		When a transaction fails, it returns to the previous level and the calibration ends.
+//		When no transaction succeeds for CALIBRATION_STALL_US after the host starts one, it is
+//		also a failure, because a host which cannot decode the level may stop talking instead
+//		of sending 0xFE. A host that sends nothing (booting, or not polling) is only waited for.
+//
+#define CALIBRATION_LEVELS		8
+#define CALIBRATION_PASS_COUNT	32
+#define CALIBRATION_STALL_US	1000000
+
+static bool is_calibrating;
+static int calibration_level;
+static int calibration_pass_count;
+static bool is_calibration_attempted;		//	The host started a transaction after the last success
+static uint64_t calibration_progress_time;
 
 // --------------------------------------------------------------------
-static bool inline is_send_fifo_empty( void ) {
-	return( send_fifo_read_ptr == send_fifo_write_ptr );
+static bool inline is_send_fifo_empty( const PS2DEV_PORT_T *p ) {
+	return( p->send_fifo_read_ptr == p->send_fifo_write_ptr );
 }
 
 // --------------------------------------------------------------------
-static bool inline is_send_fifo_full( void ) {
-	return( ((send_fifo_write_ptr + 1) & 7) == send_fifo_read_ptr );
+static bool inline is_send_fifo_full( const PS2DEV_PORT_T *p ) {
+	return( ((p->send_fifo_write_ptr + 1) & FIFO_MASK) == p->send_fifo_read_ptr );
 }
 
 // --------------------------------------------------------------------
-static void push_send_fifo( uint8_t data ) {
-	if( is_send_fifo_full() ) {
+static void push_send_fifo( PS2DEV_PORT_T *p, uint8_t data ) {
+	if( is_send_fifo_full( p ) ) {
 		return;
 	}
-	send_fifo[ send_fifo_write_ptr ] = data;
-	send_fifo_write_ptr = (send_fifo_write_ptr + 1) & 7;
+	p->send_fifo[ p->send_fifo_write_ptr ] = data;
+	p->send_fifo_write_ptr = (p->send_fifo_write_ptr + 1) & FIFO_MASK;
+	#if LATENCY_TRACE
+		p->send_push_count++;
+	#endif
 }
 
 // --------------------------------------------------------------------
-static uint8_t pop_send_fifo( void ) {
+static uint8_t pop_send_fifo( PS2DEV_PORT_T *p ) {
 	uint8_t data;
 
-	if( is_send_fifo_empty() ) {
+	if( is_send_fifo_empty( p ) ) {
 		return 0;
 	}
-	data = send_fifo[ send_fifo_read_ptr ];
-	send_fifo_read_ptr = (send_fifo_read_ptr + 1) & 7;
+	data = p->send_fifo[ p->send_fifo_read_ptr ];
+	p->send_fifo_read_ptr = (p->send_fifo_read_ptr + 1) & FIFO_MASK;
 	return data;
 }
 
 // --------------------------------------------------------------------
-static bool inline is_receive_fifo_empty( void ) {
-	return( receive_fifo_read_ptr == receive_fifo_write_ptr );
+static bool inline is_receive_fifo_empty( const PS2DEV_PORT_T *p ) {
+	return( p->receive_fifo_read_ptr == p->receive_fifo_write_ptr );
 }
 
 // --------------------------------------------------------------------
-static bool inline is_receive_fifo_full( void ) {
-	return( ((receive_fifo_write_ptr + 1) & 15) == receive_fifo_read_ptr );
+static bool inline is_receive_fifo_full( const PS2DEV_PORT_T *p ) {
+	return( ((p->receive_fifo_write_ptr + 1) & FIFO_MASK) == p->receive_fifo_read_ptr );
 }
 
 // --------------------------------------------------------------------
-static void push_receive_fifo( uint8_t data ) {
-	if( is_receive_fifo_full() ) {
+static void push_receive_fifo( PS2DEV_PORT_T *p, uint8_t data ) {
+	if( is_receive_fifo_full( p ) ) {
 		return;
 	}
-	receive_fifo[ receive_fifo_write_ptr ] = data;
-	receive_fifo_write_ptr = (receive_fifo_write_ptr + 1) & 15;
+	p->receive_fifo[ p->receive_fifo_write_ptr ] = data;
+	p->receive_fifo_write_ptr = (p->receive_fifo_write_ptr + 1) & FIFO_MASK;
 }
 
 // --------------------------------------------------------------------
-static uint8_t pop_receive_fifo( void ) {
+static uint8_t pop_receive_fifo( PS2DEV_PORT_T *p ) {
 	uint8_t data;
 
-	if( is_receive_fifo_empty() ) {
+	if( is_receive_fifo_empty( p ) ) {
 		return 0;
 	}
-	data = receive_fifo[ receive_fifo_read_ptr ];
-	receive_fifo_read_ptr = (receive_fifo_read_ptr + 1) & 15;
+	data = p->receive_fifo[ p->receive_fifo_read_ptr ];
+	p->receive_fifo_read_ptr = (p->receive_fifo_read_ptr + 1) & FIFO_MASK;
 	return data;
 }
 
@@ -186,71 +243,178 @@ static uint64_t inline _get_us( void ) {
 	return to_us_since_boot( get_absolute_time() );
 }
 
+#if PS2DEV_CAPTURE
+static uint8_t capture_buffer[ PS2DEV_CAPTURE_SIZE ];
+static int capture_size = 0;
+static uint64_t capture_time = 0;
+
+// --------------------------------------------------------------------
+static void capture( bool is_from_host, uint8_t data ) {
+	uint64_t now;
+	uint32_t value;
+
+	//	A record is 6 bytes at most.
+	if( capture_size + 6 > PS2DEV_CAPTURE_SIZE ) {
+		return;
+	}
+	now = _get_us();
+	if( (now - capture_time) > 0x7FFFFFFF ) {
+		value = 0x7FFFFFFF;
+	}
+	else {
+		value = (uint32_t)(now - capture_time);
+	}
+	capture_time = now;
+	value = (value << 1) | (is_from_host ? 1 : 0);
+	while( value > 0x7F ) {
+		capture_buffer[ capture_size++ ] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	capture_buffer[ capture_size++ ] = value;
+	capture_buffer[ capture_size++ ] = data;
+}
+#else
+#define capture( is_from_host, data )
+#endif
+
+// --------------------------------------------------------------------
+static void make_calibration_timing( int level, PS2DEV_TIMING_T *p_timing ) {
+	const PS2DEV_TIMING_T *p_slow = &timing_profiles[ PS2DEV_TIMING_SPEC ];
+	const PS2DEV_TIMING_T *p_fast = &timing_profiles[ PS2DEV_TIMING_SX2_FAST ];
+	int remain = (CALIBRATION_LEVELS - 1) - level;
+
+	p_timing->clk_low		= p_fast->clk_low		+ (p_slow->clk_low		- p_fast->clk_low		) * remain / (CALIBRATION_LEVELS - 1);
+	p_timing->clk_high		= p_fast->clk_high		+ (p_slow->clk_high		- p_fast->clk_high		) * remain / (CALIBRATION_LEVELS - 1);
+	p_timing->data_setup	= p_fast->data_setup	+ (p_slow->data_setup	- p_fast->data_setup	) * remain / (CALIBRATION_LEVELS - 1);
+	p_timing->ack_setup		= p_fast->ack_setup		+ (p_slow->ack_setup	- p_fast->ack_setup		) * remain / (CALIBRATION_LEVELS - 1);
+	p_timing->ack_clk_high	= p_fast->ack_clk_high	+ (p_slow->ack_clk_high	- p_fast->ack_clk_high	) * remain / (CALIBRATION_LEVELS - 1);
+}
+
+// --------------------------------------------------------------------
+static void init_port( PS2DEV_PORT_T *p, uint32_t clk_pin, uint32_t dat_pin ) {
+
+	p->clk_pin = clk_pin;
+	p->dat_pin = dat_pin;
+	gpio_init( p->clk_pin );
+	gpio_init( p->dat_pin );
+	gpio_pull_up( p->clk_pin );
+	gpio_pull_up( p->dat_pin );
+	gpio_set_dir( p->clk_pin, GPIO_IN );
+	gpio_set_dir( p->dat_pin, GPIO_IN );
+	gpio_put( p->clk_pin, 0 );
+	gpio_put( p->dat_pin, 0 );
+	p->state = PS2DEV_IDLE;
+
+	p->receive_fifo_read_ptr = 0;
+	p->receive_fifo_write_ptr = 0;
+	p->send_fifo_read_ptr = 0;
+	p->send_fifo_write_ptr = 0;
+}
+
 // --------------------------------------------------------------------
 bool ps2dev_init( void ) {
 
-	gpio_init( PS2CLK_PORT );
-	gpio_init( PS2DAT_PORT );
-	gpio_pull_up( PS2CLK_PORT );
-	gpio_pull_up( PS2DAT_PORT );
-	gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-	gpio_set_dir( PS2DAT_PORT, GPIO_IN );
-	gpio_put( PS2CLK_PORT, 0 );
-	gpio_put( PS2DAT_PORT, 0 );
-	ps2dev_state = PS2DEV_IDLE;
-
-	receive_fifo_read_ptr = 0;
-	receive_fifo_write_ptr = 0;
+	init_port( &ports[ PS2DEV_PORT_MOUSE ], PS2CLK_PORT, PS2DAT_PORT );
+	#if PS2DEV_KEYBOARD_ENABLE
+		init_port( &ports[ PS2DEV_PORT_KEYBOARD ], PS2KBD_CLK_PORT, PS2KBD_DAT_PORT );
+	#endif
 	sem_init( &sem, 1, 1 );
+
+	ps2dev_set_timing_profile( PS2DEV_TIMING_PROFILE );
+	#if PS2DEV_TIMING_CALIBRATION
+		ps2dev_calibration_start();
+	#endif
 	return true;
 }
 
+#if PS2DEV_JITTER_STATISTICS
+static PS2DEV_JITTER_T jitter;
+
 // --------------------------------------------------------------------
-void ps2dev_task( void ) {
+static void record_jitter( uint32_t us ) {
+
+	jitter.count++;
+	jitter.total_us += us;
+	if( us > jitter.max_us ) {
+		jitter.max_us = us;
+	}
+	jitter.histogram[ (us < PS2DEV_JITTER_BINS) ? us : (PS2DEV_JITTER_BINS - 1) ]++;
+}
+#endif
+
+// --------------------------------------------------------------------
+//	Check the width of the current PS2CLK/PS2DAT level
+//		The edge can be made at width + 1 [usec] at the earliest. The delay beyond it is
+//		the jitter caused by the other tasks on this core.
+//
+static bool inline is_elapsed( PS2DEV_PORT_T *p, uint32_t width ) {
+	uint64_t elapsed = _get_us() - p->start_time;
+
+	if( elapsed <= width ) {
+		return false;
+	}
+	#if PS2DEV_JITTER_STATISTICS
+		record_jitter( (uint32_t)(elapsed - width - 1) );
+	#endif
+	return true;
+}
 
-	switch( ps2dev_state ) {
+// --------------------------------------------------------------------
+static void port_task( PS2DEV_PORT_T *p ) {
+
+	switch( p->state ) {
 	case PS2DEV_IDLE:
-		gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-		if( !gpio_get( PS2CLK_PORT ) ) {
+		gpio_set_dir( p->clk_pin, GPIO_IN );
+		if( !gpio_get( p->clk_pin ) ) {
 			//	PS2CLK is LOW. It's send request from HOST.
-			ps2dev_state = PS2DEV_WAIT_START_BIT;
-			start_time = _get_us();
+			p->state = PS2DEV_WAIT_START_BIT;
+			p->start_time = _get_us();
 		}
-		else if( !is_send_fifo_empty() ) {
+		else if( !is_send_fifo_empty( p ) ) {
 			uint8_t data;
 
 			sem_acquire_blocking( &sem );
-			data = pop_send_fifo();
+			data = pop_send_fifo( p );
 			sem_release( &sem );
+			if( p == &ports[ PS2DEV_PORT_MOUSE ] ) {
+				capture( false, data );
+				#if LATENCY_TRACE
+					LATENCY_TRACE_SENT( p->send_pop_count++ );
+				#endif
+			}
 			//	dddd_dddd → 1d_dddd_ddd0
-			send_data = (data << 1) | 0x200;
-			send_result = SEND_DATA;
-			ps2dev_state = PS2DEV_SEND_DATA;
+			p->send_data = (data << 1) | 0x200;
+			p->send_result = SEND_DATA;
+			p->state = PS2DEV_SEND_DATA;
 		}
 		break;
 	case PS2DEV_WAIT_START_BIT:
-		gpio_set_dir( PS2DAT_PORT, GPIO_IN );
-		if( !gpio_get( PS2DAT_PORT ) ) {
+		gpio_set_dir( p->dat_pin, GPIO_IN );
+		if( !gpio_get( p->dat_pin ) ) {
 			//	PS2DAT is LOW. This is start bit from HOST.
-			ps2dev_state = PS2DEV_WAIT_CLOCK_RELEASE;
-			receive_data = 0;
-			parity_check = 0;
+			p->state = PS2DEV_WAIT_CLOCK_RELEASE;
+			p->receive_data = 0;
+			p->parity_check = 0;
 		}
-		else if( (_get_us() - start_time) > 15000 ) {
+		else if( (_get_us() - p->start_time) > 15000 ) {
 			//	Time out error.
-			ps2dev_state = PS2DEV_IDLE;
+			p->state = PS2DEV_IDLE;
 		}
 		break;
 	case PS2DEV_WAIT_CLOCK_RELEASE:
-		if( gpio_get( PS2CLK_PORT ) ) {
+		if( gpio_get( p->clk_pin ) ) {
 			//	PS2CLK is HIGH. It's released by HOST.
-			ps2dev_state = PS2DEV_D0_CLK_TO_LOW;
-			receive_data = 0;
-			start_time = _get_us();
+			p->state = PS2DEV_D0_CLK_TO_LOW;
+			p->receive_data = 0;
+			p->start_time = _get_us();
+			if( is_calibrating && !is_calibration_attempted ) {
+				is_calibration_attempted = true;
+				calibration_progress_time = p->start_time;
+			}
 		}
-		else if( (_get_us() - start_time) > 15000 ) {
+		else if( (_get_us() - p->start_time) > 15000 ) {
 			//	Time out error.
-			ps2dev_state = PS2DEV_IDLE;
+			p->state = PS2DEV_IDLE;
 		}
 		break;
 	case PS2DEV_D0_CLK_TO_LOW:
@@ -263,13 +427,12 @@ void ps2dev_task( void ) {
 	case PS2DEV_D7_CLK_TO_LOW:
 	case PS2DEV_PARITY_CLK_TO_LOW:
 	case PS2DEV_STOP_CLK_TO_LOW:
-		//	Info.) The clock width should be set to 3usec because the TinyUSB task is too busy at that time. 
-		//	       3usec can be accepted without any problem on the SX2 main unit side.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK HIGH.
+		if( is_elapsed( p, timing.clk_high ) ) {
 			//	Set PS2CLK LOW.
-			gpio_set_dir( PS2CLK_PORT, GPIO_OUT );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->clk_pin, GPIO_OUT );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_D0_WAIT:
@@ -280,102 +443,91 @@ void ps2dev_task( void ) {
 	case PS2DEV_D5_WAIT:
 	case PS2DEV_D6_WAIT:
 	case PS2DEV_D7_WAIT:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-			receive_data >>= 1;
-			if( gpio_get( PS2DAT_PORT ) ) {
-				receive_data = receive_data | 0x80;
-				parity_check = parity_check ^ 1;
+			gpio_set_dir( p->clk_pin, GPIO_IN );
+			p->receive_data >>= 1;
+			if( gpio_get( p->dat_pin ) ) {
+				p->receive_data = p->receive_data | 0x80;
+				p->parity_check = p->parity_check ^ 1;
 			}
-			ps2dev_state++;
-			start_time = _get_us();
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_PARITY_WAIT:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-			if( gpio_get( PS2DAT_PORT ) ) {
-				parity_check = parity_check ^ 1;
+			gpio_set_dir( p->clk_pin, GPIO_IN );
+			if( gpio_get( p->dat_pin ) ) {
+				p->parity_check = p->parity_check ^ 1;
 			}
-			ps2dev_state++;
-			start_time = _get_us();
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_STOP_WAIT:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->clk_pin, GPIO_IN );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_SEND_ACK:
-		//	Info.) Originally, it should be 5usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 1usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 1usec without any problem.
-		if( (_get_us() - start_time) > 1 ) {
+		//	PS2DAT setup/hold time around the ACK bit.
+		if( is_elapsed( p, timing.ack_setup ) ) {
 			//	Set PS2DAT LOW.
-			gpio_set_dir( PS2DAT_PORT, GPIO_OUT );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->dat_pin, GPIO_OUT );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_ACK_CLK_TO_LOW:
-		//	Info.) Originally, it should be 25usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 2usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 2usec without any problem.
-		if( (_get_us() - start_time) > 2 ) {
+		//	Width of PS2CLK HIGH before the ACK bit.
+		if( is_elapsed( p, timing.ack_clk_high ) ) {
 			//	Set PS2CLK LOW.
-			gpio_set_dir( PS2CLK_PORT, GPIO_OUT );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->clk_pin, GPIO_OUT );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_ACK_CLK_END:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
+			gpio_set_dir( p->clk_pin, GPIO_IN );
 
 			sem_acquire_blocking( &sem );
-			if( !is_receive_fifo_full() ) {
-				push_receive_fifo( receive_data );
+			if( !is_receive_fifo_full( p ) ) {
+				push_receive_fifo( p, p->receive_data );
 			}
 			sem_release( &sem );
-			ps2dev_state = PS2DEV_ACK_DAT_END;
+			if( p == &ports[ PS2DEV_PORT_MOUSE ] ) {
+				capture( true, p->receive_data );
+			}
+			p->state = PS2DEV_ACK_DAT_END;
 		}
 		break;
 	case PS2DEV_ACK_DAT_END:
-		//	Info.) Originally, it should be 5usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 1usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 1usec without any problem.
-		if( (_get_us() - start_time) > 1 ) {
+		//	PS2DAT setup/hold time around the ACK bit.
+		if( is_elapsed( p, timing.ack_setup ) ) {
 			//	Set PS2DAT HIGH.
-			gpio_set_dir( PS2DAT_PORT, GPIO_IN );
+			gpio_set_dir( p->dat_pin, GPIO_IN );
 
-			ps2dev_state = PS2DEV_IDLE;
+			p->state = PS2DEV_IDLE;
 		}
 		break;
 	// send state
 	case PS2DEV_SEND_DATA:
 		//	Set PS2CLK HIGH.
-		gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-		ps2dev_state++;
-		parity_check = 0;
-		start_time = _get_us();
+		gpio_set_dir( p->clk_pin, GPIO_IN );
+		p->state++;
+		p->parity_check = 0;
+		p->start_time = _get_us();
 		break;
 	case PS2DEV_SEND_START_BIT:
 	case PS2DEV_SEND_D0:
@@ -387,47 +539,43 @@ void ps2dev_task( void ) {
 	case PS2DEV_SEND_D6:
 	case PS2DEV_SEND_D7:
 	case PS2DEV_SEND_STOP:
-		//	Info.) Originally, it should be 15usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 1usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 1usec without any problem.
-		if( (_get_us() - start_time) > 1 ) {
-			if( !gpio_get( PS2CLK_PORT ) ) {
-				send_result = SEND_ABORT;
-				ps2dev_state = PS2DEV_IDLE;
+		//	PS2DAT setup time to PS2CLK edge.
+		if( is_elapsed( p, timing.data_setup ) ) {
+			if( !gpio_get( p->clk_pin ) ) {
+				p->send_result = SEND_ABORT;
+				p->state = PS2DEV_IDLE;
 			}
-			if( (send_data & 1) == 0 ) {
+			if( (p->send_data & 1) == 0 ) {
 				//	Set PS2DAT LOW.
-				gpio_set_dir( PS2DAT_PORT, GPIO_OUT );
+				gpio_set_dir( p->dat_pin, GPIO_OUT );
 			}
 			else {
 				//	Set PS2DAT HIGH.
-				gpio_set_dir( PS2DAT_PORT, GPIO_IN );
-				parity_check = parity_check ^ 1;
+				gpio_set_dir( p->dat_pin, GPIO_IN );
+				p->parity_check = p->parity_check ^ 1;
 			}
-			send_data >>= 1;
-			ps2dev_state++;
-			start_time = _get_us();
+			p->send_data >>= 1;
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_SEND_PARITY:
-		//	Info.) Originally, it should be 15usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 1usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 1usec without any problem.
-		if( (_get_us() - start_time) > 1 ) {
-			if( !gpio_get( PS2CLK_PORT ) ) {
-				send_result = SEND_ABORT;
-				ps2dev_state = PS2DEV_IDLE;
+		//	PS2DAT setup time to PS2CLK edge.
+		if( is_elapsed( p, timing.data_setup ) ) {
+			if( !gpio_get( p->clk_pin ) ) {
+				p->send_result = SEND_ABORT;
+				p->state = PS2DEV_IDLE;
 			}
-			if( parity_check ) {
+			if( p->parity_check ) {
 				//	Set PS2DAT LOW.
-				gpio_set_dir( PS2DAT_PORT, GPIO_OUT );
+				gpio_set_dir( p->dat_pin, GPIO_OUT );
 			}
 			else {
 				//	Set PS2DAT HIGH.
-				gpio_set_dir( PS2DAT_PORT, GPIO_IN );
+				gpio_set_dir( p->dat_pin, GPIO_IN );
 			}
-			ps2dev_state++;
-			start_time = _get_us();
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_SEND_START_BIT_CLK_TO_LOW:
@@ -441,18 +589,16 @@ void ps2dev_task( void ) {
 	case PS2DEV_SEND_D7_CLK_TO_LOW:
 	case PS2DEV_SEND_PARITY_CLK_TO_LOW:
 	case PS2DEV_SEND_STOP_CLK_TO_LOW:
-		//	Info.) Originally, it should be 15usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 1usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 1usec without any problem.
-		if( (_get_us() - start_time) > 1 ) {
-			if( !gpio_get( PS2CLK_PORT ) ) {
-				send_result = SEND_ABORT;
-				ps2dev_state = PS2DEV_IDLE;
+		//	PS2DAT setup time to PS2CLK edge.
+		if( is_elapsed( p, timing.data_setup ) ) {
+			if( !gpio_get( p->clk_pin ) ) {
+				p->send_result = SEND_ABORT;
+				p->state = PS2DEV_IDLE;
 			}
 			//	Set PS2CLK LOW.
-			gpio_set_dir( PS2CLK_PORT, GPIO_OUT );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->clk_pin, GPIO_OUT );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_SEND_START_BIT_WAIT:
@@ -465,25 +611,21 @@ void ps2dev_task( void ) {
 	case PS2DEV_SEND_D6_WAIT:
 	case PS2DEV_SEND_D7_WAIT:
 	case PS2DEV_SEND_PARITY_WAIT:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-			ps2dev_state++;
-			start_time = _get_us();
+			gpio_set_dir( p->clk_pin, GPIO_IN );
+			p->state++;
+			p->start_time = _get_us();
 		}
 		break;
 	case PS2DEV_SEND_STOP_WAIT:
-		//	Info.) Originally, it should be 30usec or longer.
-		//	       However, since there are cases where the TinyUSB task takes a long time, we decided to set it to 3usec, which shortens the width of PS2CLK.
-		//	       The SX2 main unit side can accept 3usec without any problem.
-		if( (_get_us() - start_time) > 3 ) {
+		//	Width of PS2CLK LOW.
+		if( is_elapsed( p, timing.clk_low ) ) {
 			//	Set PS2CLK HIGH.
-			gpio_set_dir( PS2CLK_PORT, GPIO_IN );
-			ps2dev_state = PS2DEV_IDLE;
-			send_result = SEND_SUCCESS;
+			gpio_set_dir( p->clk_pin, GPIO_IN );
+			p->state = PS2DEV_IDLE;
+			p->send_result = SEND_SUCCESS;
 		}
 		break;
 	default:
@@ -492,43 +634,225 @@ void ps2dev_task( void ) {
 }
 
 // --------------------------------------------------------------------
-bool ps2dev_check_receive_buffer_empty( void ) {
+void ps2dev_task( void ) {
+
+	if( is_calibrating && is_calibration_attempted && (_get_us() - calibration_progress_time) > CALIBRATION_STALL_US ) {
+		//	The host started a transaction, but nothing succeeded on this level
+		ps2dev_calibration_report( false );
+	}
+	port_task( &ports[ PS2DEV_PORT_MOUSE ] );
+	#if PS2DEV_KEYBOARD_ENABLE
+		port_task( &ports[ PS2DEV_PORT_KEYBOARD ] );
+	#endif
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_check_receive_buffer_empty( int port ) {
 
-	return is_receive_fifo_empty();
+	return is_receive_fifo_empty( &ports[ port ] );
 }
 
 // --------------------------------------------------------------------
-bool ps2dev_get_receive_data( uint8_t *p_data ) {
+bool ps2dev_get_receive_data( int port, uint8_t *p_data ) {
+	PS2DEV_PORT_T *p = &ports[ port ];
 
-	if( is_receive_fifo_empty() ) {
+	if( is_receive_fifo_empty( p ) ) {
 		return false;
 	}
 	sem_acquire_blocking( &sem );
-	*p_data = pop_receive_fifo();
+	*p_data = pop_receive_fifo( p );
 	sem_release( &sem );
 	return true;
 }
 
 // --------------------------------------------------------------------
-bool ps2dev_send_data( uint8_t data ) {
+bool ps2dev_send_data( int port, uint8_t data ) {
+	PS2DEV_PORT_T *p = &ports[ port ];
 
-	if( is_send_fifo_full() ) {
+	if( is_send_fifo_full( p ) ) {
 		return false;
 	}
 	sem_acquire_blocking( &sem );
-	push_send_fifo( data );
+	push_send_fifo( p, data );
 	sem_release( &sem );
 	return true;
 }
 
 // --------------------------------------------------------------------
-bool ps2dev_is_send_fifo_empty( void ) {
+bool ps2dev_is_send_fifo_empty( int port ) {
 
-	return( is_send_fifo_empty() );
+	return( is_send_fifo_empty( &ports[ port ] ) );
+}
+
+// --------------------------------------------------------------------
+int ps2dev_get_send_fifo_free( int port ) {
+	const PS2DEV_PORT_T *p = &ports[ port ];
+
+	return( (p->send_fifo_read_ptr - p->send_fifo_write_ptr - 1) & FIFO_MASK );
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_is_busy( void ) {
+	int i;
+
+	for( i = 0; i < PS2DEV_PORT_NUM; i++ ) {
+		if( ports[i].state != PS2DEV_IDLE || !is_send_fifo_empty( &ports[i] ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_is_in_frame( void ) {
+	int i;
+
+	for( i = 0; i < PS2DEV_PORT_NUM; i++ ) {
+		if( ports[i].state != PS2DEV_IDLE && ports[i].state != PS2DEV_WAIT_START_BIT && ports[i].state != PS2DEV_WAIT_CLOCK_RELEASE ) {
+			return true;
+		}
+	}
+	return false;
 }
 
 // --------------------------------------------------------------------
-int ps2dev_get_state( void ) {
+void ps2dev_get_jitter( PS2DEV_JITTER_T *p_jitter ) {
 
-	return ps2dev_state;
+	#if PS2DEV_JITTER_STATISTICS
+		*p_jitter = jitter;
+	#else
+		memset( p_jitter, 0, sizeof(*p_jitter) );
+	#endif
+}
+
+// --------------------------------------------------------------------
+void ps2dev_reset_jitter( void ) {
+
+	#if PS2DEV_JITTER_STATISTICS
+		memset( &jitter, 0, sizeof(jitter) );
+	#endif
+}
+
+// --------------------------------------------------------------------
+uint32_t ps2dev_get_send_push_count( int port ) {
+
+	#if LATENCY_TRACE
+		return ports[ port ].send_push_count;
+	#else
+		return 0;
+	#endif
+}
+
+// --------------------------------------------------------------------
+int ps2dev_get_state( int port ) {
+
+	return ports[ port ].state;
+}
+
+// --------------------------------------------------------------------
+void ps2dev_set_timing_profile( int profile ) {
+
+	if( profile == PS2DEV_TIMING_CUSTOM ) {
+		timing = custom_timing;
+	}
+	else if( profile == PS2DEV_TIMING_SPEC ) {
+		timing = timing_profiles[ PS2DEV_TIMING_SPEC ];
+	}
+	else {
+		profile = PS2DEV_TIMING_SX2_FAST;
+		timing = timing_profiles[ PS2DEV_TIMING_SX2_FAST ];
+	}
+	timing_profile = profile;
+	is_calibrating = false;
+}
+
+// --------------------------------------------------------------------
+int ps2dev_get_timing_profile( void ) {
+
+	return timing_profile;
+}
+
+// --------------------------------------------------------------------
+void ps2dev_set_custom_timing( const PS2DEV_TIMING_T *p_timing ) {
+
+	custom_timing = *p_timing;
+	if( timing_profile == PS2DEV_TIMING_CUSTOM ) {
+		timing = custom_timing;
+	}
+}
+
+// --------------------------------------------------------------------
+void ps2dev_get_timing( PS2DEV_TIMING_T *p_timing ) {
+
+	*p_timing = timing;
+}
+
+// --------------------------------------------------------------------
+void ps2dev_calibration_start( void ) {
+
+	calibration_level = 0;
+	calibration_pass_count = 0;
+	is_calibration_attempted = false;
+	make_calibration_timing( calibration_level, &timing );
+	is_calibrating = true;
+}
+
+// --------------------------------------------------------------------
+void ps2dev_calibration_report( bool success ) {
+
+	if( !is_calibrating ) {
+		return;
+	}
+	if( success ) {
+		is_calibration_attempted = false;
+		calibration_pass_count++;
+		if( calibration_pass_count < CALIBRATION_PASS_COUNT ) {
+			return;
+		}
+		calibration_pass_count = 0;
+		if( calibration_level < (CALIBRATION_LEVELS - 1) ) {
+			//	Try the next faster level.
+			calibration_level++;
+			make_calibration_timing( calibration_level, &timing );
+			return;
+		}
+	}
+	else if( calibration_level > 0 ) {
+		//	The host did not accept this level, so use the previous one.
+		calibration_level--;
+	}
+	//	Finish. The result is kept as the custom profile.
+	make_calibration_timing( calibration_level, &custom_timing );
+	ps2dev_set_timing_profile( PS2DEV_TIMING_CUSTOM );
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_is_calibrating( void ) {
+
+	return is_calibrating;
+}
+
+// --------------------------------------------------------------------
+bool ps2dev_capture_is_full( void ) {
+	#if PS2DEV_CAPTURE
+		return( capture_size + 6 > PS2DEV_CAPTURE_SIZE );
+	#else
+		return false;
+	#endif
+}
+
+// --------------------------------------------------------------------
+void ps2dev_capture_dump( void ) {
+	#if PS2DEV_CAPTURE
+		int i;
+
+		for( i = 0; i < capture_size; i++ ) {
+			if( (i & 31) == 0 ) {
+				printf( (i == 0) ? "PS2CAP" : "\r\nPS2CAP" );
+			}
+			printf( " %02X", capture_buffer[i] );
+		}
+		printf( "\r\nPS2CAP END\r\n" );
+		capture_size = 0;
+	#endif
 }
@@ -29,6 +29,90 @@
 #define PS2CLK_PORT		11
 #define PS2DAT_PORT		10
 
+//	PS/2 keyboard port
+#define PS2KBD_CLK_PORT	13
+#define PS2KBD_DAT_PORT	12
+
+//	PS/2 keyboard port
+//		0: Not used (default). PS2KBD_CLK_PORT and PS2KBD_DAT_PORT are left as they are.
+//		1: Use the PS/2 keyboard port. Define it here (or add -DPS2DEV_KEYBOARD_ENABLE=1),
+//		   and rebuild. See doc/customize.txt.
+#ifndef PS2DEV_KEYBOARD_ENABLE
+#define PS2DEV_KEYBOARD_ENABLE		0
+#endif
+
+enum {
+	PS2DEV_PORT_MOUSE = 0,		//	PS2CLK_PORT, PS2DAT_PORT
+	PS2DEV_PORT_KEYBOARD,		//	PS2KBD_CLK_PORT, PS2KBD_DAT_PORT
+	PS2DEV_PORT_NUM,
+};
+
+// --------------------------------------------------------------------
+//	PS/2 timing
+//		Each value is the minimum time [usec] of the state.
+// --------------------------------------------------------------------
+typedef struct {
+	uint16_t	clk_low;		//	Width of PS2CLK LOW
+	uint16_t	clk_high;		//	Width of PS2CLK HIGH (receive)
+	uint16_t	data_setup;		//	PS2DAT setup time to PS2CLK edge (send)
+	uint16_t	ack_setup;		//	PS2DAT setup/hold time around the ACK bit
+	uint16_t	ack_clk_high;	//	Width of PS2CLK HIGH before the ACK bit
+} PS2DEV_TIMING_T;
+
+enum {
+	PS2DEV_TIMING_SX2_FAST = 0,	//	Short PS2CLK accepted by the SX2 main unit
+	PS2DEV_TIMING_SPEC,			//	PS/2 specification compliant
+	PS2DEV_TIMING_CUSTOM,		//	PS2DEV_CUSTOM_TIMING or the result of calibration
+};
+
+//	Timing profile after ps2dev_init()
+#ifndef PS2DEV_TIMING_PROFILE
+#define PS2DEV_TIMING_PROFILE		PS2DEV_TIMING_SX2_FAST
+#endif
+
+//	Initial value of PS2DEV_TIMING_CUSTOM
+#ifndef PS2DEV_CUSTOM_TIMING
+#define PS2DEV_CUSTOM_TIMING		{ 10, 10, 5, 2, 8 }
+#endif
+
+//	1: Start the calibration in ps2dev_init()
+//		main.cpp prints the result (ps2dev_get_timing) in the form of PS2DEV_CUSTOM_TIMING.
+#ifndef PS2DEV_TIMING_CALIBRATION
+#define PS2DEV_TIMING_CALIBRATION	0
+#endif
+
+//	1: Capture the PS/2 bytes (for tools/ps2_capture.py)
+//		Each byte is recorded as [time][data].
+//			time ..... ((microseconds from the previous record) << 1) | direction
+//			           7 bits per byte, LSB first, bit7=1: next byte follows
+//			           direction 1: HOST to device, 0: device to HOST
+//			data ..... PS/2 data byte
+//		The time of a received byte is the end of its ACK bit, and the time of a sent byte
+//		is the start of its start bit.
+//		ps2dev_capture_dump() prints the records as hex lines "PS2CAP xx xx ...".
+#ifndef PS2DEV_CAPTURE
+#define PS2DEV_CAPTURE				0
+#endif
+
+#ifndef PS2DEV_CAPTURE_SIZE
+#define PS2DEV_CAPTURE_SIZE			16384
+#endif
+
+//	1: Measure the jitter of the PS2CLK/PS2DAT edges (ps2dev_get_jitter)
+#ifndef PS2DEV_JITTER_STATISTICS
+#define PS2DEV_JITTER_STATISTICS	0
+#endif
+
+#define PS2DEV_JITTER_BINS			8
+
+//	Delay of the edges from the programmed timing
+typedef struct {
+	uint32_t	count;							//	Number of edges
+	uint32_t	total_us;
+	uint32_t	max_us;
+	uint32_t	histogram[ PS2DEV_JITTER_BINS ];	//	0usec, 1usec, ..., 7usec or more
+} PS2DEV_JITTER_T;
+
 // --------------------------------------------------------------------
 //	Initialize PS2DEV driver
 //	input:
@@ -51,46 +135,206 @@ void ps2dev_task( void );
 // --------------------------------------------------------------------
 //	Check receive buffer empty
 //	input:
-//		none
+//		port ............ PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
 //	output:
 //		false ........... It's empty.
 //		true ............ It's not empty.
 // --------------------------------------------------------------------
-bool ps2dev_check_receive_buffer_empty( void );
+bool ps2dev_check_receive_buffer_empty( int port );
 
 // --------------------------------------------------------------------
 //	Get receive data (1byte)
 //	input:
+//		port ............ PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
 //		p_data .......... Address of buffer to return read results.
 //	output:
 //		true ............ Success. *p_data is active.
 //		false ........... Failed. Not found received data.
 // --------------------------------------------------------------------
-bool ps2dev_get_receive_data( uint8_t *p_data );
+bool ps2dev_get_receive_data( int port, uint8_t *p_data );
 
 // --------------------------------------------------------------------
 //	Send data
 //	input:
-//		send data
+//		port ........... PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
+//		data ........... send data
 //	output:
 //		true ........... Success
 //		false .......... Failed (aborted)
 // --------------------------------------------------------------------
-bool ps2dev_send_data( uint8_t data );
+bool ps2dev_send_data( int port, uint8_t data );
 
 // --------------------------------------------------------------------
 //	Check send fifo
 //	input:
-//		none
+//		port ........... PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
 //	output:
 //		true ........... empty
 //		false .......... not empty
 // --------------------------------------------------------------------
-bool ps2dev_is_send_fifo_empty( void );
+bool ps2dev_is_send_fifo_empty( int port );
+
+// --------------------------------------------------------------------
+//	Get free space of send fifo
+//	input:
+//		port ........... PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
+//	output:
+//		Number of bytes that can be pushed by ps2dev_send_data()
+// --------------------------------------------------------------------
+int ps2dev_get_send_fifo_free( int port );
+
+// --------------------------------------------------------------------
+//	Check frame in flight
+//	input:
+//		none
+//	output:
+//		true ........... A frame is being sent or received, or a byte is waiting in send fifo.
+//		false .......... All ports are idle.
+// --------------------------------------------------------------------
+bool ps2dev_is_busy( void );
+
+// --------------------------------------------------------------------
+//	Check the bits being clocked
+//	input:
+//		none
+//	output:
+//		true ........... A frame is being sent or received. ps2dev_task() must be called
+//		                 within the width of PS2CLK, or the bit is stretched.
+//		false .......... No frame, or waiting for the host. (The host holds PS2CLK LOW.)
+//	comment:
+//		A frame is 11 bits, about 1 msec. Between the frames, ps2dev_is_busy() can be
+//		true while the next byte waits in send fifo.
+// --------------------------------------------------------------------
+bool ps2dev_is_in_frame( void );
+
+// --------------------------------------------------------------------
+//	Get jitter statistics
+//	input:
+//		p_jitter ........ Address of buffer to return the statistics.
+//	output:
+//		none
+//	comment:
+//		All 0 if PS2DEV_JITTER_STATISTICS is 0.
+// --------------------------------------------------------------------
+void ps2dev_get_jitter( PS2DEV_JITTER_T *p_jitter );
+
+// --------------------------------------------------------------------
+//	Reset jitter statistics
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void ps2dev_reset_jitter( void );
+
+// --------------------------------------------------------------------
+//	Get the number of bytes pushed to send fifo
+//	input:
+//		port ........... PS2DEV_PORT_MOUSE or PS2DEV_PORT_KEYBOARD
+//	output:
+//		Index of the next byte pushed by ps2dev_send_data() (always 0 if LATENCY_TRACE is 0)
+// --------------------------------------------------------------------
+uint32_t ps2dev_get_send_push_count( int port );
+
+// --------------------------------------------------------------------
+//	Select timing profile
+//	input:
+//		profile ......... PS2DEV_TIMING_SX2_FAST, PS2DEV_TIMING_SPEC or PS2DEV_TIMING_CUSTOM
+//	output:
+//		none
+//	comment:
+//		The calibration in progress is canceled.
+// --------------------------------------------------------------------
+void ps2dev_set_timing_profile( int profile );
+
+// --------------------------------------------------------------------
+//	Get timing profile
+//	input:
+//		none
+//	output:
+//		Current timing profile
+// --------------------------------------------------------------------
+int ps2dev_get_timing_profile( void );
+
+// --------------------------------------------------------------------
+//	Set the timing of PS2DEV_TIMING_CUSTOM
+//	input:
+//		p_timing ........ Address of timing
+//	output:
+//		none
+// --------------------------------------------------------------------
+void ps2dev_set_custom_timing( const PS2DEV_TIMING_T *p_timing );
+
+// --------------------------------------------------------------------
+//	Get the timing currently in use
+//	input:
+//		p_timing ........ Address of buffer to return the timing.
+//	output:
+//		none
+// --------------------------------------------------------------------
+void ps2dev_get_timing( PS2DEV_TIMING_T *p_timing );
+
+// --------------------------------------------------------------------
+//	Start calibration
+//	input:
+//		none
+//	output:
+//		none
+//	comment:
+//		It starts from PS2DEV_TIMING_SPEC and shortens the timing step by
+//		step while the host keeps accepting it. The result is stored in
+//		PS2DEV_TIMING_CUSTOM.
+// --------------------------------------------------------------------
+void ps2dev_calibration_start( void );
+
+// --------------------------------------------------------------------
+//	Report the result of a transaction for calibration
+//	input:
+//		success ......... true: The host accepted the transaction.
+//		                  false: Timeout or resend request from the host.
+//	output:
+//		none
+//	comment:
+//		ps2dev_task() also counts a failure when no transaction succeeds for
+//		1 second after the host starts one, so the calibration does not stay
+//		on a level forever. While the host sends nothing, it only waits.
+// --------------------------------------------------------------------
+void ps2dev_calibration_report( bool success );
+
+// --------------------------------------------------------------------
+//	Check calibration
+//	input:
+//		none
+//	output:
+//		true ............ Calibration in progress
+//		false ........... Not calibrating
+// --------------------------------------------------------------------
+bool ps2dev_is_calibrating( void );
+
+// --------------------------------------------------------------------
+//	Check capture buffer
+//	input:
+//		none
+//	output:
+//		true ............ The capture buffer is full. (always false if PS2DEV_CAPTURE is 0)
+//		false ........... Not full
+// --------------------------------------------------------------------
+bool ps2dev_capture_is_full( void );
+
+// --------------------------------------------------------------------
+//	Dump the captured records to stdio, and restart the capture
+//	input:
+//		none
+//	output:
+//		none
+//	comment:
+//		PS/2 is not processed while it prints. The gap is recorded in the next record.
+// --------------------------------------------------------------------
+void ps2dev_capture_dump( void );
 
 // --------------------------------------------------------------------
 //	fobOp
 // --------------------------------------------------------------------
-int ps2dev_get_state( void );
+int ps2dev_get_state( int port );
 
 #endif
@@ -0,0 +1,132 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator cooperative task scheduler
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+//	It does not depend on the Pico SDK, so it can be built on the host with a fake time source.
+
+#include <stdio.h>
+#include <stddef.h>
+#include "scheduler.h"
+
+static SCHED_TASK_T *p_task_table = NULL;
+static int task_count = 0;
+static uint32_t (*p_get_time)( void ) = NULL;
+
+// --------------------------------------------------------------------
+void sched_reset_statistics( void ) {
+	uint32_t now = p_get_time();
+	int i;
+
+	for( i = 0; i < task_count; i++ ) {
+		p_task_table[i].last_start_us	= now;
+		p_task_table[i].run_count		= 0;
+		p_task_table[i].max_runtime_us	= 0;
+		p_task_table[i].max_interval_us	= 0;
+		p_task_table[i].overrun_count	= 0;
+		p_task_table[i].late_count		= 0;
+	}
+}
+
+// --------------------------------------------------------------------
+void sched_init( SCHED_TASK_T *p_tasks, int count, uint32_t (*p_get_us)( void ) ) {
+
+	p_task_table = p_tasks;
+	task_count = count;
+	p_get_time = p_get_us;
+	sched_reset_statistics();
+}
+
+// --------------------------------------------------------------------
+static void run_task( SCHED_TASK_T *p ) {
+	uint32_t start, runtime, interval;
+
+	start = p_get_time();
+	interval = start - p->last_start_us;
+	if( p->run_count != 0 && interval > p->max_interval_us ) {
+		p->max_interval_us = interval;
+	}
+	p->last_start_us = start;
+	p->p_task();
+	runtime = p_get_time() - start;
+	if( runtime > p->max_runtime_us ) {
+		p->max_runtime_us = runtime;
+	}
+	if( p->budget_us != 0 && runtime > p->budget_us ) {
+		p->overrun_count++;
+	}
+	p->run_count++;
+}
+
+// --------------------------------------------------------------------
+static bool is_deadline_passed( const SCHED_TASK_T *p, uint32_t now ) {
+
+	return( p->deadline_us != 0 && (now - p->last_start_us) >= p->deadline_us );
+}
+
+// --------------------------------------------------------------------
+void sched_run( void ) {
+	SCHED_TASK_T *p_urgent = NULL;
+	uint32_t now;
+	int i;
+
+	for( i = 0; i < task_count; i++ ) {
+		if( p_task_table[i].p_is_urgent != NULL && p_task_table[i].p_is_urgent() ) {
+			p_urgent = &p_task_table[i];
+			break;
+		}
+	}
+	if( p_urgent == NULL ) {
+		//	Nothing is urgent: round-robin
+		for( i = 0; i < task_count; i++ ) {
+			run_task( &p_task_table[i] );
+		}
+		return;
+	}
+
+	//	The urgent task runs. The other tasks are deferred until their deadline.
+	run_task( p_urgent );
+	now = p_get_time();
+	for( i = 0; i < task_count; i++ ) {
+		if( &p_task_table[i] != p_urgent && is_deadline_passed( &p_task_table[i], now ) ) {
+			p_task_table[i].late_count++;
+			run_task( &p_task_table[i] );
+			now = p_get_time();
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+void sched_dump( void ) {
+	int i;
+
+	for( i = 0; i < task_count; i++ ) {
+		printf( "SCHED %s runs=%lu max=%luus interval=%luus overrun=%lu late=%lu\r\n", 
+			p_task_table[i].p_name, 
+			(unsigned long) p_task_table[i].run_count, 
+			(unsigned long) p_task_table[i].max_runtime_us, 
+			(unsigned long) p_task_table[i].max_interval_us, 
+			(unsigned long) p_task_table[i].overrun_count, 
+			(unsigned long) p_task_table[i].late_count );
+	}
+}
@@ -0,0 +1,108 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator cooperative task scheduler
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		//	1: main() prints the statistics of each task, the core layout, the USB mounts and the key latency to stdio
+		#ifndef SCHED_STATISTICS_DUMP
+		#define SCHED_STATISTICS_DUMP		0
+		#endif
+
+		//	Interval of sched_dump() called by main() [msec]
+		#define SCHED_DUMP_INTERVAL			10000
+
+		//	Task
+		//		The table order is the priority. While a task reports that it is urgent
+		//		(e.g. a PS/2 frame is in flight), only the urgent task runs. The other tasks
+		//		wait, but not longer than their deadline (starvation limit): a task whose
+		//		deadline has passed runs even if the urgent state continues, and it is
+		//		counted in late_count. Otherwise all tasks run in turn.
+		typedef struct {
+			//	Configuration
+			const char	*p_name;
+			void		(*p_task)( void );
+			bool		(*p_is_urgent)( void );	//	NULL: never urgent
+			uint32_t	deadline_us;			//	The task runs at least once in this period. 0: no deadline
+			uint32_t	budget_us;				//	Expected maximum runtime of one call
+			//	Statistics
+			uint32_t	last_start_us;
+			uint32_t	run_count;
+			uint32_t	max_runtime_us;
+			uint32_t	max_interval_us;		//	Maximum time between two calls
+			uint32_t	overrun_count;			//	Number of calls longer than budget_us
+			uint32_t	late_count;				//	Number of calls during the urgent state (deadline passed)
+		} SCHED_TASK_T;
+
+		// --------------------------------------------------------------------
+		//	Initialize scheduler
+		//	input:
+		//		p_tasks ......... Task table (the statistics are cleared)
+		//		count ........... Number of tasks
+		//		p_get_us ........ Time source [usec] (time_us_32() on the target)
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void sched_init( SCHED_TASK_T *p_tasks, int count, uint32_t (*p_get_us)( void ) );
+
+		// --------------------------------------------------------------------
+		//	Run one pass
+		//	input:
+		//		none
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void sched_run( void );
+
+		// --------------------------------------------------------------------
+		//	Clear statistics
+		//	input:
+		//		none
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void sched_reset_statistics( void );
+
+		// --------------------------------------------------------------------
+		//	Print the statistics to stdio
+		//	input:
+		//		none
+		//	output:
+		//		none
+		//	comment:
+		//		"SCHED <name> runs=... max=...us interval=...us overrun=... late=..." for each task.
+		// --------------------------------------------------------------------
+		void sched_dump( void );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
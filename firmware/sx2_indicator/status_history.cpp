@@ -0,0 +1,235 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator status history
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include "status_history.h"
+#include "u2p.h"
+#include <pico/time.h>
+#include <hardware/sync.h>
+
+#define VARIABLE_MASK			0x7F
+#define VARIABLE_NEXT			0x80
+#define VARIABLE_MAX_BYTES		5			//	32 bits
+
+//	The history is published by seqlock. (odd history_sequence: being updated)
+//	status_history_append() is the only writer, so it never waits for the reader on the other core.
+static uint8_t history[ STATUS_HISTORY_SIZE ];
+static int history_head = 0;				//	Oldest record
+static int history_tail = 0;				//	Next record is written here
+static int history_used = 0;
+static volatile uint32_t history_sequence = 0;
+
+//	Status and time before the oldest record
+static uint8_t base_status[ U2P_STATUS_MAX_LENGTH ];
+static uint32_t base_time;
+
+//	Status and time of the newest record
+static uint8_t last_status[ U2P_STATUS_MAX_LENGTH ];
+static uint32_t last_time;
+
+// --------------------------------------------------------------------
+static inline uint32_t _get_ms( void ) {
+	return to_ms_since_boot( get_absolute_time() );
+}
+
+// --------------------------------------------------------------------
+static inline uint8_t history_peek( int head, int offset ) {
+	return history[ (head + offset) % STATUS_HISTORY_SIZE ];
+}
+
+// --------------------------------------------------------------------
+//	Decode the record at offset from head
+//	The return value is the size of the record.
+//	The reader may see a record being written, so the length of the variable is limited.
+//	(The result is discarded by the seqlock.)
+//
+static int decode_record( int head, int offset, uint32_t *p_time_delta, uint8_t *p_status ) {
+	int size = 0;
+	int shift;
+	int index;
+	uint8_t d;
+	uint32_t change_mask;
+
+	*p_time_delta = 0;
+	shift = 0;
+	do {
+		d = history_peek( head, offset + size );
+		size++;
+		*p_time_delta |= (uint32_t)(d & VARIABLE_MASK) << shift;
+		shift += 7;
+	} while( (d & VARIABLE_NEXT) && size < VARIABLE_MAX_BYTES );
+
+	change_mask = 0;
+	shift = 0;
+	do {
+		d = history_peek( head, offset + size );
+		size++;
+		change_mask |= (uint32_t)(d & VARIABLE_MASK) << shift;
+		shift += 7;
+	} while( (d & VARIABLE_NEXT) && shift < VARIABLE_MAX_BYTES * 7 );
+
+	for( index = 0; change_mask != 0 && index < U2P_STATUS_MAX_LENGTH; index++, change_mask >>= 1 ) {
+		if( change_mask & 1 ) {
+			p_status[ index ] = history_peek( head, offset + size );
+			size++;
+		}
+	}
+	return size;
+}
+
+// --------------------------------------------------------------------
+static void drop_oldest_record( void ) {
+	uint32_t time_delta;
+	int size;
+
+	size = decode_record( history_head, 0, &time_delta, base_status );
+	base_time += time_delta;
+	history_head = (history_head + size) % STATUS_HISTORY_SIZE;
+	history_used -= size;
+}
+
+// --------------------------------------------------------------------
+static void put_variable( uint32_t value ) {
+	do {
+		history[ history_tail ] = (value & VARIABLE_MASK) | ((value > VARIABLE_MASK) ? VARIABLE_NEXT : 0);
+		history_tail = (history_tail + 1) % STATUS_HISTORY_SIZE;
+		history_used++;
+		value >>= 7;
+	} while( value != 0 );
+}
+
+// --------------------------------------------------------------------
+void status_history_init( void ) {
+
+	base_time = _get_ms();
+	last_time = base_time;
+}
+
+// --------------------------------------------------------------------
+void status_history_append( const uint8_t *p_status, int length ) {
+	uint32_t change_mask = 0;
+	uint32_t now, time_delta;
+	int index, size, count = 0;
+
+	for( index = 0; index < length && index < U2P_STATUS_MAX_LENGTH; index++ ) {
+		if( p_status[ index ] != last_status[ index ] ) {
+			change_mask |= 1u << index;
+			count++;
+		}
+	}
+	if( change_mask == 0 ) {
+		return;
+	}
+	now = _get_ms();
+	time_delta = now - last_time;
+
+	//	Maximum size of the record: time delta (5 bytes), change mask (5 bytes), changed bytes
+	size = VARIABLE_MAX_BYTES * 2 + count;
+
+	history_sequence = history_sequence + 1;
+	__dmb();
+	while( STATUS_HISTORY_SIZE - history_used < size ) {
+		drop_oldest_record();
+	}
+	put_variable( time_delta );
+	put_variable( change_mask );
+	for( index = 0; change_mask != 0; index++, change_mask >>= 1 ) {
+		if( change_mask & 1 ) {
+			history[ history_tail ] = p_status[ index ];
+			history_tail = (history_tail + 1) % STATUS_HISTORY_SIZE;
+			history_used++;
+			last_status[ index ] = p_status[ index ];
+		}
+	}
+	last_time = now;
+	__dmb();
+	history_sequence = history_sequence + 1;
+}
+
+// --------------------------------------------------------------------
+//	Decode the samples of a field (status_history_query without the seqlock)
+//
+static int decode_samples( int index, uint32_t now, uint32_t period, STATUS_HISTORY_SAMPLE_T *p_samples, int max_samples ) {
+	uint8_t status[ U2P_STATUS_MAX_LENGTH ];
+	uint32_t time, time_delta;
+	int head, used, offset, count, i;
+
+	for( i = 0; i < U2P_STATUS_MAX_LENGTH; i++ ) {
+		status[i] = base_status[i];
+	}
+	time = base_time;
+	head = history_head;
+	used = history_used;
+	p_samples[0].age = now - time;
+	p_samples[0].value = status[ index ];
+	count = 1;
+	for( offset = 0; offset < used; ) {
+		offset += decode_record( head, offset, &time_delta, status );
+		time += time_delta;
+		if( status[ index ] == p_samples[ count - 1 ].value ) {
+			continue;
+		}
+		if( (now - time) > period ) {
+			//	Before the period: It becomes the value at the start of the period.
+			p_samples[0].age = now - time;
+			p_samples[0].value = status[ index ];
+			continue;
+		}
+		if( count == max_samples ) {
+			//	Drop the oldest change. p_samples[0] is kept, unless it is the only one.
+			for( i = 1; i < count - 1; i++ ) {
+				p_samples[i] = p_samples[i + 1];
+			}
+			count = (count > 1) ? (count - 1) : 0;
+		}
+		p_samples[ count ].age = now - time;
+		p_samples[ count ].value = status[ index ];
+		count++;
+	}
+	return count;
+}
+
+// --------------------------------------------------------------------
+int status_history_query( int index, uint32_t period, STATUS_HISTORY_SAMPLE_T *p_samples, int max_samples ) {
+	uint32_t sequence, now;
+	int count, retry;
+
+	if( index < 0 || index >= U2P_STATUS_MAX_LENGTH || max_samples < 1 ) {
+		return 0;
+	}
+	for( retry = 0; retry < STATUS_HISTORY_QUERY_RETRY; retry++ ) {
+		do {
+			sequence = history_sequence;
+		} while( sequence & 1 );
+		__dmb();
+		now = _get_ms();
+		count = decode_samples( index, now, period, p_samples, max_samples );
+		__dmb();
+		if( sequence == history_sequence ) {
+			return count;
+		}
+	}
+	//	status_history_append() was called during every try.
+	return 0;
+}
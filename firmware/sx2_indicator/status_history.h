@@ -0,0 +1,97 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator status history
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __STATUS_HISTORY_H__
+#define __STATUS_HISTORY_H__
+
+#include <cstdint>
+
+//	Size of the history ring [bytes]
+//		Each record is [time delta][change mask][changed bytes].
+//			time delta ..... milliseconds from the previous record, 7 bits per byte, bit7=1: next byte follows
+//			change mask .... bit n is data(n+1), 7 bits per byte, bit7=1: next byte follows
+//			changed bytes .. new values of the changed bytes only
+//		A record is appended only when the status changes. For 1 changed byte of data1...data7,
+//		it is 3 bytes within 127 msec from the previous record, and 4 bytes within 16 seconds.
+//		Memory use:
+//			Idle (no change) ................................ 0 bytes/hour
+//			Typical (3 changes per minute, 5 bytes each) .... 900 bytes/hour
+//			Volume drag at 60 frames/sec (3 bytes each) ..... 180 bytes/sec (648 Kbytes/hour)
+//		The oldest records are dropped when the ring is full. 4096 bytes keep about 4.5 hours
+//		of the typical use, or the last 22 seconds of the volume drag.
+#ifndef STATUS_HISTORY_SIZE
+#define STATUS_HISTORY_SIZE		4096
+#endif
+
+//	Number of tries of status_history_query() when the history is changed while it is read
+#define STATUS_HISTORY_QUERY_RETRY	4
+
+typedef struct {
+	uint32_t	age;			//	[ms] Time from the change to now
+	uint8_t		value;			//	Value after the change
+} STATUS_HISTORY_SAMPLE_T;
+
+// --------------------------------------------------------------------
+//	Initialize status history
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void status_history_init( void );
+
+// --------------------------------------------------------------------
+//	Append the status
+//	input:
+//		p_status ........ Status bytes (data1, data2, ...)
+//		length .......... Number of bytes (0 ... U2P_STATUS_MAX_LENGTH)
+//	output:
+//		none
+//	comment:
+//		It appends a record only when a byte changes. 
+//		The cost is O(1) (amortized, each record is dropped only once).
+//		It must be called from one core only. It never waits for status_history_query().
+// --------------------------------------------------------------------
+void status_history_append( const uint8_t *p_status, int length );
+
+// --------------------------------------------------------------------
+//	Query a field over the last period
+//	input:
+//		index ........... Field index (U2P_DATA1 ...)
+//		period .......... [ms] Length of the period
+//		p_samples ....... Address of buffer to return the samples.
+//		max_samples ..... Size of p_samples
+//	output:
+//		Number of samples.
+//	comment:
+//		p_samples[0] is the value at the start of the period (or the oldest record), and the
+//		following ones are the changes in order of time. If there are more changes than
+//		max_samples, the newest ones are returned.
+//		It can be called from the other core. If the history is changed while it is read, it is
+//		read again up to STATUS_HISTORY_QUERY_RETRY times, and then 0 is returned.
+// --------------------------------------------------------------------
+int status_history_query( int index, uint32_t period, STATUS_HISTORY_SAMPLE_T *p_samples, int max_samples );
+
+#endif
@@ -391,6 +391,12 @@ void tft_send_framebuffer( const uint16_t *p_buffer ) {
 	dma_channel_configure( dma_tx_channel, &dma_tx_config, &spi_get_hw( SPI_PORT )->dr, p_buffer, len, true /* start */ );
 }
 
+// --------------------------------------------------------------------
+bool tft_is_sending( void ) {
+
+	return dma_channel_is_busy( dma_tx_channel );
+}
+
 // --------------------------------------------------------------------
 void tft_pset( uint16_t *p_dest, int dest_width, int dest_height, int x, int y, uint16_t color ) {
 
@@ -45,6 +45,16 @@ bool tft_init( void );
 // --------------------------------------------------------------------
 void tft_send_framebuffer( const uint16_t *p_buffer );
 
+// --------------------------------------------------------------------
+//	Check the frame buffer being sent
+//	input:
+//		none
+//	output:
+//		true ..... The previous frame is being sent. tft_send_framebuffer() waits for it.
+//		false .... tft_send_framebuffer() starts without waiting.
+// --------------------------------------------------------------------
+bool tft_is_sending( void );
+
 // --------------------------------------------------------------------
 void tft_pset( uint16_t *p_dest, int dest_width, int dest_height, int x, int y, uint16_t color );
 
@@ -0,0 +1,458 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator USB keyboard to PS/2 keyboard converter
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include "u2k.h"
+#include "usb_host_driver.h"
+#include "ps2dev_driver.h"
+#include <pico/time.h>
+#include <tusb.h>
+
+enum {
+	PS2_IDLE = 0,
+	PS2_RECV_ARGUMENT,
+};
+static int ps2state = PS2_IDLE;
+
+#define KEYBOARD_ID1			0xAB
+#define KEYBOARD_ID2			0x83
+#define SCANCODE_SET			0x02		//	Only the scancode set 2 is supported.
+
+//	Scancode set 2 of each HID usage (keyboard page)
+//		bit7-0: scancode, bit8: 0xE0 prefix, 0: no scancode
+//		PrintScreen and Pause have the special sequences below.
+#define SC_E0					0x100
+#define SC_CODE_MASK			0x0FF
+#define USAGE_PRINT_SCREEN		0x46
+#define USAGE_PAUSE				0x48
+#define USAGE_MODIFIER			0xE0
+
+static const uint16_t usage_to_set2[ 256 ] = {
+	//	0x00 ... 0x0F: -, -, -, -, A, B, C, D, E, F, G, H, I, J, K, L
+	0x000, 0x000, 0x000, 0x000, 0x01C, 0x032, 0x021, 0x023, 0x024, 0x02B, 0x034, 0x033, 0x043, 0x03B, 0x042, 0x04B,
+	//	0x10 ... 0x1F: M, N, O, P, Q, R, S, T, U, V, W, X, Y, Z, 1, 2
+	0x03A, 0x031, 0x044, 0x04D, 0x015, 0x02D, 0x01B, 0x02C, 0x03C, 0x02A, 0x01D, 0x022, 0x035, 0x01A, 0x016, 0x01E,
+	//	0x20 ... 0x2F: 3, 4, 5, 6, 7, 8, 9, 0, Enter, Esc, BS, Tab, Space, -, =, [
+	0x026, 0x025, 0x02E, 0x036, 0x03D, 0x03E, 0x046, 0x045, 0x05A, 0x076, 0x066, 0x00D, 0x029, 0x04E, 0x055, 0x054,
+	//	0x30 ... 0x3F: ], \, Non-US #, ;, ', `, ",", ., /, CapsLock, F1, F2, F3, F4, F5, F6
+	0x05B, 0x05D, 0x05D, 0x04C, 0x052, 0x00E, 0x041, 0x049, 0x04A, 0x058, 0x005, 0x006, 0x004, 0x00C, 0x003, 0x00B,
+	//	0x40 ... 0x4F: F7, F8, F9, F10, F11, F12, PrintScreen, ScrollLock, Pause, Insert, Home, PageUp, Delete, End, PageDown, Right
+	0x083, 0x00A, 0x001, 0x009, 0x078, 0x007, 0x000, 0x07E, 0x000, 0x170, 0x16C, 0x17D, 0x171, 0x169, 0x17A, 0x174,
+	//	0x50 ... 0x5F: Left, Down, Up, NumLock, KP /, KP *, KP -, KP +, KP Enter, KP 1, KP 2, KP 3, KP 4, KP 5, KP 6, KP 7
+	0x16B, 0x172, 0x175, 0x077, 0x14A, 0x07C, 0x07B, 0x079, 0x15A, 0x069, 0x072, 0x07A, 0x06B, 0x073, 0x074, 0x06C,
+	//	0x60 ... 0x6F: KP 8, KP 9, KP 0, KP ., Non-US \, Application, Power, KP =, F13, F14, F15, F16, F17, F18, F19, F20
+	0x075, 0x07D, 0x070, 0x071, 0x061, 0x12F, 0x137, 0x00F, 0x008, 0x010, 0x018, 0x020, 0x028, 0x030, 0x038, 0x040,
+	//	0x70 ... 0x7F: F21, F22, F23, F24, -, ...
+	0x048, 0x050, 0x057, 0x05F, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+	//	0x80 ... 0x8F: -, -, -, -, -, KP ",", -, Ro, Katakana/Hiragana, Yen, Henkan, Muhenkan, -, -, -, -
+	0x000, 0x000, 0x000, 0x000, 0x000, 0x06D, 0x000, 0x051, 0x013, 0x06A, 0x064, 0x067, 0x000, 0x000, 0x000, 0x000,
+	//	0x90 ... 0xDF: -
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	//	0xE0 ... 0xEF: LCtrl, LShift, LAlt, LGUI, RCtrl, RShift, RAlt, RGUI, -, ...
+	0x014, 0x012, 0x011, 0x11F, 0x114, 0x059, 0x111, 0x127, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+	//	0xF0 ... 0xFF: -
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const uint8_t make_print_screen[]	= { 0xE0, 0x12, 0xE0, 0x7C };
+static const uint8_t break_print_screen[]	= { 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12 };
+static const uint8_t make_pause[]			= { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };	//	No break code
+
+#define SCANCODE_MAX_LENGTH		8
+
+static bool is_scanning_enabled = true;		//	0xF4: enable, 0xF5: disable
+static uint8_t typematic = U2K_DEFAULT_TYPEMATIC;
+static uint32_t typematic_delay_us;
+static uint32_t typematic_period_us;
+static uint8_t typematic_usage = 0;			//	The last pressed key repeats. 0: none
+static uint64_t typematic_time;				//	Time of the next repeat
+static uint8_t last_byte = 0xAA;			//	for 0xFE (Resend)
+
+static USB_KEY_EVENT_T pending_event;		//	Waiting for the space of the send FIFO
+static bool has_pending_event = false;
+
+static U2K_LATENCY_T latency;
+static uint64_t latency_sum;
+
+//	Command table
+//		Same as u2p. The command which has an argument sends ACK(0xFA) at first,
+//		and the response after the argument.
+typedef struct {
+	uint8_t			command;
+	bool			has_argument;
+	const uint8_t	*p_response;
+	int				response_length;
+	void			(*p_handler)( uint8_t argument );
+} PS2_COMMAND_T;
+
+static const uint8_t response_ack[] = { 0xFA };
+static const uint8_t response_reset[] = { 0xFA, 0xAA };
+static const uint8_t response_echo[] = { 0xEE };
+static const uint8_t response_id[] = { 0xFA, KEYBOARD_ID1, KEYBOARD_ID2 };
+static uint8_t response_scancode_set[] = { 0xFA, SCANCODE_SET };
+static int scancode_set_response_length = 1;
+
+#define COMMAND_INDEX_BASE		0xE0
+#define COMMAND_INDEX_SIZE		0x20
+static const PS2_COMMAND_T *command_index[ COMMAND_INDEX_SIZE ];
+static const PS2_COMMAND_T *p_current_command = nullptr;
+static uint64_t start_time;
+
+// --------------------------------------------------------------------
+static uint64_t inline _get_us( void ) {
+	return to_us_since_boot( get_absolute_time() );
+}
+
+// --------------------------------------------------------------------
+static void send_bytes( const uint8_t *p_data, int length ) {
+	int i;
+
+	for( i = 0; i < length; i++ ) {
+		ps2dev_send_data( PS2DEV_PORT_KEYBOARD, p_data[i] );
+	}
+	if( length > 0 ) {
+		last_byte = p_data[ length - 1 ];
+	}
+}
+
+// --------------------------------------------------------------------
+//	Typematic rate/delay (argument of 0xF3)
+//		period = (8 + A) * 2^B * 4.17ms, A: bit2-0, B: bit4-3
+//		delay  = (1 + D) * 250ms, D: bit6-5
+//
+static void set_typematic( uint8_t value ) {
+
+	typematic = value & 0x7F;
+	typematic_period_us = (8 + (typematic & 7)) * (1 << ((typematic >> 3) & 3)) * 4167;
+	typematic_delay_us = (1 + ((typematic >> 5) & 3)) * 250000;
+}
+
+// --------------------------------------------------------------------
+static void set_default_keyboard_mode( void ) {
+
+	set_typematic( U2K_DEFAULT_TYPEMATIC );
+	typematic_usage = 0;
+}
+
+// --------------------------------------------------------------------
+//	Make the scancode sequence of a key
+//	output:
+//		Length of the sequence (0: The key has no scancode.)
+//
+static int make_scancode( uint8_t usage, bool is_make, uint8_t *p_code ) {
+	const uint8_t *p_special = nullptr;
+	int length = 0, i;
+	uint16_t code;
+
+	if( usage == USAGE_PRINT_SCREEN ) {
+		p_special = is_make ? make_print_screen : break_print_screen;
+		length = is_make ? sizeof(make_print_screen) : sizeof(break_print_screen);
+	}
+	else if( usage == USAGE_PAUSE ) {
+		p_special = make_pause;
+		length = is_make ? sizeof(make_pause) : 0;
+	}
+	if( p_special != nullptr ) {
+		for( i = 0; i < length; i++ ) {
+			p_code[i] = p_special[i];
+		}
+		return length;
+	}
+
+	code = usage_to_set2[ usage ];
+	if( code == 0 ) {
+		return 0;
+	}
+	if( code & SC_E0 ) {
+		p_code[ length++ ] = 0xE0;
+	}
+	if( !is_make ) {
+		p_code[ length++ ] = 0xF0;
+	}
+	p_code[ length++ ] = (uint8_t)( code & SC_CODE_MASK );
+	return length;
+}
+
+// --------------------------------------------------------------------
+static void update_latency( uint32_t event_time_us ) {
+	uint32_t delta;
+
+	delta = time_us_32() - event_time_us;
+	if( latency.count == 0 || delta < latency.min_us ) {
+		latency.min_us = delta;
+	}
+	if( delta > latency.max_us ) {
+		latency.max_us = delta;
+	}
+	latency.count++;
+	latency_sum += delta;
+	latency.average_us = (uint32_t)( latency_sum / latency.count );
+}
+
+// --------------------------------------------------------------------
+static void process_key_event( void ) {
+	uint8_t code[ SCANCODE_MAX_LENGTH ];
+	int length;
+
+	if( !has_pending_event ) {
+		if( !usb_get_key_event( &pending_event ) ) {
+			return;
+		}
+		has_pending_event = true;
+	}
+	if( !is_scanning_enabled ) {
+		has_pending_event = false;
+		return;
+	}
+	length = make_scancode( pending_event.usage, pending_event.is_make, code );
+	if( length > ps2dev_get_send_fifo_free( PS2DEV_PORT_KEYBOARD ) ) {
+		//	The sequence is not split. Wait for the space.
+		return;
+	}
+	has_pending_event = false;
+	send_bytes( code, length );
+	update_latency( pending_event.time_us );
+
+	//	Typematic: The last pressed key repeats. The modifiers and Pause do not repeat.
+	if( pending_event.is_make ) {
+		if( length > 0 && pending_event.usage < USAGE_MODIFIER && pending_event.usage != USAGE_PAUSE ) {
+			typematic_usage = pending_event.usage;
+			typematic_time = _get_us() + typematic_delay_us;
+		}
+	}
+	else if( pending_event.usage == typematic_usage ) {
+		typematic_usage = 0;
+	}
+}
+
+// --------------------------------------------------------------------
+static void process_typematic( void ) {
+	uint8_t code[ SCANCODE_MAX_LENGTH ];
+	int length;
+
+	if( typematic_usage == 0 || !is_scanning_enabled || _get_us() < typematic_time ) {
+		return;
+	}
+	if( !ps2dev_is_send_fifo_empty( PS2DEV_PORT_KEYBOARD ) ) {
+		return;
+	}
+	length = make_scancode( typematic_usage, true, code );
+	send_bytes( code, length );
+	typematic_time = typematic_time + typematic_period_us;
+}
+
+// --------------------------------------------------------------------
+static void command_reset( uint8_t argument ) {
+
+	(void) argument;
+	set_default_keyboard_mode();
+	is_scanning_enabled = true;
+}
+
+// --------------------------------------------------------------------
+static void command_resend( uint8_t argument ) {
+
+	(void) argument;
+	ps2dev_send_data( PS2DEV_PORT_KEYBOARD, last_byte );
+}
+
+// --------------------------------------------------------------------
+static void command_set_defaults( uint8_t argument ) {
+
+	(void) argument;
+	set_default_keyboard_mode();
+}
+
+// --------------------------------------------------------------------
+static void command_disable_scanning( uint8_t argument ) {
+
+	(void) argument;
+	set_default_keyboard_mode();
+	is_scanning_enabled = false;
+}
+
+// --------------------------------------------------------------------
+static void command_enable_scanning( uint8_t argument ) {
+
+	(void) argument;
+	typematic_usage = 0;
+	is_scanning_enabled = true;
+}
+
+// --------------------------------------------------------------------
+static void command_set_typematic( uint8_t argument ) {
+
+	set_typematic( argument );
+}
+
+// --------------------------------------------------------------------
+static void command_scancode_set( uint8_t argument ) {
+
+	//	0: Get the current set. The other sets are acknowledged, but the set 2 is kept.
+	scancode_set_response_length = (argument == 0) ? sizeof(response_scancode_set) : 1;
+}
+
+// --------------------------------------------------------------------
+static void command_set_leds( uint8_t argument ) {
+	uint8_t leds = 0;
+
+	//	PS/2: bit0 ScrollLock, bit1 NumLock, bit2 CapsLock
+	if( argument & 0x01 ) {
+		leds |= KEYBOARD_LED_SCROLLLOCK;
+	}
+	if( argument & 0x02 ) {
+		leds |= KEYBOARD_LED_NUMLOCK;
+	}
+	if( argument & 0x04 ) {
+		leds |= KEYBOARD_LED_CAPSLOCK;
+	}
+	usb_set_keyboard_leds( leds );
+}
+
+// --------------------------------------------------------------------
+static const PS2_COMMAND_T command_table[] = {
+	{ 0xFF, false, response_reset,			sizeof(response_reset),			command_reset				},	//	Reset
+	{ 0xFE, false, nullptr,					0,								command_resend				},	//	Resend
+	{ 0xF6, false, response_ack,			sizeof(response_ack),			command_set_defaults		},	//	Set defaults
+	{ 0xF5, false, response_ack,			sizeof(response_ack),			command_disable_scanning	},	//	Disable scanning
+	{ 0xF4, false, response_ack,			sizeof(response_ack),			command_enable_scanning		},	//	Enable scanning
+	{ 0xF3, true,  response_ack,			sizeof(response_ack),			command_set_typematic		},	//	Set typematic rate/delay
+	{ 0xF2, false, response_id,				sizeof(response_id),			nullptr						},	//	Get device ID
+	{ 0xF0, true,  response_scancode_set,	1,								command_scancode_set		},	//	Get/Set scancode set
+	{ 0xEE, false, response_echo,			sizeof(response_echo),			nullptr						},	//	Echo
+	{ 0xED, true,  response_ack,			sizeof(response_ack),			command_set_leds			},	//	Set LEDs
+};
+
+// --------------------------------------------------------------------
+static void send_response( const PS2_COMMAND_T *p_command ) {
+
+	if( p_command->p_response == response_scancode_set ) {
+		send_bytes( response_scancode_set, scancode_set_response_length );
+		return;
+	}
+	send_bytes( p_command->p_response, p_command->response_length );
+}
+
+// --------------------------------------------------------------------
+static void ps2_recv_command( void ) {
+	uint8_t data;
+	const PS2_COMMAND_T *p_command;
+
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_KEYBOARD, &data ) ) {
+		process_key_event();
+		process_typematic();
+		return;
+	}
+	if( data < COMMAND_INDEX_BASE || command_index[ data - COMMAND_INDEX_BASE ] == nullptr ) {
+		//	Unknown command
+		ps2dev_send_data( PS2DEV_PORT_KEYBOARD, 0xFE );
+		return;
+	}
+	p_command = command_index[ data - COMMAND_INDEX_BASE ];
+	if( p_command->has_argument ) {
+		ps2dev_send_data( PS2DEV_PORT_KEYBOARD, 0xFA );
+		p_current_command = p_command;
+		ps2state = PS2_RECV_ARGUMENT;
+		start_time = _get_us();
+		return;
+	}
+	if( p_command->p_handler != nullptr ) {
+		p_command->p_handler( 0 );
+	}
+	send_response( p_command );
+}
+
+// --------------------------------------------------------------------
+static void ps2_recv_argument( void ) {
+	uint8_t data;
+
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_KEYBOARD, &data ) ) {
+		if( (_get_us() - start_time) > 50000 ) {
+			//	time out
+			ps2state = PS2_IDLE;
+		}
+		return;
+	}
+	ps2state = PS2_IDLE;
+	if( data >= COMMAND_INDEX_BASE && command_index[ data - COMMAND_INDEX_BASE ] != nullptr ) {
+		//	A command instead of the argument. The previous command is canceled.
+		ps2dev_send_data( PS2DEV_PORT_KEYBOARD, 0xFA );
+		return;
+	}
+	p_current_command->p_handler( data );
+	send_response( p_current_command );
+}
+
+// --------------------------------------------------------------------
+void u2k_init( void ) {
+	size_t i;
+
+	for( i = 0; i < sizeof(command_table) / sizeof(command_table[0]); i++ ) {
+		command_index[ command_table[i].command - COMMAND_INDEX_BASE ] = &command_table[i];
+	}
+	set_default_keyboard_mode();
+	u2k_reset_latency();
+	#if PS2DEV_KEYBOARD_ENABLE
+		//	Self test passed
+		send_bytes( response_reset + 1, 1 );
+	#endif
+}
+
+// --------------------------------------------------------------------
+void u2k_task( void ) {
+
+	#if PS2DEV_KEYBOARD_ENABLE
+		switch( ps2state ) {
+		case PS2_IDLE:
+			ps2_recv_command();
+			break;
+		case PS2_RECV_ARGUMENT:
+			ps2_recv_argument();
+			break;
+		default:
+			ps2state = PS2_IDLE;
+			break;
+		}
+	#endif
+}
+
+// --------------------------------------------------------------------
+void u2k_get_latency( U2K_LATENCY_T *p_latency ) {
+
+	*p_latency = latency;
+}
+
+// --------------------------------------------------------------------
+void u2k_reset_latency( void ) {
+
+	latency.count = 0;
+	latency.min_us = 0;
+	latency.max_us = 0;
+	latency.average_us = 0;
+	latency_sum = 0;
+}
@@ -0,0 +1,84 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//	
+//	SX|2 indicator USB keyboard to PS/2 keyboard converter
+//	Copyright (c) 2022 Takayuki Hara
+//	
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//	
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//	
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#ifndef __U2K_H__
+#define __U2K_H__
+
+#include <cstdint>
+
+//	Typematic rate/delay after reset (argument of 0xF3)
+//		bit6-5: delay ((1 + D) * 250ms), bit4-0: rate (10.9 characters/sec)
+#define U2K_DEFAULT_TYPEMATIC	0x2B
+
+//	Latency from the USB report to the scancode handed to the PS/2 send FIFO
+//		The time to shift the bytes out of the FIFO is not included. It is about
+//		1ms per byte, and the FIFO is empty unless the host inhibits the clock.
+typedef struct {
+	uint32_t	count;				//	Number of measured key events
+	uint32_t	min_us;
+	uint32_t	max_us;
+	uint32_t	average_us;
+} U2K_LATENCY_T;
+
+// --------------------------------------------------------------------
+//	Initialize u2k
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void u2k_init( void );
+
+// --------------------------------------------------------------------
+//	u2k task
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void u2k_task( void );
+
+// --------------------------------------------------------------------
+//	Get latency statistics
+//	input:
+//		p_latency ....... Address of buffer to return the statistics.
+//	output:
+//		none
+//	comment:
+//		The end point is the send FIFO, not PS2DAT. (see U2K_LATENCY_T)
+//		The typematic repeat is not included.
+// --------------------------------------------------------------------
+void u2k_get_latency( U2K_LATENCY_T *p_latency );
+
+// --------------------------------------------------------------------
+//	Reset latency statistics
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void u2k_reset_latency( void );
+
+#endif
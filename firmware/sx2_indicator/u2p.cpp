@@ -26,60 +26,311 @@
 #include "u2p.h"
 #include "usb_host_driver.h"
 #include "ps2dev_driver.h"
+#include "asset.h"
+#include "status_history.h"
+#include "latency_trace.h"
 #include <pico/time.h>
+#include <hardware/sync.h>
 
 enum {
 	PS2_IDLE = 0,
 	PS2_SEND_DATAS,
 	PS2_RECV_DATAS,
+	PS2_RECV_ARGUMENT,
+	PS2_RECV_ASSET_CHUNK,
 };
 static int ps2state = PS2_IDLE;
 
-static volatile int ocm_status[16] = {};
+#define MOUSE_ID				0x10
+#define MOUSE_ID_DELTA_MODE		0x11
+#define MOUSE_ID_WHEEL			0x03		//	IntelliMouse (wheel)
+#define MOUSE_ID_5BUTTONS		0x04		//	IntelliMouse Explorer (wheel + 5 buttons)
+#define DELTA_MODE_REQUEST		0x11		//	Argument of 0xF3 to enter the delta mode
+#define DELTA_BITMAP_MASK		0x7F
+#define DELTA_BITMAP_NEXT		0x80		//	Another change bitmap byte follows
+#define DELTA_BITMAP_MAX_BYTES	((U2P_STATUS_MAX_LENGTH + 6) / 7)	//	7 bits per byte
+
+#define CAPABILITY_VERSION		0x01
+
+//	ocm_status is published by seqlock. (odd status_sequence: being updated)
+//	work_status is updated by the received bytes, and copied to ocm_status when the frame is complete.
+static volatile uint8_t ocm_status[ U2P_STATUS_MAX_LENGTH ] = {};
+static volatile int ocm_status_length = 0;
+static volatile uint32_t status_sequence = 0;
+static uint8_t work_status[ U2P_STATUS_MAX_LENGTH ] = {};
+static int work_status_length = 0;
 static int ocm_status_write_ptr;
 static int remain_bytes;
 static uint64_t start_time;
 
+static bool is_delta_mode = false;
+static bool is_change_bitmap;
+static int change_bitmap_bytes;
+static uint64_t change_bitmap;
+static bool is_frame_error;
+
+//	Standard PS/2 mouse mode
+#define DEFAULT_SAMPLE_RATE		100			//	[samples/sec]
+#define DEFAULT_RESOLUTION		USB_MOUSE_DEFAULT_RESOLUTION	//	0: 1count/mm, 1: 2count/mm, 2: 4count/mm, 3: 8count/mm
+
+static bool is_stream_mode = true;			//	true: stream mode (0xEA), false: remote mode (0xF0)
+static bool is_reporting_enabled = false;	//	0xF4: enable, 0xF5: disable
+static bool is_scaling_2to1 = false;		//	0xE7: 2:1, 0xE6: 1:1
+static int sample_rate = DEFAULT_SAMPLE_RATE;
+static int resolution = DEFAULT_RESOLUTION;
+static uint8_t device_id = MOUSE_ID;
+static uint8_t sample_rate_history[3];		//	The last 3 arguments of 0xF3, for the IntelliMouse knock sequence
+static uint64_t last_report_time;
+static uint8_t last_packet[4];				//	for 0xFE (Resend)
+static int last_packet_length = 0;
+
+//	Command table
+//		The responses are precomputed, and they are sent after the handler is called.
+//		The command which has an argument sends ACK(0xFA) at first, and the response after the argument.
+typedef struct {
+	uint8_t			command;
+	bool			has_argument;
+	const uint8_t	*p_response;
+	int				response_length;
+	void			(*p_handler)( uint8_t argument );
+} PS2_COMMAND_T;
+
+static const uint8_t response_ack[] = { 0xFA };
+static const uint8_t response_reset[] = { 0xFA, 0xAA, MOUSE_ID };
+static const uint8_t response_capability[] = { 0xFA, CAPABILITY_VERSION, U2P_STATUS_MAX_LENGTH, U2P_FEATURES };
+static uint8_t response_id[] = { 0xFA, MOUSE_ID };
+static uint8_t response_status[] = { 0xFA, 0x00, DEFAULT_RESOLUTION, DEFAULT_SAMPLE_RATE };
+static uint8_t response_asset_commit[] = { 0xFA, 0x00, 0x00 };
+
+#define COMMAND_INDEX_BASE		0xE0
+#define COMMAND_INDEX_SIZE		0x20
+static const PS2_COMMAND_T *command_index[ COMMAND_INDEX_SIZE ];
+static const PS2_COMMAND_T *p_current_command = nullptr;
+
+//	Asset upload
+//		The chunk is [sequence][slot][offset L][offset H][length][data x length][checksum].
+//		The data is kept in asset_chunk_data, and it is written into the slot after the
+//		checksum is verified. The host waits for the answer of each chunk (stop-and-wait),
+//		and it sends the chunk again if it is rejected.
+#define ASSET_CHUNK_HEADER_SIZE	5
+#define ASSET_CHUNK_DATA_SIZE	255
+static uint8_t asset_chunk_header[ ASSET_CHUNK_HEADER_SIZE ];
+static uint8_t asset_chunk_data[ ASSET_CHUNK_DATA_SIZE ];
+static int asset_chunk_count;
+static uint8_t asset_chunk_checksum;
+static bool is_asset_chunk_error;
+static int asset_upload_slot = -1;
+static uint8_t asset_expected_sequence;
+
 // --------------------------------------------------------------------
 static uint64_t inline _get_us( void ) {
 	return to_us_since_boot( get_absolute_time() );
 }
 
+// --------------------------------------------------------------------
+static void discard_work_status( void ) {
+	int i;
+
+	for( i = 0; i < U2P_STATUS_MAX_LENGTH; i++ ) {
+		work_status[i] = ocm_status[i];
+	}
+	work_status_length = ocm_status_length;
+}
+
+// --------------------------------------------------------------------
+static void commit_work_status( void ) {
+	int i;
+
+	status_sequence = status_sequence + 1;
+	__dmb();
+	for( i = 0; i < U2P_STATUS_MAX_LENGTH; i++ ) {
+		ocm_status[i] = work_status[i];
+	}
+	ocm_status_length = work_status_length;
+	__dmb();
+	status_sequence = status_sequence + 1;
+	status_history_append( work_status, work_status_length );
+}
+
+// --------------------------------------------------------------------
+static void update_responses( void ) {
+
+	response_id[1] = device_id;
+	response_status[1] = (is_stream_mode ? 0x00 : 0x40) | (is_reporting_enabled ? 0x20 : 0x00) | (is_scaling_2to1 ? 0x10 : 0x00);
+	response_status[2] = resolution;
+	response_status[3] = sample_rate;
+}
+
+// --------------------------------------------------------------------
+static void set_default_mouse_mode( void ) {
+
+	is_stream_mode = true;
+	is_reporting_enabled = false;
+	is_scaling_2to1 = false;
+	sample_rate = DEFAULT_SAMPLE_RATE;
+	resolution = DEFAULT_RESOLUTION;
+	usb_set_mouse_resolution( resolution );
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void send_response( const uint8_t *p_response, int length ) {
+	int i;
+
+	for( i = 0; i < length; i++ ) {
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, p_response[i] );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Scaling 2:1 (stream mode only)
+//
+static int16_t scale_delta( int16_t delta ) {
+	static const int16_t scale_table[] = { 0, 1, 1, 3, 6, 9 };
+
+	if( !is_scaling_2to1 ) {
+		return delta;
+	}
+	if( delta >= 0 && delta <= 5 ) {
+		return scale_table[ delta ];
+	}
+	if( delta < 0 && delta >= -5 ) {
+		return -scale_table[ -delta ];
+	}
+	return delta * 2;
+}
+
+// --------------------------------------------------------------------
+//	Send a standard PS/2 mouse movement packet (3 or 4 bytes)
+//		[YO][XO][YS][XS][1][M][R][L]
+//		X movement (lower 8 bits)
+//		Y movement (lower 8 bits)
+//		Z movement (ID 0x03), or [0][0][B5][B4][Z][Z][Z][Z] (ID 0x04)
+//
+static void send_standard_packet( bool is_stream ) {
+	int16_t delta_x, delta_y, delta_z;
+	int32_t button;
+	uint8_t *p = last_packet;
+
+	get_mouse_position( &delta_x, &delta_y, &delta_z, &button, 255 );
+	LATENCY_TRACE_TAKE( ps2dev_get_send_push_count( PS2DEV_PORT_MOUSE ) );
+	delta_y = -delta_y;
+	delta_z = -delta_z;			//	PS/2: positive is toward the user
+	if( is_stream ) {
+		delta_x = scale_delta( delta_x );
+		delta_y = scale_delta( delta_y );
+	}
+	p[0] = 0x08 | (button & 0x07);
+	if( delta_x < -256 ) {
+		delta_x = -256;
+		p[0] |= 0x40;
+	}
+	else if( delta_x > 255 ) {
+		delta_x = 255;
+		p[0] |= 0x40;
+	}
+	if( delta_y < -256 ) {
+		delta_y = -256;
+		p[0] |= 0x80;
+	}
+	else if( delta_y > 255 ) {
+		delta_y = 255;
+		p[0] |= 0x80;
+	}
+	if( delta_x < 0 ) {
+		p[0] |= 0x10;
+	}
+	if( delta_y < 0 ) {
+		p[0] |= 0x20;
+	}
+	p[1] = (uint8_t) delta_x;
+	p[2] = (uint8_t) delta_y;
+	last_packet_length = 3;
+
+	if( device_id == MOUSE_ID_WHEEL || device_id == MOUSE_ID_5BUTTONS ) {
+		if( delta_z < -8 ) {
+			delta_z = -8;
+		}
+		else if( delta_z > 7 ) {
+			delta_z = 7;
+		}
+		if( device_id == MOUSE_ID_WHEEL ) {
+			p[3] = (uint8_t) delta_z;
+		}
+		else {
+			p[3] = (delta_z & 0x0F) | ((button >> 3) & 0x03) << 4;
+		}
+		last_packet_length = 4;
+	}
+	send_response( last_packet, last_packet_length );
+	last_report_time = _get_us();
+}
+
+// --------------------------------------------------------------------
+//	Stream mode: Send the movement as soon as the USB mouse reports it.
+//
+static void ps2_stream_report( void ) {
+
+	if( !is_stream_mode || !is_reporting_enabled ) {
+		return;
+	}
+	if( !ps2dev_is_send_fifo_empty( PS2DEV_PORT_MOUSE ) || !is_mouse_updated() ) {
+		return;
+	}
+	if( (_get_us() - last_report_time) < (uint64_t)(1000000 / sample_rate) ) {
+		//	Throttled by the sample rate.
+		return;
+	}
+	send_standard_packet( true );
+}
+
 // --------------------------------------------------------------------
 static void ps2_send_datas( void ) {
-	int16_t delta_x, delta_y;
+	int16_t delta_x, delta_y, delta_z;
 	int32_t button;
 	int mouse_button;
+	uint8_t gamepad;
 
-	if( !ps2dev_is_send_fifo_empty() ) {
+	if( !ps2dev_is_send_fifo_empty( PS2DEV_PORT_MOUSE ) ) {
+		return;
+	}
+	if( is_reporting_enabled || device_id == MOUSE_ID_WHEEL || device_id == MOUSE_ID_5BUTTONS ) {
+		//	The host enabled the data reporting (0xF4) or the IntelliMouse ID, 
+		//	so it is a standard PS/2 host. It reads only the movement packet.
+		//	(MOUSE_ID_DELTA_MODE is the OCM, and it sends the status frame after the packet.)
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFA );
+		send_standard_packet( false );
+		ps2state = PS2_IDLE;
 		return;
 	}
 	if( is_mouse_active() ) {
-		get_mouse_position( &delta_x, &delta_y, &button );
-		if( delta_x < -128 ) {
-			delta_x = -128;
-		}
-		else if( delta_x > 127 ) {
-			delta_x = 127;
-		}
+		//	The movement beyond 127 is sent by the next Data read.
+		get_mouse_position( &delta_x, &delta_y, &delta_z, &button, 127 );
+		LATENCY_TRACE_TAKE( ps2dev_get_send_push_count( PS2DEV_PORT_MOUSE ) );
 		delta_y = -delta_y;
-		if( delta_y < -128 ) {
-			delta_y = -128;
-		}
-		else if( delta_y > 127 ) {
-			delta_y = 127;
-		}
-		mouse_button = 0x08 | button;
+		mouse_button = 0x08 | (button & 0x07);
+	}
+	else if( is_gamepad_active() ) {
+		//	Joypad: The direction is -1, 0 or 1 (up is positive, same as the mouse).
+		gamepad = get_gamepad_state();
+		delta_x = ((gamepad & USB_GAMEPAD_RIGHT) ? 1 : 0) - ((gamepad & USB_GAMEPAD_LEFT) ? 1 : 0);
+		delta_y = ((gamepad & USB_GAMEPAD_UP) ? 1 : 0) - ((gamepad & USB_GAMEPAD_DOWN) ? 1 : 0);
+		mouse_button = 0x18 | ((gamepad & USB_GAMEPAD_A) ? 0x01 : 0) | ((gamepad & USB_GAMEPAD_B) ? 0x02 : 0) | 
+		               ((gamepad & (USB_GAMEPAD_C | USB_GAMEPAD_START)) ? 0x04 : 0);
 	}
 	else {
 		delta_x = 0;
 		delta_y = 0;
 		mouse_button = 0;
 	}
-	ps2dev_send_data( 0xFA );
-	ps2dev_send_data( mouse_button );
-	ps2dev_send_data( delta_x );
-	ps2dev_send_data( delta_y );
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFA );
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, mouse_button );
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, delta_x );
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, delta_y );
+	last_packet[0] = mouse_button;
+	last_packet[1] = (uint8_t) delta_x;
+	last_packet[2] = (uint8_t) delta_y;
+	last_packet_length = 3;
 	ps2state = PS2_RECV_DATAS;
 	ocm_status_write_ptr = 0;
 	remain_bytes = -1;
@@ -90,51 +341,373 @@ static void ps2_send_datas( void ) {
 static void ps2_recv_datas( void ) {
 	uint8_t data;
 
-	if( !ps2dev_get_receive_data( &data ) ) {
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_MOUSE, &data ) ) {
 		if( (_get_us() - start_time) > 50000 ) {
 			//	time out
 			ps2state = PS2_IDLE;
+			discard_work_status();
+			ps2dev_calibration_report( false );
 		}
 		return;
 	}
 	start_time = _get_us();
 	if( remain_bytes == -1 ) {
 		remain_bytes = data;
-		return;
+		is_change_bitmap = is_delta_mode;
+		change_bitmap = 0;
+		change_bitmap_bytes = 0;
+		is_frame_error = false;
 	}
-	if( remain_bytes ) {
-		if( ocm_status_write_ptr < (int)(sizeof(ocm_status) / sizeof(ocm_status[0])) ) {
-			ocm_status[ ocm_status_write_ptr++ ] = data;
+	else if( is_change_bitmap ) {
+		//	Delta mode: Each change bitmap byte has 7 bits, bit n is data(n+1).
+		if( change_bitmap_bytes < DELTA_BITMAP_MAX_BYTES ) {
+			change_bitmap |= (uint64_t)(data & DELTA_BITMAP_MASK) << (change_bitmap_bytes * 7);
+			change_bitmap_bytes++;
 		}
+		else {
+			//	Too long for U2P_STATUS_MAX_LENGTH. The rest of the frame is received, but discarded.
+			is_frame_error = true;
+		}
+		is_change_bitmap = ((data & DELTA_BITMAP_NEXT) != 0);
+		remain_bytes--;
+	}
+	else if( remain_bytes ) {
+		if( is_delta_mode ) {
+			if( change_bitmap == 0 ) {
+				//	More data than the bits of the change bitmap. The rest of the frame is received, but discarded.
+				is_frame_error = true;
+			}
+			//	Skip the unchanged bytes.
+			while( change_bitmap != 0 && (change_bitmap & 1) == 0 ) {
+				change_bitmap >>= 1;
+				ocm_status_write_ptr++;
+			}
+			change_bitmap >>= 1;
+		}
+		if( ocm_status_write_ptr < U2P_STATUS_MAX_LENGTH ) {
+			//	Bytes beyond U2P_STATUS_MAX_LENGTH are received, but ignored.
+			work_status[ ocm_status_write_ptr ] = data;
+			if( work_status_length <= ocm_status_write_ptr ) {
+				work_status_length = ocm_status_write_ptr + 1;
+			}
+		}
+		ocm_status_write_ptr++;
 		remain_bytes--;
 	}
 	if( remain_bytes == 0 ) {
 		ps2state = PS2_IDLE;
+		if( change_bitmap != 0 ) {
+			//	Less data than the bits of the change bitmap.
+			is_frame_error = true;
+		}
+		if( is_frame_error ) {
+			discard_work_status();
+		}
+		else {
+			commit_work_status();
+		}
+		ps2dev_calibration_report( true );
 	}
 }
 
 // --------------------------------------------------------------------
-static void ps2_communication( void ) {
+static void command_reset( uint8_t argument ) {
+
+	(void) argument;
+	is_delta_mode = false;
+	device_id = MOUSE_ID;
+	set_default_mouse_mode();
+}
+
+// --------------------------------------------------------------------
+static void command_set_defaults( uint8_t argument ) {
+
+	(void) argument;
+	set_default_mouse_mode();
+}
+
+// --------------------------------------------------------------------
+static void command_set_scaling_1to1( uint8_t argument ) {
+
+	(void) argument;
+	is_scaling_2to1 = false;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_set_scaling_2to1( uint8_t argument ) {
+
+	(void) argument;
+	is_scaling_2to1 = true;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_set_resolution( uint8_t argument ) {
+
+	resolution = argument & 3;
+	usb_set_mouse_resolution( resolution );
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_status_request( uint8_t argument ) {
+	int32_t button;
+
+	(void) argument;
+	//	[0][Remote][Enable][Scaling][0][L][M][R]
+	button = get_mouse_button();
+	response_status[1] = (response_status[1] & 0xF8) | 
+		((button & 0x01) << 2) | ((button & 0x04) >> 1) | ((button & 0x02) >> 1);
+}
+
+// --------------------------------------------------------------------
+static void command_set_stream_mode( uint8_t argument ) {
+
+	(void) argument;
+	is_stream_mode = true;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_set_remote_mode( uint8_t argument ) {
+
+	(void) argument;
+	is_stream_mode = false;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_read_data( uint8_t argument ) {
+
+	(void) argument;
+	ps2state = PS2_SEND_DATAS;
+}
+
+// --------------------------------------------------------------------
+static void command_set_sample_rate( uint8_t argument ) {
+
+	sample_rate_history[0] = sample_rate_history[1];
+	sample_rate_history[1] = sample_rate_history[2];
+	sample_rate_history[2] = argument;
+
+	if( argument == DELTA_MODE_REQUEST ) {
+		//	The host supports the delta mode. It is confirmed by 0xF2 (MOUSE_ID_DELTA_MODE).
+		is_delta_mode = true;
+		device_id = MOUSE_ID_DELTA_MODE;
+	}
+	else if( argument != 0 ) {
+		sample_rate = argument;
+	}
+
+	//	IntelliMouse knock sequence
+	if( sample_rate_history[0] == 200 && sample_rate_history[1] == 100 && sample_rate_history[2] == 80 ) {
+		device_id = MOUSE_ID_WHEEL;
+	}
+	else if( sample_rate_history[0] == 200 && sample_rate_history[1] == 200 && sample_rate_history[2] == 80 && device_id == MOUSE_ID_WHEEL ) {
+		device_id = MOUSE_ID_5BUTTONS;
+	}
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_enable_reporting( uint8_t argument ) {
+
+	(void) argument;
+	is_reporting_enabled = true;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_disable_reporting( uint8_t argument ) {
+
+	(void) argument;
+	is_reporting_enabled = false;
+	update_responses();
+}
+
+// --------------------------------------------------------------------
+static void command_asset_chunk( uint8_t argument ) {
+
+	(void) argument;
+	asset_chunk_count = 0;
+	asset_chunk_checksum = 0;
+	is_asset_chunk_error = false;
+	ps2state = PS2_RECV_ASSET_CHUNK;
+	start_time = _get_us();
+}
+
+// --------------------------------------------------------------------
+static void command_asset_begin( uint8_t argument ) {
+
+	if( asset_begin( argument ) ) {
+		asset_upload_slot = argument;
+	}
+	else {
+		asset_upload_slot = -1;
+	}
+	asset_expected_sequence = 0;
+}
+
+// --------------------------------------------------------------------
+static void command_asset_commit( uint8_t argument ) {
+	int throughput;
+
+	if( argument != asset_upload_slot ) {
+		throughput = 0;
+	}
+	else {
+		throughput = asset_commit( argument );
+		if( throughput > 0xFFFF ) {
+			throughput = 0xFFFF;
+		}
+		if( throughput != 0 ) {
+			asset_upload_slot = -1;
+		}
+		//	else: The slot is incomplete. The host can send the missing chunks, and commit again.
+	}
+	response_asset_commit[1] = (uint8_t) throughput;
+	response_asset_commit[2] = (uint8_t)( throughput >> 8 );
+}
+
+// --------------------------------------------------------------------
+static void command_asset_invalidate( uint8_t argument ) {
+
+	asset_invalidate( argument );
+	if( argument == asset_upload_slot ) {
+		asset_upload_slot = -1;
+	}
+}
+
+// --------------------------------------------------------------------
+static void command_resend( uint8_t argument ) {
+
+	(void) argument;
+	//	The host could not receive the previous byte.
+	ps2dev_calibration_report( false );
+	send_response( last_packet, last_packet_length );
+}
+
+static const PS2_COMMAND_T command_table[] = {
+	{ 0xFF, false, response_reset,		sizeof(response_reset),			command_reset				},	//	Reset
+	{ 0xFE, false, nullptr,				0,								command_resend				},	//	Resend
+	{ 0xF6, false, response_ack,		sizeof(response_ack),			command_set_defaults		},	//	Set defaults
+	{ 0xF5, false, response_ack,		sizeof(response_ack),			command_disable_reporting	},	//	Disable data reporting
+	{ 0xF4, false, response_ack,		sizeof(response_ack),			command_enable_reporting	},	//	Enable data reporting
+	{ 0xF3, true,  response_ack,		sizeof(response_ack),			command_set_sample_rate		},	//	Set sample rate
+	{ 0xF2, false, response_id,			sizeof(response_id),			nullptr						},	//	Get device ID
+	{ 0xF0, false, response_ack,		sizeof(response_ack),			command_set_remote_mode		},	//	Set remote mode
+	{ 0xEB, false, nullptr,				0,								command_read_data			},	//	Read data
+	{ 0xEA, false, response_ack,		sizeof(response_ack),			command_set_stream_mode		},	//	Set stream mode
+	{ 0xE9, false, response_status,		sizeof(response_status),		command_status_request		},	//	Status request
+	{ 0xE8, true,  response_ack,		sizeof(response_ack),			command_set_resolution		},	//	Set resolution
+	{ 0xE7, false, response_ack,		sizeof(response_ack),			command_set_scaling_2to1	},	//	Set scaling 2:1
+	{ 0xE6, false, response_ack,		sizeof(response_ack),			command_set_scaling_1to1	},	//	Set scaling 1:1
+	{ 0xE5, true,  response_ack,		sizeof(response_ack),			command_asset_invalidate	},	//	Asset invalidate
+	{ 0xE4, true,  response_asset_commit,	sizeof(response_asset_commit),	command_asset_commit	},	//	Asset commit
+	{ 0xE3, true,  response_ack,		sizeof(response_ack),			command_asset_begin			},	//	Asset begin
+	{ 0xE2, false, nullptr,				0,								command_asset_chunk			},	//	Asset chunk
+	{ 0xE1, false, response_capability,	sizeof(response_capability),	nullptr						},	//	Get capability
+};
+
+// --------------------------------------------------------------------
+static void ps2_recv_command( void ) {
 	uint8_t data;
+	const PS2_COMMAND_T *p_command;
+
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_MOUSE, &data ) ) {
+		ps2_stream_report();
+		return;
+	}
+	if( data < COMMAND_INDEX_BASE || command_index[ data - COMMAND_INDEX_BASE ] == nullptr ) {
+		//	Unknown command
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFE );
+		return;
+	}
+	p_command = command_index[ data - COMMAND_INDEX_BASE ];
+	if( p_command->has_argument ) {
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFA );
+		p_current_command = p_command;
+		ps2state = PS2_RECV_ARGUMENT;
+		start_time = _get_us();
+		return;
+	}
+	if( p_command->p_handler != nullptr ) {
+		p_command->p_handler( 0 );
+	}
+	send_response( p_command->p_response, p_command->response_length );
+}
+
+// --------------------------------------------------------------------
+static void ps2_recv_argument( void ) {
+	uint8_t data;
+
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_MOUSE, &data ) ) {
+		if( (_get_us() - start_time) > 50000 ) {
+			//	time out
+			ps2state = PS2_IDLE;
+		}
+		return;
+	}
+	ps2state = PS2_IDLE;
+	p_current_command->p_handler( data );
+	send_response( p_current_command->p_response, p_current_command->response_length );
+}
+
+// --------------------------------------------------------------------
+static void ps2_recv_asset_chunk( void ) {
+	uint8_t data;
+	int offset, length;
+
+	if( !ps2dev_get_receive_data( PS2DEV_PORT_MOUSE, &data ) ) {
+		if( (_get_us() - start_time) > 50000 ) {
+			//	time out: The host sends it again.
+			ps2state = PS2_IDLE;
+		}
+		return;
+	}
+	start_time = _get_us();
+	asset_chunk_checksum += data;
+	if( asset_chunk_count < ASSET_CHUNK_HEADER_SIZE ) {
+		asset_chunk_header[ asset_chunk_count ] = data;
+		asset_chunk_count++;
+		if( asset_chunk_count == ASSET_CHUNK_HEADER_SIZE ) {
+			is_asset_chunk_error = (asset_chunk_header[0] != asset_expected_sequence) || (asset_chunk_header[1] != asset_upload_slot);
+		}
+		return;
+	}
+	offset = asset_chunk_header[2] | (asset_chunk_header[3] << 8);
+	length = asset_chunk_header[4];
+	if( asset_chunk_count < ASSET_CHUNK_HEADER_SIZE + length ) {
+		asset_chunk_data[ asset_chunk_count - ASSET_CHUNK_HEADER_SIZE ] = data;
+		asset_chunk_count++;
+		return;
+	}
+	//	data is the checksum. The sum of all bytes of the chunk is 0.
+	//	The slot is written only by the verified chunk.
+	ps2state = PS2_IDLE;
+	if( !is_asset_chunk_error && asset_chunk_checksum == 0 ) {
+		is_asset_chunk_error = !asset_write( asset_upload_slot, offset, asset_chunk_data, length );
+	}
+	else {
+		is_asset_chunk_error = true;
+	}
+	if( is_asset_chunk_error ) {
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFE );
+		ps2dev_send_data( PS2DEV_PORT_MOUSE, asset_expected_sequence );
+		return;
+	}
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, 0xFA );
+	ps2dev_send_data( PS2DEV_PORT_MOUSE, asset_expected_sequence );
+	asset_expected_sequence++;
+}
+
+// --------------------------------------------------------------------
+static void ps2_communication( void ) {
 
 	switch( ps2state ) {
 	case PS2_IDLE:
-		if( ps2dev_get_receive_data( &data ) ) {
-			if( data == 0xFF ) {
-				ps2dev_send_data( 0xFA );
-				ps2dev_send_data( 0xAA );
-				ps2dev_send_data( 0x10 );
-			}
-			else if( data == 0xF3 ) {
-				ps2dev_send_data( 0xFA );
-			}
-			else if( data == 40 ) {
-				ps2dev_send_data( 0xFA );
-			}
-			else if( data == 0xEB ) {
-				ps2state = PS2_SEND_DATAS;
-			}
-		}
+		ps2_recv_command();
 		break;
 	case PS2_SEND_DATAS:
 		ps2_send_datas();
@@ -142,6 +715,12 @@ static void ps2_communication( void ) {
 	case PS2_RECV_DATAS:
 		ps2_recv_datas();
 		break;
+	case PS2_RECV_ARGUMENT:
+		ps2_recv_argument();
+		break;
+	case PS2_RECV_ASSET_CHUNK:
+		ps2_recv_asset_chunk();
+		break;
 	default:
 		break;
 	}
@@ -149,6 +728,13 @@ static void ps2_communication( void ) {
 
 // --------------------------------------------------------------------
 void u2p_init( void ) {
+	size_t i;
+
+	for( i = 0; i < sizeof(command_table) / sizeof(command_table[0]); i++ ) {
+		command_index[ command_table[i].command - COMMAND_INDEX_BASE ] = &command_table[i];
+	}
+	status_history_init();
+	set_default_mouse_mode();
 }
 
 // --------------------------------------------------------------------
@@ -158,5 +744,27 @@ void u2p_task( void ) {
 
 // --------------------------------------------------------------------
 int u2p_get_information( int index ) {
+
+	if( index < 0 || index >= U2P_STATUS_MAX_LENGTH ) {
+		return 0;
+	}
 	return ocm_status[ index ];
 }
+
+// --------------------------------------------------------------------
+void u2p_get_status( U2P_STATUS_T *p_status ) {
+	uint32_t sequence;
+	int i;
+
+	do {
+		do {
+			sequence = status_sequence;
+		} while( sequence & 1 );
+		__dmb();
+		p_status->length = ocm_status_length;
+		for( i = 0; i < U2P_STATUS_MAX_LENGTH; i++ ) {
+			p_status->data[i] = ocm_status[i];
+		}
+		__dmb();
+	} while( sequence != status_sequence );
+}
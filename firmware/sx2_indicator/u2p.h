@@ -26,6 +26,22 @@
 #ifndef __U2P_H__
 #define __U2P_H__
 
+#include <cstdint>
+
+//	Maximum number of status bytes (data1, data2, ...) received by 0xEB.
+#define U2P_STATUS_MAX_LENGTH	32
+
+//	Feature bits reported by the capability command (0xE1)
+#define U2P_FEATURE_DELTA_MODE		0x01	//	Delta mode (0xF3 0x11)
+#define U2P_FEATURE_LONG_BITMAP		0x02	//	Change bitmap longer than 1 byte
+#define U2P_FEATURE_ASSET_UPLOAD	0x04	//	Asset upload (0xE2 ... 0xE5)
+#define U2P_FEATURES				(U2P_FEATURE_DELTA_MODE | U2P_FEATURE_LONG_BITMAP | U2P_FEATURE_ASSET_UPLOAD)
+
+typedef struct {
+	int			length;							//	Number of bytes received so far (0 ... U2P_STATUS_MAX_LENGTH)
+	uint8_t		data[ U2P_STATUS_MAX_LENGTH ];	//	data[ U2P_DATA1 ] ... data[ length - 1 ]
+} U2P_STATUS_T;
+
 // --------------------------------------------------------------------
 //	Initialize u2p
 //	input:
@@ -63,4 +79,18 @@ enum {
 
 int u2p_get_information( int index );
 
+// --------------------------------------------------------------------
+//	Get status
+//	input:
+//		p_status ... Address of buffer to return the status.
+//	output:
+//		none
+//	comment:
+//		It returns a consistent copy of the last complete frame, so the
+//		bytes never come from two different data reads.
+//		It can be called from the other core.
+//		The bytes that the host has not sent yet are 0.
+// --------------------------------------------------------------------
+void u2p_get_status( U2P_STATUS_T *p_status );
+
 #endif
@@ -23,95 +23,695 @@
 //	THE SOFTWARE.
 // --------------------------------------------------------------------
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tusb.h>
 #include "tusb_config.h"
 #include "usb_host_driver.h"
+#include "hid_parser.h"
+#include "latency_trace.h"
 #include "bsp/board.h"
 #include <pico/multicore.h>
+#include <pico/time.h>
+#include <hardware/sync.h>
 
 typedef enum {
-	DM_UNKNOWN = 0,
+	DM_UNKNOWN = 0,			//	Free entry
 	DM_MOUSE,
+	DM_KEYBOARD,
 	DM_GAMEPAD,
 } DETECT_MODE_T;
 
-static volatile DETECT_MODE_T	detect_mode = DM_UNKNOWN;
+//	Mouse state handed to u2p
+//		X, Y, wheel and buttons of all mice are packed in one 32-bit word (mouse_packed).
+//		The USB callbacks add the movement to it, and get_mouse_position() takes it and
+//		writes back the part beyond the limit, so the fast movement is not lost.
+//		Cortex-M0+ has no exclusive access instructions (LDREX/STREX), so the read-modify-write
+//		is guarded by a hardware spinlock. It is a few instructions with the interrupts
+//		disabled, so it never blocks for long and it can be used from the other core.
+//			bit10-0 .... X (signed, -1023 ... 1023)
+//			bit21-11 ... Y (signed, -1023 ... 1023)
+//			bit26-22 ... wheel (signed, -15 ... 15)
+//			bit31-27 ... buttons
+//		X and Y beyond the field are kept in mouse_carry_x/y (saturated at MOUSE_CARRY_MAX), and
+//		they are moved into the field when get_mouse_position() takes the movement.
+#define MOUSE_PACK_X_SHIFT		0
+#define MOUSE_PACK_Y_SHIFT		11
+#define MOUSE_PACK_XY_BITS		11
+#define MOUSE_PACK_WHEEL_SHIFT	22
+#define MOUSE_PACK_WHEEL_BITS	5
+#define MOUSE_PACK_BUTTON_SHIFT	27
+#define MOUSE_PACK_BUTTON_BITS	5
+#define MOUSE_DELTA_MAX			((1 << (MOUSE_PACK_XY_BITS - 1)) - 1)
+#define MOUSE_WHEEL_MAX			((1 << (MOUSE_PACK_WHEEL_BITS - 1)) - 1)
+#define MOUSE_WHEEL_LIMIT		7
+#define MOUSE_CARRY_MAX			32767
 
-static volatile int16_t			mouse_delta_x = 0;
-static volatile int16_t			mouse_delta_y = 0;
-static volatile int				mouse_resolution = 0;
-static int32_t					mouse_button = 0;
-static semaphore_t				sem;
+//	The movement is multiplied by the Q8 gain. The fraction remains in each device.
+#define MOUSE_DELTA_FRACTION	8
 
 #define MAX_REPORT	4
+
+//	Gamepad
+//		The thresholds and the button map are the same as usb_gamepad_bridge_for_msx.
+#define	LEFT_THRESHOLD		-64
+#define	RIGHT_THRESHOLD		64
+#define	TOP_THRESHOLD		-64
+#define	BOTTOM_THRESHOLD	64
+
+#define	LEFT_THRESHOLD_JOYSTICK		(LEFT_THRESHOLD + 128)
+#define	RIGHT_THRESHOLD_JOYSTICK	(RIGHT_THRESHOLD + 128)
+#define	TOP_THRESHOLD_JOYSTICK		(TOP_THRESHOLD + 128)
+#define	BOTTOM_THRESHOLD_JOYSTICK	(BOTTOM_THRESHOLD + 128)
+
+#define A_BUTTON			GAMEPAD_BUTTON_C
+#define B_BUTTON			GAMEPAD_BUTTON_A
+#define C_BUTTON			GAMEPAD_BUTTON_B
+#define START_BUTTON		GAMEPAD_BUTTON_TR
+
+typedef struct TU_ATTR_PACKED {
+	uint8_t		x;			//< X position of the gamepad. LEFT:0 ... CENTER:128 ... RIGHT:255
+	uint8_t		y;			//< Y position of the gamepad. TOP:0 .... CENTER:128 ... BOTTOM:255
+	uint32_t	buttons;	//< Buttons of the gamepad.
+	int8_t		reserved1;
+	int8_t		reserved2;
+} my_hid_joystick_report_t;
+
+//	Device table
+//		One entry for each HID interface (dev_addr, instance). sizeof(USB_DEVICE_T) is 88 bytes,
+//		so USB_DEVICE_MAX (CFG_TUH_HID = 8) entries use 704 bytes.
+#define USB_DEVICE_MAX			CFG_TUH_HID
+
+//	Keyboard
+//		The pressed keys are kept as a bitmap of the HID usage (0x00 ... 0xFF). The modifier
+//		byte of the boot report is mapped to 0xE0 ... 0xE7. A new report is compared with the
+//		bitmap word by word, so the cost is fixed and each changed key costs O(1).
+#define KEY_BITMAP_WORDS		(256 / 32)
+#define KEY_USAGE_MODIFIER		0xE0
+#define KEY_USAGE_FIRST			0x04		//	0x01 ... 0x03 are the error codes (ErrorRollOver etc.)
+#define KEY_EVENT_FIFO_SIZE		32			//	Power of 2
+
+//	Parsed report descriptor cache
+//		Hubs and KVM switches mount the same interface again and again. The result of
+//		the parser is kept with the key (VID, PID, interface, descriptor length), and it is
+//		reused without parsing. The least recently used entry is replaced.
+#define PLAN_CACHE_SIZE			4
+
+typedef struct {
+	uint8_t					dev_addr;
+	uint8_t					instance;
+	uint8_t					role;				//	DETECT_MODE_T (1 byte regardless of the size of enum)
+	uint8_t					report_count;
+	uint8_t					gamepad;			//	USB_GAMEPAD_xxx of the gamepad
+	tuh_hid_report_info_t	report_info[ MAX_REPORT ];
+	int16_t					fraction_x;			//	Q8, the part less than 1 count
+	int16_t					fraction_y;			//	Q8
+	int32_t					button;
+	HID_MOUSE_PLAN_T		plan;				//	Field extraction plan of the report protocol
+	bool					is_report_protocol;	//	true: The mouse sends the report protocol (use plan)
+	uint32_t				keys[ KEY_BITMAP_WORDS ];	//	Pressed keys of the keyboard
+	uint32_t				mount_time;			//	time_us_32() at mount. 0: The first report was received.
+} USB_DEVICE_T;
+
+typedef struct {
+	uint16_t				vid;
+	uint16_t				pid;
+	uint8_t					instance;
+	uint8_t					itf_protocol;
+	uint16_t				desc_len;
+	uint32_t				last_used;			//	0: Free entry
+	bool					is_mouse_plan;		//	true: plan is valid (HID_ITF_PROTOCOL_MOUSE)
+	uint8_t					report_count;		//	HID_ITF_PROTOCOL_NONE
+	HID_MOUSE_PLAN_T		plan;
+	tuh_hid_report_info_t	report_info[ MAX_REPORT ];
+} PLAN_CACHE_T;
+
+static USB_DEVICE_T				devices[ USB_DEVICE_MAX ];
+static USB_KEY_EVENT_T			key_event_fifo[ KEY_EVENT_FIFO_SIZE ];
+static volatile int				key_event_read_ptr = 0;
+static volatile int				key_event_write_ptr = 0;
+static uint8_t					keyboard_leds = 0;
+static volatile uint8_t			pending_keyboard_leds = 0;
+static volatile bool			is_keyboard_leds_pending = false;
+static PLAN_CACHE_T				plan_cache[ PLAN_CACHE_SIZE ];
+static uint32_t					plan_cache_clock = 0;
+static USB_MOUNT_STATISTICS_T	mount_statistics;
+static volatile int				mouse_resolution = USB_MOUSE_DEFAULT_RESOLUTION;
+static volatile uint32_t		mouse_packed = 0;
+static volatile bool			mouse_updated = false;
+static int32_t					mouse_carry_x = 0;			//	Guarded by p_mouse_lock
+static int32_t					mouse_carry_y = 0;
+static spin_lock_t				*p_mouse_lock;
+static semaphore_t				sem;
+
+//	Acceleration curves for each resolution (0xE8)
+//		The gain of the last point whose speed is lower than or equal to max(|x|,|y|) is used.
+static USB_MOUSE_CURVE_POINT_T mouse_curves[ USB_MOUSE_RESOLUTIONS ][ USB_MOUSE_CURVE_POINTS ] = {
+	{ {  0,  64 } },										//	0: 1count/mm ... x0.25
+	{ {  0, 128 } },										//	1: 2count/mm ... x0.5
+	{ {  0, 256 } },										//	2: 4count/mm ... x1.0 (default)
+	{ {  0, 256 }, {  6, 384 }, { 16, 512 } },				//	3: 8count/mm ... x1.0, accelerated up to x2.0
+};
+static int mouse_curve_points[ USB_MOUSE_RESOLUTIONS ] = { 1, 1, 1, 3 };
 #define DEBUG_ON	0
 
-// Each HID instance can has multiple reports
-static struct {
-	uint8_t report_count;
-	tuh_hid_report_info_t report_info[MAX_REPORT];
-} hid_info[ CFG_TUH_HID ];
+//	1: Print the cost of the field extraction and the boot protocol cast when a mouse is mounted.
+#define HID_PARSER_BENCHMARK	0
 
 // --------------------------------------------------------------------
 void usb_init( void ) {
 
 	tusb_init();
 	sem_init( &sem, 1, 1 );
+	p_mouse_lock = spin_lock_init( spin_lock_claim_unused( true ) );
+}
+
+// --------------------------------------------------------------------
+static USB_DEVICE_T *find_device( uint8_t dev_addr, uint8_t instance ) {
+	int i;
+
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role != DM_UNKNOWN && devices[i].dev_addr == dev_addr && devices[i].instance == instance ) {
+			return &devices[i];
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------------------------------------------
+static USB_DEVICE_T *alloc_device( uint8_t dev_addr, uint8_t instance ) {
+	USB_DEVICE_T *p_device;
+	int i;
+
+	p_device = find_device( dev_addr, instance );
+	if( p_device != NULL ) {
+		return p_device;
+	}
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role == DM_UNKNOWN ) {
+			devices[i].dev_addr = dev_addr;
+			devices[i].instance = instance;
+			return &devices[i];
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------------------------------------------
+static int count_devices( DETECT_MODE_T role ) {
+	int i, count = 0;
+
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role == role ) {
+			count++;
+		}
+	}
+	return count;
 }
 
 // --------------------------------------------------------------------
 bool is_mouse_active( void ) {
-	return( detect_mode == DM_MOUSE );
+	return( count_devices( DM_MOUSE ) != 0 );
 }
 
 // --------------------------------------------------------------------
-void get_mouse_position( int16_t *p_delta_x, int16_t *p_delta_y, int32_t *p_button ) {
+bool is_gamepad_active( void ) {
+	return( count_devices( DM_GAMEPAD ) != 0 );
+}
 
-	if( detect_mode == DM_MOUSE ) {
-		sem_acquire_blocking( &sem );
-		*p_delta_x	= mouse_delta_x;
-		*p_delta_y	= mouse_delta_y;
-		*p_button	= mouse_button;
-		mouse_delta_x = 0;
-		mouse_delta_y = 0;
-		sem_release( &sem );
+// --------------------------------------------------------------------
+uint8_t get_gamepad_state( void ) {
+	uint8_t state = 0;
+	int i;
+
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role == DM_GAMEPAD ) {
+			state |= devices[i].gamepad;
+		}
+	}
+	return state;
+}
+
+// --------------------------------------------------------------------
+bool is_mouse_updated( void ) {
+	return( mouse_updated && is_mouse_active() );
+}
+
+// --------------------------------------------------------------------
+static int32_t unpack_field( uint32_t packed, int shift, int bits ) {
+	int32_t value;
+
+	value = (int32_t)( packed << (32 - shift - bits) );
+	return value >> (32 - bits);
+}
+
+// --------------------------------------------------------------------
+static uint32_t pack_field( int32_t value, int shift, int bits ) {
+
+	return ((uint32_t) value & ((1u << bits) - 1)) << shift;
+}
+
+// --------------------------------------------------------------------
+static uint32_t pack_mouse( int32_t x, int32_t y, int32_t wheel, int32_t button ) {
+
+	return pack_field( x, MOUSE_PACK_X_SHIFT, MOUSE_PACK_XY_BITS ) | 
+	       pack_field( y, MOUSE_PACK_Y_SHIFT, MOUSE_PACK_XY_BITS ) | 
+	       pack_field( wheel, MOUSE_PACK_WHEEL_SHIFT, MOUSE_PACK_WHEEL_BITS ) | 
+	       ((uint32_t) button << MOUSE_PACK_BUTTON_SHIFT);
+}
+
+// --------------------------------------------------------------------
+static int32_t clamp( int32_t value, int32_t limit ) {
+
+	if( value < -limit ) {
+		return -limit;
+	}
+	if( value > limit ) {
+		return limit;
+	}
+	return value;
+}
+
+// --------------------------------------------------------------------
+//	Split the movement into the part in the packed field and the carry.
+//
+static int32_t split_delta( int32_t delta, int32_t *p_carry ) {
+	int32_t packed;
+
+	packed = clamp( delta, MOUSE_DELTA_MAX );
+	*p_carry = clamp( delta - packed, MOUSE_CARRY_MAX );
+	return packed;
+}
+
+// --------------------------------------------------------------------
+int32_t get_mouse_button( void ) {
+
+	return (int32_t)( mouse_packed >> MOUSE_PACK_BUTTON_SHIFT );
+}
+
+// --------------------------------------------------------------------
+void usb_set_mouse_resolution( int resolution ) {
+
+	if( resolution < 0 || resolution >= USB_MOUSE_RESOLUTIONS ) {
+		return;
+	}
+	mouse_resolution = resolution;
+}
+
+// --------------------------------------------------------------------
+void usb_set_mouse_curve( int resolution, const USB_MOUSE_CURVE_POINT_T *p_curve, int count ) {
+	uint32_t saved_irq;
+	int i;
+
+	if( resolution < 0 || resolution >= USB_MOUSE_RESOLUTIONS || count < 1 || count > USB_MOUSE_CURVE_POINTS ) {
+		return;
+	}
+	saved_irq = spin_lock_blocking( p_mouse_lock );
+	for( i = 0; i < count; i++ ) {
+		mouse_curves[ resolution ][ i ] = p_curve[ i ];
+	}
+	mouse_curve_points[ resolution ] = count;
+	spin_unlock( p_mouse_lock, saved_irq );
+}
+
+// --------------------------------------------------------------------
+//	All mice are merged in mouse_packed. The part beyond the limit is written back.
+//
+void get_mouse_position( int16_t *p_delta_x, int16_t *p_delta_y, int16_t *p_delta_wheel, int32_t *p_button, int16_t limit ) {
+	int32_t delta_x, delta_y, delta_wheel, button;
+	int32_t take_x, take_y, take_wheel;
+	uint32_t saved_irq;
+
+	if( !is_mouse_active() ) {
+		*p_delta_x		= 0;
+		*p_delta_y		= 0;
+		*p_delta_wheel	= 0;
+		*p_button		= 0;
+		return;
+	}
+	saved_irq = spin_lock_blocking( p_mouse_lock );
+	delta_x			= unpack_field( mouse_packed, MOUSE_PACK_X_SHIFT, MOUSE_PACK_XY_BITS ) + mouse_carry_x;
+	delta_y			= unpack_field( mouse_packed, MOUSE_PACK_Y_SHIFT, MOUSE_PACK_XY_BITS ) + mouse_carry_y;
+	delta_wheel		= unpack_field( mouse_packed, MOUSE_PACK_WHEEL_SHIFT, MOUSE_PACK_WHEEL_BITS );
+	button			= (int32_t)( mouse_packed >> MOUSE_PACK_BUTTON_SHIFT );
+	take_x			= clamp( delta_x, limit );
+	take_y			= clamp( delta_y, limit );
+	take_wheel		= clamp( delta_wheel, MOUSE_WHEEL_LIMIT );
+	mouse_packed	= pack_mouse( split_delta( delta_x - take_x, &mouse_carry_x ), split_delta( delta_y - take_y, &mouse_carry_y ), 
+	                              delta_wheel - take_wheel, button );
+	//	If the remainder has 1 count or more, it is reported by the next call.
+	mouse_updated	= (take_x != delta_x) || (take_y != delta_y) || (take_wheel != delta_wheel);
+	spin_unlock( p_mouse_lock, saved_irq );
+
+	*p_delta_x		= (int16_t) take_x;
+	*p_delta_y		= (int16_t) take_y;
+	*p_delta_wheel	= (int16_t) take_wheel;
+	*p_button		= button;
+}
+
+// --------------------------------------------------------------------
+static int32_t get_mouse_gain( int speed ) {
+	const USB_MOUSE_CURVE_POINT_T *p_curve = mouse_curves[ mouse_resolution ];
+	int count = mouse_curve_points[ mouse_resolution ];
+	int32_t gain;
+	int i;
+
+	gain = p_curve[0].gain;
+	for( i = 1; i < count; i++ ) {
+		if( speed < p_curve[i].speed ) {
+			break;
+		}
+		gain = p_curve[i].gain;
+	}
+	return gain;
+}
+
+// --------------------------------------------------------------------
+//	Multiply by the gain, and return the integer part. The fraction remains in *p_fraction.
+//
+static int32_t apply_gain( int32_t delta, int32_t gain, int16_t *p_fraction ) {
+	int32_t value, count;
+
+	value = delta * gain + *p_fraction;
+	count = value / (1 << MOUSE_DELTA_FRACTION);
+	*p_fraction = (int16_t)( value - count * (1 << MOUSE_DELTA_FRACTION) );
+	return count;
+}
+
+// --------------------------------------------------------------------
+//	Buttons of all mice. It is called in the spinlock.
+//
+static int32_t merge_mouse_button( void ) {
+	int32_t button = 0;
+	int i;
+
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role == DM_MOUSE ) {
+			button |= devices[i].button;
+		}
+	}
+	return button;
+}
+
+// --------------------------------------------------------------------
+static void process_mouse_movement( USB_DEVICE_T *p_device, int32_t x, int32_t y, int32_t wheel, bool has_wheel, int32_t buttons ) {
+	int32_t gain, delta_x, delta_y, delta_wheel;
+	uint32_t saved_irq;
+
+	saved_irq = spin_lock_blocking( p_mouse_lock );
+	//	gain is Q8, so the result is the Q8 delta.
+	gain = get_mouse_gain( (abs( x ) > abs( y )) ? abs( x ) : abs( y ) );
+	delta_x		= unpack_field( mouse_packed, MOUSE_PACK_X_SHIFT, MOUSE_PACK_XY_BITS );
+	delta_y		= unpack_field( mouse_packed, MOUSE_PACK_Y_SHIFT, MOUSE_PACK_XY_BITS );
+	delta_wheel	= unpack_field( mouse_packed, MOUSE_PACK_WHEEL_SHIFT, MOUSE_PACK_WHEEL_BITS );
+	delta_x		= split_delta( delta_x + mouse_carry_x + apply_gain( x, gain, &p_device->fraction_x ), &mouse_carry_x );
+	delta_y		= split_delta( delta_y + mouse_carry_y + apply_gain( y, gain, &p_device->fraction_y ), &mouse_carry_y );
+	if( has_wheel ) {
+		delta_wheel = clamp( delta_wheel + wheel, MOUSE_WHEEL_MAX );
+	}
+	p_device->button = (buttons & (MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE | MOUSE_BUTTON_BACKWARD | MOUSE_BUTTON_FORWARD));
+	mouse_packed = pack_mouse( delta_x, delta_y, delta_wheel, merge_mouse_button() );
+	mouse_updated = true;
+	spin_unlock( p_mouse_lock, saved_irq );
+	if( x != 0 || y != 0 || wheel != 0 ) {
+		LATENCY_TRACE_REPORT();
+	}
+}
+
+// --------------------------------------------------------------------
+static void process_mouse_report( USB_DEVICE_T *p_device, uint8_t const *report, uint16_t len ) {
+	const HID_MOUSE_PLAN_T *p_plan = &p_device->plan;
+	hid_mouse_report_t const *p_boot;
+
+	if( p_device->is_report_protocol ) {
+		if( p_plan->report_id != 0 && (len == 0 || report[0] != p_plan->report_id) ) {
+			//	Other report (e.g. consumer control)
+			return;
+		}
+		process_mouse_movement( p_device, 
+			hid_extract_field( report, len, &p_plan->field[ HID_MOUSE_X ] ),
+			hid_extract_field( report, len, &p_plan->field[ HID_MOUSE_Y ] ),
+			hid_extract_field( report, len, &p_plan->field[ HID_MOUSE_WHEEL ] ),
+			p_plan->field[ HID_MOUSE_WHEEL ].bit_size != 0,
+			hid_extract_field( report, len, &p_plan->field[ HID_MOUSE_BUTTONS ] ) );
 	}
 	else {
-		*p_delta_x	= 0;
-		*p_delta_y	= 0;
-		*p_button	= 0;
+		//	The boot protocol report has no wheel. (3 bytes)
+		p_boot = (hid_mouse_report_t const*) report;
+		process_mouse_movement( p_device, p_boot->x, p_boot->y, p_boot->wheel, len >= 4, p_boot->buttons );
 	}
 }
 
 // --------------------------------------------------------------------
-static void process_mouse_report( hid_mouse_report_t const * report ) {
-	int16_t delta_x;
-	int16_t delta_y;
+static void push_key_event( uint8_t usage, bool is_make, uint32_t time_us ) {
+	int next_ptr;
 
-	sem_acquire_blocking( &sem );
-	delta_x = mouse_delta_x + (int16_t) report->x;
-	if( delta_x < -127 ) {
-		delta_x = -127;
+	next_ptr = (key_event_write_ptr + 1) & (KEY_EVENT_FIFO_SIZE - 1);
+	if( next_ptr == key_event_read_ptr ) {
+		//	FIFO is full. The event is lost.
+		return;
 	}
-	else if( delta_x > 127 ) {
-		delta_x = 127;
+	key_event_fifo[ key_event_write_ptr ].usage		= usage;
+	key_event_fifo[ key_event_write_ptr ].is_make	= is_make;
+	key_event_fifo[ key_event_write_ptr ].time_us	= time_us;
+	key_event_write_ptr = next_ptr;
+}
+
+// --------------------------------------------------------------------
+bool usb_get_key_event( USB_KEY_EVENT_T *p_event ) {
+
+	if( key_event_read_ptr == key_event_write_ptr ) {
+		return false;
 	}
+	sem_acquire_blocking( &sem );
+	*p_event = key_event_fifo[ key_event_read_ptr ];
+	key_event_read_ptr = (key_event_read_ptr + 1) & (KEY_EVENT_FIFO_SIZE - 1);
+	sem_release( &sem );
+	return true;
+}
+
+// --------------------------------------------------------------------
+static void process_keyboard_report( USB_DEVICE_T *p_device, uint8_t const *report, uint16_t len ) {
+	hid_keyboard_report_t const *p_boot = (hid_keyboard_report_t const*) report;
+	uint32_t keys[ KEY_BITMAP_WORDS ] = { 0 };
+	uint32_t diff, bit, time_us;
+	uint8_t usage;
+	int i;
 
-	delta_y = mouse_delta_y + (int16_t) report->y;
-	if( delta_y < -127 ) {
-		delta_y = -127;
+	if( len < sizeof(hid_keyboard_report_t) ) {
+		return;
 	}
-	else if( delta_y > 127 ) {
-		delta_y = 127;
+	time_us = time_us_32();
+	for( i = 0; i < 6; i++ ) {
+		usage = p_boot->keycode[i];
+		if( usage == 0 ) {
+			continue;
+		}
+		if( usage < KEY_USAGE_FIRST ) {
+			//	Too many keys (phantom state). The previous state is kept.
+			return;
+		}
+		keys[ usage >> 5 ] |= 1u << (usage & 31);
 	}
+	keys[ KEY_USAGE_MODIFIER >> 5 ] |= (uint32_t) p_boot->modifier << (KEY_USAGE_MODIFIER & 31);
 
-	mouse_button = (report->buttons & (MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE));
-	mouse_delta_x = delta_x;
-	mouse_delta_y = delta_y;
+	sem_acquire_blocking( &sem );
+	for( i = 0; i < KEY_BITMAP_WORDS; i++ ) {
+		diff = keys[i] ^ p_device->keys[i];
+		while( diff != 0 ) {
+			bit = __builtin_ctz( diff );
+			diff &= diff - 1;
+			push_key_event( (uint8_t) ((i << 5) | bit), (keys[i] >> bit) & 1, time_us );
+		}
+		p_device->keys[i] = keys[i];
+	}
 	sem_release( &sem );
 }
 
+// --------------------------------------------------------------------
+void usb_set_keyboard_leds( uint8_t leds ) {
+
+	//	It is sent by usb_task(), because TinyUSB must be called on the core of tuh_task().
+	pending_keyboard_leds = leds;
+	__dmb();
+	is_keyboard_leds_pending = true;
+}
+
+// --------------------------------------------------------------------
+void usb_task( void ) {
+	int i;
+
+	tuh_task();
+	if( !is_keyboard_leds_pending ) {
+		return;
+	}
+	is_keyboard_leds_pending = false;
+	__dmb();
+	//	The buffer must be kept until the transfer completes.
+	keyboard_leds = pending_keyboard_leds;
+	for( i = 0; i < USB_DEVICE_MAX; i++ ) {
+		if( devices[i].role == DM_KEYBOARD ) {
+			tuh_hid_set_report( devices[i].dev_addr, devices[i].instance, 0, HID_REPORT_TYPE_OUTPUT, &keyboard_leds, sizeof(keyboard_leds) );
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Digital state of the gamepad
+//		x, y ........... Position relative to the center (-128 ... 127)
+//
+static uint8_t make_gamepad_state( int x, int y, uint32_t button ) {
+	uint8_t state = 0;
+
+	if( x <= LEFT_THRESHOLD ) {
+		state |= USB_GAMEPAD_LEFT;
+	}
+	else if( x >= RIGHT_THRESHOLD ) {
+		state |= USB_GAMEPAD_RIGHT;
+	}
+	if( y <= TOP_THRESHOLD ) {
+		state |= USB_GAMEPAD_UP;
+	}
+	else if( y >= BOTTOM_THRESHOLD ) {
+		state |= USB_GAMEPAD_DOWN;
+	}
+	if( (button & A_BUTTON) != 0 ) {
+		state |= USB_GAMEPAD_A;
+	}
+	if( (button & B_BUTTON) != 0 ) {
+		state |= USB_GAMEPAD_B;
+	}
+	if( (button & C_BUTTON) != 0 ) {
+		state |= USB_GAMEPAD_C;
+	}
+	if( (button & START_BUTTON) != 0 ) {
+		state |= USB_GAMEPAD_START;
+	}
+	return state;
+}
+
+// --------------------------------------------------------------------
+static void process_gamepad_report( USB_DEVICE_T *p_device, uint8_t const *report, uint16_t len ) {
+	tuh_hid_report_info_t *p_info = NULL;
+	hid_gamepad_report_t const *p_gamepad;
+	my_hid_joystick_report_t const *p_joystick;
+	int i;
+
+	if( p_device->report_count == 1 && p_device->report_info[0].report_id == 0 ) {
+		//	Simple report without report ID as 1st byte
+		p_info = &p_device->report_info[0];
+	}
+	else if( len > 0 ) {
+		//	Composite report, 1st byte is report ID, data starts from 2nd byte
+		for( i = 0; i < p_device->report_count; i++ ) {
+			if( report[0] == p_device->report_info[i].report_id ) {
+				p_info = &p_device->report_info[i];
+				break;
+			}
+		}
+		report++;
+		len--;
+	}
+	if( p_info == NULL || p_info->usage_page != HID_USAGE_PAGE_DESKTOP ) {
+		return;
+	}
+
+	if( p_info->usage == HID_USAGE_DESKTOP_GAMEPAD && len >= sizeof(hid_gamepad_report_t) ) {
+		p_gamepad = (hid_gamepad_report_t const*) report;
+		p_device->gamepad = make_gamepad_state( p_gamepad->x, p_gamepad->y, p_gamepad->buttons );
+	}
+	else if( p_info->usage == HID_USAGE_DESKTOP_JOYSTICK && len >= 6 ) {
+		p_joystick = (my_hid_joystick_report_t const*) report;
+		p_device->gamepad = make_gamepad_state( 
+			(int) p_joystick->x - 128, (int) p_joystick->y - 128, p_joystick->buttons );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Check the application collections of the report descriptor
+//		Only the Generic Desktop Gamepad or Joystick is a gamepad. The other interfaces
+//		without the boot protocol (consumer control, vendor, ...) are not used.
+//
+static bool has_gamepad_collection( const tuh_hid_report_info_t *p_info, int count ) {
+	int i;
+
+	for( i = 0; i < count; i++ ) {
+		if( p_info[i].usage_page == HID_USAGE_PAGE_DESKTOP && 
+		    (p_info[i].usage == HID_USAGE_DESKTOP_GAMEPAD || p_info[i].usage == HID_USAGE_DESKTOP_JOYSTICK) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+#if HID_PARSER_BENCHMARK
+// --------------------------------------------------------------------
+static void benchmark_mouse_plan( const HID_MOUSE_PLAN_T *p_plan ) {
+	static uint8_t report[ CFG_TUH_HID_EP_BUFSIZE ];
+	volatile int32_t sum = 0;
+	hid_mouse_report_t const *p_boot = (hid_mouse_report_t const*) report;
+	uint32_t start, plan_time, cast_time;
+	int i, j;
+
+	start = time_us_32();
+	for( i = 0; i < 1000; i++ ) {
+		for( j = 0; j < HID_MOUSE_FIELDS; j++ ) {
+			sum += hid_extract_field( report, sizeof(report), &p_plan->field[j] );
+		}
+	}
+	plan_time = time_us_32() - start;
+
+	start = time_us_32();
+	for( i = 0; i < 1000; i++ ) {
+		sum += p_boot->x + p_boot->y + p_boot->wheel + p_boot->buttons;
+	}
+	cast_time = time_us_32() - start;
+	printf( "Extraction: plan %lu ns/report, cast %lu ns/report\r\n", (unsigned long) plan_time, (unsigned long) cast_time );
+}
+#endif
+
+// --------------------------------------------------------------------
+static PLAN_CACHE_T *find_plan_cache( uint16_t vid, uint16_t pid, uint8_t instance, uint8_t itf_protocol, uint16_t desc_len ) {
+	PLAN_CACHE_T *p_cache;
+	int i;
+
+	for( i = 0; i < PLAN_CACHE_SIZE; i++ ) {
+		p_cache = &plan_cache[i];
+		if( p_cache->last_used != 0 && p_cache->vid == vid && p_cache->pid == pid && 
+		    p_cache->instance == instance && p_cache->itf_protocol == itf_protocol && p_cache->desc_len == desc_len ) {
+			p_cache->last_used = ++plan_cache_clock;
+			return p_cache;
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------------------------------------------
+static PLAN_CACHE_T *alloc_plan_cache( uint16_t vid, uint16_t pid, uint8_t instance, uint8_t itf_protocol, uint16_t desc_len ) {
+	PLAN_CACHE_T *p_cache = &plan_cache[0];
+	int i;
+
+	for( i = 1; i < PLAN_CACHE_SIZE; i++ ) {
+		if( plan_cache[i].last_used < p_cache->last_used ) {
+			p_cache = &plan_cache[i];
+		}
+	}
+	p_cache->vid			= vid;
+	p_cache->pid			= pid;
+	p_cache->instance		= instance;
+	p_cache->itf_protocol	= itf_protocol;
+	p_cache->desc_len		= desc_len;
+	p_cache->last_used		= ++plan_cache_clock;
+	return p_cache;
+}
+
+// --------------------------------------------------------------------
+void usb_get_mount_statistics( USB_MOUNT_STATISTICS_T *p_statistics ) {
+
+	*p_statistics = mount_statistics;
+}
+
 // --------------------------------------------------------------------
 //	HIDڑꂽƂɌĂяoR[obN
 //
@@ -124,28 +724,98 @@ void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* desc_r
 		static const char* protocol_str[] = { "None", "Keyboard", "Mouse" };
 	#endif
 	uint8_t const itf_protocol = tuh_hid_interface_protocol( dev_addr, instance );
+	USB_DEVICE_T *p_device;
+	PLAN_CACHE_T *p_cache = NULL;
+	uint16_t vid = 0, pid = 0;
+	bool is_mouse_plan;
+	bool is_used = true;
 	#if DEBUG_ON
 		printf( "tuh_hid_mount_cb( %d, %d ) : [%s]\r\n", dev_addr, instance, protocol_str[ itf_protocol ] );
 	#endif
 
+	sem_acquire_blocking( &sem );
+	p_device = alloc_device( dev_addr, instance );
+	if( p_device == NULL ) {
+		//	The device table is full. This interface is not used.
+		sem_release( &sem );
+		#if DEBUG_ON
+			printf( "Error: device table is full\r\n" );
+		#endif
+		return;
+	}
+	p_device->fraction_x = 0;
+	p_device->fraction_y = 0;
+	p_device->button = 0;
+	p_device->report_count = 0;
+	p_device->gamepad = 0;
+	memset( p_device->keys, 0, sizeof(p_device->keys) );
+	p_device->mount_time = time_us_32() | 1;
+	mount_statistics.mount_count++;
+
+	if( itf_protocol != HID_ITF_PROTOCOL_KEYBOARD && tuh_vid_pid_get( dev_addr, &vid, &pid ) ) {
+		p_cache = find_plan_cache( vid, pid, instance, itf_protocol, desc_len );
+		if( p_cache != NULL ) {
+			mount_statistics.cache_hit_count++;
+		}
+	}
+
 	// By default host stack will use activate boot protocol on supported interface.
 	// Therefore for this simple example, we only need to parse generic report descriptor (with built-in parser)
-	if( itf_protocol == HID_ITF_PROTOCOL_NONE ) {
-		hid_info[instance].report_count = tuh_hid_parse_report_descriptor(hid_info[instance].report_info, MAX_REPORT, desc_report, desc_len);
-		board_led_write( 0 );
-		detect_mode = DM_GAMEPAD;
-	}
-	else if( itf_protocol == HID_ITF_PROTOCOL_MOUSE ) {
-		board_led_write( 1 );
-		detect_mode = DM_MOUSE;
-		mouse_delta_x = 0;
-		mouse_delta_y = 0;
-		mouse_button = 0;
-		mouse_resolution = 0;
+	if( itf_protocol == HID_ITF_PROTOCOL_MOUSE ) {
+		p_device->role = DM_MOUSE;
+		//	Switch to the report protocol if the report descriptor can be parsed.
+		//	The boot protocol is used until tuh_hid_set_protocol_complete_cb().
+		p_device->is_report_protocol = false;
+		if( p_cache != NULL ) {
+			is_mouse_plan = p_cache->is_mouse_plan;
+			p_device->plan = p_cache->plan;
+		}
+		else {
+			is_mouse_plan = hid_parse_mouse_descriptor( desc_report, desc_len, &p_device->plan );
+			if( vid != 0 || pid != 0 ) {
+				p_cache = alloc_plan_cache( vid, pid, instance, itf_protocol, desc_len );
+				p_cache->is_mouse_plan = is_mouse_plan;
+				p_cache->plan = p_device->plan;
+			}
+		}
+		if( is_mouse_plan ) {
+			tuh_hid_set_protocol( dev_addr, instance, HID_PROTOCOL_REPORT );
+			#if HID_PARSER_BENCHMARK
+				benchmark_mouse_plan( &p_device->plan );
+			#endif
+		}
+	}
+	else if( itf_protocol == HID_ITF_PROTOCOL_KEYBOARD ) {
+		p_device->role = DM_KEYBOARD;
 	}
 	else {
-		board_led_write( 0 );
-		detect_mode = DM_GAMEPAD;
+		if( p_cache != NULL ) {
+			p_device->report_count = p_cache->report_count;
+			memcpy( p_device->report_info, p_cache->report_info, sizeof(p_device->report_info) );
+		}
+		else {
+			p_device->report_count = tuh_hid_parse_report_descriptor( p_device->report_info, MAX_REPORT, desc_report, desc_len );
+			if( vid != 0 || pid != 0 ) {
+				p_cache = alloc_plan_cache( vid, pid, instance, itf_protocol, desc_len );
+				p_cache->report_count = p_device->report_count;
+				memcpy( p_cache->report_info, p_device->report_info, sizeof(p_cache->report_info) );
+			}
+		}
+		if( has_gamepad_collection( p_device->report_info, p_device->report_count ) ) {
+			p_device->role = DM_GAMEPAD;
+		}
+		else {
+			//	The entry stays free (DM_UNKNOWN).
+			is_used = false;
+		}
+	}
+	sem_release( &sem );
+	board_led_write( is_mouse_active() ? 1 : 0 );
+	if( !is_used ) {
+		#if DEBUG_ON
+			printf( "Not a gamepad: not used\r\n" );
+		#endif
+		return;
 	}
 
 	// request to receive report
@@ -163,28 +833,93 @@ void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* desc_r
 //	Callback to be called when the gamepad is disconnected.
 //
 void tuh_hid_umount_cb( uint8_t dev_addr, uint8_t instance ) {
-
-	(void) dev_addr;
-	(void) instance;
+	USB_DEVICE_T *p_device;
+	uint32_t bit, saved_irq;
+	bool is_mouse = false;
+	int i;
 
 	//	́AȂؒfĂȂĂpɂɌĂ΂̂ŉȂB
 	#if DEBUG_ON
 		printf( "tuh_hid_umount_cb( %d, %d )\r\n", dev_addr, instance );
 	#endif
-	detect_mode = DM_UNKNOWN;
+	//	Only the entry of this interface is released. The other devices are not affected.
+	sem_acquire_blocking( &sem );
+	p_device = find_device( dev_addr, instance );
+	if( p_device != NULL ) {
+		if( p_device->role == DM_KEYBOARD ) {
+			//	Release the pressed keys, so that no key remains pressed on the PS/2 side.
+			for( i = 0; i < KEY_BITMAP_WORDS; i++ ) {
+				while( p_device->keys[i] != 0 ) {
+					bit = __builtin_ctz( p_device->keys[i] );
+					p_device->keys[i] &= p_device->keys[i] - 1;
+					push_key_event( (uint8_t) ((i << 5) | bit), false, time_us_32() );
+				}
+			}
+		}
+		is_mouse = (p_device->role == DM_MOUSE);
+		p_device->role = DM_UNKNOWN;
+	}
+	sem_release( &sem );
+
+	//	The buttons of the removed mouse are released.
+	saved_irq = spin_lock_blocking( p_mouse_lock );
+	if( is_mouse ) {
+		//	The movement of the removed mouse is not sent after it is unplugged.
+		p_device->fraction_x = 0;
+		p_device->fraction_y = 0;
+		mouse_carry_x = 0;
+		mouse_carry_y = 0;
+		mouse_packed = pack_mouse( 0, 0, 0, merge_mouse_button() );
+		mouse_updated = false;
+	}
+	else {
+		mouse_packed = (mouse_packed & ~(((1u << MOUSE_PACK_BUTTON_BITS) - 1) << MOUSE_PACK_BUTTON_SHIFT)) | 
+		               ((uint32_t) merge_mouse_button() << MOUSE_PACK_BUTTON_SHIFT);
+	}
+	spin_unlock( p_mouse_lock, saved_irq );
+	board_led_write( is_mouse_active() ? 1 : 0 );
+}
+
+// --------------------------------------------------------------------
+void tuh_hid_set_protocol_complete_cb( uint8_t dev_addr, uint8_t instance, uint8_t protocol ) {
+	USB_DEVICE_T *p_device;
+
+	sem_acquire_blocking( &sem );
+	p_device = find_device( dev_addr, instance );
+	if( p_device != NULL && p_device->role == DM_MOUSE ) {
+		p_device->is_report_protocol = (protocol == HID_PROTOCOL_REPORT);
+	}
+	sem_release( &sem );
 }
 
 // --------------------------------------------------------------------
 void tuh_hid_report_received_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len ) {
 
-	uint8_t const itf_protocol = tuh_hid_interface_protocol( dev_addr, instance );
+	USB_DEVICE_T *p_device = find_device( dev_addr, instance );
+	uint32_t elapsed;
 
-	if( itf_protocol == HID_ITF_PROTOCOL_MOUSE ) {
-		process_mouse_report( (hid_mouse_report_t const*) report );
+	if( p_device != NULL && p_device->mount_time != 0 ) {
+		//	Time to the first report after mount
+		elapsed = time_us_32() - p_device->mount_time;
+		p_device->mount_time = 0;
+		mount_statistics.last_first_report_us = elapsed;
+		if( elapsed > mount_statistics.max_first_report_us ) {
+			mount_statistics.max_first_report_us = elapsed;
+		}
+	}
+
+	if( p_device == NULL ) {
+		//	Not in the device table.
+	}
+	else if( p_device->role == DM_MOUSE ) {
+		process_mouse_report( p_device, report, len );
+	}
+	else if( p_device->role == DM_KEYBOARD ) {
+		process_keyboard_report( p_device, report, len );
 	}
 	else {
 		// Generic report requires matching ReportID and contents with previous parsed report info
-		//	process_gamepad_report( (hid_gamepad_report_t const*) report );
+		process_gamepad_report( p_device, report, len );
 	}
 
 	// continue to request to receive report
@@ -30,10 +30,141 @@
 	#endif
 
 		#include <stdint.h>
+		#include <stdbool.h>
 
+		//	Resolution (0xE8) and acceleration curve
+		#define USB_MOUSE_RESOLUTIONS			4
+		#define USB_MOUSE_DEFAULT_RESOLUTION	2
+		#define USB_MOUSE_CURVE_POINTS			4
+
+		typedef struct {
+			int16_t		speed;			//	[counts/report] The gain is used when max(|x|,|y|) >= speed
+			int16_t		gain;			//	Q8 fixed point (256 = x1.0)
+		} USB_MOUSE_CURVE_POINT_T;
+
+		//	Key event of the USB keyboard
+		typedef struct {
+			uint8_t		usage;			//	HID usage ID of the keyboard page (0xE0 ... 0xE7: modifiers)
+			bool		is_make;		//	true: pressed, false: released
+			uint32_t	time_us;		//	time_us_32() when the USB report was received
+		} USB_KEY_EVENT_T;
+
+		//	Digital state of the gamepad (get_gamepad_state)
+		#define USB_GAMEPAD_UP					0x01
+		#define USB_GAMEPAD_DOWN				0x02
+		#define USB_GAMEPAD_LEFT				0x04
+		#define USB_GAMEPAD_RIGHT				0x08
+		#define USB_GAMEPAD_A					0x10	//	MSX trigger A
+		#define USB_GAMEPAD_B					0x20	//	MSX trigger B
+		#define USB_GAMEPAD_C					0x40
+		#define USB_GAMEPAD_START				0x80
+
+		//	Statistics of mount
+		typedef struct {
+			uint32_t	mount_count;			//	Number of tuh_hid_mount_cb()
+			uint32_t	cache_hit_count;		//	Number of mounts which reused the parsed report descriptor
+			uint32_t	last_first_report_us;	//	Time from the last mount to its first report [usec]
+			uint32_t	max_first_report_us;
+		} USB_MOUNT_STATISTICS_T;
+
+		// --------------------------------------------------------------------
+		//	Initialize USB host
+		//	input:
+		//		none
+		//	output:
+		//		none
+		//	comment:
+		//		It must be called on the core which calls usb_task().
+		// --------------------------------------------------------------------
 		void usb_init( void );
+
+		// --------------------------------------------------------------------
+		//	USB host task (tuh_task and the requests from the other modules)
+		//	input:
+		//		none
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void usb_task( void );
+
 		bool is_mouse_active( void );
-		void get_mouse_position( int16_t *p_delta_x, int16_t *p_delta_y, int32_t *p_button );
+		bool is_gamepad_active( void );
+
+		// --------------------------------------------------------------------
+		//	Get the state of the gamepads
+		//	input:
+		//		none
+		//	output:
+		//		USB_GAMEPAD_xxx of all gamepads
+		// --------------------------------------------------------------------
+		uint8_t get_gamepad_state( void );
+
+		bool is_mouse_updated( void );
+		int32_t get_mouse_button( void );
+
+		// --------------------------------------------------------------------
+		//	Get mouse movement
+		//	input:
+		//		p_delta_x, p_delta_y, p_delta_wheel, p_button ... Address of buffer to return results.
+		//		limit ........... Maximum absolute value of delta X and delta Y.
+		//	output:
+		//		none
+		//	comment:
+		//		The movement beyond limit remains, and it is returned by the next call.
+		//		The wheel is limited to -7 ... 7 in the same way.
+		// --------------------------------------------------------------------
+		void get_mouse_position( int16_t *p_delta_x, int16_t *p_delta_y, int16_t *p_delta_wheel, int32_t *p_button, int16_t limit );
+
+		// --------------------------------------------------------------------
+		//	Select the acceleration curve used for the following USB reports
+		//	input:
+		//		resolution ...... 0 ... USB_MOUSE_RESOLUTIONS - 1 (argument of 0xE8)
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void usb_set_mouse_resolution( int resolution );
+
+		// --------------------------------------------------------------------
+		//	Replace the acceleration curve
+		//	input:
+		//		resolution ...... 0 ... USB_MOUSE_RESOLUTIONS - 1
+		//		p_curve ......... Points in ascending order of speed. p_curve[0].speed should be 0.
+		//		count ........... 1 ... USB_MOUSE_CURVE_POINTS
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void usb_set_mouse_curve( int resolution, const USB_MOUSE_CURVE_POINT_T *p_curve, int count );
+
+		// --------------------------------------------------------------------
+		//	Get key event of the USB keyboards
+		//	input:
+		//		p_event ......... Address of buffer to return the event.
+		//	output:
+		//		true ............ Success. *p_event is active.
+		//		false ........... No event.
+		//	comment:
+		//		Only the changed keys are reported. When a keyboard is disconnected,
+		//		the break events of its pressed keys are reported.
+		// --------------------------------------------------------------------
+		bool usb_get_key_event( USB_KEY_EVENT_T *p_event );
+
+		// --------------------------------------------------------------------
+		//	Set the LEDs of all USB keyboards
+		//	input:
+		//		leds ............ KEYBOARD_LED_NUMLOCK | KEYBOARD_LED_CAPSLOCK | KEYBOARD_LED_SCROLLLOCK
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void usb_set_keyboard_leds( uint8_t leds );
+
+		// --------------------------------------------------------------------
+		//	Get statistics of mount
+		//	input:
+		//		p_statistics .... Address of buffer to return the statistics.
+		//	output:
+		//		none
+		// --------------------------------------------------------------------
+		void usb_get_mount_statistics( USB_MOUNT_STATISTICS_T *p_statistics );
 
 	#ifdef __cplusplus
 	}
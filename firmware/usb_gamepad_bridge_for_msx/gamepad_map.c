@@ -0,0 +1,543 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//
+//	Copyright (c) 2021-2022 HRA! (t.hara)
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+
+#include <string.h>
+#include "gamepad_map.h"
+
+//	Item type
+#define ITEM_MAIN				0
+#define ITEM_GLOBAL				1
+#define ITEM_LOCAL				2
+#define ITEM_LONG				0xFE
+
+//	Main items
+#define MAIN_INPUT				0x8
+#define MAIN_COLLECTION			0xA
+#define MAIN_END_COLLECTION		0xC
+
+//	Global items
+#define GLOBAL_USAGE_PAGE		0x0
+#define GLOBAL_LOGICAL_MIN		0x1
+#define GLOBAL_LOGICAL_MAX		0x2
+#define GLOBAL_REPORT_SIZE		0x7
+#define GLOBAL_REPORT_ID		0x8
+#define GLOBAL_REPORT_COUNT		0x9
+#define GLOBAL_PUSH				0xA
+#define GLOBAL_POP				0xB
+
+//	Local items
+#define LOCAL_USAGE				0x0
+#define LOCAL_USAGE_MIN			0x1
+#define LOCAL_USAGE_MAX			0x2
+
+#define PAGE_DESKTOP			0x01
+#define PAGE_BUTTON				0x09
+#define USAGE_JOYSTICK			0x04
+#define USAGE_GAMEPAD			0x05
+#define USAGE_X					0x30
+#define USAGE_HAT_SWITCH		0x39
+
+#define INPUT_CONSTANT			0x01
+#define INPUT_VARIABLE			0x02
+#define COLLECTION_APPLICATION	0x01
+
+#define MAX_USAGES				16
+#define MAX_REPORT_IDS			8
+#define MAX_PUSH				2
+#define MAX_FIELD_SIZE			24
+
+typedef struct {
+	uint16_t	usage_page;
+	int32_t		logical_min;
+	int32_t		logical_max;
+	uint32_t	report_size;
+	uint32_t	report_count;
+	uint8_t		report_id;
+} GLOBAL_STATE_T;
+
+typedef struct {
+	uint32_t	usage[ MAX_USAGES ];	//	(usage page << 16) | usage, if the size is 4 bytes
+	int			usage_count;
+	uint32_t	usage_min;
+	uint32_t	usage_max;
+	bool		has_range;
+} LOCAL_STATE_T;
+
+//	Position and range of an input
+typedef struct {
+	uint16_t	bit_offset;
+	uint8_t		bit_size;			//	0: The input does not exist.
+	int32_t		logical_min;
+	int32_t		logical_max;
+} FIELD_T;
+
+//	Inputs of the gamepad
+typedef struct {
+	FIELD_T		axis[ GAMEPAD_AXES ];
+	FIELD_T		hat;
+	uint16_t	button_offset[ GAMEPAD_MAP_MAX_BUTTONS ];
+	uint32_t	buttons;			//	bit n: button n + 1 exists
+	uint32_t	report_bits;		//	Size of the report including the report ID byte
+	uint8_t		report_id;
+} GAMEPAD_FIELDS_T;
+
+//	Directions of the hat switch for each position. The 9th is the null state.
+static const uint8_t hat_directions[ 9 ] = {
+	(1 << GAMEPAD_HAT_UP),
+	(1 << GAMEPAD_HAT_UP) | (1 << GAMEPAD_HAT_RIGHT),
+	(1 << GAMEPAD_HAT_RIGHT),
+	(1 << GAMEPAD_HAT_DOWN) | (1 << GAMEPAD_HAT_RIGHT),
+	(1 << GAMEPAD_HAT_DOWN),
+	(1 << GAMEPAD_HAT_DOWN) | (1 << GAMEPAD_HAT_LEFT),
+	(1 << GAMEPAD_HAT_LEFT),
+	(1 << GAMEPAD_HAT_UP) | (1 << GAMEPAD_HAT_LEFT),
+	0,
+};
+
+//	Bits of the Joymega matrix cleared by each button
+//	            b5, b4, b3, b2, b1, b0
+//	matrix[0] = Up, Dn, L,  L,  A,  St
+//	matrix[1] = Up, Dn, Lt, Rt, B,  C
+//	matrix[2] = L,  L,  L,  L,  A,  St
+//	matrix[3] = Z,  Y,  X,  Md, H,  H
+//	matrix[4] = H,  H,  H,  H,  A,  St
+static const uint64_t joymega_mask[ GAMEPAD_MAP_BUTTONS ] = {
+	GAMEPAD_MAP_MATRIX_BIT( 0, 5 ) | GAMEPAD_MAP_MATRIX_BIT( 1, 5 ),								//	UP
+	GAMEPAD_MAP_MATRIX_BIT( 0, 4 ) | GAMEPAD_MAP_MATRIX_BIT( 1, 4 ),								//	DOWN
+	GAMEPAD_MAP_MATRIX_BIT( 1, 3 ),																//	LEFT
+	GAMEPAD_MAP_MATRIX_BIT( 1, 2 ),																//	RIGHT
+	GAMEPAD_MAP_MATRIX_BIT( 0, 1 ) | GAMEPAD_MAP_MATRIX_BIT( 2, 1 ) | GAMEPAD_MAP_MATRIX_BIT( 4, 1 ),	//	A
+	GAMEPAD_MAP_MATRIX_BIT( 1, 1 ),																//	B
+	GAMEPAD_MAP_MATRIX_BIT( 1, 0 ),																//	C
+	GAMEPAD_MAP_MATRIX_BIT( 3, 3 ),																//	X
+	GAMEPAD_MAP_MATRIX_BIT( 3, 4 ),																//	Y
+	GAMEPAD_MAP_MATRIX_BIT( 3, 5 ),																//	Z
+	GAMEPAD_MAP_MATRIX_BIT( 0, 0 ) | GAMEPAD_MAP_MATRIX_BIT( 2, 0 ) | GAMEPAD_MAP_MATRIX_BIT( 4, 0 ),	//	START
+	GAMEPAD_MAP_MATRIX_BIT( 3, 2 ),																//	MODE
+};
+
+// --------------------------------------------------------------------
+static uint32_t get_item_data( const uint8_t *p, int size ) {
+	uint32_t data = 0;
+
+	if( size >= 1 ) data = p[0];
+	if( size >= 2 ) data |= (uint32_t) p[1] << 8;
+	if( size >= 4 ) data |= ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+	return data;
+}
+
+// --------------------------------------------------------------------
+static int32_t get_signed_item_data( const uint8_t *p, int size ) {
+
+	if( size == 1 ) return (int8_t) p[0];
+	if( size == 2 ) return (int16_t)( p[0] | (p[1] << 8) );
+	return (int32_t) get_item_data( p, size );
+}
+
+// --------------------------------------------------------------------
+static uint32_t get_usage( const GLOBAL_STATE_T *p_global, const LOCAL_STATE_T *p_local, uint32_t index ) {
+	uint32_t usage;
+
+	if( p_local->has_range ) {
+		usage = p_local->usage_min + index;
+		if( usage > p_local->usage_max ) {
+			usage = p_local->usage_max;
+		}
+	}
+	else if( p_local->usage_count == 0 ) {
+		return 0;
+	}
+	else if( index < (uint32_t) p_local->usage_count ) {
+		usage = p_local->usage[ index ];
+	}
+	else {
+		//	The last usage is used for the rest.
+		usage = p_local->usage[ p_local->usage_count - 1 ];
+	}
+	if( usage <= 0xFFFF ) {
+		usage |= (uint32_t) p_global->usage_page << 16;
+	}
+	return usage;
+}
+
+// --------------------------------------------------------------------
+static void set_field( FIELD_T *p_field, uint32_t bit_offset, const GLOBAL_STATE_T *p_global ) {
+
+	if( p_field->bit_size != 0 || p_global->report_size == 0 || p_global->report_size > MAX_FIELD_SIZE ) {
+		return;
+	}
+	p_field->bit_offset = (uint16_t) bit_offset;
+	p_field->bit_size = (uint8_t) p_global->report_size;
+	p_field->logical_min = p_global->logical_min;
+	p_field->logical_max = p_global->logical_max;
+	if( p_field->logical_max <= p_field->logical_min ) {
+		//	The range is not declared, so it is the whole field.
+		p_field->logical_min = 0;
+		p_field->logical_max = (int32_t)((1u << p_field->bit_size) - 1);
+	}
+}
+
+// --------------------------------------------------------------------
+static bool parse_descriptor( const uint8_t *p_desc, uint16_t desc_len, GAMEPAD_FIELDS_T *p_fields ) {
+	GLOBAL_STATE_T global, global_stack[ MAX_PUSH ];
+	LOCAL_STATE_T local;
+	uint8_t report_ids[ MAX_REPORT_IDS ];
+	uint32_t report_offsets[ MAX_REPORT_IDS ];
+	int report_id_count = 1;
+	int current = 0;
+	int push_level = 0;
+	int collection_level = 0;
+	int gamepad_collection_level = 0;		//	0: out of the gamepad collection
+	int target_report = -1;					//	Index of report_ids[] used by the program
+	int pos = 0;
+	uint32_t i, usage, bit_offset;
+
+	memset( p_fields, 0, sizeof(*p_fields) );
+	memset( &global, 0, sizeof(global) );
+	memset( &local, 0, sizeof(local) );
+	report_ids[0] = 0;
+	report_offsets[0] = 0;
+
+	while( pos < desc_len ) {
+		uint8_t prefix = p_desc[ pos ];
+		int size, type, tag;
+		const uint8_t *p_data;
+		uint32_t data;
+
+		if( prefix == ITEM_LONG ) {
+			if( pos + 1 >= desc_len ) {
+				break;
+			}
+			pos += 3 + p_desc[ pos + 1 ];
+			continue;
+		}
+		size = prefix & 3;
+		if( size == 3 ) {
+			size = 4;
+		}
+		type = (prefix >> 2) & 3;
+		tag = prefix >> 4;
+		if( pos + 1 + size > desc_len ) {
+			break;
+		}
+		p_data = &p_desc[ pos + 1 ];
+		data = get_item_data( p_data, size );
+		pos += 1 + size;
+
+		if( type == ITEM_GLOBAL ) {
+			switch( tag ) {
+			case GLOBAL_USAGE_PAGE:		global.usage_page = (uint16_t) data;							break;
+			case GLOBAL_LOGICAL_MIN:	global.logical_min = get_signed_item_data( p_data, size );	break;
+			case GLOBAL_LOGICAL_MAX:
+				//	Logical Maximum is unsigned when Logical Minimum is not negative. (e.g. 0x25 0xFF is 255)
+				global.logical_max = (global.logical_min >= 0) ? (int32_t) data : get_signed_item_data( p_data, size );
+				break;
+			case GLOBAL_REPORT_SIZE:	global.report_size = data;									break;
+			case GLOBAL_REPORT_COUNT:	global.report_count = data;									break;
+			case GLOBAL_REPORT_ID:
+				global.report_id = (uint8_t) data;
+				for( current = 0; current < report_id_count; current++ ) {
+					if( report_ids[ current ] == global.report_id ) {
+						break;
+					}
+				}
+				if( current == report_id_count ) {
+					if( report_id_count == MAX_REPORT_IDS ) {
+						return false;
+					}
+					//	The report ID byte is at the top of report.
+					report_ids[ current ] = global.report_id;
+					report_offsets[ current ] = 8;
+					report_id_count++;
+				}
+				break;
+			case GLOBAL_PUSH:
+				if( push_level < MAX_PUSH ) {
+					global_stack[ push_level++ ] = global;
+				}
+				break;
+			case GLOBAL_POP:
+				if( push_level > 0 ) {
+					global = global_stack[ --push_level ];
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		else if( type == ITEM_LOCAL ) {
+			if( size == 4 ) {
+				usage = data;
+			}
+			else {
+				usage = data & 0xFFFF;
+			}
+			switch( tag ) {
+			case LOCAL_USAGE:
+				if( local.usage_count < MAX_USAGES ) {
+					local.usage[ local.usage_count++ ] = usage;
+				}
+				break;
+			case LOCAL_USAGE_MIN:
+				local.usage_min = usage;
+				local.has_range = true;
+				break;
+			case LOCAL_USAGE_MAX:
+				local.usage_max = usage;
+				local.has_range = true;
+				break;
+			default:
+				break;
+			}
+		}
+		else if( type == ITEM_MAIN ) {
+			if( tag == MAIN_COLLECTION ) {
+				collection_level++;
+				usage = get_usage( &global, &local, 0 );
+				if( gamepad_collection_level == 0 && data == COLLECTION_APPLICATION && 
+						(usage == ((PAGE_DESKTOP << 16) | USAGE_GAMEPAD) || usage == ((PAGE_DESKTOP << 16) | USAGE_JOYSTICK)) ) {
+					gamepad_collection_level = collection_level;
+				}
+			}
+			else if( tag == MAIN_END_COLLECTION ) {
+				if( collection_level == gamepad_collection_level ) {
+					gamepad_collection_level = 0;
+				}
+				if( collection_level > 0 ) {
+					collection_level--;
+				}
+			}
+			else if( tag == MAIN_INPUT ) {
+				bit_offset = report_offsets[ current ];
+				if( gamepad_collection_level != 0 && (target_report < 0 || target_report == current) && 
+						(data & (INPUT_CONSTANT | INPUT_VARIABLE)) == INPUT_VARIABLE ) {
+					target_report = current;
+					for( i = 0; i < global.report_count; i++ ) {
+						usage = get_usage( &global, &local, i );
+						if( usage >= ((PAGE_DESKTOP << 16) | USAGE_X) && usage < ((PAGE_DESKTOP << 16) | (USAGE_X + GAMEPAD_AXES)) ) {
+							set_field( &p_fields->axis[ usage - ((PAGE_DESKTOP << 16) | USAGE_X) ], bit_offset, &global );
+						}
+						else if( usage == ((PAGE_DESKTOP << 16) | USAGE_HAT_SWITCH) ) {
+							set_field( &p_fields->hat, bit_offset, &global );
+						}
+						else if( (usage >> 16) == PAGE_BUTTON && (usage & 0xFFFF) >= 1 && (usage & 0xFFFF) <= GAMEPAD_MAP_MAX_BUTTONS && 
+								global.report_size == 1 && !(p_fields->buttons & (1u << ((usage & 0xFFFF) - 1))) ) {
+							p_fields->buttons |= 1u << ((usage & 0xFFFF) - 1);
+							p_fields->button_offset[ (usage & 0xFFFF) - 1 ] = (uint16_t) bit_offset;
+						}
+						bit_offset += global.report_size;
+					}
+				}
+				report_offsets[ current ] += global.report_size * global.report_count;
+			}
+			//	Local items are cleared by each main item.
+			memset( &local, 0, sizeof(local) );
+		}
+	}
+
+	if( target_report < 0 ) {
+		return false;
+	}
+	p_fields->report_id = report_ids[ target_report ];
+	p_fields->report_bits = report_offsets[ target_report ];
+	return true;
+}
+
+// --------------------------------------------------------------------
+//	Get the operation for a field (it is added if it is not in the program yet)
+//
+static GAMEPAD_OP_T *get_op( GAMEPAD_PROGRAM_T *p_program, uint8_t kind, uint16_t bit_offset, uint8_t bit_size, int32_t logical_min ) {
+	GAMEPAD_OP_T *p_op;
+	int i;
+
+	for( i = 0; i < p_program->op_count; i++ ) {
+		p_op = &p_program->op[ i ];
+		if( p_op->kind == kind && p_op->bit_offset == bit_offset ) {
+			return p_op;
+		}
+	}
+	if( p_program->op_count == GAMEPAD_MAP_MAX_OPS ) {
+		return NULL;
+	}
+	p_op = &p_program->op[ p_program->op_count++ ];
+	p_op->kind = kind;
+	p_op->bit_offset = bit_offset;
+	p_op->bit_size = bit_size;
+	p_op->is_signed = (logical_min < 0) ? 1 : 0;
+	return p_op;
+}
+
+// --------------------------------------------------------------------
+static bool compile_source( GAMEPAD_PROGRAM_T *p_program, const GAMEPAD_FIELDS_T *p_fields, uint8_t source, uint64_t mask ) {
+	const FIELD_T *p_field;
+	GAMEPAD_OP_T *p_op;
+	int64_t range;
+	int index;
+
+	if( source >= GAMEPAD_SRC_BUTTON( 1 ) && source <= GAMEPAD_SRC_BUTTON( GAMEPAD_MAP_MAX_BUTTONS ) ) {
+		index = source - GAMEPAD_SRC_BUTTON( 1 );
+		if( !(p_fields->buttons & (1u << index)) ) {
+			return false;
+		}
+		p_op = get_op( p_program, GAMEPAD_OP_BUTTON, p_fields->button_offset[ index ], 1, 0 );
+		if( p_op == NULL ) {
+			return false;
+		}
+		p_op->mask[0] |= mask;
+		return true;
+	}
+	if( source >= GAMEPAD_SRC_AXIS_LOW( 0 ) && source <= GAMEPAD_SRC_AXIS_HIGH( GAMEPAD_AXES - 1 ) ) {
+		p_field = &p_fields->axis[ (source - GAMEPAD_SRC_AXIS_LOW( 0 )) >> 1 ];
+		if( p_field->bit_size == 0 ) {
+			return false;
+		}
+		p_op = get_op( p_program, GAMEPAD_OP_AXIS, p_field->bit_offset, p_field->bit_size, p_field->logical_min );
+		if( p_op == NULL ) {
+			return false;
+		}
+		//	e.g. 0...255: low = 64, high = 192, -127...127: low = -64, high = 64
+		range = (int64_t) p_field->logical_max - p_field->logical_min + 1;
+		p_op->low = (int32_t)( p_field->logical_min + range / GAMEPAD_MAP_THRESHOLD );
+		p_op->high = (int32_t)( p_field->logical_min + range * (GAMEPAD_MAP_THRESHOLD - 1) / GAMEPAD_MAP_THRESHOLD );
+		p_op->mask[ source & 1 ] |= mask;
+		return true;
+	}
+	if( source >= GAMEPAD_SRC_HAT( 0 ) && source < GAMEPAD_SRC_HAT( GAMEPAD_HAT_DIRECTIONS ) ) {
+		p_field = &p_fields->hat;
+		if( p_field->bit_size == 0 ) {
+			return false;
+		}
+		p_op = get_op( p_program, GAMEPAD_OP_HAT, p_field->bit_offset, p_field->bit_size, p_field->logical_min );
+		if( p_op == NULL ) {
+			return false;
+		}
+		p_op->low = p_field->logical_min;
+		p_program->hat_mask[ source - GAMEPAD_SRC_HAT( 0 ) ] |= mask;
+		return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------
+//	Extract a field
+//		The report is long enough (min_len is checked), so the bytes are not checked here.
+//
+static inline int32_t extract_field( const uint8_t *p_report, const GAMEPAD_OP_T *p_op ) {
+	uint32_t value;
+	int index, shift, last;
+
+	index = p_op->bit_offset >> 3;
+	shift = p_op->bit_offset & 7;
+	last = (p_op->bit_offset + p_op->bit_size - 1) >> 3;
+	//	bit_size <= 24 and shift <= 7, so 4 bytes are enough.
+	value = p_report[ index ];
+	if( index + 1 <= last ) value |= (uint32_t) p_report[ index + 1 ] << 8;
+	if( index + 2 <= last ) value |= (uint32_t) p_report[ index + 2 ] << 16;
+	if( index + 3 <= last ) value |= (uint32_t) p_report[ index + 3 ] << 24;
+	value = (value >> shift) & ((1u << p_op->bit_size) - 1);
+	if( p_op->is_signed && (value & (1u << (p_op->bit_size - 1))) ) {
+		value |= ~((1u << p_op->bit_size) - 1);
+	}
+	return (int32_t) value;
+}
+
+// --------------------------------------------------------------------
+const GAMEPAD_PROFILE_T *gamepad_map_find_profile( const GAMEPAD_PROFILE_T *p_profiles, int count, uint16_t vid, uint16_t pid ) {
+	int i;
+
+	for( i = 0; i < count; i++ ) {
+		if( (p_profiles[i].vid == vid && p_profiles[i].pid == pid) || (p_profiles[i].vid == 0 && p_profiles[i].pid == 0) ) {
+			return &p_profiles[i];
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------------------------------------------
+bool gamepad_map_compile( const uint8_t *p_desc, uint16_t desc_len, const GAMEPAD_PROFILE_T *p_profile, GAMEPAD_PROGRAM_T *p_program ) {
+	GAMEPAD_FIELDS_T fields;
+	int i, j;
+	bool is_mapped = false;
+
+	memset( p_program, 0, sizeof(*p_program) );
+	if( p_profile == NULL || !parse_descriptor( p_desc, desc_len, &fields ) ) {
+		return false;
+	}
+	for( i = 0; i < GAMEPAD_MAP_BUTTONS; i++ ) {
+		for( j = 0; j < GAMEPAD_MAP_SOURCES; j++ ) {
+			if( compile_source( p_program, &fields, p_profile->source[i][j], joymega_mask[i] ) ) {
+				is_mapped = true;
+			}
+		}
+	}
+	p_program->report_id = fields.report_id;
+	p_program->min_len = (uint16_t)( (fields.report_bits + 7) >> 3 );
+	return is_mapped;
+}
+
+// --------------------------------------------------------------------
+bool gamepad_map_run( const GAMEPAD_PROGRAM_T *p_program, const uint8_t *p_report, uint16_t len, uint64_t *p_clear ) {
+	const GAMEPAD_OP_T *p_op;
+	uint64_t clear = 0;
+	uint32_t position;
+	uint8_t directions;
+	int32_t value;
+	int i;
+
+	if( len < p_program->min_len || (p_program->report_id != 0 && p_report[0] != p_program->report_id) ) {
+		return false;
+	}
+	for( i = 0; i < p_program->op_count; i++ ) {
+		p_op = &p_program->op[ i ];
+		value = extract_field( p_report, p_op );
+		switch( p_op->kind ) {
+		case GAMEPAD_OP_BUTTON:
+			clear |= p_op->mask[0] & (0 - (uint64_t)(value & 1));
+			break;
+		case GAMEPAD_OP_AXIS:
+			clear |= p_op->mask[0] & (0 - (uint64_t)(value <= p_op->low));
+			clear |= p_op->mask[1] & (0 - (uint64_t)(value >= p_op->high));
+			break;
+		default:
+			position = (uint32_t)(value - p_op->low);
+			directions = hat_directions[ (position < 8) ? position : 8 ];
+			clear |= p_program->hat_mask[ GAMEPAD_HAT_UP    ] & (0 - (uint64_t)((directions >> GAMEPAD_HAT_UP   ) & 1));
+			clear |= p_program->hat_mask[ GAMEPAD_HAT_RIGHT ] & (0 - (uint64_t)((directions >> GAMEPAD_HAT_RIGHT) & 1));
+			clear |= p_program->hat_mask[ GAMEPAD_HAT_DOWN  ] & (0 - (uint64_t)((directions >> GAMEPAD_HAT_DOWN ) & 1));
+			clear |= p_program->hat_mask[ GAMEPAD_HAT_LEFT  ] & (0 - (uint64_t)((directions >> GAMEPAD_HAT_LEFT ) & 1));
+			break;
+		}
+	}
+	*p_clear = clear;
+	return true;
+}
+
+// --------------------------------------------------------------------
+uint64_t gamepad_map_get_mask( int button ) {
+
+	if( button < 0 || button >= GAMEPAD_MAP_BUTTONS ) {
+		return 0;
+	}
+	return joymega_mask[ button ];
+}
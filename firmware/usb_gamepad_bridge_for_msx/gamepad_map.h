@@ -0,0 +1,185 @@
+// --------------------------------------------------------------------
+//	The MIT License (MIT)
+//
+//	Copyright (c) 2021-2022 HRA! (t.hara)
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//	THE SOFTWARE.
+// --------------------------------------------------------------------
+//	Gamepad mapping engine
+//		The report descriptor and a mapping profile are compiled into a short
+//		program of extraction and mask operations. Running the program on an
+//		input report gives the bits of the Joymega matrix to be cleared.
+//
+
+#ifndef __GAMEPAD_MAP_H__
+#define __GAMEPAD_MAP_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		//	Joymega matrix as one word: matrix[n] is bit (8 * n + 0) ... (8 * n + 5)
+		#define GAMEPAD_MAP_MATRIX_BIT( n, b )		(1ull << ((n) * 8 + (b)))
+
+		//	Buttons of Joymega
+		enum {
+			GAMEPAD_MAP_UP = 0,
+			GAMEPAD_MAP_DOWN,
+			GAMEPAD_MAP_LEFT,
+			GAMEPAD_MAP_RIGHT,
+			GAMEPAD_MAP_A,
+			GAMEPAD_MAP_B,
+			GAMEPAD_MAP_C,
+			GAMEPAD_MAP_X,
+			GAMEPAD_MAP_Y,
+			GAMEPAD_MAP_Z,
+			GAMEPAD_MAP_START,
+			GAMEPAD_MAP_MODE,
+			GAMEPAD_MAP_BUTTONS,
+		};
+
+		//	Axes (Generic Desktop X, Y, Z, Rx, Ry, Rz)
+		enum {
+			GAMEPAD_AXIS_X = 0,
+			GAMEPAD_AXIS_Y,
+			GAMEPAD_AXIS_Z,
+			GAMEPAD_AXIS_RX,
+			GAMEPAD_AXIS_RY,
+			GAMEPAD_AXIS_RZ,
+			GAMEPAD_AXES,
+		};
+
+		//	Directions of the hat switch
+		enum {
+			GAMEPAD_HAT_UP = 0,
+			GAMEPAD_HAT_RIGHT,
+			GAMEPAD_HAT_DOWN,
+			GAMEPAD_HAT_LEFT,
+			GAMEPAD_HAT_DIRECTIONS,
+		};
+
+		//	Sources of a Joymega button in the profile
+		#define GAMEPAD_SRC_NONE					0x00
+		#define GAMEPAD_SRC_BUTTON( n )				(n)							//	HID button 1 ... 32
+		#define GAMEPAD_SRC_AXIS_LOW( a )			(0x40 | ((a) << 1))			//	The axis is tilted to the minimum
+		#define GAMEPAD_SRC_AXIS_HIGH( a )			(0x41 | ((a) << 1))			//	The axis is tilted to the maximum
+		#define GAMEPAD_SRC_HAT( d )				(0x60 | (d))
+
+		#define GAMEPAD_MAP_SOURCES					2		//	Sources per Joymega button
+		#define GAMEPAD_MAP_MAX_BUTTONS				32
+		#define GAMEPAD_MAP_MAX_OPS					16
+
+		//	The axis is tilted when it is within 1/GAMEPAD_MAP_THRESHOLD of its range from the end.
+		#define GAMEPAD_MAP_THRESHOLD				4
+
+		//	Mapping profile
+		//		They are const tables in flash.
+		typedef struct {
+			uint16_t	vid;
+			uint16_t	pid;
+			uint8_t		source[ GAMEPAD_MAP_BUTTONS ][ GAMEPAD_MAP_SOURCES ];	//	GAMEPAD_SRC_xxx
+		} GAMEPAD_PROFILE_T;
+
+		enum {
+			GAMEPAD_OP_BUTTON = 0,
+			GAMEPAD_OP_AXIS,
+			GAMEPAD_OP_HAT,
+		};
+
+		//	One operation of the program (32 bytes)
+		typedef struct {
+			uint16_t	bit_offset;		//	Bit offset from the top of report (includes the report ID byte)
+			uint8_t		bit_size;		//	1 ... 24
+			uint8_t		kind;			//	GAMEPAD_OP_xxx
+			uint8_t		is_signed;		//	1: Logical Minimum is negative
+			uint8_t		reserved[3];
+			int32_t		low;			//	AXIS: tilted to the minimum at or below this, HAT: logical minimum
+			int32_t		high;			//	AXIS: tilted to the maximum at or above this
+			uint64_t	mask[2];		//	Bits to clear. BUTTON: [0] pressed, AXIS: [0] low, [1] high
+		} GAMEPAD_OP_T;
+
+		//	Compiled program
+		typedef struct {
+			uint8_t			report_id;		//	0: The report has no report ID
+			uint8_t			op_count;
+			uint16_t		min_len;		//	Reports shorter than this are ignored.
+			uint8_t			reserved[4];
+			uint64_t		hat_mask[ GAMEPAD_HAT_DIRECTIONS ];
+			GAMEPAD_OP_T	op[ GAMEPAD_MAP_MAX_OPS ];
+		} GAMEPAD_PROGRAM_T;
+
+		// --------------------------------------------------------------------
+		//	Find the profile of a device
+		//	input:
+		//		p_profiles ...... Profile table
+		//		count ........... Number of entries of p_profiles
+		//		vid, pid ........ VID/PID of the device
+		//	output:
+		//		The first entry which matches the device. NULL if there is no entry.
+		//	comment:
+		//		vid = 0 and pid = 0 matches any device, so such an entry should be the last.
+		// --------------------------------------------------------------------
+		const GAMEPAD_PROFILE_T *gamepad_map_find_profile( const GAMEPAD_PROFILE_T *p_profiles, int count, uint16_t vid, uint16_t pid );
+
+		// --------------------------------------------------------------------
+		//	Compile the report descriptor and the profile
+		//	input:
+		//		p_desc .......... Report descriptor
+		//		desc_len ........ Size of p_desc
+		//		p_profile ....... Mapping profile
+		//		p_program ....... Address of buffer to return the program.
+		//	output:
+		//		true ............ Success.
+		//		false ........... It is not a gamepad, or no source of the profile is in the report.
+		//	comment:
+		//		The first report which has an input in a Gamepad (or Joystick) collection is used.
+		// --------------------------------------------------------------------
+		bool gamepad_map_compile( const uint8_t *p_desc, uint16_t desc_len, const GAMEPAD_PROFILE_T *p_profile, GAMEPAD_PROGRAM_T *p_program );
+
+		// --------------------------------------------------------------------
+		//	Run the program
+		//	input:
+		//		p_program ....... Program
+		//		p_report ........ Input report (includes the report ID byte)
+		//		len ............. Size of p_report
+		//		p_clear ......... Address of buffer to return the bits of the Joymega matrix to clear.
+		//	output:
+		//		true ............ Success.
+		//		false ........... The report is not for this program (report ID), or it is too short.
+		//	comment:
+		//		The cost is bounded by GAMEPAD_MAP_MAX_OPS, and there is no branch for the
+		//		button state.
+		// --------------------------------------------------------------------
+		bool gamepad_map_run( const GAMEPAD_PROGRAM_T *p_program, const uint8_t *p_report, uint16_t len, uint64_t *p_clear );
+
+		// --------------------------------------------------------------------
+		//	Get the bits of the Joymega matrix for a button
+		//	input:
+		//		button .......... GAMEPAD_MAP_xxx
+		//	output:
+		//		The bits which are cleared while the button is pressed.
+		// --------------------------------------------------------------------
+		uint64_t gamepad_map_get_mask( int button );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,433 @@
+// --------------------------------------------------------------------
+//	Host build of usb_gamepad_bridge_for_msx.c
+//		The bridge is included here, so the test can reach its static
+//		functions through bridge_host.h. The stubs of GPIO, PIO, the timer,
+//		the alarm and TinyUSB are also here.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include "bridge_host.h"
+#include "pio_model.h"
+
+//	The debug messages of the bridge are printed only with BRIDGE_HOST_VERBOSE=1
+static int host_printf( const char *p_format, ... );
+#define printf	host_printf
+#define main	bridge_main
+
+//	The tests use both ports
+#define MSX_PORTS	BRIDGE_HOST_PORTS
+
+#include "../usb_gamepad_bridge_for_msx.c"
+
+#undef printf
+#undef main
+
+volatile uint64_t host_time_us = 1000000;
+
+//	Clock model of core1 (only while bridge_host_run_core1() runs)
+static BRIDGE_HOST_ELAPSE_T p_core1_elapse = NULL;
+
+// --------------------------------------------------------------------
+static void take_clocks( uint32_t clocks ) {
+	BRIDGE_HOST_ELAPSE_T p_elapse = p_core1_elapse;
+
+	if( p_elapse != NULL ) {
+		//	The callbacks of core0 in p_elapse do not take the clocks of core1
+		p_core1_elapse = NULL;
+		p_elapse( clocks );
+		p_core1_elapse = p_elapse;
+	}
+}
+
+// --------------------------------------------------------------------
+static int host_printf( const char *p_format, ... ) {
+	static int verbose = -1;
+	va_list args;
+	int result;
+
+	if( verbose < 0 ) {
+		verbose = (getenv( "BRIDGE_HOST_VERBOSE" ) != NULL);
+	}
+	if( !verbose ) {
+		return 0;
+	}
+	va_start( args, p_format );
+	result = vprintf( p_format, args );
+	va_end( args );
+	return result;
+}
+
+// --------------------------------------------------------------------
+//	GPIO
+static volatile uint32_t gpio_in_level = 0xFFFFFFFFu;		//	Pulled up
+static volatile uint32_t gpio_out_level = 0;
+static volatile uint32_t gpio_invert = 0;
+static volatile uint32_t gpio_pio_function = 0;			//	bit n: GPIOn is given to PIO
+
+void gpio_init( uint gpio ) {
+	(void) gpio;
+}
+
+void gpio_set_dir( uint gpio, bool out ) {
+	(void) gpio;
+	(void) out;
+}
+
+void gpio_pull_up( uint gpio ) {
+	(void) gpio;
+}
+
+void gpio_set_function( uint gpio, enum gpio_function fn ) {
+	if( fn == GPIO_FUNC_PIO0 ) {
+		gpio_pio_function |= 1u << gpio;
+	}
+	else {
+		gpio_pio_function &= ~(1u << gpio);
+	}
+}
+
+void gpio_set_inover( uint gpio, uint value ) {
+	if( value == GPIO_OVERRIDE_INVERT ) {
+		gpio_invert |= 1u << gpio;
+	}
+	else {
+		gpio_invert &= ~(1u << gpio);
+	}
+}
+
+static bool get_input( uint gpio ) {
+	return( ((gpio_in_level ^ gpio_invert) >> gpio) & 1 );
+}
+
+bool gpio_get( uint gpio ) {
+	take_clocks( BRIDGE_HOST_CLOCKS_GPIO_GET );
+	return get_input( gpio );
+}
+
+void gpio_put_masked( uint32_t mask, uint32_t value ) {
+	take_clocks( BRIDGE_HOST_CLOCKS_GPIO_PUT_MASKED );
+	gpio_out_level = (gpio_out_level & ~mask) | (value & mask);
+}
+
+// --------------------------------------------------------------------
+//	PIO
+//		The state machines run on pio_model when joymega.pio is loaded.
+//		The last data put into TX FIFO is kept in any case.
+#define PIO_SMS		4
+
+pio_hw_t host_pio0;
+static int pio_sm_count = 0;
+static PIO_MODEL_T joymega_model;
+static bool is_joymega_model_loaded = false;
+
+static struct {
+	PIO_MODEL_T			model;
+	bool				is_enabled;
+	uint				out_base;
+	uint				sel_pin;
+	volatile uint32_t	last_data;
+} pio_sm[ PIO_SMS ];
+
+uint pio_add_program( PIO pio, const pio_program_t *p_program ) {
+	(void) pio;
+	(void) p_program;
+	return 0;
+}
+
+int pio_claim_unused_sm( PIO pio, bool required ) {
+	(void) pio;
+	(void) required;
+	return pio_sm_count++;
+}
+
+void pio_gpio_init( PIO pio, uint pin ) {
+	(void) pio;
+	gpio_pio_function |= 1u << pin;
+}
+
+void pio_sm_set_enabled( PIO pio, uint sm, bool enabled ) {
+	(void) pio;
+	pio_sm[ sm % PIO_SMS ].is_enabled = enabled;
+}
+
+void pio_sm_put( PIO pio, uint sm, uint32_t data ) {
+	(void) pio;
+	pio_sm[ sm % PIO_SMS ].last_data = data;
+	if( is_joymega_model_loaded ) {
+		pio_model_put( &pio_sm[ sm % PIO_SMS ].model, data );
+	}
+}
+
+bool pio_sm_is_tx_fifo_full( PIO pio, uint sm ) {
+	(void) pio;
+	return( is_joymega_model_loaded && pio_sm[ sm % PIO_SMS ].model.fifo_count >= PIO_MODEL_FIFO );
+}
+
+// --------------------------------------------------------------------
+//	joymega_program_init() and joymega_program_start() (stub/joymega.pio.h)
+//
+void host_joymega_program_init( PIO pio, uint sm, uint out_base, uint sel_pin ) {
+	(void) pio;
+	sm %= PIO_SMS;
+	pio_sm[ sm ].model = joymega_model;
+	pio_sm[ sm ].model.out_count = 6;
+	pio_sm[ sm ].model.pull_threshold = 6;
+	pio_sm[ sm ].out_base = out_base;
+	pio_sm[ sm ].sel_pin = sel_pin;
+	pio_sm[ sm ].is_enabled = false;
+}
+
+void host_joymega_program_start( PIO pio, uint sm, uint32_t timeout_count, uint32_t packed_matrix ) {
+	(void) pio;
+	sm %= PIO_SMS;
+	if( is_joymega_model_loaded ) {
+		pio_model_restart( &pio_sm[ sm ].model, pio_model_label( &joymega_model, "idle" ), get_input( pio_sm[ sm ].sel_pin ) );
+		pio_sm[ sm ].model.isr = timeout_count;
+		pio_sm[ sm ].model.x = packed_matrix;
+	}
+	pio_sm[ sm ].last_data = packed_matrix;
+	pio_sm[ sm ].is_enabled = true;
+}
+
+// --------------------------------------------------------------------
+bool bridge_host_load_pio( const char *p_path ) {
+
+	is_joymega_model_loaded = pio_model_load( &joymega_model, p_path, "joymega" ) && pio_model_label( &joymega_model, "idle" ) >= 0;
+	return is_joymega_model_loaded;
+}
+
+// --------------------------------------------------------------------
+void bridge_host_step_pio( void ) {
+	int sm;
+
+	if( !is_joymega_model_loaded ) {
+		return;
+	}
+	for( sm = 0; sm < pio_sm_count && sm < PIO_SMS; sm++ ) {
+		if( pio_sm[ sm ].is_enabled ) {
+			pio_model_step( &pio_sm[ sm ].model, get_input( pio_sm[ sm ].sel_pin ) );
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Timer
+uint32_t time_us_32( void ) {
+	take_clocks( BRIDGE_HOST_CLOCKS_TIME_US_32 );
+	return (uint32_t) host_time_us;
+}
+
+uint64_t time_us_64( void ) {
+	take_clocks( BRIDGE_HOST_CLOCKS_TIME_US_64 );
+	return host_time_us;
+}
+
+absolute_time_t get_absolute_time( void ) {
+	return time_us_64();
+}
+
+// --------------------------------------------------------------------
+//	Hardware alarm (one)
+static hardware_alarm_callback_t p_alarm_callback = NULL;
+static bool is_alarm_armed = false;
+static uint64_t alarm_target = 0;
+
+int hardware_alarm_claim_unused( bool required ) {
+	(void) required;
+	return 0;
+}
+
+void hardware_alarm_set_callback( uint alarm_num, hardware_alarm_callback_t callback ) {
+	(void) alarm_num;
+	p_alarm_callback = callback;
+}
+
+bool hardware_alarm_set_target( uint alarm_num, absolute_time_t target ) {
+	(void) alarm_num;
+	if( target <= host_time_us ) {
+		//	Missed (the same as the SDK)
+		return true;
+	}
+	alarm_target = target;
+	is_alarm_armed = true;
+	return false;
+}
+
+void hardware_alarm_cancel( uint alarm_num ) {
+	(void) alarm_num;
+	is_alarm_armed = false;
+}
+
+// --------------------------------------------------------------------
+void host_advance_us( uint64_t us ) {
+	uint64_t end = host_time_us + us;
+
+	while( is_alarm_armed && alarm_target <= end ) {
+		host_time_us = alarm_target;
+		is_alarm_armed = false;
+		if( p_alarm_callback != NULL ) {
+			p_alarm_callback( 0 );
+		}
+	}
+	host_time_us = end;
+}
+
+// --------------------------------------------------------------------
+//	TinyUSB
+#define HOST_DEVICES	8
+
+static struct {
+	uint8_t		dev_addr;
+	uint8_t		instance;
+	uint8_t		protocol;
+	uint16_t	vid;
+	uint16_t	pid;
+} host_device[ HOST_DEVICES ];
+
+static int find_device( uint8_t dev_addr, uint8_t instance ) {
+	int i;
+
+	for( i = 0; i < HOST_DEVICES; i++ ) {
+		if( host_device[i].dev_addr == dev_addr && host_device[i].instance == instance ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+uint8_t tuh_hid_interface_protocol( uint8_t dev_addr, uint8_t instance ) {
+	int i = find_device( dev_addr, instance );
+
+	return (i < 0) ? HID_ITF_PROTOCOL_NONE : host_device[i].protocol;
+}
+
+bool tuh_hid_receive_report( uint8_t dev_addr, uint8_t instance ) {
+	(void) dev_addr;
+	(void) instance;
+	return true;
+}
+
+bool tuh_vid_pid_get( uint8_t dev_addr, uint16_t *p_vid, uint16_t *p_pid ) {
+	int i;
+
+	for( i = 0; i < HOST_DEVICES; i++ ) {
+		if( host_device[i].dev_addr == dev_addr ) {
+			*p_vid = host_device[i].vid;
+			*p_pid = host_device[i].pid;
+			return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------
+void bridge_host_init( void ) {
+	int port;
+
+	memset( host_device, 0, sizeof(host_device) );
+	gpio_in_level = 0xFFFFFFFFu;
+	gpio_out_level = 0;
+	gpio_invert = 0;
+	gpio_pio_function = 0;
+	pio_sm_count = 0;
+	is_alarm_armed = false;
+
+	port_init();
+	joymega_pio_init();
+	autofire_init();
+	//	SEL=L (idle) at the start
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		bridge_host_set_sel( port, false );
+	}
+}
+
+// --------------------------------------------------------------------
+void bridge_host_mount( uint8_t dev_addr, uint8_t instance, uint8_t protocol, uint16_t vid, uint16_t pid, const uint8_t *p_desc, uint16_t desc_len ) {
+	int i = find_device( 0, 0 );
+
+	if( i >= 0 ) {
+		host_device[i].dev_addr = dev_addr;
+		host_device[i].instance = instance;
+		host_device[i].protocol = protocol;
+		host_device[i].vid = vid;
+		host_device[i].pid = pid;
+	}
+	tuh_hid_mount_cb( dev_addr, instance, p_desc, desc_len );
+}
+
+// --------------------------------------------------------------------
+void bridge_host_report( uint8_t dev_addr, uint8_t instance, const uint8_t *p_report, uint16_t len ) {
+
+	tuh_hid_report_received_cb( dev_addr, instance, p_report, len );
+}
+
+// --------------------------------------------------------------------
+void bridge_host_umount( uint8_t dev_addr, uint8_t instance ) {
+	int i = find_device( dev_addr, instance );
+
+	tuh_hid_umount_cb( dev_addr, instance );
+	if( i >= 0 ) {
+		memset( &host_device[i], 0, sizeof(host_device[i]) );
+	}
+}
+
+// --------------------------------------------------------------------
+bool bridge_host_poll( int port ) {
+
+	if( msx_port[ port ].process_mode == 0 ) {
+		return false;
+	}
+	mouse_mode( &msx_port[ port ], gpio_get( msx_port[ port ].sel_pin ), time_us_32() );
+	return true;
+}
+
+// --------------------------------------------------------------------
+void bridge_host_run_core1( BRIDGE_HOST_ELAPSE_T p_elapse ) {
+
+	p_elapse( BRIDGE_HOST_CLOCKS_LOOP );
+	p_core1_elapse = p_elapse;
+	response_task();
+	p_core1_elapse = NULL;
+}
+
+// --------------------------------------------------------------------
+void bridge_host_set_sel( int port, bool level ) {
+	uint32_t bit = 1u << msx_sel_pin[ port ];
+
+	//	MSX_SEL_LOGIC 1: SEL=H is LOW at the pin
+	if( MSX_SEL_LOGIC != 0 ) {
+		level = !level;
+	}
+	gpio_in_level = level ? (gpio_in_level | bit) : (gpio_in_level & ~bit);
+}
+
+// --------------------------------------------------------------------
+uint8_t bridge_host_get_pins( int port ) {
+	uint32_t level = gpio_out_level;
+	uint pin;
+	int sm;
+
+	for( sm = 0; sm < pio_sm_count && sm < PIO_SMS && is_joymega_model_loaded; sm++ ) {
+		for( pin = pio_sm[ sm ].out_base; pin < pio_sm[ sm ].out_base + 6; pin++ ) {
+			if( (gpio_pio_function >> pin) & 1 ) {
+				level = (level & ~(1u << pin)) | (((pio_sm[ sm ].model.pins >> (pin - pio_sm[ sm ].out_base)) & 1) << pin);
+			}
+		}
+	}
+	return (uint8_t)( (level >> msx_button_pin[ port ]) & 0x3F );
+}
+
+// --------------------------------------------------------------------
+uint32_t bridge_host_get_packed_matrix( int port ) {
+
+	return pio_sm[ msx_port[ port ].joymega_sm % PIO_SMS ].last_data;
+}
+
+// --------------------------------------------------------------------
+void bridge_host_get_mouse_words( int port, uint32_t *p_published, uint32_t *p_sent ) {
+
+	*p_published = msx_port[ port ].mouse_published;
+	*p_sent = msx_port[ port ].mouse_sent;
+}
@@ -0,0 +1,142 @@
+// --------------------------------------------------------------------
+//	Host build of usb_gamepad_bridge_for_msx.c
+//		The bridge is compiled with the stubs in stub/. The test calls the
+//		TinyUSB callbacks as core0, and bridge_host_poll() or
+//		bridge_host_run_core1() as core1. The GPIO levels are kept in the
+//		variables, and the time is host_time_us advanced by the test.
+//		With bridge_host_load_pio(), the joymega state machines run on
+//		pio_model one system clock at a time (bridge_host_step_pio()).
+// --------------------------------------------------------------------
+
+#ifndef __BRIDGE_HOST_H__
+#define __BRIDGE_HOST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BRIDGE_HOST_PORTS		2
+#define BRIDGE_HOST_CLOCK_HZ	125000000u		//	clk_sys
+
+extern volatile uint64_t host_time_us;
+
+// --------------------------------------------------------------------
+//	Advance the time, and fire the hardware alarm when it comes
+//	input:
+//		us .............. [usec]
+//	output:
+//		none
+// --------------------------------------------------------------------
+void host_advance_us( uint64_t us );
+
+// --------------------------------------------------------------------
+//	Initialize the bridge (the same as initialization() without TinyUSB)
+//	input:
+//		none
+//	output:
+//		none
+// --------------------------------------------------------------------
+void bridge_host_init( void );
+
+// --------------------------------------------------------------------
+//	Connect a HID interface (tuh_hid_mount_cb)
+//	input:
+//		dev_addr, instance ... Device
+//		protocol ............. HID_ITF_PROTOCOL_NONE (gamepad) or HID_ITF_PROTOCOL_MOUSE
+//		vid, pid ............. VID/PID
+//		p_desc, desc_len ..... Report descriptor
+//	output:
+//		none
+// --------------------------------------------------------------------
+void bridge_host_mount( uint8_t dev_addr, uint8_t instance, uint8_t protocol, uint16_t vid, uint16_t pid, const uint8_t *p_desc, uint16_t desc_len );
+
+// --------------------------------------------------------------------
+//	Receive a report (tuh_hid_report_received_cb), and disconnect (tuh_hid_umount_cb)
+// --------------------------------------------------------------------
+void bridge_host_report( uint8_t dev_addr, uint8_t instance, const uint8_t *p_report, uint16_t len );
+void bridge_host_umount( uint8_t dev_addr, uint8_t instance );
+
+// --------------------------------------------------------------------
+//	Run one poll of core1 for the port (mouse_mode, if the port is in mouse_mode)
+//	input:
+//		port ............ 0 or 1
+//	output:
+//		true ..... mouse_mode was called
+//		false .... The port is in joypad_mode (PIO answers)
+// --------------------------------------------------------------------
+bool bridge_host_poll( int port );
+
+// --------------------------------------------------------------------
+//	Run joymega.pio on pio_model (call before bridge_host_init())
+//	input:
+//		p_path .......... path of joymega.pio
+//	output:
+//		true ..... Success
+//		false .... It cannot be loaded
+// --------------------------------------------------------------------
+bool bridge_host_load_pio( const char *p_path );
+
+// --------------------------------------------------------------------
+//	Run one system clock of the enabled state machines
+// --------------------------------------------------------------------
+void bridge_host_step_pio( void );
+
+// --------------------------------------------------------------------
+//	Run one pass of the loop of core1 (response_task) with the clock model
+//	input:
+//		p_elapse ........ Called with the clocks taken by core1. It advances
+//		                  the time, PIO and MSX by them.
+//	output:
+//		none
+//	comment:
+//		The clocks are the estimates for RP2040 at 125MHz with the code in
+//		the XIP cache. gpio_get, gpio_put_masked, time_us_32, time_us_64 and
+//		get_absolute_time take their clocks when they are called, and the
+//		clocks include the code which uses them (a check of SEL in mouse_mode,
+//		a change of the state, a pass of a loop). A pass of response_task
+//		takes BRIDGE_HOST_CLOCKS_LOOP more. p_elapse is not called again while
+//		it runs, so it may call the TinyUSB callbacks as core0.
+// --------------------------------------------------------------------
+typedef void (*BRIDGE_HOST_ELAPSE_T)( uint32_t clocks );
+
+#define BRIDGE_HOST_CLOCKS_LOOP				8		//	Call of response_task
+#define BRIDGE_HOST_CLOCKS_GPIO_GET			15		//	SIO read and the check of SEL
+#define BRIDGE_HOST_CLOCKS_GPIO_PUT_MASKED	25		//	SIO write and the change of the state
+#define BRIDGE_HOST_CLOCKS_TIME_US_32		12		//	TIMERAWL read and a pass of a loop
+#define BRIDGE_HOST_CLOCKS_TIME_US_64		24		//	Call of the SDK (TIMERAWH, TIMERAWL, TIMERAWH)
+
+void bridge_host_run_core1( BRIDGE_HOST_ELAPSE_T p_elapse );
+
+// --------------------------------------------------------------------
+//	SEL and the button pins of the port
+//		level of SEL is seen from MSX (true: H). The level at the pin is
+//		inverted when MSX_SEL_LOGIC is 1.
+//		The pins are bit0-5 from MSX_BUTTON_PIN: TRG B, TRG A, RIGHT, LEFT, DOWN, UP.
+//		They are the output of the state machine while the pins are given to PIO.
+// --------------------------------------------------------------------
+void bridge_host_set_sel( int port, bool level );
+uint8_t bridge_host_get_pins( int port );
+
+// --------------------------------------------------------------------
+//	The last matrix put into TX FIFO of the joymega state machine of the port
+//		The format is pack_joymega_matrix().
+// --------------------------------------------------------------------
+uint32_t bridge_host_get_packed_matrix( int port );
+
+// --------------------------------------------------------------------
+//	The words of the mouse handoff of the port
+//	input:
+//		port ............ 0 or 1
+//		p_published ..... mouse_published (core0)
+//		p_sent .......... mouse_sent (core1)
+// --------------------------------------------------------------------
+void bridge_host_get_mouse_words( int port, uint32_t *p_published, uint32_t *p_sent );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+// --------------------------------------------------------------------
+//	Host test of the mouse handoff of the bridge (conservation model)
+//		core0 (USB reports) publishes the total of the movement, and core1
+//		(mouse_mode) sends the backlog to MSX. Whatever the interleaving is,
+//		the movement read by MSX plus the backlog left in the words must be
+//		the movement of the reports (unless the backlog reaches its limit,
+//		which clips the oldest movement).
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "bridge_host.h"
+
+#define MOUSE_PORT				0
+#define MOUSE_DEV_ADDR			1
+#define MOUSE_INSTANCE			0
+#define MOUSE_PROTOCOL			2			//	HID_ITF_PROTOCOL_MOUSE
+#define MOUSE_BUTTON_MIDDLE		4
+#define BACKLOG_LIMIT			1023		//	MOUSE_BACKLOG_LIMIT
+#define READ_INTERVAL_US		30			//	SEL edge to the read of the pins
+#define TRANSFER_TIMEOUT_US		600			//	Longer than MOUSE_TIMEOUT_US
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Backlog of the axis (0: X, 1: Y) in the words, and the resolution
+//
+static int get_backlog( int axis ) {
+	uint32_t published, sent;
+	int shift = axis * 12;
+
+	bridge_host_get_mouse_words( MOUSE_PORT, &published, &sent );
+	return (int)((((published >> shift) - (sent >> shift)) & 0xFFF) ^ 0x800) - 0x800;
+}
+
+static int get_resolution( void ) {
+	uint32_t published, sent;
+
+	bridge_host_get_mouse_words( MOUSE_PORT, &published, &sent );
+	return (int)((published >> 26) & 3);
+}
+
+// --------------------------------------------------------------------
+static void send_report( uint8_t buttons, int8_t x, int8_t y ) {
+	uint8_t report[5] = { buttons, (uint8_t) x, (uint8_t) y, 0, 0 };
+
+	bridge_host_report( MOUSE_DEV_ADDR, MOUSE_INSTANCE, report, sizeof(report) );
+}
+
+// --------------------------------------------------------------------
+//	Nibble on the pins: D0 = UP (bit5), D1 = DOWN (bit4), D2 = LEFT (bit3), D3 = RIGHT (bit2)
+//
+static int get_nibble( uint8_t pins ) {
+
+	return ((pins >> 5) & 1) | (((pins >> 4) & 1) << 1) | (((pins >> 3) & 1) << 2) | (((pins >> 2) & 1) << 3);
+}
+
+// --------------------------------------------------------------------
+//	Read the mouse like MSX: 4 nibbles at SEL=H, L, H, L. SEL stays L and
+//	mouse_mode goes back to idle by its timeout.
+//
+static void msx_read_mouse( int *p_x, int *p_y ) {
+	int nibble[4], i;
+
+	for( i = 0; i < 4; i++ ) {
+		bridge_host_set_sel( MOUSE_PORT, (i & 1) == 0 );
+		bridge_host_poll( MOUSE_PORT );
+		host_advance_us( READ_INTERVAL_US );
+		bridge_host_poll( MOUSE_PORT );
+		nibble[i] = get_nibble( bridge_host_get_pins( MOUSE_PORT ) );
+	}
+	*p_x = (int8_t)((nibble[0] << 4) | nibble[1]);
+	*p_y = (int8_t)((nibble[2] << 4) | nibble[3]);
+	host_advance_us( TRANSFER_TIMEOUT_US );
+	bridge_host_poll( MOUSE_PORT );
+	bridge_host_poll( MOUSE_PORT );
+}
+
+// --------------------------------------------------------------------
+static void mount_mouse( void ) {
+
+	bridge_host_init();
+	bridge_host_mount( MOUSE_DEV_ADDR, MOUSE_INSTANCE, MOUSE_PROTOCOL, 0x046D, 0xC077, NULL, 0 );
+	bridge_host_poll( MOUSE_PORT );
+}
+
+// --------------------------------------------------------------------
+//	Random reports, MSX reads and resolution changes in one thread.
+//	The movement read by MSX is scaled by the resolution of the transfer.
+//
+static void test_random_interleave( void ) {
+	static const int shift_x[] = { 0, 0, 1, 1 };
+	static const int shift_y[] = { 0, 1, 1, 2 };
+	long expected_x = 0, expected_y = 0, read_x = 0, read_y = 0;
+	int step, x, y, resolution, buttons = 0, idle_reads;
+
+	srand( 12345 );
+	mount_mouse();
+	for( step = 0; step < 200000; step++ ) {
+		if( (rand() % 4) != 3 && abs( get_backlog( 0 ) ) < 800 && abs( get_backlog( 1 ) ) < 800 ) {
+			x = (rand() % 121) - 60;
+			y = (rand() % 121) - 60;
+			//	The middle button changes the resolution
+			buttons = ((rand() % 200) == 0) ? MOUSE_BUTTON_MIDDLE : 0;
+			send_report( (uint8_t) buttons, (int8_t) x, (int8_t) y );
+			expected_x -= x;
+			expected_y -= y;
+		}
+		else {
+			resolution = get_resolution();
+			msx_read_mouse( &x, &y );
+			read_x += (long) x * (1 << shift_x[ resolution ]);
+			read_y += (long) y * (1 << shift_y[ resolution ]);
+		}
+		CHECK( abs( get_backlog( 0 ) ) <= BACKLOG_LIMIT && abs( get_backlog( 1 ) ) <= BACKLOG_LIMIT );
+		CHECK( read_x + get_backlog( 0 ) == expected_x && read_y + get_backlog( 1 ) == expected_y );
+		if( error_count > 10 ) {
+			return;
+		}
+	}
+
+	//	Drain: only the bits under the resolution are left
+	for( idle_reads = 0; idle_reads < 100; idle_reads++ ) {
+		resolution = get_resolution();
+		msx_read_mouse( &x, &y );
+		read_x += (long) x * (1 << shift_x[ resolution ]);
+		read_y += (long) y * (1 << shift_y[ resolution ]);
+	}
+	resolution = get_resolution();
+	CHECK( abs( get_backlog( 0 ) ) < (1 << shift_x[ resolution ]) );
+	CHECK( abs( get_backlog( 1 ) ) < (1 << shift_y[ resolution ]) );
+	CHECK( read_x + get_backlog( 0 ) == expected_x && read_y + get_backlog( 1 ) == expected_y );
+	printf( "random interleave: moved (%ld, %ld), read (%ld, %ld)\n", expected_x, expected_y, read_x, read_y );
+}
+
+// --------------------------------------------------------------------
+//	Without the reads of MSX, the backlog stops at MOUSE_BACKLOG_LIMIT.
+//	A new mouse does not take over the backlog of the old one.
+//
+static void test_backlog_limit( void ) {
+	long read_x = 0;
+	int i, x, y;
+
+	mount_mouse();
+	for( i = 0; i < 50; i++ ) {
+		send_report( 0, 100, -100 );
+	}
+	CHECK( get_backlog( 0 ) == -BACKLOG_LIMIT );
+	CHECK( get_backlog( 1 ) == BACKLOG_LIMIT );
+	for( i = 0; i < 20; i++ ) {
+		msx_read_mouse( &x, &y );
+		CHECK( x >= -127 && x <= 127 && y >= -127 && y <= 127 );
+		read_x += x;
+	}
+	CHECK( read_x == -BACKLOG_LIMIT );
+	CHECK( get_backlog( 0 ) == 0 && get_backlog( 1 ) == 0 );
+
+	for( i = 0; i < 5; i++ ) {
+		send_report( 0, 50, 50 );
+	}
+	bridge_host_umount( MOUSE_DEV_ADDR, MOUSE_INSTANCE );
+	bridge_host_mount( MOUSE_DEV_ADDR, MOUSE_INSTANCE, MOUSE_PROTOCOL, 0x046D, 0xC077, NULL, 0 );
+	CHECK( get_backlog( 0 ) == 0 && get_backlog( 1 ) == 0 );
+}
+
+// --------------------------------------------------------------------
+//	core0 and core1 as two threads. The time is advanced only by core1,
+//	so the transfers never time out in the middle.
+//
+#define THREAD_REPORTS		200000
+#define THREAD_TRANSFERS	10000000	//	Give up (the backlog is not drained)
+
+static volatile bool is_core0_done = false;
+static volatile bool is_core1_done = false;
+static long thread_expected_x = 0;
+static long thread_expected_y = 0;
+
+static void *core0_thread( void *p_arg ) {
+	int i, x, y;
+
+	(void) p_arg;
+	srand( 777 );
+	for( i = 0; i < THREAD_REPORTS; i++ ) {
+		//	Keep the backlog under the limit (the test does not want the clipping)
+		while( (abs( get_backlog( 0 ) ) > 800 || abs( get_backlog( 1 ) ) > 800) && !is_core1_done ) {
+			sched_yield();
+		}
+		x = (rand() % 61) - 30;
+		y = (rand() % 61) - 30;
+		send_report( 0, (int8_t) x, (int8_t) y );
+		thread_expected_x -= x;
+		thread_expected_y -= y;
+	}
+	__sync_synchronize();
+	is_core0_done = true;
+	return NULL;
+}
+
+static void test_two_cores( void ) {
+	pthread_t thread;
+	long read_x = 0, read_y = 0, transfers = 0;
+	int x, y, zero_reads = 0;
+
+	mount_mouse();
+	is_core0_done = false;
+	is_core1_done = false;
+	pthread_create( &thread, NULL, core0_thread, NULL );
+	while( zero_reads < 3 && transfers < THREAD_TRANSFERS ) {
+		msx_read_mouse( &x, &y );
+		CHECK( x >= -127 && x <= 127 && y >= -127 && y <= 127 );
+		read_x += x;
+		read_y += y;
+		transfers++;
+		if( is_core0_done && x == 0 && y == 0 ) {
+			zero_reads++;
+		}
+	}
+	is_core1_done = true;
+	pthread_join( thread, NULL );
+	CHECK( transfers < THREAD_TRANSFERS );
+	CHECK( read_x == thread_expected_x && read_y == thread_expected_y );
+	printf( "two cores: %d reports, %ld transfers, moved (%ld, %ld), read (%ld, %ld)\n", THREAD_REPORTS, transfers,
+		thread_expected_x, thread_expected_y, read_x, read_y );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	test_random_interleave();
+	test_backlog_limit();
+	test_two_cores();
+
+	if( error_count ) {
+		printf( "bridge_mouse_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "bridge_mouse_test: OK\n" );
+	return 0;
+}
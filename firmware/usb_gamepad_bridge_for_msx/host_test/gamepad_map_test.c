@@ -0,0 +1,240 @@
+// --------------------------------------------------------------------
+//	Host test of gamepad_map.c
+//		The report descriptors of the common gamepad layouts are mounted on
+//		the bridge with the default profile, and the reports are checked
+//		against the Joymega matrix put into TX FIFO of the PIO.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "bridge_host.h"
+#include "gamepad_map.h"
+
+#define PAD_PORT				0
+#define PAD_DEV_ADDR			1
+#define PAD_INSTANCE			0
+#define PROTOCOL_NONE			0			//	HID_ITF_PROTOCOL_NONE
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Hat switch only (no axes), 12 buttons, no report ID
+//		[button 1-8][button 9-12, pad][hat 0-7 (null: 8-15), pad]
+static const uint8_t hat_pad_descriptor[] = {
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01,
+	0x15, 0x00, 0x25, 0x01, 0x35, 0x00, 0x45, 0x01, 0x75, 0x01, 0x95, 0x0C,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x81, 0x02,
+	0x95, 0x04, 0x81, 0x01,
+	0x05, 0x01, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x75, 0x04, 0x95, 0x01, 0x65, 0x14, 0x09, 0x39, 0x81, 0x42,
+	0x65, 0x00, 0x95, 0x01, 0x81, 0x01,
+	0xC0,
+};
+
+//	Signed axes -127...127 (the layout of hid_gamepad_report_t of TinyUSB)
+//		[X][Y][Z][Rz][Rx][Ry][hat 1-8 (0: centered)][button 1-32]
+static const uint8_t signed_pad_descriptor[] = {
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01,
+	0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x09, 0x33, 0x09, 0x34,
+	0x15, 0x81, 0x25, 0x7F, 0x95, 0x06, 0x75, 0x08, 0x81, 0x02,
+	0x05, 0x01, 0x09, 0x39, 0x15, 0x01, 0x25, 0x08, 0x35, 0x00, 0x46, 0x3B, 0x01, 0x65, 0x14,
+	0x75, 0x08, 0x95, 0x01, 0x81, 0x02,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x20, 0x15, 0x00, 0x25, 0x01, 0x95, 0x20, 0x75, 0x01, 0x81, 0x02,
+	0xC0,
+};
+
+//	Keyboard (report ID 1) and gamepad (report ID 3) in one interface
+//		[3][X 0-255][Y 0-255][hat 0-7, button 1-4][button 5-12][button 13-14, pad]
+#define REPORT_ID_KEYBOARD		1
+#define REPORT_ID_PAD			3
+
+static const uint8_t composite_pad_descriptor[] = {
+	0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, REPORT_ID_KEYBOARD,
+	0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+	0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+	0xC0,
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, REPORT_ID_PAD,
+	0x09, 0x30, 0x09, 0x31, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02, 0x81, 0x02,
+	0x09, 0x39, 0x15, 0x00, 0x25, 0x07, 0x35, 0x00, 0x46, 0x3B, 0x01, 0x65, 0x14, 0x75, 0x04, 0x95, 0x01, 0x81, 0x42,
+	0x65, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0E, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0E, 0x81, 0x02,
+	0x75, 0x06, 0x95, 0x01, 0x81, 0x01,
+	0xC0,
+};
+
+//	Consumer control (not a gamepad)
+static const uint8_t consumer_descriptor[] = {
+	0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03,
+	0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xC0,
+};
+
+// --------------------------------------------------------------------
+//	Joymega matrix in the format of gamepad_map (matrix[n] is bit 8n ... 8n+5)
+//	from the packed format of the PIO
+//
+static uint64_t get_matrix( void ) {
+	uint32_t packed = bridge_host_get_packed_matrix( PAD_PORT );
+	uint64_t matrix;
+	int i;
+
+	matrix = ((uint64_t)(packed & 0x3F) << 8) | ((uint64_t)((packed >> 6) & 0x3F) << 16) |
+	         ((uint64_t)((packed >> 12) & 0x3F) << 24) | ((uint64_t)((packed >> 18) & 0x3F) << 32);
+	for( i = 0; i < 6; i++ ) {
+		if( (packed >> (31 - i)) & 1 ) {
+			matrix |= 1ull << i;
+		}
+	}
+	return matrix;
+}
+
+// --------------------------------------------------------------------
+//	Matrix while the Joymega buttons (bit n: GAMEPAD_MAP_xxx) are pressed
+//
+static uint64_t expected_matrix( uint32_t buttons ) {
+	//	0x33, 0x3F, 0x03, 0x3F, 0x3F
+	uint64_t matrix = 0x3F3F033F33ull;
+	int i;
+
+	for( i = 0; i < GAMEPAD_MAP_BUTTONS; i++ ) {
+		if( (buttons >> i) & 1 ) {
+			matrix &= ~gamepad_map_get_mask( i );
+		}
+	}
+	return matrix;
+}
+
+#define PRESS( b )		(1u << (GAMEPAD_MAP_##b))
+
+// --------------------------------------------------------------------
+static void mount( const uint8_t *p_desc, uint16_t desc_len ) {
+
+	bridge_host_init();
+	bridge_host_mount( PAD_DEV_ADDR, PAD_INSTANCE, PROTOCOL_NONE, 0x1234, 0x5678, p_desc, desc_len );
+}
+
+// --------------------------------------------------------------------
+static void report( const uint8_t *p_report, uint16_t len, uint32_t buttons, int line ) {
+	uint64_t matrix;
+
+	bridge_host_report( PAD_DEV_ADDR, PAD_INSTANCE, p_report, len );
+	matrix = get_matrix();
+	if( matrix != expected_matrix( buttons ) ) {
+		printf( "NG: line %d: matrix %010llX, expected %010llX\n", line,
+			(unsigned long long) matrix, (unsigned long long) expected_matrix( buttons ) );
+		error_count++;
+	}
+}
+#define REPORT( buttons, ... )	do { \
+		static const uint8_t data[] = { __VA_ARGS__ }; \
+		report( data, sizeof(data), (buttons), __LINE__ ); \
+	} while( 0 )
+
+// --------------------------------------------------------------------
+//	The default profile: B = 1, C = 2, A = 3, Y = 4, Z = 5, X = 6, MODE = 7, START = 8
+//
+static void test_hat_pad( void ) {
+
+	mount( hat_pad_descriptor, sizeof(hat_pad_descriptor) );
+	REPORT( 0,									0x00, 0x00, 0x0F );
+	REPORT( PRESS( UP ),						0x00, 0x00, 0x00 );
+	REPORT( PRESS( UP ) | PRESS( RIGHT ),		0x00, 0x00, 0x01 );
+	REPORT( PRESS( RIGHT ),						0x00, 0x00, 0x02 );
+	REPORT( PRESS( DOWN ) | PRESS( RIGHT ),		0x00, 0x00, 0x03 );
+	REPORT( PRESS( DOWN ),						0x00, 0x00, 0x04 );
+	REPORT( PRESS( DOWN ) | PRESS( LEFT ),		0x00, 0x00, 0x05 );
+	REPORT( PRESS( LEFT ),						0x00, 0x00, 0x06 );
+	REPORT( PRESS( UP ) | PRESS( LEFT ),		0x00, 0x00, 0x07 );
+	REPORT( 0,									0x00, 0x00, 0x08 );
+	REPORT( PRESS( B ),							0x01, 0x00, 0x0F );
+	REPORT( PRESS( C ),							0x02, 0x00, 0x0F );
+	REPORT( PRESS( A ),							0x04, 0x00, 0x0F );
+	REPORT( PRESS( Y ) | PRESS( Z ) | PRESS( X ),	0x38, 0x00, 0x0F );
+	REPORT( PRESS( MODE ) | PRESS( START ),		0xC0, 0x00, 0x0F );
+	//	Buttons 9 ... 12 are not in the profile, and the padding is ignored
+	REPORT( 0,									0x00, 0xFF, 0xFF );
+	//	A short report is ignored (the last state stays)
+	REPORT( PRESS( A ) | PRESS( LEFT ),			0x04, 0x00, 0x06 );
+	REPORT( PRESS( A ) | PRESS( LEFT ),			0x00, 0x00 );
+}
+
+// --------------------------------------------------------------------
+static void test_signed_pad( void ) {
+
+	mount( signed_pad_descriptor, sizeof(signed_pad_descriptor) );
+	//	X, Y, Z, Rz, Rx, Ry, hat, buttons
+	REPORT( 0,						0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( LEFT ),			0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( RIGHT ),			0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( UP ),			0x00, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( DOWN ),			0x00, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	//	The threshold is 1/4 of the range from the end: -64 and 64
+	REPORT( PRESS( LEFT ),			0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( 0,						0xC1, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( DOWN ),			0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	//	The other axes are not in the profile
+	REPORT( 0,						0x00, 0x00, 0x81, 0x7F, 0x81, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00 );
+	//	Hat: 1 is up, 0 is centered
+	REPORT( PRESS( UP ),			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( DOWN ) | PRESS( LEFT ),	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00 );
+	//	The axis and the hat are merged
+	REPORT( PRESS( UP ) | PRESS( LEFT ),	0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 );
+	REPORT( PRESS( A ) | PRESS( START ),	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00 );
+	REPORT( 0,						0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF );
+}
+
+// --------------------------------------------------------------------
+static void test_composite_pad( void ) {
+
+	mount( composite_pad_descriptor, sizeof(composite_pad_descriptor) );
+	//	ID, X, Y, hat | buttons 1-4, buttons 5-12, buttons 13-14
+	REPORT( 0,								REPORT_ID_PAD, 0x80, 0x80, 0x08, 0x00, 0x00 );
+	REPORT( PRESS( LEFT ) | PRESS( DOWN ),	REPORT_ID_PAD, 0x00, 0xFF, 0x08, 0x00, 0x00 );
+	REPORT( PRESS( RIGHT ) | PRESS( UP ),	REPORT_ID_PAD, 0xC0, 0x40, 0x08, 0x00, 0x00 );
+	REPORT( 0,								REPORT_ID_PAD, 0xBF, 0x41, 0x08, 0x00, 0x00 );
+	REPORT( PRESS( UP ) | PRESS( RIGHT ),	REPORT_ID_PAD, 0x80, 0x80, 0x01, 0x00, 0x00 );
+	REPORT( PRESS( B ) | PRESS( A ),		REPORT_ID_PAD, 0x80, 0x80, 0x58, 0x00, 0x00 );
+	REPORT( PRESS( X ) | PRESS( START ),	REPORT_ID_PAD, 0x80, 0x80, 0x08, 0x0A, 0x00 );
+	//	The keyboard report does not change the gamepad
+	REPORT( PRESS( X ) | PRESS( START ),	REPORT_ID_KEYBOARD, 0x00, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09 );
+	REPORT( 0,								REPORT_ID_PAD, 0x80, 0x80, 0x08, 0x00, 0x03 );
+}
+
+// --------------------------------------------------------------------
+//	Only the Gamepad or Joystick collection is compiled
+//
+static void test_not_gamepad( void ) {
+	static const GAMEPAD_PROFILE_T profile = { 0, 0, { { GAMEPAD_SRC_BUTTON( 1 ), GAMEPAD_SRC_NONE } } };
+	GAMEPAD_PROGRAM_T program;
+
+	CHECK( !gamepad_map_compile( consumer_descriptor, sizeof(consumer_descriptor), &profile, &program ) );
+	CHECK( gamepad_map_compile( hat_pad_descriptor, sizeof(hat_pad_descriptor), &profile, &program ) );
+	CHECK( program.op_count == 1 && program.report_id == 0 && program.min_len == 3 );
+	CHECK( gamepad_map_compile( composite_pad_descriptor, sizeof(composite_pad_descriptor), &profile, &program ) );
+	CHECK( program.report_id == REPORT_ID_PAD && program.min_len == 6 );
+	//	Truncated descriptor
+	CHECK( !gamepad_map_compile( signed_pad_descriptor, 20, &profile, &program ) );
+}
+
+// --------------------------------------------------------------------
+int main( void ) {
+
+	test_hat_pad();
+	test_signed_pad();
+	test_composite_pad();
+	test_not_gamepad();
+
+	if( error_count ) {
+		printf( "gamepad_map_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "gamepad_map_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,273 @@
+// --------------------------------------------------------------------
+//	Host test of joymega.pio (SEL-to-output latency and timeouts)
+//		joymega.pio is assembled by pio_model and run at 125MHz. The SEL
+//		edges are placed at every phase of the PIO loops, and the latency
+//		until the pins show the value of the next state is measured.
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "pio_model.h"
+
+#define SYS_CLOCK_HZ		125000000u
+#define NS_PER_CYCLE		(1000000000u / SYS_CLOCK_HZ)
+#define JOYMEGA_TIMEOUT_US	1100
+#define MAX_LATENCY_NS		100				//	Requirement: tens of nanoseconds
+#define PHASES				16				//	SEL edges at 16 different clocks of the loops
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	The model and the SEL line
+static const char *p_pio_path = "joymega.pio";
+static PIO_MODEL_T sm;
+static bool sel_level;						//	Level of SEL at the connector (true: H)
+static bool is_positive_logic;				//	MSX_SEL_LOGIC 1: GPIO inverts the input
+
+//	matrix[0...4] (6 different values)
+static const uint8_t matrix[5] = { 0x15, 0x2A, 0x33, 0x0C, 0x3C };
+
+//	Output after each SEL edge: rise 1, fall 1, ... rise 4, fall 4 (idle)
+static const int edge_matrix[8] = { 0, 1, 0, 1, 2, 3, 4, 1 };
+
+// --------------------------------------------------------------------
+//	The same format as pack_joymega_matrix() of usb_gamepad_bridge_for_msx.c
+//
+static uint32_t pack_matrix( const uint8_t *p_matrix ) {
+	uint32_t packed;
+	int i;
+
+	packed = (uint32_t)p_matrix[1] | ((uint32_t)p_matrix[2] << 6) | ((uint32_t)p_matrix[3] << 12) | ((uint32_t)p_matrix[4] << 18);
+	for( i = 0; i < 6; i++ ) {
+		if( (p_matrix[0] >> i) & 1 ) {
+			packed |= 1u << (31 - i);
+		}
+	}
+	return packed;
+}
+
+// --------------------------------------------------------------------
+//	Input of the SEL pin seen by PIO
+//		MSX_SEL_LOGIC 1: SEL=H is LOW at the pin, and gpio_set_inover() inverts it.
+//
+static bool get_sel_input( void ) {
+	bool pin = is_positive_logic ? !sel_level : sel_level;
+
+	return is_positive_logic ? !pin : pin;
+}
+
+// --------------------------------------------------------------------
+//	The same as joymega_program_start(): ISR is the timeout count, X is the matrix
+//
+static void start( void ) {
+
+	sel_level = false;
+	pio_model_restart( &sm, pio_model_label( &sm, "idle" ), get_sel_input() );
+	sm.out_count = 6;
+	sm.pull_threshold = 6;
+	sm.isr = (uint32_t)( (uint64_t) SYS_CLOCK_HZ * JOYMEGA_TIMEOUT_US / 1000000 / 2 );
+	sm.x = pack_matrix( matrix );
+}
+
+// --------------------------------------------------------------------
+static void run_cycles( uint64_t cycles ) {
+
+	while( cycles-- ) {
+		pio_model_step( &sm, get_sel_input() );
+	}
+}
+
+// --------------------------------------------------------------------
+static void run_us( uint32_t us ) {
+
+	run_cycles( (uint64_t) us * (SYS_CLOCK_HZ / 1000000) );
+}
+
+// --------------------------------------------------------------------
+//	Change SEL, and return the clocks until the pins show the expected value
+//
+static int edge_value( bool level, uint8_t expected ) {
+	int cycles;
+
+	sel_level = level;
+	for( cycles = 1; cycles < 1000; cycles++ ) {
+		run_cycles( 1 );
+		if( (sm.pins & 0x3F) == expected ) {
+			return cycles;
+		}
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------
+static int edge( bool level, int expected_matrix ) {
+
+	return edge_value( level, matrix[ expected_matrix ] );
+}
+
+// --------------------------------------------------------------------
+//	A whole sequence at the phase, and the latency of each edge
+//
+static void test_latency( void ) {
+	int min_cycles[8], max_cycles[8];
+	int phase, i, cycles;
+
+	for( i = 0; i < 8; i++ ) {
+		min_cycles[i] = 1000;
+		max_cycles[i] = 0;
+	}
+	for( phase = 0; phase < PHASES; phase++ ) {
+		start();
+		run_us( 10 );
+		CHECK( (sm.pins & 0x3F) == matrix[1] );
+		for( i = 0; i < 8; i++ ) {
+			//	The edges come at the different clocks of the loops
+			run_cycles( 100 + phase + i * 3 );
+			cycles = edge( (i & 1) == 0, edge_matrix[i] );
+			CHECK( cycles > 0 );
+			if( cycles < min_cycles[i] ) {
+				min_cycles[i] = cycles;
+			}
+			if( cycles > max_cycles[i] ) {
+				max_cycles[i] = cycles;
+			}
+			//	The value stays until the next edge
+			run_us( 5 );
+			CHECK( (sm.pins & 0x3F) == matrix[ edge_matrix[i] ] );
+		}
+	}
+	printf( "edge        latency [ns]\n" );
+	for( i = 0; i < 8; i++ ) {
+		printf( "%s %d (state %d)  %3d...%3d\n", (i & 1) ? "fall" : "rise", i / 2 + 1, (i + 1) % 8,
+			min_cycles[i] * NS_PER_CYCLE, max_cycles[i] * NS_PER_CYCLE );
+		CHECK( max_cycles[i] * NS_PER_CYCLE <= MAX_LATENCY_NS );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Return the time [usec] until the state machine comes back to idle
+//
+static uint32_t wait_idle_us( void ) {
+	int idle = pio_model_label( &sm, "idle" );
+	uint64_t start_cycle = sm.cycle;
+
+	do {
+		run_cycles( 1 );
+	} while( sm.pc != idle && (sm.cycle - start_cycle) < (uint64_t) SYS_CLOCK_HZ );
+	return (uint32_t)( (sm.cycle - start_cycle) / (SYS_CLOCK_HZ / 1000000) );
+}
+
+// --------------------------------------------------------------------
+//	The state 1...4 time out 1100usec after the 1st rising edge, and
+//	the state 5...7 time out 1650usec after the 3rd rising edge.
+//
+static void test_timeout( void ) {
+	uint32_t us;
+
+	//	SEL stays H after the 1st rising edge (state 1)
+	start();
+	run_us( 10 );
+	edge( true, 0 );
+	us = wait_idle_us();
+	printf( "timeout of state 1: %luus\n", (unsigned long) us );
+	CHECK( us >= 1095 && us <= 1105 );
+
+	//	SEL stays L in the state 2: it is counted from the 1st rising edge
+	start();
+	run_us( 10 );
+	edge( true, 0 );
+	run_us( 300 );
+	edge( false, 1 );
+	us = wait_idle_us() + 300;
+	printf( "timeout of state 2: %luus\n", (unsigned long) us );
+	CHECK( us >= 1095 && us <= 1105 );
+
+	//	After the timeout, the next rising edge is the state 1 again. Without it, the
+	//	3rd rising edge is the state 5 and outputs matrix[2].
+	run_us( 10 );
+	edge( true, 0 );
+	run_us( 10 );
+	edge( false, 1 );
+	run_us( 10 );
+	sel_level = true;
+	run_us( 1 );
+	CHECK( (sm.pins & 0x3F) == matrix[0] );
+
+	//	SEL stays H after the 3rd rising edge (state 5)
+	start();
+	run_us( 10 );
+	edge( true, 0 );
+	run_us( 20 );
+	edge( false, 1 );
+	run_us( 20 );
+	edge( true, 0 );
+	run_us( 20 );
+	edge( false, 1 );
+	run_us( 20 );
+	edge( true, 2 );
+	us = wait_idle_us();
+	printf( "timeout of state 5: %luus\n", (unsigned long) us );
+	CHECK( us >= 1645 && us <= 1655 );
+}
+
+// --------------------------------------------------------------------
+//	The matrix taken from TX FIFO at the start of a sequence is used for the
+//	whole sequence, even if the next one is put in the middle of it. The next
+//	one is output from the idle after the sequence.
+//
+static void test_fifo_update( void ) {
+	uint8_t next[5] = { 0x01, 0x02, 0x04, 0x08, 0x10 };
+	int i;
+
+	start();
+	run_us( 10 );
+	edge( true, 0 );
+	run_us( 5 );
+	CHECK( pio_model_put( &sm, pack_matrix( next ) ) );
+	for( i = 1; i < 7; i++ ) {
+		run_us( 5 );
+		CHECK( edge( (i & 1) == 0, edge_matrix[i] ) > 0 );
+	}
+	run_us( 5 );
+	CHECK( edge_value( false, next[1] ) > 0 );
+	run_us( 10 );
+	CHECK( (sm.pins & 0x3F) == next[1] );
+}
+
+// --------------------------------------------------------------------
+int main( int argc, char *argv[] ) {
+
+	if( argc > 1 ) {
+		p_pio_path = argv[1];
+	}
+	if( !pio_model_load( &sm, p_pio_path, "joymega" ) ) {
+		printf( "joymega_timing_test: cannot load %s\n", p_pio_path );
+		return 1;
+	}
+	printf( "joymega: %d instructions\n", sm.length );
+
+	is_positive_logic = false;
+	test_latency();
+	test_timeout();
+	test_fifo_update();
+
+	is_positive_logic = true;
+	test_latency();
+
+	if( error_count ) {
+		printf( "joymega_timing_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "joymega_timing_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,622 @@
+// --------------------------------------------------------------------
+//	MSX joystick port simulator (host test)
+//		The bridge runs with joymega.pio on pio_model and with the clock
+//		model of core1 (bridge_host_run_core1). The MSX side drives SEL
+//		with the timings of the MSX BIOS and with adversarial ones, reads
+//		the pins, and decodes the 3-button and 6-button Joymega sequences
+//		and the mouse nibbles. For each state, the response latency (SEL
+//		edge to the last change of the pins before the read) and the slack
+//		(the read minus the later of the edge and the last change) are
+//		reported. It is the benchmark of the changes of the core1 loop.
+//
+//		msx_port_test <path of joymega.pio>
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bridge_host.h"
+#include "gamepad_map.h"
+
+#define CLOCKS_PER_US			(BRIDGE_HOST_CLOCK_HZ / 1000000)
+#define NS_PER_CLOCK			(1000000000u / BRIDGE_HOST_CLOCK_HZ)
+#define US( us )				((uint64_t)(us) * CLOCKS_PER_US)
+
+#define MOUSE_DEV_ADDR			1			//	Port 1
+#define PAD_DEV_ADDR			2			//	Port 2
+#define PAD_INSTANCE			0
+#define PROTOCOL_NONE			0			//	HID_ITF_PROTOCOL_NONE
+#define PROTOCOL_MOUSE			2			//	HID_ITF_PROTOCOL_MOUSE
+
+//	Pins (bit0-5 from MSX_BUTTON_PIN, L is pressed)
+#define PIN_TRG_B				0x01
+#define PIN_TRG_A				0x02
+#define PIN_RIGHT				0x04
+#define PIN_LEFT				0x08
+#define PIN_DOWN				0x10
+#define PIN_UP					0x20
+#define PIN_DIRECTIONS			(PIN_UP | PIN_DOWN | PIN_LEFT | PIN_RIGHT)
+
+#define JOYMEGA_EDGES			8			//	6-button: rise 1, fall 1, ... rise 4, fall 4
+#define MOUSE_EDGES				6			//	state 1 ... 5, and idle
+#define JOYMEGA_IDLE_US			1200		//	Longer than JOYMEGA_TIMEOUT_US
+#define JOYMEGA_GAP_US			50			//	After the 6-button read
+#define MOUSE_IDLE_US			100
+#define MOUSE_ABORT_US			600			//	Longer than MOUSE_TIMEOUT_US
+#define MOUSE_LATENCY_LIMIT_NS	1000		//	The loop of one port per pass took up to 1.16us with one mouse
+
+static int error_count = 0;
+
+// --------------------------------------------------------------------
+static void check( bool condition, const char *p_text, int line ) {
+
+	if( !condition ) {
+		printf( "NG: line %d: %s\n", line, p_text );
+		error_count++;
+	}
+}
+#define CHECK( condition )		check( (condition), #condition, __LINE__ )
+
+// --------------------------------------------------------------------
+//	Timings of the MSX side
+//		The length of a state is from its SEL edge to the next edge.
+//
+typedef struct {
+	const char		*p_name;
+	const uint32_t	*p_length_ns;			//	Length of each state (NULL: random)
+	uint32_t		min_length_ns;			//	Random length
+	uint32_t		max_length_ns;
+	uint32_t		read_ns;				//	SEL edge to the read (0: read_before_edge_ns before the next edge)
+	uint32_t		read_before_edge_ns;
+} MSX_TIMING_T;
+
+//	Measured on MSX with the BIOS (msx_mouse_timing.pdf). The BIOS reads the
+//	pins and then changes SEL, so the read is assumed 8usec before the edge.
+static const uint32_t bios_mouse_length_ns[ MOUSE_EDGES ] = { 113000, 60000, 48000, 60000, 48000, 67000 };
+
+static const MSX_TIMING_T mouse_timing[] = {
+	{ "MSX BIOS",						bios_mouse_length_ns,	0,		0,		0,		8000 },
+	{ "R800, 8us states",				NULL,	8000,	8000,	4000,	0 },
+	{ "random 4...80us states",			NULL,	4000,	80000,	3000,	0 },
+};
+
+//	Joymega drivers change SEL and read the pins by OUT and IN of the PSG.
+static const MSX_TIMING_T joymega_timing[] = {
+	{ "Z80 3.58MHz",					NULL,	20000,	20000,	12000,	0 },
+	{ "R800",							NULL,	3000,	3000,	1500,	0 },
+	{ "300ns states (faster than MSX)",	NULL,	300,	300,	150,	0 },
+	{ "random 150ns...50us states",		NULL,	150,	50000,	150,	0 },
+};
+
+// --------------------------------------------------------------------
+//	Events of the MSX side (and core0), run by elapse() at their clocks
+//
+#define MAX_EVENTS				64
+#define MAX_READS				32
+#define MAX_STATES				(JOYMEGA_EDGES + 1)
+
+enum { EVENT_SEL, EVENT_READ, EVENT_REPORT };
+
+typedef struct {
+	uint64_t		clock;
+	uint8_t			kind;
+	uint8_t			port;
+	bool			level;					//	EVENT_SEL
+	uint8_t			state;					//	EVENT_READ: state of the statistics (0: none)
+	uint8_t			read;					//	EVENT_READ: index of read_pins[]
+} MSX_EVENT_T;
+
+typedef struct {
+	uint32_t		count;
+	uint32_t		max_latency;			//	[clock]
+	int64_t			min_slack;				//	[clock]
+} STATE_STATISTICS_T;
+
+static uint64_t now_clock = 0;
+static MSX_EVENT_T event[ MAX_EVENTS ];
+static int event_count = 0;
+static int event_index = 0;
+static uint8_t read_pins[ MAX_READS ];
+static int read_count = 0;
+static uint64_t sequence_edge[ MAX_STATES ];		//	Clocks of the SEL edges of add_sequence(), and its end
+
+static uint64_t edge_clock[ BRIDGE_HOST_PORTS ];
+static uint64_t change_clock[ BRIDGE_HOST_PORTS ];
+static uint8_t last_pins[ BRIDGE_HOST_PORTS ];
+static STATE_STATISTICS_T statistics[ BRIDGE_HOST_PORTS ][ MAX_STATES ];
+
+//	The report sent by EVENT_REPORT
+static uint8_t event_dev_addr;
+static uint8_t event_report[ 8 ];
+static uint16_t event_report_length;
+
+// --------------------------------------------------------------------
+static void run_event( const MSX_EVENT_T *p_event ) {
+	STATE_STATISTICS_T *p_statistics;
+	uint64_t settled;
+
+	switch( p_event->kind ) {
+	case EVENT_SEL:
+		bridge_host_set_sel( p_event->port, p_event->level );
+		edge_clock[ p_event->port ] = now_clock;
+		break;
+	case EVENT_READ:
+		read_pins[ p_event->read ] = bridge_host_get_pins( p_event->port );
+		if( p_event->state == 0 ) {
+			break;
+		}
+		p_statistics = &statistics[ p_event->port ][ p_event->state ];
+		settled = change_clock[ p_event->port ];
+		if( settled < edge_clock[ p_event->port ] ) {
+			settled = edge_clock[ p_event->port ];
+		}
+		if( (uint32_t)(settled - edge_clock[ p_event->port ]) > p_statistics->max_latency ) {
+			p_statistics->max_latency = (uint32_t)(settled - edge_clock[ p_event->port ]);
+		}
+		if( p_statistics->count == 0 || (int64_t)(now_clock - settled) < p_statistics->min_slack ) {
+			p_statistics->min_slack = (int64_t)(now_clock - settled);
+		}
+		p_statistics->count++;
+		break;
+	case EVENT_REPORT:
+		bridge_host_report( event_dev_addr, PAD_INSTANCE, event_report, event_report_length );
+		break;
+	default:
+		break;
+	}
+}
+
+// --------------------------------------------------------------------
+//	Advance the time, PIO and the MSX side by the clocks taken by core1
+//
+static void elapse( uint32_t clocks ) {
+	uint8_t pins;
+	int port;
+
+	while( clocks-- ) {
+		while( event_index < event_count && event[ event_index ].clock <= now_clock ) {
+			run_event( &event[ event_index++ ] );
+		}
+		bridge_host_step_pio();
+		now_clock++;
+		if( (now_clock % CLOCKS_PER_US) == 0 ) {
+			host_advance_us( 1 );
+		}
+		for( port = 0; port < BRIDGE_HOST_PORTS; port++ ) {
+			pins = bridge_host_get_pins( port );
+			if( pins != last_pins[ port ] ) {
+				last_pins[ port ] = pins;
+				change_clock[ port ] = now_clock;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Run core1 until all events are done
+//
+static void run_events( void ) {
+
+	while( event_index < event_count ) {
+		bridge_host_run_core1( elapse );
+	}
+	event_count = 0;
+	event_index = 0;
+}
+
+// --------------------------------------------------------------------
+//	Add an event in the order of the clock
+//
+static void add_event( uint64_t clock, int kind, int port, bool level, int state ) {
+	int i;
+
+	if( event_count >= MAX_EVENTS || (kind == EVENT_READ && read_count >= MAX_READS) ) {
+		CHECK( false );
+		return;
+	}
+	for( i = event_count; i > event_index && event[ i - 1 ].clock > clock; i-- ) {
+		event[i] = event[ i - 1 ];
+	}
+	event[i].clock = clock;
+	event[i].kind = (uint8_t) kind;
+	event[i].port = (uint8_t) port;
+	event[i].level = level;
+	event[i].state = (uint8_t) state;
+	event[i].read = (kind == EVENT_READ) ? (uint8_t) read_count++ : 0;
+	event_count++;
+}
+
+// --------------------------------------------------------------------
+//	SEL edges from the clock: H, L, H, L ... The pins are read after each
+//	edge, and the index of the 1st read is returned. The clocks of the
+//	edges and the end of the last state are in sequence_edge[].
+//
+static int add_sequence( int port, uint64_t clock, int edges, const MSX_TIMING_T *p_timing ) {
+	uint32_t length_ns, read_ns;
+	int first_read = read_count;
+	int i;
+
+	for( i = 0; i < edges; i++ ) {
+		if( p_timing->p_length_ns != NULL ) {
+			length_ns = p_timing->p_length_ns[i];
+		}
+		else {
+			length_ns = p_timing->min_length_ns + (uint32_t)( rand() % (p_timing->max_length_ns - p_timing->min_length_ns + 1) );
+		}
+		read_ns = (p_timing->read_ns != 0) ? p_timing->read_ns : (length_ns - p_timing->read_before_edge_ns);
+		sequence_edge[i] = clock;
+		add_event( clock, EVENT_SEL, port, (i & 1) == 0, i + 1 );
+		add_event( clock + read_ns / NS_PER_CLOCK, EVENT_READ, port, false, i + 1 );
+		clock += length_ns / NS_PER_CLOCK;
+	}
+	sequence_edge[ edges ] = clock;
+	return first_read;
+}
+
+// --------------------------------------------------------------------
+static void reset_statistics( void ) {
+
+	memset( statistics, 0, sizeof(statistics) );
+	read_count = 0;
+}
+
+// --------------------------------------------------------------------
+//	Print the statistics of the port, and check the slack
+//
+static void print_statistics( int port, const char *p_kind, const char *p_timing ) {
+	static const char *s_joymega_state[] = { "", "rise 1", "fall 1", "rise 2", "fall 2", "rise 3", "fall 3", "rise 4", "fall 4" };
+	static const char *s_mouse_state[] = { "", "state 1", "state 2", "state 3", "state 4", "state 5", "idle" };
+	const STATE_STATISTICS_T *p_statistics;
+	int state;
+
+	printf( "port %d %s, %s\n", port + 1, p_kind, p_timing );
+	printf( "  state      n   max latency [ns]   min slack [ns]\n" );
+	for( state = 1; state < MAX_STATES; state++ ) {
+		p_statistics = &statistics[ port ][ state ];
+		if( p_statistics->count == 0 ) {
+			continue;
+		}
+		printf( "  %-8s %4lu   %16lu   %14lld\n", (strcmp( p_kind, "mouse" ) == 0) ? s_mouse_state[ state ] : s_joymega_state[ state ],
+			(unsigned long) p_statistics->count, (unsigned long)( p_statistics->max_latency * NS_PER_CLOCK ),
+			(long long)( p_statistics->min_slack * NS_PER_CLOCK ) );
+		CHECK( p_statistics->min_slack > 0 );
+	}
+}
+
+// --------------------------------------------------------------------
+//	Gamepad: X, Y (0...255) and 8 buttons
+//
+static const uint8_t pad_descriptor[] = {
+	0x05, 0x01, 0x09, 0x05, 0xA1, 0x01,
+	0x09, 0x30, 0x09, 0x31, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02, 0x81, 0x02,
+	0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+	0xC0,
+};
+
+//	HID button of the Joymega buttons in the default profile
+static const int pad_button[ GAMEPAD_MAP_BUTTONS ] = {
+	0, 0, 0, 0,					//	UP, DOWN, LEFT, RIGHT (X and Y)
+	3, 1, 2,					//	A, B, C
+	6, 4, 5,					//	X, Y, Z
+	8, 7,						//	START, MODE
+};
+
+#define PRESSED( b )		(1u << (GAMEPAD_MAP_##b))
+
+// --------------------------------------------------------------------
+//	The report of the Joymega buttons
+//
+static void set_pad_report( uint8_t dev_addr, uint32_t buttons ) {
+	int i;
+
+	event_dev_addr = dev_addr;
+	event_report_length = 3;
+	event_report[0] = (buttons & PRESSED( LEFT )) ? 0x00 : (buttons & PRESSED( RIGHT )) ? 0xFF : 0x80;
+	event_report[1] = (buttons & PRESSED( UP )) ? 0x00 : (buttons & PRESSED( DOWN )) ? 0xFF : 0x80;
+	event_report[2] = 0;
+	for( i = GAMEPAD_MAP_A; i < GAMEPAD_MAP_BUTTONS; i++ ) {
+		if( buttons & (1u << i) ) {
+			event_report[2] |= (uint8_t)( 1 << (pad_button[i] - 1) );
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+//	Random buttons (the opposite directions are not pressed together)
+//
+static uint32_t random_pad_buttons( void ) {
+	uint32_t buttons = (uint32_t) rand() & ((1u << GAMEPAD_MAP_BUTTONS) - 1);
+
+	if( buttons & PRESSED( UP ) ) {
+		buttons &= ~PRESSED( DOWN );
+	}
+	if( buttons & PRESSED( LEFT ) ) {
+		buttons &= ~PRESSED( RIGHT );
+	}
+	return buttons;
+}
+
+// --------------------------------------------------------------------
+//	Joymega decoder of the MSX side
+//		SEL=L ........... UP, DOWN, LEFT, RIGHT, TRG A: B, TRG B: C
+//		SEL=H ........... LEFT and RIGHT are L (Mega Drive pad), TRG A: A, TRG B: START
+//		SEL=H (3rd) ..... UP, DOWN, LEFT and RIGHT are L (6-button pad)
+//		SEL=L (3rd) ..... UP: Z, DOWN: Y, LEFT: X, RIGHT: MODE
+//
+static uint32_t pressed_if( uint8_t pins, uint8_t pin, int button ) {
+
+	return (pins & pin) ? 0 : (1u << button);
+}
+
+static int32_t decode_3button( uint8_t low, uint8_t high ) {
+
+	if( (high & (PIN_LEFT | PIN_RIGHT)) != 0 ) {
+		return -1;
+	}
+	return (int32_t)( pressed_if( low, PIN_UP, GAMEPAD_MAP_UP ) | pressed_if( low, PIN_DOWN, GAMEPAD_MAP_DOWN ) |
+		pressed_if( low, PIN_LEFT, GAMEPAD_MAP_LEFT ) | pressed_if( low, PIN_RIGHT, GAMEPAD_MAP_RIGHT ) |
+		pressed_if( low, PIN_TRG_A, GAMEPAD_MAP_B ) | pressed_if( low, PIN_TRG_B, GAMEPAD_MAP_C ) |
+		pressed_if( high, PIN_TRG_A, GAMEPAD_MAP_A ) | pressed_if( high, PIN_TRG_B, GAMEPAD_MAP_START ) );
+}
+
+//	p_pins[0...6]: after rise 1, fall 1, rise 2, fall 2, rise 3, fall 3, rise 4
+static int32_t decode_6button( const uint8_t *p_pins ) {
+	int32_t buttons;
+
+	if( p_pins[2] != p_pins[0] || p_pins[3] != p_pins[1] ) {
+		return -1;
+	}
+	if( (p_pins[4] & PIN_DIRECTIONS) != 0 || (p_pins[6] & PIN_DIRECTIONS) != PIN_DIRECTIONS ) {
+		return -1;
+	}
+	buttons = decode_3button( p_pins[1], p_pins[0] );
+	if( buttons < 0 ) {
+		return -1;
+	}
+	return buttons | (int32_t)( pressed_if( p_pins[5], PIN_UP, GAMEPAD_MAP_Z ) | pressed_if( p_pins[5], PIN_DOWN, GAMEPAD_MAP_Y ) |
+		pressed_if( p_pins[5], PIN_LEFT, GAMEPAD_MAP_X ) | pressed_if( p_pins[5], PIN_RIGHT, GAMEPAD_MAP_MODE ) );
+}
+
+// --------------------------------------------------------------------
+//	Read the Joymega at the port
+//	input:
+//		port ............ 0 or 1
+//		is_6button ...... true: 8 edges, false: 2 edges
+//		p_timing ........ Timing of the MSX side
+//		p_next .......... Buttons of the report sent after the rise 2 (NULL: none)
+//	output:
+//		Decoded buttons (-1: no pad)
+//
+static int32_t read_joymega( int port, bool is_6button, const MSX_TIMING_T *p_timing, const uint32_t *p_next ) {
+	uint8_t low;
+	int first;
+
+	//	SEL=L before the sequence (PIO takes the new matrix from TX FIFO in the idle loop)
+	read_count = 0;
+	add_event( now_clock + US( 1 ), EVENT_READ, port, false, 0 );
+	first = add_sequence( port, now_clock + US( 2 ), is_6button ? JOYMEGA_EDGES : 2, p_timing );
+	if( p_next != NULL ) {
+		set_pad_report( PAD_DEV_ADDR, *p_next );
+		add_event( sequence_edge[2] + 1, EVENT_REPORT, port, false, 0 );
+	}
+	run_events();
+	low = read_pins[0];
+	//	The 3-button read leaves PIO in the state 2 until the timeout
+	add_event( now_clock + US( is_6button ? JOYMEGA_GAP_US : JOYMEGA_IDLE_US ), EVENT_READ, port, false, 0 );
+	run_events();
+	return is_6button ? decode_6button( &read_pins[ first ] ) : decode_3button( low, read_pins[ first ] );
+}
+
+// --------------------------------------------------------------------
+//	Mouse decoder of the MSX side
+//		state 1...4: X high, X low, Y high, Y low. The nibble is UP: D0,
+//		DOWN: D1, LEFT: D2, RIGHT: D3. TRG A: left button, TRG B: right button.
+//
+static int get_nibble( uint8_t pins ) {
+
+	return ((pins >> 5) & 1) | (((pins >> 4) & 1) << 1) | (((pins >> 3) & 1) << 2) | (((pins >> 2) & 1) << 3);
+}
+
+typedef struct {
+	int		x;
+	int		y;
+	int		buttons;						//	bit0: left, bit1: right
+} MOUSE_READ_T;
+
+static void decode_mouse( const uint8_t *p_pins, MOUSE_READ_T *p_read ) {
+
+	p_read->x = (int8_t)( (get_nibble( p_pins[0] ) << 4) | get_nibble( p_pins[1] ) );
+	p_read->y = (int8_t)( (get_nibble( p_pins[2] ) << 4) | get_nibble( p_pins[3] ) );
+	p_read->buttons = ((p_pins[0] & PIN_TRG_A) ? 0 : 1) | ((p_pins[0] & PIN_TRG_B) ? 0 : 2);
+}
+
+// --------------------------------------------------------------------
+static void set_mouse_report( uint8_t dev_addr, int buttons, int x, int y ) {
+
+	event_dev_addr = dev_addr;
+	event_report_length = 5;
+	event_report[0] = (uint8_t) buttons;
+	event_report[1] = (uint8_t)(int8_t) x;
+	event_report[2] = (uint8_t)(int8_t) y;
+	event_report[3] = 0;
+	event_report[4] = 0;
+}
+
+// --------------------------------------------------------------------
+static void send_event_report( void ) {
+
+	bridge_host_report( event_dev_addr, PAD_INSTANCE, event_report, event_report_length );
+}
+
+// --------------------------------------------------------------------
+//	Mount the devices and clear the MSX side
+//
+static void start( bool is_port1_mouse, bool is_port2_mouse ) {
+	int port;
+
+	bridge_host_init();
+	bridge_host_mount( MOUSE_DEV_ADDR, PAD_INSTANCE, is_port1_mouse ? PROTOCOL_MOUSE : PROTOCOL_NONE, 0x1234, 0x0001,
+		is_port1_mouse ? NULL : pad_descriptor, is_port1_mouse ? 0 : sizeof(pad_descriptor) );
+	bridge_host_mount( PAD_DEV_ADDR, PAD_INSTANCE, is_port2_mouse ? PROTOCOL_MOUSE : PROTOCOL_NONE, 0x1234, 0x0002,
+		is_port2_mouse ? NULL : pad_descriptor, is_port2_mouse ? 0 : sizeof(pad_descriptor) );
+	for( port = 0; port < BRIDGE_HOST_PORTS; port++ ) {
+		last_pins[ port ] = bridge_host_get_pins( port );
+		change_clock[ port ] = now_clock;
+		edge_clock[ port ] = now_clock;
+	}
+	event_count = 0;
+	event_index = 0;
+	reset_statistics();
+	//	PIO comes to idle
+	add_event( now_clock + US( JOYMEGA_IDLE_US ), EVENT_READ, 0, false, 0 );
+	run_events();
+}
+
+// --------------------------------------------------------------------
+//	3-button and 6-button reads of a Joymega pad on the port 2 (the port 1
+//	is a mouse). A report in the middle of a sequence changes the buttons
+//	from the next sequence.
+//
+static void test_joymega( const MSX_TIMING_T *p_timing ) {
+	uint32_t buttons, next;
+	int i, button;
+
+	start( true, false );
+	srand( 1 );
+	for( i = 0; i < 40; i++ ) {
+		if( i < GAMEPAD_MAP_BUTTONS ) {
+			button = i;
+			buttons = 1u << button;
+		}
+		else {
+			buttons = random_pad_buttons();
+		}
+		set_pad_report( PAD_DEV_ADDR, buttons );
+		send_event_report();
+		CHECK( read_joymega( 1, false, p_timing, NULL ) == (int32_t)( buttons & ~(PRESSED( X ) | PRESSED( Y ) | PRESSED( Z ) | PRESSED( MODE )) ) );
+		CHECK( read_joymega( 1, true, p_timing, NULL ) == (int32_t) buttons );
+
+		next = random_pad_buttons();
+		CHECK( read_joymega( 1, true, p_timing, &next ) == (int32_t) buttons );
+		CHECK( read_joymega( 1, true, p_timing, NULL ) == (int32_t) next );
+		if( error_count > 10 ) {
+			break;
+		}
+	}
+	print_statistics( 1, "Joymega", p_timing->p_name );
+}
+
+// --------------------------------------------------------------------
+//	Transfers of the mouse. A report in the middle of a transfer is sent
+//	by the next transfer, and a transfer stopped by MSX times out.
+//
+static void test_mouse( const MSX_TIMING_T *p_timing ) {
+	MOUSE_READ_T read;
+	int i, x, y, buttons, first;
+
+	start( true, false );
+	srand( 2 );
+	for( i = 0; i < 40; i++ ) {
+		x = (rand() % 255) - 127;
+		y = (rand() % 255) - 127;
+		buttons = rand() % 4;
+		set_mouse_report( MOUSE_DEV_ADDR, buttons, x, y );
+		send_event_report();
+
+		//	A report in the state 2
+		first = add_sequence( 0, now_clock + US( MOUSE_IDLE_US ), MOUSE_EDGES, p_timing );
+		set_mouse_report( MOUSE_DEV_ADDR, 0, 1, -1 );
+		add_event( sequence_edge[1] + 1, EVENT_REPORT, 0, false, 0 );
+		run_events();
+		decode_mouse( &read_pins[ first ], &read );
+		CHECK( read.x == -x && read.y == -y && read.buttons == buttons );
+
+		first = add_sequence( 0, now_clock + US( MOUSE_IDLE_US ), MOUSE_EDGES, p_timing );
+		run_events();
+		decode_mouse( &read_pins[ first ], &read );
+		CHECK( read.x == -1 && read.y == 1 && read.buttons == 0 );
+
+		//	MSX stops in the state 2, and the next transfer starts after the timeout
+		first = add_sequence( 0, now_clock + US( MOUSE_IDLE_US ), 2, p_timing );
+		run_events();
+		set_mouse_report( MOUSE_DEV_ADDR, 2, -x, y );
+		send_event_report();
+		first = add_sequence( 0, now_clock + US( MOUSE_ABORT_US ), MOUSE_EDGES, p_timing );
+		run_events();
+		decode_mouse( &read_pins[ first ], &read );
+		CHECK( read.x == x && read.y == -y && read.buttons == 2 );
+		read_count = 0;
+		if( error_count > 10 ) {
+			break;
+		}
+	}
+	print_statistics( 0, "mouse", p_timing->p_name );
+}
+
+// --------------------------------------------------------------------
+//	Two mice. MSX reads the port 1 and then the port 2 like the BIOS, or
+//	both at the same time (one write to the PSG changes both SEL).
+//
+static void test_two_mice( const MSX_TIMING_T *p_timing, bool is_same_time ) {
+	MOUSE_READ_T read;
+	int i, port, x[2], y[2], first[2];
+	uint64_t clock;
+
+	start( true, true );
+	srand( 3 );
+	for( i = 0; i < 40; i++ ) {
+		for( port = 0; port < 2; port++ ) {
+			x[ port ] = (rand() % 255) - 127;
+			y[ port ] = (rand() % 255) - 127;
+			set_mouse_report( (port == 0) ? MOUSE_DEV_ADDR : PAD_DEV_ADDR, 0, x[ port ], y[ port ] );
+			send_event_report();
+		}
+		clock = now_clock + US( MOUSE_IDLE_US );
+		first[0] = add_sequence( 0, clock, MOUSE_EDGES, p_timing );
+		if( !is_same_time ) {
+			clock = sequence_edge[ MOUSE_EDGES ];
+		}
+		first[1] = add_sequence( 1, clock, MOUSE_EDGES, p_timing );
+		run_events();
+		for( port = 0; port < 2; port++ ) {
+			decode_mouse( &read_pins[ first[ port ] ], &read );
+			CHECK( read.x == -x[ port ] && read.y == -y[ port ] );
+		}
+		read_count = 0;
+		if( error_count > 10 ) {
+			break;
+		}
+	}
+	for( port = 0; port < 2; port++ ) {
+		print_statistics( port, "mouse", is_same_time ? "two mice at the same time" : "two mice, one after the other" );
+		//	Each port must be served as fast as one mouse was
+		for( i = 1; i <= MOUSE_EDGES; i++ ) {
+			CHECK( statistics[ port ][ i ].max_latency * NS_PER_CLOCK < MOUSE_LATENCY_LIMIT_NS );
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+int main( int argc, char *argv[] ) {
+	size_t i;
+
+	if( argc < 2 || !bridge_host_load_pio( argv[1] ) ) {
+		printf( "msx_port_test: cannot load joymega.pio\n" );
+		return 1;
+	}
+	for( i = 0; i < sizeof(joymega_timing) / sizeof(joymega_timing[0]); i++ ) {
+		test_joymega( &joymega_timing[i] );
+	}
+	for( i = 0; i < sizeof(mouse_timing) / sizeof(mouse_timing[0]); i++ ) {
+		test_mouse( &mouse_timing[i] );
+	}
+	test_two_mice( &mouse_timing[0], false );
+	test_two_mice( &mouse_timing[2], true );
+
+	if( error_count ) {
+		printf( "msx_port_test: %d errors\n", error_count );
+		return 1;
+	}
+	printf( "msx_port_test: OK\n" );
+	return 0;
+}
@@ -0,0 +1,417 @@
+// --------------------------------------------------------------------
+//	Cycle model of one PIO state machine (host test)
+// --------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "pio_model.h"
+
+enum { OP_JMP, OP_MOV, OP_OUT, OP_PULL, OP_SET };
+enum { COND_ALWAYS, COND_NOT_X, COND_X_DEC, COND_NOT_Y, COND_Y_DEC, COND_X_NE_Y, COND_PIN, COND_NOT_OSRE };
+enum { REG_PINS, REG_X, REG_Y, REG_NULL, REG_ISR, REG_OSR, REG_PC };
+enum { MOV_NONE, MOV_INVERT, MOV_REVERSE };
+
+#define MAX_TOKENS	8
+
+// --------------------------------------------------------------------
+static uint32_t bit_mask( int bits ) {
+
+	return( bits >= 32 ? 0xFFFFFFFFu : ((1u << bits) - 1) );
+}
+
+// --------------------------------------------------------------------
+//	Split the line into the words (',' is a separator)
+//
+static int split_line( char *p_line, char **p_tokens ) {
+	int count = 0;
+	char *p;
+
+	for( p = p_line; *p != '\0'; p++ ) {
+		if( *p == ',' ) {
+			*p = ' ';
+		}
+	}
+	for( p = strtok( p_line, " \t\r\n" ); p != NULL && count < MAX_TOKENS; p = strtok( NULL, " \t\r\n" ) ) {
+		p_tokens[ count++ ] = p;
+	}
+	return count;
+}
+
+// --------------------------------------------------------------------
+static int get_register( const char *p_name ) {
+	static const char *s_name[] = { "pins", "x", "y", "null", "isr", "osr", "pc" };
+	int i;
+
+	for( i = 0; i < (int)(sizeof(s_name) / sizeof(s_name[0])); i++ ) {
+		if( strcmp( p_name, s_name[i] ) == 0 ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------
+int pio_model_label( const PIO_MODEL_T *p, const char *p_label ) {
+	int i;
+
+	for( i = 0; i < p->label_count; i++ ) {
+		if( strcmp( p->label_name[i], p_label ) == 0 ) {
+			return p->label_address[i];
+		}
+	}
+	return -1;
+}
+
+// --------------------------------------------------------------------
+//	Assemble one instruction
+//
+static bool assemble( PIO_MODEL_T *p, PIO_MODEL_INSTRUCTION_T *p_ins, char **p_tokens, int count ) {
+	static const char *s_condition[] = { "", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre" };
+	const char *p_source;
+	int i, target;
+
+	memset( p_ins, 0, sizeof(*p_ins) );
+	//	[n] delay
+	if( count > 1 && p_tokens[ count - 1 ][0] == '[' ) {
+		p_ins->delay = (uint8_t) atoi( p_tokens[ count - 1 ] + 1 );
+		count--;
+	}
+	if( strcmp( p_tokens[0], "jmp" ) == 0 && (count == 2 || count == 3) ) {
+		p_ins->opcode = OP_JMP;
+		if( count == 3 ) {
+			for( i = 1; i < (int)(sizeof(s_condition) / sizeof(s_condition[0])); i++ ) {
+				if( strcmp( p_tokens[1], s_condition[i] ) == 0 ) {
+					p_ins->condition = (uint8_t) i;
+				}
+			}
+			if( p_ins->condition == COND_ALWAYS ) {
+				return false;
+			}
+		}
+		target = pio_model_label( p, p_tokens[ count - 1 ] );
+		if( target < 0 ) {
+			return false;
+		}
+		p_ins->target = (uint8_t) target;
+		return true;
+	}
+	if( strcmp( p_tokens[0], "mov" ) == 0 && count == 3 ) {
+		p_ins->opcode = OP_MOV;
+		p_source = p_tokens[2];
+		if( p_source[0] == '!' || p_source[0] == '~' ) {
+			p_ins->operation = MOV_INVERT;
+			p_source++;
+		}
+		else if( strncmp( p_source, "::", 2 ) == 0 ) {
+			p_ins->operation = MOV_REVERSE;
+			p_source += 2;
+		}
+		if( get_register( p_tokens[1] ) < 0 || get_register( p_tokens[1] ) == REG_NULL ||
+		    get_register( p_source ) < 0 || get_register( p_source ) == REG_PC ) {
+			return false;
+		}
+		p_ins->destination = (uint8_t) get_register( p_tokens[1] );
+		p_ins->source = (uint8_t) get_register( p_source );
+		return true;
+	}
+	if( strcmp( p_tokens[0], "nop" ) == 0 && count == 1 ) {
+		p_ins->opcode = OP_MOV;
+		p_ins->destination = REG_Y;
+		p_ins->source = REG_Y;
+		return true;
+	}
+	if( strcmp( p_tokens[0], "out" ) == 0 && count == 3 ) {
+		p_ins->opcode = OP_OUT;
+		p_ins->destination = (uint8_t) get_register( p_tokens[1] );
+		p_ins->bit_count = (uint8_t) atoi( p_tokens[2] );
+		return( get_register( p_tokens[1] ) >= REG_PINS && get_register( p_tokens[1] ) <= REG_NULL &&
+			p_ins->bit_count >= 1 && p_ins->bit_count <= 32 );
+	}
+	if( strcmp( p_tokens[0], "pull" ) == 0 ) {
+		p_ins->opcode = OP_PULL;
+		p_ins->is_block = true;
+		for( i = 1; i < count; i++ ) {
+			if( strcmp( p_tokens[i], "noblock" ) == 0 ) {
+				p_ins->is_block = false;
+			}
+			else if( strcmp( p_tokens[i], "iffull" ) == 0 ) {
+				p_ins->condition = 1;
+			}
+			else if( strcmp( p_tokens[i], "block" ) != 0 ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	if( strcmp( p_tokens[0], "set" ) == 0 && count == 3 ) {
+		p_ins->opcode = OP_SET;
+		p_ins->destination = (uint8_t) get_register( p_tokens[1] );
+		p_ins->bit_count = (uint8_t)( strtol( p_tokens[2], NULL, 0 ) & 31 );
+		return( p_ins->destination == REG_X || p_ins->destination == REG_Y );
+	}
+	return false;
+}
+
+// --------------------------------------------------------------------
+//	Read the lines of the program
+//		pass 0: labels and the wrap, pass 1: instructions
+//
+static bool read_program( PIO_MODEL_T *p, FILE *p_file, const char *p_program, int pass ) {
+	char line[ 256 ], *p_tokens[ MAX_TOKENS ], *p_comment;
+	bool is_target = false;
+	int count, address = 0;
+
+	rewind( p_file );
+	while( fgets( line, sizeof(line), p_file ) != NULL ) {
+		if( line[0] == '%' ) {
+			is_target = false;
+			continue;
+		}
+		p_comment = strchr( line, ';' );
+		if( p_comment != NULL ) {
+			*p_comment = '\0';
+		}
+		p_comment = strstr( line, "//" );
+		if( p_comment != NULL ) {
+			*p_comment = '\0';
+		}
+		count = split_line( line, p_tokens );
+		if( count == 0 ) {
+			continue;
+		}
+		if( strcmp( p_tokens[0], ".program" ) == 0 ) {
+			is_target = (count == 2 && strcmp( p_tokens[1], p_program ) == 0);
+			continue;
+		}
+		if( !is_target ) {
+			continue;
+		}
+		if( strcmp( p_tokens[0], ".wrap_target" ) == 0 ) {
+			p->wrap_target = address;
+			continue;
+		}
+		if( strcmp( p_tokens[0], ".wrap" ) == 0 ) {
+			p->wrap = address - 1;
+			continue;
+		}
+		if( p_tokens[0][0] == '.' ) {
+			//	.side_set, .origin, .define ... are not supported
+			return false;
+		}
+		if( strcmp( p_tokens[0], "public" ) == 0 ) {
+			p_tokens[0] = p_tokens[1];
+			count = 1;
+		}
+		if( p_tokens[0][ strlen( p_tokens[0] ) - 1 ] == ':' ) {
+			if( pass == 0 ) {
+				if( p->label_count >= PIO_MODEL_LABELS || strlen( p_tokens[0] ) >= sizeof(p->label_name[0]) ) {
+					return false;
+				}
+				p_tokens[0][ strlen( p_tokens[0] ) - 1 ] = '\0';
+				strcpy( p->label_name[ p->label_count ], p_tokens[0] );
+				p->label_address[ p->label_count ] = address;
+				p->label_count++;
+			}
+			continue;
+		}
+		if( address >= PIO_MODEL_INSTRUCTIONS ) {
+			return false;
+		}
+		if( pass == 1 && !assemble( p, &p->program[ address ], p_tokens, count ) ) {
+			fprintf( stderr, "pio_model: unsupported instruction at %d: %s\n", address, p_tokens[0] );
+			return false;
+		}
+		address++;
+	}
+	p->length = address;
+	return( address > 0 );
+}
+
+// --------------------------------------------------------------------
+bool pio_model_load( PIO_MODEL_T *p, const char *p_path, const char *p_program ) {
+	FILE *p_file;
+	bool result;
+
+	memset( p, 0, sizeof(*p) );
+	p->wrap = -1;
+	p->out_count = 32;
+	p->pull_threshold = 32;
+	p_file = fopen( p_path, "r" );
+	if( p_file == NULL ) {
+		return false;
+	}
+	result = read_program( p, p_file, p_program, 0 ) && read_program( p, p_file, p_program, 1 );
+	fclose( p_file );
+	if( p->wrap < 0 ) {
+		p->wrap = p->length - 1;
+	}
+	return result;
+}
+
+// --------------------------------------------------------------------
+void pio_model_restart( PIO_MODEL_T *p, int address, bool jmp_pin ) {
+	int i;
+
+	p->pc = address;
+	p->delay = 0;
+	p->x = 0;
+	p->y = 0;
+	p->isr = 0;
+	p->osr = 0;
+	p->osr_count = 32;
+	p->fifo_count = 0;
+	p->is_stalled = false;
+	for( i = 0; i < PIO_MODEL_SYNC_CYCLES; i++ ) {
+		p->sync[i] = jmp_pin;
+	}
+}
+
+// --------------------------------------------------------------------
+bool pio_model_put( PIO_MODEL_T *p, uint32_t data ) {
+
+	if( p->fifo_count >= PIO_MODEL_FIFO ) {
+		return false;
+	}
+	p->fifo[ p->fifo_count++ ] = data;
+	return true;
+}
+
+// --------------------------------------------------------------------
+static uint32_t read_register( PIO_MODEL_T *p, int source ) {
+
+	switch( source ) {
+	case REG_X:		return p->x;
+	case REG_Y:		return p->y;
+	case REG_ISR:	return p->isr;
+	case REG_OSR:	return p->osr;
+	case REG_PINS:	return p->pins;
+	default:		return 0;
+	}
+}
+
+// --------------------------------------------------------------------
+static void write_register( PIO_MODEL_T *p, int destination, uint32_t value, int bits ) {
+
+	switch( destination ) {
+	case REG_X:		p->x = value;	break;
+	case REG_Y:		p->y = value;	break;
+	case REG_ISR:	p->isr = value;	break;
+	case REG_OSR:	p->osr = value;	p->osr_count = 0;	break;
+	case REG_PINS:	p->pins = (p->pins & ~bit_mask( bits )) | (value & bit_mask( bits ));	break;
+	default:		break;
+	}
+}
+
+// --------------------------------------------------------------------
+static uint32_t reverse_bits( uint32_t value ) {
+	uint32_t result = 0;
+	int i;
+
+	for( i = 0; i < 32; i++ ) {
+		result = (result << 1) | ((value >> i) & 1);
+	}
+	return result;
+}
+
+// --------------------------------------------------------------------
+//	Execute the instruction, and return true if it jumps
+//
+static bool execute( PIO_MODEL_T *p, const PIO_MODEL_INSTRUCTION_T *p_ins, bool pin ) {
+	uint32_t value;
+	bool is_taken;
+
+	switch( p_ins->opcode ) {
+	case OP_JMP:
+		switch( p_ins->condition ) {
+		case COND_NOT_X:	is_taken = (p->x == 0);									break;
+		case COND_X_DEC:	is_taken = (p->x != 0);		p->x--;						break;
+		case COND_NOT_Y:	is_taken = (p->y == 0);									break;
+		case COND_Y_DEC:	is_taken = (p->y != 0);		p->y--;						break;
+		case COND_X_NE_Y:	is_taken = (p->x != p->y);								break;
+		case COND_PIN:		is_taken = pin;											break;
+		case COND_NOT_OSRE:	is_taken = (p->osr_count < p->pull_threshold);			break;
+		default:			is_taken = true;										break;
+		}
+		if( is_taken ) {
+			p->pc = p_ins->target;
+		}
+		return is_taken;
+	case OP_MOV:
+		value = read_register( p, p_ins->source );
+		if( p_ins->operation == MOV_INVERT ) {
+			value = ~value;
+		}
+		else if( p_ins->operation == MOV_REVERSE ) {
+			value = reverse_bits( value );
+		}
+		if( p_ins->destination == REG_PC ) {
+			p->pc = (int)(value & (PIO_MODEL_INSTRUCTIONS - 1));
+			return true;
+		}
+		write_register( p, p_ins->destination, value, p->out_count );
+		return false;
+	case OP_OUT:
+		value = p->osr & bit_mask( p_ins->bit_count );
+		p->osr = (p_ins->bit_count >= 32) ? 0 : (p->osr >> p_ins->bit_count);
+		p->osr_count += p_ins->bit_count;
+		if( p->osr_count > 32 ) {
+			p->osr_count = 32;
+		}
+		write_register( p, p_ins->destination, value, p_ins->bit_count );
+		return false;
+	case OP_PULL:
+		if( p_ins->condition != 0 && p->osr_count < p->pull_threshold ) {
+			return false;
+		}
+		if( p->fifo_count > 0 ) {
+			p->osr = p->fifo[0];
+			memmove( &p->fifo[0], &p->fifo[1], sizeof(p->fifo[0]) * (PIO_MODEL_FIFO - 1) );
+			p->fifo_count--;
+		}
+		else if( p_ins->is_block ) {
+			p->is_stalled = true;
+			return false;
+		}
+		else {
+			p->osr = p->x;
+		}
+		p->osr_count = 0;
+		return false;
+	case OP_SET:
+		write_register( p, p_ins->destination, p_ins->bit_count, 5 );
+		return false;
+	default:
+		return false;
+	}
+}
+
+// --------------------------------------------------------------------
+void pio_model_step( PIO_MODEL_T *p, bool jmp_pin ) {
+	const PIO_MODEL_INSTRUCTION_T *p_ins;
+	bool pin;
+	int i;
+
+	//	The level seen by the instruction is the one PIO_MODEL_SYNC_CYCLES clocks ago
+	pin = p->sync[ PIO_MODEL_SYNC_CYCLES - 1 ];
+	for( i = PIO_MODEL_SYNC_CYCLES - 1; i > 0; i-- ) {
+		p->sync[i] = p->sync[ i - 1 ];
+	}
+	p->sync[0] = jmp_pin;
+	p->cycle++;
+
+	if( p->delay > 0 ) {
+		p->delay--;
+		return;
+	}
+	p_ins = &p->program[ p->pc ];
+	p->is_stalled = false;
+	if( !execute( p, p_ins, pin ) ) {
+		if( p->is_stalled ) {
+			return;
+		}
+		p->pc = (p->pc == p->wrap) ? p->wrap_target : (p->pc + 1) % p->length;
+	}
+	p->delay = p_ins->delay;
+}
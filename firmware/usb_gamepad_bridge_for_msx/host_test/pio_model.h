@@ -0,0 +1,109 @@
+// --------------------------------------------------------------------
+//	Cycle model of one PIO state machine (host test)
+//
+//	It assembles a .pio source and runs it one system clock at a time, so the
+//	SEL-to-output latency and the timeouts of joymega.pio can be checked
+//	without the RP2040. Only the instructions used by this project are
+//	supported: jmp, mov, out, pull, set and nop, with the delay [n].
+//	The JMP pin goes through the 2-flop input synchronizer like the GPIO.
+//	Side-set, in, push, wait and irq are not supported (load fails).
+// --------------------------------------------------------------------
+
+#ifndef __PIO_MODEL_H__
+#define __PIO_MODEL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PIO_MODEL_INSTRUCTIONS	32
+#define PIO_MODEL_LABELS		32
+#define PIO_MODEL_FIFO			4
+#define PIO_MODEL_SYNC_CYCLES	2			//	Latency of the input synchronizer [clock]
+
+typedef struct {
+	uint8_t		opcode;
+	uint8_t		condition;
+	uint8_t		destination;
+	uint8_t		source;
+	uint8_t		operation;					//	0: none, 1: invert, 2: bit-reverse
+	uint8_t		bit_count;
+	uint8_t		delay;
+	uint8_t		target;
+	bool		is_block;
+} PIO_MODEL_INSTRUCTION_T;
+
+typedef struct {
+	//	Program
+	PIO_MODEL_INSTRUCTION_T	program[ PIO_MODEL_INSTRUCTIONS ];
+	int						length;
+	int						wrap_target;
+	int						wrap;
+	char					label_name[ PIO_MODEL_LABELS ][ 32 ];
+	int						label_address[ PIO_MODEL_LABELS ];
+	int						label_count;
+
+	//	Configuration (out pins, shift right, no autopull)
+	int						out_count;
+	int						pull_threshold;
+
+	//	State
+	int						pc;
+	int						delay;
+	uint32_t				x;
+	uint32_t				y;
+	uint32_t				isr;
+	uint32_t				osr;
+	int						osr_count;				//	Output shift count
+	uint32_t				pins;					//	Value of the out pins
+	uint32_t				fifo[ PIO_MODEL_FIFO ];
+	int						fifo_count;
+	bool					sync[ PIO_MODEL_SYNC_CYCLES ];
+	bool					is_stalled;
+	uint64_t				cycle;
+} PIO_MODEL_T;
+
+// --------------------------------------------------------------------
+//	Load the program
+//	input:
+//		p .............. model
+//		p_path ......... path of the .pio source
+//		p_program ...... name of .program
+//	output:
+//		true ..... Success
+//		false .... The file or the program is not found, or it has an unsupported instruction
+// --------------------------------------------------------------------
+bool pio_model_load( PIO_MODEL_T *p, const char *p_path, const char *p_program );
+
+// --------------------------------------------------------------------
+//	Address of the label (the same as <program>_offset_<label> of pioasm)
+//	input:
+//		p .............. model
+//		p_label ........ name of the label
+//	output:
+//		address, or -1 if it is not found
+// --------------------------------------------------------------------
+int pio_model_label( const PIO_MODEL_T *p, const char *p_label );
+
+// --------------------------------------------------------------------
+//	Restart the state machine at the address (like pio_sm_restart() and jmp)
+//		The registers, the shift counters and the FIFO are cleared.
+//		The input synchronizer is filled with jmp_pin.
+// --------------------------------------------------------------------
+void pio_model_restart( PIO_MODEL_T *p, int address, bool jmp_pin );
+
+// --------------------------------------------------------------------
+//	Put the data into TX FIFO (like pio_sm_put())
+//	output:
+//		false .... FIFO is full
+// --------------------------------------------------------------------
+bool pio_model_put( PIO_MODEL_T *p, uint32_t data );
+
+// --------------------------------------------------------------------
+//	Run one system clock
+//	input:
+//		p .............. model
+//		jmp_pin ........ level of the JMP pin at this clock (after the GPIO inversion)
+// --------------------------------------------------------------------
+void pio_model_step( PIO_MODEL_T *p, bool jmp_pin );
+
+#endif
@@ -0,0 +1,28 @@
+// --------------------------------------------------------------------
+//	Host test stub of bsp/board.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_BSP_BOARD_H__
+#define __HOST_STUB_BSP_BOARD_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+		#include "pico/time.h"
+
+		static inline void board_init( void ) {
+		}
+
+		static inline void board_led_write( bool state ) {
+			(void) state;
+		}
+
+		static inline uint32_t board_millis( void ) {
+			return (uint32_t)(host_time_us / 1000);
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,23 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/clocks.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_CLOCKS_H__
+#define __HOST_STUB_HARDWARE_CLOCKS_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+		enum clock_index { clk_sys = 5 };
+
+		static inline uint32_t clock_get_hz( enum clock_index clk_index ) {
+			(void) clk_index;
+			return 125000000;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
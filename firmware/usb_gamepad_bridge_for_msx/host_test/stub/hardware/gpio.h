@@ -0,0 +1,31 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/gpio.h
+//		The levels are the arrays of bridge_stub.c. gpio_get() applies the input override.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_GPIO_H__
+#define __HOST_STUB_HARDWARE_GPIO_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+		#define GPIO_IN		false
+		#define GPIO_OUT	true
+
+		enum gpio_function { GPIO_FUNC_SIO = 5, GPIO_FUNC_PIO0 = 6, GPIO_FUNC_PIO1 = 7 };
+		enum gpio_override { GPIO_OVERRIDE_NORMAL = 0, GPIO_OVERRIDE_INVERT = 1, GPIO_OVERRIDE_LOW = 2, GPIO_OVERRIDE_HIGH = 3 };
+
+		void gpio_init( uint gpio );
+		void gpio_set_dir( uint gpio, bool out );
+		void gpio_pull_up( uint gpio );
+		void gpio_set_function( uint gpio, enum gpio_function fn );
+		void gpio_set_inover( uint gpio, uint value );
+		bool gpio_get( uint gpio );
+		void gpio_put_masked( uint32_t mask, uint32_t value );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
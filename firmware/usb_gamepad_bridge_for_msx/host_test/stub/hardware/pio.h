@@ -0,0 +1,39 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/pio.h
+//		The state machines are run by bridge_host.c on pio_model.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_PIO_H__
+#define __HOST_STUB_HARDWARE_PIO_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+		#include "hardware/gpio.h"
+
+		typedef struct { int index; } pio_hw_t;
+		typedef pio_hw_t *PIO;
+		extern pio_hw_t host_pio0;
+		#define pio0	(&host_pio0)
+
+		typedef struct { int dummy; } pio_sm_config;
+		typedef struct pio_program {
+			const uint16_t	*instructions;
+			uint8_t			length;
+			int8_t			origin;
+		} pio_program_t;
+
+		enum pio_src_dest { pio_pins = 0, pio_x = 1, pio_y = 2, pio_null = 3, pio_isr = 8, pio_osr = 9 };
+
+		uint pio_add_program( PIO pio, const pio_program_t *p_program );
+		int pio_claim_unused_sm( PIO pio, bool required );
+		void pio_gpio_init( PIO pio, uint pin );
+		void pio_sm_set_enabled( PIO pio, uint sm, bool enabled );
+		void pio_sm_put( PIO pio, uint sm, uint32_t data );
+		bool pio_sm_is_tx_fifo_full( PIO pio, uint sm );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
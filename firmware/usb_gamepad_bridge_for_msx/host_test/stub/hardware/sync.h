@@ -0,0 +1,28 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/sync.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_SYNC_H__
+#define __HOST_STUB_HARDWARE_SYNC_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdint.h>
+
+		static inline void __dmb( void ) {
+			__sync_synchronize();
+		}
+
+		static inline uint32_t save_and_disable_interrupts( void ) {
+			return 0;
+		}
+
+		static inline void restore_interrupts( uint32_t status ) {
+			(void) status;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,29 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/timer.h
+//		One alarm. It is fired by host_advance_us() (bridge_host.h).
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_TIMER_H__
+#define __HOST_STUB_HARDWARE_TIMER_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+		#include "pico/time.h"
+
+		typedef void (*hardware_alarm_callback_t)( uint alarm_num );
+
+		//	They take the clocks of core1 in bridge_host_run_core1() (bridge_host.c)
+		uint32_t time_us_32( void );
+		uint64_t time_us_64( void );
+
+		int hardware_alarm_claim_unused( bool required );
+		void hardware_alarm_set_callback( uint alarm_num, hardware_alarm_callback_t callback );
+		bool hardware_alarm_set_target( uint alarm_num, absolute_time_t target );
+		void hardware_alarm_cancel( uint alarm_num );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,16 @@
+// --------------------------------------------------------------------
+//	Host test stub of hardware/uart.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_HARDWARE_UART_H__
+#define __HOST_STUB_HARDWARE_UART_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
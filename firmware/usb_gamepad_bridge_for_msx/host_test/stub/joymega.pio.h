@@ -0,0 +1,36 @@
+// --------------------------------------------------------------------
+//	Host test stub of joymega.pio.h (pioasm output)
+//		The state machine runs on pio_model when bridge_host_load_pio()
+//		loaded joymega.pio. Otherwise it does not run.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_JOYMEGA_PIO_H__
+#define __HOST_STUB_JOYMEGA_PIO_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "hardware/pio.h"
+
+		#define joymega_offset_idle	0u
+
+		static const pio_program_t joymega_program = { NULL, 0, -1 };
+
+		//	bridge_host.c
+		void host_joymega_program_init( PIO pio, uint sm, uint out_base, uint sel_pin );
+		void host_joymega_program_start( PIO pio, uint sm, uint32_t timeout_count, uint32_t packed_matrix );
+
+		static inline void joymega_program_init( PIO pio, uint sm, uint offset, uint out_base, uint sel_pin ) {
+			(void) offset;
+			host_joymega_program_init( pio, sm, out_base, sel_pin );
+		}
+
+		static inline void joymega_program_start( PIO pio, uint sm, uint offset, uint32_t timeout_count, uint32_t packed_matrix ) {
+			(void) offset;
+			host_joymega_program_start( pio, sm, timeout_count, packed_matrix );
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,21 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/multicore.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_MULTICORE_H__
+#define __HOST_STUB_PICO_MULTICORE_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+		//	core1 is run by the test (response_core() is not launched)
+		static inline void multicore_launch_core1( void (*p_entry)( void ) ) {
+			(void) p_entry;
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
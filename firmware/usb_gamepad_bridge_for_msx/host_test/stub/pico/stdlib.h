@@ -0,0 +1,19 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/stdlib.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_STDLIB_H__
+#define __HOST_STUB_PICO_STDLIB_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stdio.h>
+		#include "pico/types.h"
+		#include "pico/time.h"
+		#include "hardware/gpio.h"
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
@@ -0,0 +1,34 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/time.h
+//		The time is host_time_us, and it is advanced by the test.
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_TIME_H__
+#define __HOST_STUB_PICO_TIME_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+		extern volatile uint64_t host_time_us;
+
+		//	It takes the clocks of core1 in bridge_host_run_core1() (bridge_host.c)
+		absolute_time_t get_absolute_time( void );
+
+		static inline uint64_t to_us_since_boot( absolute_time_t t ) {
+			return t;
+		}
+
+		static inline absolute_time_t from_us_since_boot( uint64_t us ) {
+			return us;
+		}
+
+		static inline uint32_t to_ms_since_boot( absolute_time_t t ) {
+			return (uint32_t)(t / 1000);
+		}
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
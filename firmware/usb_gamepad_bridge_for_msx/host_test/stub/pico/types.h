@@ -0,0 +1,21 @@
+// --------------------------------------------------------------------
+//	Host test stub of pico/types.h
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_PICO_TYPES_H__
+#define __HOST_STUB_PICO_TYPES_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include <stddef.h>
+		#include <stdint.h>
+		#include <stdbool.h>
+
+		typedef unsigned int uint;
+		typedef uint64_t absolute_time_t;
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
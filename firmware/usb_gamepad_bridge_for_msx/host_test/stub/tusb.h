@@ -0,0 +1,39 @@
+// --------------------------------------------------------------------
+//	Host test stub of tusb.h (TinyUSB 0.14 HID host)
+//		The devices are set by bridge_host_mount() (bridge_host.h).
+// --------------------------------------------------------------------
+
+#ifndef __HOST_STUB_TUSB_H__
+#define __HOST_STUB_TUSB_H__
+	#ifdef __cplusplus
+	extern "C" {
+	#endif
+
+		#include "pico/types.h"
+
+		typedef struct __attribute__((packed)) {
+			uint8_t		buttons;
+			int8_t		x;
+			int8_t		y;
+			int8_t		wheel;
+			int8_t		pan;
+		} hid_mouse_report_t;
+
+		enum { HID_ITF_PROTOCOL_NONE = 0, HID_ITF_PROTOCOL_KEYBOARD = 1, HID_ITF_PROTOCOL_MOUSE = 2 };
+		enum { MOUSE_BUTTON_LEFT = 1, MOUSE_BUTTON_RIGHT = 2, MOUSE_BUTTON_MIDDLE = 4 };
+
+		static inline bool tusb_init( void ) {
+			return true;
+		}
+
+		static inline void tuh_task( void ) {
+		}
+
+		uint8_t tuh_hid_interface_protocol( uint8_t dev_addr, uint8_t instance );
+		bool tuh_hid_receive_report( uint8_t dev_addr, uint8_t instance );
+		bool tuh_vid_pid_get( uint8_t dev_addr, uint16_t *p_vid, uint16_t *p_pid );
+
+	#ifdef __cplusplus
+	}
+	#endif
+#endif
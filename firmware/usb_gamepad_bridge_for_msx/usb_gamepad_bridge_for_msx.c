@@ -33,14 +33,37 @@
 #include <bsp/board.h>
 #include <tusb.h>
 #include <hardware/uart.h>
+#include <hardware/pio.h>
+#include <hardware/clocks.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include "joymega.pio.h"
+#include "gamepad_map.h"
+
+// --------------------------------------------------------------------
+//	MSX ̃WCXeBbN|[g̐
+//		1: |[g1 ̂ (W)
+//		2: |[g1 ƃ|[g2Bڑꂽɋ󂢂Ă|[g֊蓖Ă (USB nuoR)
+//		   GPIO9`15 |[g2 ɔzƂ 2 ɂ邱ƁB1 ̂Ƃ͋쓮ȂB
+//
+//	Number of the MSX joystick ports
+//		1: Port 1 only (default)
+//		2: Port 1 and port 2. The devices are assigned to a free port in the
+//		   connected order (through a USB hub).
+//		   Set 2 only when GPIO9-15 are wired to port 2. With 1, they are not driven.
+//
+#ifndef MSX_PORTS
+#define MSX_PORTS 1
+#endif
 
 // --------------------------------------------------------------------
 //	MSX  AAAEAAAB ̃{^ɑΉ GPIOs̊Jnԍ
 //
-//	Start number of the GPIO pin corresponding to the Up, Down, Left, 
+//	Start number of the GPIO pin corresponding to the Up, Down, Left,
 //	Right, A, and B buttons on the MSX.
 //
 #define MSX_BUTTON_PIN 2
+#define MSX_BUTTON_PIN2 9			//	Port 2
 
 // --------------------------------------------------------------------
 //	MSX 痈 SELM GPIOsԍ
@@ -48,6 +71,7 @@
 //	GPIO pin number of the SEL signal coming from the MSX
 //
 #define MSX_SEL_PIN 8
+#define MSX_SEL_PIN2 15				//	Port 2
 
 // --------------------------------------------------------------------
 //	SELM̘_
@@ -61,95 +85,216 @@
 #define MSX_SEL_LOGIC 0
 
 // --------------------------------------------------------------------
-//	X,Yx
+//	Joymega ̃V[PX̃^CAEg [usec]
+//		1ڂ SEL ̗オ肩炱̎ԓ 3ڂ̗オ肪Ȃ
+//		ŏ蒼B
 //
-//	X,Y axis sensitivity
+//	Timeout of the Joymega sequence [usec]
+//		The sequence restarts when the 3rd rising edge of SEL does not come
+//		within this time from the 1st one.
 //
-#define	LEFT_THRESHOLD		-64
-#define	RIGHT_THRESHOLD		64
-#define	TOP_THRESHOLD		-64
-#define	BOTTOM_THRESHOLD	64
-
-#define	LEFT_THRESHOLD_JOYSTICK		(LEFT_THRESHOLD + 128)
-#define	RIGHT_THRESHOLD_JOYSTICK	(RIGHT_THRESHOLD + 128)
-#define	TOP_THRESHOLD_JOYSTICK		(TOP_THRESHOLD + 128)
-#define	BOTTOM_THRESHOLD_JOYSTICK	(BOTTOM_THRESHOLD + 128)
+#define JOYMEGA_TIMEOUT_US 1100
 
 // --------------------------------------------------------------------
 //	BUTTON MAP
+//		Q[pbh̃|[gfBXNv^Ae{^Ǝ̈ʒu𒲂ׂĎgB
+//		VID/PID ƂɊ蓖ĂςBŌ { 0, 0 } ͂̑̃Q[pbhpB
+//		́A͈͂̒[ 1/4 ȓɓ|ꂽ牟ꂽ̂ƂB
+//		VID/PID ʂ̊蓖ẮA@ŊmFQ[pbhǉ邱ƁB
+//
+//	The positions of the buttons and the axes are taken from the report
+//	descriptor of the gamepad. The assignment can be changed for each VID/PID.
+//	The last entry { 0, 0 } is for the other gamepads.
+//	An axis is pressed when it is within 1/4 of its range from the end.
+//	Add a VID/PID entry only for a gamepad checked on the real hardware.
 //
-#define A_BUTTON			GAMEPAD_BUTTON_C
-#define B_BUTTON			GAMEPAD_BUTTON_A
-#define C_BUTTON			GAMEPAD_BUTTON_B
-#define X_BUTTON			GAMEPAD_BUTTON_Z
-#define Y_BUTTON			GAMEPAD_BUTTON_X
-#define Z_BUTTON			GAMEPAD_BUTTON_Y
-#define START_BUTTON		GAMEPAD_BUTTON_TR
-#define MODE_BUTTON			GAMEPAD_BUTTON_TL
+#define SRC2( a, b )	{ a, b }
+#define SRC( a )		{ a, GAMEPAD_SRC_NONE }
+
+static const GAMEPAD_PROFILE_T gamepad_profiles[] = {
+	//	Others
+	{ 0x0000, 0x0000, {
+		SRC2( GAMEPAD_SRC_AXIS_LOW( GAMEPAD_AXIS_Y ), GAMEPAD_SRC_HAT( GAMEPAD_HAT_UP ) ),		//	UP
+		SRC2( GAMEPAD_SRC_AXIS_HIGH( GAMEPAD_AXIS_Y ), GAMEPAD_SRC_HAT( GAMEPAD_HAT_DOWN ) ),	//	DOWN
+		SRC2( GAMEPAD_SRC_AXIS_LOW( GAMEPAD_AXIS_X ), GAMEPAD_SRC_HAT( GAMEPAD_HAT_LEFT ) ),		//	LEFT
+		SRC2( GAMEPAD_SRC_AXIS_HIGH( GAMEPAD_AXIS_X ), GAMEPAD_SRC_HAT( GAMEPAD_HAT_RIGHT ) ),	//	RIGHT
+		SRC( GAMEPAD_SRC_BUTTON( 3 ) ),								//	A
+		SRC( GAMEPAD_SRC_BUTTON( 1 ) ),								//	B
+		SRC( GAMEPAD_SRC_BUTTON( 2 ) ),								//	C
+		SRC( GAMEPAD_SRC_BUTTON( 6 ) ),								//	X
+		SRC( GAMEPAD_SRC_BUTTON( 4 ) ),								//	Y
+		SRC( GAMEPAD_SRC_BUTTON( 5 ) ),								//	Z
+		SRC( GAMEPAD_SRC_BUTTON( 8 ) ),								//	START
+		SRC( GAMEPAD_SRC_BUTTON( 7 ) ),								//	MODE
+	} },
+};
 
 // --------------------------------------------------------------------
-#define DEBUG_UART_ON 1
+//	AUTOFIRE (A)
+//		{^Ƃ̘A˂̎ƁA̒ŉĂ鎞 [usec]B
+//		 0 ̃{^͘A˂Ȃ (lׂ͂ĘA˂Ȃ)B
+//		n[hEFAA[Ő؂ւ̂ŁAUSB ̃|[g̊ԊuɊ֌WȂ
+//		usec PʂŐmɘA˂BĂ鎞Ԃ 1 ȏAɂ邱ƁB
+//		ȊO̐ݒ̃{^͘A˂ȂB
+//
+//	Period of the autofire of each button, and the pressed time in it [usec].
+//	The button which has the period 0 does not autofire (all buttons by default).
+//	The hardware alarm toggles the buttons, so the timing is accurate to usec
+//	regardless of the interval of the USB reports. The pressed time should be
+//	1 or more, and less than the period. Other entries do not autofire.
+//
+typedef struct {
+	uint32_t	period_us;
+	uint32_t	on_us;
+} AUTOFIRE_CONFIG_T;
+
+static const AUTOFIRE_CONFIG_T autofire_config[ GAMEPAD_MAP_BUTTONS ] = {
+	{ 0, 0 },					//	UP
+	{ 0, 0 },					//	DOWN
+	{ 0, 0 },					//	LEFT
+	{ 0, 0 },					//	RIGHT
+	{ 0, 0 },					//	A		(e.g. { 66666, 33333 } for 15 shots/sec)
+	{ 0, 0 },					//	B
+	{ 0, 0 },					//	C
+	{ 0, 0 },					//	X
+	{ 0, 0 },					//	Y
+	{ 0, 0 },					//	Z
+	{ 0, 0 },					//	START
+	{ 0, 0 },					//	MODE
+};
 
 // --------------------------------------------------------------------
-#if MSX_SEL_LOGIC == 0
-	#define MSX_SEL_H true
-	#define MSX_SEL_L false
-#else
-	#define MSX_SEL_H false
-	#define MSX_SEL_L true
+//	}EX̉Ԃ̓v
+//		1 ɂƁAmouse_mode ̊eXe[g̒ (MSX  SEL ؂ւԊu) ƁA
+//		SEL 𒲂ׂԊu̍ől (̒x)  MOUSE_TIMING_DUMP_INTERVAL_MS Ƃ
+//		UART ɏo͂B[v̕ύX@Ŕׂ̂ɎgB
+//
+//	Statistics of the mouse response timing
+//		When it is 1, the length of each state of mouse_mode (the interval of SEL
+//		changed by MSX) and the maximum interval of the SEL polling (the response
+//		delay) are printed to UART every MOUSE_TIMING_DUMP_INTERVAL_MS.
+//
+#ifndef MOUSE_TIMING_STATISTICS
+#define MOUSE_TIMING_STATISTICS 0
 #endif
+#define MOUSE_TIMING_DUMP_INTERVAL_MS	5000
 
 // --------------------------------------------------------------------
-typedef struct TU_ATTR_PACKED {
-	uint8_t		x;			//< X position of the gamepad. LEFT:0 ... CENTER:128 ... RIGHT:255
-	uint8_t		y;			//< Y position of the gamepad. TOP:0 .... CENTER:128 ... BOTTOM:255
-	uint32_t	buttons;	//< Buttons of the gamepad.
-	int8_t		reserved1;
-	int8_t		reserved2;
-} my_hid_joystick_report_t;
-
-typedef struct {
-	uint8_t		id;			//	0x01
-	uint8_t		notuse_1;	//	0x7F
-	uint8_t		notuse_2;	//	0x7F
-	uint8_t		x;			//< X position of the gamepad. LEFT:0 ... CENTER:128 ... RIGHT:255
-	uint8_t		y;			//< Y position of the gamepad. TOP:0 .... CENTER:128 ... BOTTOM:255	
-	uint8_t		buttons0;	//< Buttons of the gamepad. : XABY1111
-	uint8_t		buttons1;	//< Buttons of the gamepad. : 00SM00CZ
-	uint8_t		notuse_7;	//	0x00
-} my_hid_megadrive_mini_pad_report_t;
-
-// --------------------------------------------------------------------
-static uint8_t volatile joymega_matrix[5] = {
-	0x33, 0x3F, 0x03, 0x3F, 0x3F
-};
+#define DEBUG_UART_ON 1
 
 // --------------------------------------------------------------------
-#define MAX_REPORT  4
+//	SEL ̃x
+//		_̂Ƃ joymega_pio_init()  SEL ̃s̓͂ GPIO Ŕ]B
+//		] PIO łȂ gpio_get() ɂ̂ŁAMSX_SEL_LOGIC ɂ炸
+//		PIO  mouse_mode  1  SEL=H ɌB
+//
+#define MSX_SEL_H true
+#define MSX_SEL_L false
 
-// Each HID instance can has multiple reports
-static struct {
-	uint8_t report_count;
-	tuh_hid_report_info_t report_info[MAX_REPORT];
-} hid_info[ CFG_TUH_HID ];
+// --------------------------------------------------------------------
+//	Mouse information
 
-static int process_mode = 0;	//	0: joypad_mode, 1: mouse_mode
+//	core0  core1 ̎󂯓n
+//		core0 ͈ړʂ̗ݐϒl mouse_published ɁAcore1  MSX ֑ړʂ̗ݐϒl
+//		mouse_sent ɏBǂ 1 core  32bit Pʂŏ̂ŁAr͕svB
+//		肫Ȃړʂ́A̓]ɎzB
+//
+//	Handoff between core0 and core1
+//		core0 writes the total of the movement to mouse_published, and core1 writes the
+//		total of the movement sent to MSX to mouse_sent. Each word has only one writer,
+//		so no lock is needed. The movement which is not sent yet is carried to the next
+//		transfer.
+//
+//	mouse_published: bit 0-11: X total, bit12-23: Y total, bit24-25: buttons, bit26-27: resolution
+//	mouse_sent ..... bit 0-11: X total, bit12-23: Y total
+#define MOUSE_TOTAL_MASK		0xFFF
+#define MOUSE_BACKLOG_LIMIT		1023		//	Maximum movement carried to the next transfers
+#define MOUSE_TIMEOUT_US		500			//	Timeout of the mouse transfer [usec]
+
+#if MOUSE_TIMING_STATISTICS
+	//	core1  core0 \ (\͕ʂ̓]̒l邱Ƃ)
+	//	state 0  idleBŏ̒ő̉̒x̂]TƂB
+	#define MOUSE_TIMING_STATES	6
+
+	typedef struct {
+		uint32_t	count;				//	Number of completed states
+		uint32_t	min_length_us;		//	Minimum length of the state (from SEL edge to SEL edge)
+		uint32_t	max_delay_us;		//	Maximum interval of the SEL polling
+	} MOUSE_STATE_TIMING_T;
+#endif
 
 // --------------------------------------------------------------------
-//	Mouse information
+//	WCXeBbN|[gƂ̏
+//		|[gǂŋL͖̂B
+//
+typedef struct {
+	uint				button_pin;
+	uint				sel_pin;
+
+	//	蓖ĂꂽfoCX (core0)
+	uint8_t				dev_addr;						//	0: Free
+	uint8_t				instance;
+	bool				has_program;
+	GAMEPAD_PROGRAM_T	program;						//	Q[pbh̃|[g joymega_matrix ɂvO (ڑɍ)
+
+	volatile int		process_mode;					//	0: joypad_mode, 1: mouse_mode
+
+	//	joypad_mode  PIO  SEL ɉ (core1 ͎gȂ)
+	uint8_t				joymega_matrix[5];
+	uint				joymega_sm;
+	uint32_t			joymega_packed_matrix;
+	bool				is_joymega_matrix_pending;
+
+	//	A (core0 ̃n[hEFAA[̊荞݂ƋL̂ŁAcore0 ̒ʏ폈
+	//	荞݋֎~ŐG)
+	uint64_t			autofire_clear;					//	Q[pbh̏ ( bit)
+	uint64_t			autofire_output;				//	A˂𔽉fďo͂ ( bit)
+	uint32_t			autofire_pressed;				//	bit n: A˒̃{^ GAMEPAD_MAP_n
+	struct {
+		uint64_t		edge_time;						//	ɐ؂ւ鎞 [usec]
+		bool			is_released;					//	A˂ŗĂ
+	} autofire_state[ GAMEPAD_MAP_BUTTONS ];
+
+	//	core0  core1 ̎󂯓n
+	volatile uint32_t	mouse_published;
+	volatile uint32_t	mouse_sent;
+
+	//	USB}EX瑗ĂW邽߂̕ϐ (core0)
+	int16_t				mouse_total_x;
+	int16_t				mouse_total_y;
+	volatile int		mouse_resolution;
+	int32_t				mouse_button;
+
+	//	MSX֑MĂeێϐ (core1)
+	int32_t				mouse_sending_data;
+	uint32_t			mouse_sending_published;
+	uint32_t			mouse_sending_sent;				//	mouse_sent after this transfer
+	bool				is_mouse_sending_valid;
+	int					mouse_state;					//	0: idle, 1...5: state 1...5
+	uint32_t			mouse_start_time;
+
+	#if MOUSE_TIMING_STATISTICS
+		volatile MOUSE_STATE_TIMING_T	mouse_timing[ MOUSE_TIMING_STATES ];
+		volatile uint32_t				mouse_timing_timeout;
+		volatile bool					is_mouse_timing_reset_requested;
+		uint32_t						mouse_state_start;
+		uint32_t						mouse_poll_last;		//	0: not polled yet
+		uint32_t						mouse_poll_delay;
+	#endif
+} MSX_PORT_T;
+
+static MSX_PORT_T msx_port[ MSX_PORTS ];
 
-//	USB}EX瑗ĂW邽߂̕ϐ
-static volatile int16_t	mouse_delta_x = 0;
-static volatile int16_t	mouse_delta_y = 0;
-static volatile int		mouse_resolution = 0;
-static int32_t	mouse_button = 0;
+static const uint8_t msx_button_pin[] = { MSX_BUTTON_PIN, MSX_BUTTON_PIN2 };
+static const uint8_t msx_sel_pin[] = { MSX_SEL_PIN, MSX_SEL_PIN2 };
 
-//	USB}EX瑗ĂɁuMpvɉHli[ϐ
-static volatile int32_t	mouse_current_data = 3;
-static volatile bool mouse_consume_data = false;
+//	joypad_mode  PIO (vO͑S|[gŋLA|[gƂɃXe[g}Vg)
+static PIO joymega_pio = pio0;
+static uint joymega_offset;
+static uint32_t joymega_timeout_count;
 
-//	MSX֑MĂeێϐ
-static int32_t	mouse_sending_data = 0;
+//	A˂̃n[hEFAA[ (S|[gŋL)
+static uint autofire_alarm;
 
 //	LED Pattern
 static int led_state = 0;
@@ -162,208 +307,513 @@ static const int led_pattern[5][8] = {
 };
 
 // --------------------------------------------------------------------
-static void initialization( void ) {
-	uint8_t i;
-
-	board_init();
-	tusb_init();
+//	joymega_matrix  PIO  X WX^̌`ɂ
+//		bit 0-5: matrix[1], bit 6-11: matrix[2], bit12-17: matrix[3], bit18-23: matrix[4],
+//		bit26-31: matrix[0] (bit]BPIO  mov pins, ::x ŏo͂)
+//
+static uint32_t pack_joymega_matrix( const uint8_t *p_matrix ) {
+	uint32_t packed;
+	int i;
 
-	//	GPIO̐M̌ݒ
+	packed = (uint32_t)p_matrix[1] | ((uint32_t)p_matrix[2] << 6) | ((uint32_t)p_matrix[3] << 12) | ((uint32_t)p_matrix[4] << 18);
 	for( i = 0; i < 6; i++ ) {
-		gpio_init( MSX_BUTTON_PIN + i );
-		gpio_set_dir( MSX_BUTTON_PIN + i, GPIO_OUT );
+		if( (p_matrix[0] >> i) & 1 ) {
+			packed |= 1u << (31 - i);
+		}
 	}
-	gpio_init( MSX_SEL_PIN );
-	gpio_set_dir( MSX_SEL_PIN, GPIO_IN );
-	gpio_pull_up( MSX_SEL_PIN );
+	return packed;
 }
 
 // --------------------------------------------------------------------
-static uint64_t inline my_get_us( void ) {
-	return to_us_since_boot( get_absolute_time() );
+static void joymega_pio_init( void ) {
+	MSX_PORT_T *p;
+	uint8_t i;
+	int port;
+
+	//	[v 1 2NbN JOYMEGA_TIMEOUT_US ɂȂJEg
+	joymega_timeout_count = (uint32_t)( (uint64_t)clock_get_hz( clk_sys ) * JOYMEGA_TIMEOUT_US / 1000000 / 2 );
+	joymega_offset = pio_add_program( joymega_pio, &joymega_program );
+
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		p = &msx_port[ port ];
+		#if MSX_SEL_LOGIC != 0
+			//	1  SEL=H ɂȂ悤ɔ] (PIO  gpio_get() ̗)
+			gpio_set_inover( p->sel_pin, GPIO_OVERRIDE_INVERT );
+		#endif
+		p->joymega_packed_matrix = pack_joymega_matrix( p->joymega_matrix );
+		p->joymega_sm = pio_claim_unused_sm( joymega_pio, true );
+		joymega_program_init( joymega_pio, p->joymega_sm, joymega_offset, p->button_pin, p->sel_pin );
+		for( i = 0; i < 6; i++ ) {
+			pio_gpio_init( joymega_pio, p->button_pin + i );
+		}
+		joymega_program_start( joymega_pio, p->joymega_sm, joymega_offset, joymega_timeout_count, p->joymega_packed_matrix );
+	}
 }
 
 // --------------------------------------------------------------------
-static void joypad_mode( void ) {
-	static const uint32_t mask = 0x3F << MSX_BUTTON_PIN;
-	static const uint64_t sequence_trigger_us = 1100;		//	1100[usec]
-	static const uint64_t sequence_finish_us = 1600;		//	1600[usec]
-	static uint64_t start_time;
+//	joypad_mode  mouse_mode ̐؂ւ (core0 Ă)
+//		mouse_mode  core1  GPIO 𒼐ڑ삷̂ŁA{^̃s SIO ɖ߂B
+//
+static void set_process_mode( MSX_PORT_T *p, int mode ) {
+	uint8_t i;
 
-	//	state 0
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[1] << MSX_BUTTON_PIN );
+	if( mode == p->process_mode ) {
+		return;
 	}
-	start_time = my_get_us();
+	if( mode == 0 ) {
+		uint32_t status;
 
-	//	state 1
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[0] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_trigger_us ) {
-			break;
+		p->process_mode = mode;
+		for( i = 0; i < 6; i++ ) {
+			pio_gpio_init( joymega_pio, p->button_pin + i );
 		}
+		//	A˂̃A[r FIFO ɏȂ悤ɂ
+		status = save_and_disable_interrupts();
+		joymega_program_start( joymega_pio, p->joymega_sm, joymega_offset, joymega_timeout_count, p->joymega_packed_matrix );
+		p->is_joymega_matrix_pending = false;
+		restore_interrupts( status );
 	}
-	if( (my_get_us() - start_time) > sequence_trigger_us ) {
-		return;
+	else {
+		pio_sm_set_enabled( joymega_pio, p->joymega_sm, false );
+		for( i = 0; i < 6; i++ ) {
+			gpio_set_function( p->button_pin + i, GPIO_FUNC_SIO );
+		}
+		#if MOUSE_TIMING_STATISTICS
+			p->is_mouse_timing_reset_requested = true;
+		#endif
+		p->process_mode = mode;
 	}
+}
 
-	//	state 2
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[1] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_trigger_us ) {
-			break;
-		}
+// --------------------------------------------------------------------
+//	ŐV joymega_matrix  PIO ɓn
+//		PIO ̓V[PX̊Jn TX FIFO ôŁAV[PX̓r
+//		o͂ς邱Ƃ͂ȂBFIFO tȂ玟ɉ񂷁B
+//		A˂̃A[̊荞݂Ă΂̂ŁA荞݋֎~ FIFO ɏB
+//
+static void joymega_pio_task( MSX_PORT_T *p ) {
+	uint32_t status;
+
+	status = save_and_disable_interrupts();
+	if( p->is_joymega_matrix_pending && p->process_mode == 0 && !pio_sm_is_tx_fifo_full( joymega_pio, p->joymega_sm ) ) {
+		pio_sm_put( joymega_pio, p->joymega_sm, p->joymega_packed_matrix );
+		p->is_joymega_matrix_pending = false;
 	}
-	if( (my_get_us() - start_time) > sequence_trigger_us ) {
-		return;
+	restore_interrupts( status );
+}
+
+// --------------------------------------------------------------------
+static void update_joymega_matrix( MSX_PORT_T *p, const uint8_t *p_matrix ) {
+
+	memcpy( p->joymega_matrix, p_matrix, sizeof(p->joymega_matrix) );
+	p->joymega_packed_matrix = pack_joymega_matrix( p_matrix );
+	p->is_joymega_matrix_pending = true;
+	joymega_pio_task( p );
+}
+
+// --------------------------------------------------------------------
+//	 bit  joymega_matrix ďo͂
+//
+static void output_joymega_clear( MSX_PORT_T *p, uint64_t clear ) {
+	static const uint8_t default_matrix[5] = {
+		0x33, 0x3F, 0x03, 0x3F, 0x3F
+	};
+	uint8_t matrix[5];
+	int i;
+
+	for( i = 0; i < 5; i++ ) {
+		matrix[i] = default_matrix[i] & ~(uint8_t)( clear >> (i * 8) );
 	}
-	//	state 3
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[0] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_trigger_us ) {
-			break;
+	update_joymega_matrix( p, matrix );
+}
+
+// --------------------------------------------------------------------
+//	A˂̏Ԃ now ܂Ői߂ďo͂ (荞݋֎~A܂̓A[̊荞݂Ă)
+//	input:
+//		p ............... |[g
+//		now ............. ݂̎ [usec]
+//	output:
+//		ɐ؂ւ鎞 [usec]BA˒̃{^ 0B
+//
+static uint64_t autofire_step( MSX_PORT_T *p, uint64_t now ) {
+	uint64_t clear = p->autofire_clear;
+	uint64_t next = 0;
+	int i;
+
+	for( i = 0; i < GAMEPAD_MAP_BUTTONS; i++ ) {
+		if( !(p->autofire_pressed & (1u << i)) ) {
+			continue;
 		}
-	}
-	if( (my_get_us() - start_time) > sequence_trigger_us ) {
-		return;
-	}
-	//	state 4
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[1] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_trigger_us ) {
-			break;
+		//	ꂽ琔̂ŁAA[xĂ덷͗܂Ȃ
+		while( p->autofire_state[i].edge_time <= now ) {
+			p->autofire_state[i].is_released = !p->autofire_state[i].is_released;
+			p->autofire_state[i].edge_time += p->autofire_state[i].is_released ?
+				(autofire_config[i].period_us - autofire_config[i].on_us) : autofire_config[i].on_us;
 		}
-	}
-	if( (my_get_us() - start_time) > sequence_trigger_us ) {
-		return;
-	}
-	//	state 5
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[2] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_finish_us ) {
-			break;
+		if( p->autofire_state[i].is_released ) {
+			clear &= ~gamepad_map_get_mask( i );
+		}
+		if( next == 0 || p->autofire_state[i].edge_time < next ) {
+			next = p->autofire_state[i].edge_time;
 		}
 	}
-	if( (my_get_us() - start_time) > sequence_finish_us ) {
-		return;
+	if( clear != p->autofire_output ) {
+		p->autofire_output = clear;
+		output_joymega_clear( p, clear );
 	}
-	//	state 6
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[3] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_finish_us ) {
-			break;
+	return next;
+}
+
+// --------------------------------------------------------------------
+//	S|[g̘A˂̏Ԃi߂āAԑ̐؂ւ̎ɃA[ݒ肷
+//
+static void autofire_schedule( void ) {
+	uint64_t now, next, port_next;
+	int port;
+
+	for( ;; ) {
+		now = time_us_64();
+		next = 0;
+		for( port = 0; port < MSX_PORTS; port++ ) {
+			port_next = autofire_step( &msx_port[ port ], now );
+			if( port_next != 0 && (next == 0 || port_next < next) ) {
+				next = port_next;
+			}
+		}
+		if( next == 0 ) {
+			hardware_alarm_cancel( autofire_alarm );
+			return;
+		}
+		//	ݒ肷OɎ߂Ă܂Axi߂
+		if( !hardware_alarm_set_target( autofire_alarm, from_us_since_boot( next ) ) ) {
+			return;
 		}
 	}
-	if( (my_get_us() - start_time) > sequence_finish_us ) {
-		return;
-	}
-	//	state 7
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, (uint32_t)joymega_matrix[4] << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > sequence_finish_us ) {
-			break;
+}
+
+// --------------------------------------------------------------------
+static void autofire_alarm_callback( uint alarm_num ) {
+
+	(void) alarm_num;
+	autofire_schedule();
+}
+
+// --------------------------------------------------------------------
+static void autofire_init( void ) {
+
+	autofire_alarm = (uint) hardware_alarm_claim_unused( true );
+	hardware_alarm_set_callback( autofire_alarm, autofire_alarm_callback );
+}
+
+// --------------------------------------------------------------------
+//	{^A˂邩
+//		Ă鎞Ԃ 0 ȏ̐ݒ autofire_step i߂ꂸ
+//		~܂Ă܂̂ŁAA˂Ȃ{^ƂĈB
+//
+static bool is_autofire_enabled( int i ) {
+
+	return( autofire_config[i].on_us != 0 && autofire_config[i].on_us < autofire_config[i].period_us );
+}
+
+// --------------------------------------------------------------------
+//	Q[pbh̏ԂA˂ɓn
+//		ꂽuԂ͉ĂԂn܂B
+//
+static void update_autofire( MSX_PORT_T *p, uint64_t clear ) {
+	uint64_t now;
+	uint32_t status;
+	int i;
+
+	status = save_and_disable_interrupts();
+	now = time_us_64();
+	for( i = 0; i < GAMEPAD_MAP_BUTTONS; i++ ) {
+		if( !is_autofire_enabled( i ) || !(clear & gamepad_map_get_mask( i )) ) {
+			p->autofire_pressed &= ~(1u << i);
+		}
+		else if( !(p->autofire_pressed & (1u << i)) ) {
+			p->autofire_pressed |= 1u << i;
+			p->autofire_state[i].edge_time = now + autofire_config[i].on_us;
+			p->autofire_state[i].is_released = false;
 		}
 	}
+	p->autofire_clear = clear;
+	autofire_schedule();
+	restore_interrupts( status );
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_button_bits( void ) {
-	return (mouse_sending_data & 3);
+static void port_init( void ) {
+	static const uint8_t default_matrix[5] = {
+		0x33, 0x3F, 0x03, 0x3F, 0x3F
+	};
+	MSX_PORT_T *p;
+	int port;
+
+	memset( msx_port, 0, sizeof(msx_port) );
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		p = &msx_port[ port ];
+		p->button_pin = msx_button_pin[ port ];
+		p->sel_pin = msx_sel_pin[ port ];
+		memcpy( p->joymega_matrix, default_matrix, sizeof(p->joymega_matrix) );
+	}
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_1st( void ) {
+static void initialization( void ) {
+	uint8_t i;
+	int port;
 
-	//	MSX֑ĂŒɍXVȂ悤ɃRs[
-	mouse_sending_data = mouse_current_data;
+	board_init();
+	tusb_init();
+	port_init();
 
-	//	1ڂ̃f[^͖Ӗ ({^̂)
-	return get_mouse_button_bits();
+	//	GPIO̐M̌ݒ
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		for( i = 0; i < 6; i++ ) {
+			gpio_init( msx_port[ port ].button_pin + i );
+			gpio_set_dir( msx_port[ port ].button_pin + i, GPIO_OUT );
+		}
+		gpio_init( msx_port[ port ].sel_pin );
+		gpio_set_dir( msx_port[ port ].sel_pin, GPIO_IN );
+		gpio_pull_up( msx_port[ port ].sel_pin );
+	}
+
+	joymega_pio_init();
+	autofire_init();
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_2nd( void ) {
+static int32_t inline get_mouse_backlog( uint32_t total, uint32_t sent ) {
 
-	return get_mouse_button_bits() | ((mouse_sending_data >> 2) & 0x3C);
+	//	12bit ̍𕄍tɂ
+	return (int32_t)(((total - sent) & MOUSE_TOTAL_MASK) ^ 0x800) - 0x800;
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_3rd( void ) {
+static int32_t inline clamp_mouse_delta( int32_t delta ) {
 
-	return get_mouse_button_bits() | ((mouse_sending_data >> 6) & 0x3C);
+	if( delta < -127 ) {
+		return -127;
+	}
+	if( delta > 127 ) {
+		return 127;
+	}
+	return delta;
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_4th( void ) {
+//	ŐV mouse_published 瑗Mp̃f[^ (܂Mς݂ɂ͂Ȃ)
+//
+static void prepare_mouse_packet( MSX_PORT_T *p ) {
+	static const int reverse_inv4[] = { 3, 1, 2, 0 };
+	static const int reverse16[] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+	static const int shift_x[] = { 0, 0, 1, 1 };
+	static const int shift_y[] = { 0, 1, 1, 2 };
+	uint32_t published = p->mouse_published;
+	uint32_t sent = p->mouse_sent;
+	int32_t delta_x, delta_y;
+	int resolution;
+
+	if( p->is_mouse_sending_valid && published == p->mouse_sending_published ) {
+		return;
+	}
+	resolution = (published >> 26) & 3;
+	delta_x = clamp_mouse_delta( get_mouse_backlog( published, sent ) ) >> shift_x[ resolution ];
+	delta_y = clamp_mouse_delta( get_mouse_backlog( published >> 12, sent >> 12 ) ) >> shift_y[ resolution ];
+
+	p->mouse_sending_data = reverse_inv4[ (published >> 24) & 3 ] |
+		(reverse16[ (delta_x >> 4) & 0x0F ] <<  4) | (reverse16[ delta_x & 0x0F ] <<  8) |
+		(reverse16[ (delta_y >> 4) & 0x0F ] << 12) | (reverse16[ delta_y & 0x0F ] << 16);
 
-	return get_mouse_button_bits() | ((mouse_sending_data >> 10) & 0x3C);
+	//	𑜓xĎ̂Ăbit ͑Mς݂ɂȂŁA̓]Ɏz
+	p->mouse_sending_sent = ((sent + (uint32_t)(delta_x * (1 << shift_x[ resolution ]))) & MOUSE_TOTAL_MASK) |
+		((((sent >> 12) + (uint32_t)(delta_y * (1 << shift_y[ resolution ]))) & MOUSE_TOTAL_MASK) << 12);
+	p->mouse_sending_published = published;
+	p->is_mouse_sending_valid = true;
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_5th( void ) {
+//	]Jn̂ŁAmouse_sending_data ̈ړʂ𑗐Mς݂ɂ
+//
+static void commit_mouse_packet( MSX_PORT_T *p ) {
 
-	return get_mouse_button_bits() | ((mouse_sending_data >> 14) & 0x3C);
+	p->mouse_sent = p->mouse_sending_sent;
+	p->is_mouse_sending_valid = false;
 }
 
 // --------------------------------------------------------------------
-static uint32_t inline get_mouse_nibble_bits_6th( void ) {
+//	state ̊Ԃɏo͂l
+//		idle  state 5 ̓{^̂ (idle ̒l͖Ӗ)B
+//		state 1...4  XʁAXʁAYʁAYʂ̃juB
+//
+static uint32_t inline get_mouse_nibble_bits( const MSX_PORT_T *p, int state ) {
+	static const uint8_t shift[] = { 0, 2, 6, 10, 14, 0 };
+	static const uint8_t mask[] = { 0x00, 0x3C, 0x3C, 0x3C, 0x3C, 0x00 };
 
-	return get_mouse_button_bits();
+	return (p->mouse_sending_data & 3) | ((p->mouse_sending_data >> shift[ state ]) & mask[ state ]);
 }
 
+#if MOUSE_TIMING_STATISTICS
 // --------------------------------------------------------------------
-static void mouse_mode( void ) {
-	static const uint32_t mask = 0x3F << MSX_BUTTON_PIN;
-	static const uint64_t timeout_us = 500;		//	500[usec]
-	static uint64_t start_time;
+static void record_mouse_timing( MSX_PORT_T *p, int state, uint32_t length, uint32_t delay ) {
+	volatile MOUSE_STATE_TIMING_T *p_timing = &p->mouse_timing[ state ];
+
+	p_timing->count++;
+	if( length < p_timing->min_length_us ) {
+		p_timing->min_length_us = length;
+	}
+	if( delay > p_timing->max_delay_us ) {
+		p_timing->max_delay_us = delay;
+	}
+}
 
-	//	idle
-	gpio_put_masked( mask, get_mouse_nibble_bits_1st() << MSX_BUTTON_PIN );
-	if( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
+// --------------------------------------------------------------------
+//	core0 ̗vœvZbg (core1  idle ŌĂ)
+//
+static void reset_mouse_timing( MSX_PORT_T *p ) {
+	int i;
+
+	if( !p->is_mouse_timing_reset_requested ) {
 		return;
 	}
+	for( i = 0; i < MOUSE_TIMING_STATES; i++ ) {
+		p->mouse_timing[i].count = 0;
+		p->mouse_timing[i].min_length_us = UINT32_MAX;
+		p->mouse_timing[i].max_delay_us = 0;
+	}
+	p->mouse_timing_timeout = 0;
+	p->mouse_poll_last = 0;
+	p->is_mouse_timing_reset_requested = false;
+}
 
-	mouse_consume_data = true;
-	mouse_current_data &= 0xF;
-	start_time = my_get_us();
+// --------------------------------------------------------------------
+//	SEL 𒲂ׂԊuL^
+//
+static void poll_mouse_timing( MSX_PORT_T *p, uint32_t now ) {
 
-	//	state 1
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, get_mouse_nibble_bits_2nd() << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > timeout_us ) {
-			return;
-		}
+	if( p->mouse_poll_last == 0 ) {
+		p->mouse_state_start = now;
 	}
+	else if( (now - p->mouse_poll_last) > p->mouse_poll_delay ) {
+		p->mouse_poll_delay = now - p->mouse_poll_last;
+	}
+	p->mouse_poll_last = now;
+}
 
-	//	state 2
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, get_mouse_nibble_bits_3rd() << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > timeout_us ) {
-			return;
+// --------------------------------------------------------------------
+//	Xe[gÎŁAƉ̒xL^
+//
+static void end_mouse_state_timing( MSX_PORT_T *p, uint32_t now ) {
+
+	record_mouse_timing( p, p->mouse_state, now - p->mouse_state_start, p->mouse_poll_delay );
+	p->mouse_state_start = now;
+	p->mouse_poll_delay = 0;
+}
+#endif
+
+// --------------------------------------------------------------------
+//	mouse_mode  1񕪂̏
+//		SEL ؂ւĂ玟̃Xe[g̒lo͂B
+//		҂ɖ߂̂ŁAcore1 ͕̃|[g݂ɒׂB
+//	input:
+//		p ............... |[g
+//		sel ............. SEL ̃x
+//		now ............. time_us_32() [usec]
+//	output:
+//		true ............ ]
+//
+static bool mouse_mode( MSX_PORT_T *p, bool sel, uint32_t now ) {
+	uint32_t mask = 0x3Fu << p->button_pin;
+
+	#if MOUSE_TIMING_STATISTICS
+		poll_mouse_timing( p, now );
+	#endif
+
+	if( p->mouse_state == 0 ) {
+		//	idle
+		#if MOUSE_TIMING_STATISTICS
+			reset_mouse_timing( p );
+		#endif
+		prepare_mouse_packet( p );
+		if( sel == MSX_SEL_L ) {
+			gpio_put_masked( mask, get_mouse_nibble_bits( p, 0 ) << p->button_pin );
+			return false;
 		}
-	}
 
-	//	state 3
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, get_mouse_nibble_bits_4th() << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > timeout_us ) {
-			return;
+		//	̓]̊Ԃ mouse_sending_data g
+		commit_mouse_packet( p );
+		p->mouse_start_time = now;
+	}
+	else if( sel == ((p->mouse_state & 1) ? MSX_SEL_H : MSX_SEL_L) ) {
+		//	state 1, 3, 5  SEL=HAstate 2, 4  SEL=L ̊ԑ
+		if( (now - p->mouse_start_time) > MOUSE_TIMEOUT_US ) {
+			#if MOUSE_TIMING_STATISTICS
+				p->mouse_timing_timeout++;
+				p->mouse_state_start = now;
+				p->mouse_poll_delay = 0;
+			#endif
+			p->mouse_state = 0;
+			return false;
 		}
+		return true;
 	}
 
-	//	state 4
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_L ) {
-		gpio_put_masked( mask, get_mouse_nibble_bits_5th() << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > timeout_us ) {
-			return;
+	//	SEL ؂ւ̂Ŏ̃Xe[g (state 5 ̎ idle)
+	#if MOUSE_TIMING_STATISTICS
+		end_mouse_state_timing( p, now );
+	#endif
+	if( p->mouse_state == 5 ) {
+		p->mouse_state = 0;
+		return false;
+	}
+	p->mouse_state++;
+	gpio_put_masked( mask, get_mouse_nibble_bits( p, p->mouse_state ) << p->button_pin );
+	return true;
+}
+
+// --------------------------------------------------------------------
+//	core1  1̏
+//		ǂꂩ̃|[g̓]n܂AS̓]I (Œ MOUSE_TIMEOUT_US)
+//		܂ŁASEL  32bit ̎ǂރ[vŉB|[g𒲂ׂԊúA
+//		}EX 2ł]ĂȂƂ̃}EX 1Z (host_test/msx_port_test)B
+//		̃[v̊ԁAidle ̃|[g SEL ̗オ肾𒲂ׂB
+//
+static void response_task( void ) {
+	bool sel[ MSX_PORTS ], last_sel;
+	bool is_transferring = false;
+	MSX_PORT_T *p;
+	uint32_t now;
+	int port;
+
+	now = time_us_32();
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		p = &msx_port[ port ];
+		sel[ port ] = MSX_SEL_H;
+		//	joypad_mode ̃|[g PIO 
+		if( p->process_mode != 0 ) {
+			sel[ port ] = gpio_get( p->sel_pin );
+			is_transferring |= mouse_mode( p, sel[ port ], now );
 		}
 	}
 
-	//	state 5
-	while( gpio_get( MSX_SEL_PIN ) == MSX_SEL_H ) {
-		gpio_put_masked( mask, get_mouse_nibble_bits_6th() << MSX_BUTTON_PIN );
-		if( (my_get_us() - start_time) > timeout_us ) {
-			return;
+	while( is_transferring ) {
+		now = time_us_32();
+		is_transferring = false;
+		for( port = 0; port < MSX_PORTS; port++ ) {
+			p = &msx_port[ port ];
+			if( p->mouse_state == 0 && p->process_mode == 0 ) {
+				continue;
+			}
+			last_sel = sel[ port ];
+			sel[ port ] = gpio_get( p->sel_pin );
+			if( p->mouse_state != 0 || (sel[ port ] == MSX_SEL_H && last_sel == MSX_SEL_L) ) {
+				is_transferring |= mouse_mode( p, sel[ port ], now );
+			}
+			#if MOUSE_TIMING_STATISTICS
+				else {
+					poll_mouse_timing( p, now );
+				}
+			#endif
 		}
 	}
 }
@@ -372,12 +822,7 @@ static void mouse_mode( void ) {
 void response_core( void ) {
 
 	for( ;; ) {
-		if( process_mode == 0 ) {
-			joypad_mode();
-		}
-		else {
-			mouse_mode();
-		}
+		response_task();
 	}
 }
 
@@ -385,261 +830,173 @@ void response_core( void ) {
 void led_blinking_task(void) {
 	const uint32_t interval_ms = 250;
 	static uint32_t start_ms = 0;
+	int pattern = 0;
+	int port;
 
 	// Blink every interval ms
 	if (board_millis() - start_ms < interval_ms) return; // not enough time
 	start_ms += interval_ms;
-	if( process_mode == 0 ) {
-		board_led_write( led_pattern[ 0 ][ led_state ] );
-	}
-	else {
-		board_led_write( led_pattern[ mouse_resolution + 1 ][ led_state ] );
+	//	mouse_mode ̃|[g΁Aŏ̃|[g̉𑜓x\
+	for( port = MSX_PORTS - 1; port >= 0; port-- ) {
+		if( msx_port[ port ].process_mode != 0 ) {
+			pattern = msx_port[ port ].mouse_resolution + 1;
+		}
 	}
+	board_led_write( led_pattern[ pattern ][ led_state ] );
 	led_state = (led_state + 1) & 7;
 }
 
+#if MOUSE_TIMING_STATISTICS
 // --------------------------------------------------------------------
-static void process_gamepad_report( hid_gamepad_report_t const *p_report ) {
-	static const uint8_t default_matrix[5] = {
-		0x33, 0x3F, 0x03, 0x3F, 0x3F
-	};
-	uint8_t matrix[5];
-	uint8_t button;
-
-	#if DEBUG_UART_ON
-		printf( "process_gamepad_report()\n" );
-	#endif
-
-	//	            b5,b4,b3,b2,b1,b0
-	//	matrix[0] =   k k ` r
-	//	matrix[1] =    E a b
-	//	matrix[2] = k k k k ` r
-	//	matrix[3] = y x w l g g
-	//	matrix[4] = g g g g ` r
-
-	memcpy( matrix, default_matrix, sizeof(matrix) );
-	if( p_report->x <= LEFT_THRESHOLD ) {
-		matrix[1] &= 0x37;
-	}
-	else if( p_report->x >= RIGHT_THRESHOLD ) {
-		matrix[1] &= 0x3B;
-	}
-
-	if( p_report->y <= TOP_THRESHOLD ) {
-		matrix[0] &= 0x1F;
-		matrix[1] &= 0x1F;
-	}
-	else if( p_report->y >= BOTTOM_THRESHOLD ) {
-		matrix[0] &= 0x2F;
-		matrix[1] &= 0x2F;
-	}
+//	}EX̉Ԃ̓v UART ɏo͂ (core0)
+//
+static void mouse_timing_dump_task( void ) {
+	static uint32_t start_ms = 0;
+	MSX_PORT_T *p;
+	int port, i;
 
-	button = p_report->buttons;
-	if( (button & A_BUTTON) != 0 ) {
-		matrix[0] &= 0x3D;
-		matrix[2] &= 0x3D;
-		matrix[4] &= 0x3D;
-	}
-	if( (button & B_BUTTON) != 0 ) {
-		matrix[1] &= 0x3D;
-	}
-	if( (button & C_BUTTON) != 0 ) {
-		matrix[1] &= 0x3E;
-	}
-	if( (button & X_BUTTON) != 0 ) {
-		matrix[3] &= 0x37;
-	}
-	if( (button & Y_BUTTON) != 0 ) {
-		matrix[3] &= 0x2F;
-	}
-	if( (button & Z_BUTTON) != 0 ) {
-		matrix[3] &= 0x1F;
-	}
-	if( (button & START_BUTTON) != 0 ) {
-		matrix[0] &= 0x3E;
-		matrix[2] &= 0x3E;
-		matrix[4] &= 0x3E;
+	if( board_millis() - start_ms < MOUSE_TIMING_DUMP_INTERVAL_MS ) {
+		return;
 	}
-	if( (button & MODE_BUTTON) != 0 ) {
-		matrix[3] &= 0x3B;
+	start_ms += MOUSE_TIMING_DUMP_INTERVAL_MS;
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		p = &msx_port[ port ];
+		if( p->process_mode == 0 || p->is_mouse_timing_reset_requested ) {
+			continue;
+		}
+		printf( "MOUSE%d transfers=%lu timeouts=%lu\r\n", port + 1, (unsigned long) p->mouse_timing[0].count, (unsigned long) p->mouse_timing_timeout );
+		printf( "  idle: max_delay=%luus\r\n", (unsigned long) p->mouse_timing[0].max_delay_us );
+		for( i = 1; i < MOUSE_TIMING_STATES; i++ ) {
+			if( p->mouse_timing[i].count == 0 ) {
+				continue;
+			}
+			printf( "  state%d: n=%lu min_length=%luus max_delay=%luus slack=%ldus\r\n", i,
+				(unsigned long) p->mouse_timing[i].count, (unsigned long) p->mouse_timing[i].min_length_us,
+				(unsigned long) p->mouse_timing[i].max_delay_us,
+				(long) p->mouse_timing[i].min_length_us - (long) p->mouse_timing[i].max_delay_us );
+		}
+		p->is_mouse_timing_reset_requested = true;
 	}
-	memcpy( (void*) joymega_matrix, matrix, sizeof(matrix) );
-
-	#if DEBUG_UART_ON
-		printf( "pos_x = %d\r\n", (int)p_report->x );
-		printf( "pos_y = %d\r\n", (int)p_report->y );
-		printf( "buttons = 0x%02X\r\n", (int)p_report->buttons );
-	#endif
 }
+#endif
 
 // --------------------------------------------------------------------
-static void process_joystick_report( my_hid_joystick_report_t const *p_report ) {
-	static const uint8_t default_matrix[5] = {
-		0x33, 0x3F, 0x03, 0x3F, 0x3F
-	};
-	uint8_t matrix[5];
-	uint8_t button;
-
-	#if DEBUG_UART_ON
-		printf( "process_joystick_report()\n" );
-	#endif
-
-	//	            b5,b4,b3,b2,b1,b0
-	//	matrix[0] =   k k ` r
-	//	matrix[1] =    E a b
-	//	matrix[2] = k k k k ` r
-	//	matrix[3] = y x w l g g
-	//	matrix[4] = g g g g ` r
-
-	memcpy( matrix, default_matrix, sizeof(matrix) );
-	if( p_report->x <= LEFT_THRESHOLD_JOYSTICK ) {
-		matrix[1] &= 0x37;
-	}
-	else if( p_report->x >= RIGHT_THRESHOLD_JOYSTICK ) {
-		matrix[1] &= 0x3B;
-	}
+static int16_t update_mouse_total( int16_t total, int16_t delta, uint32_t sent ) {
+	int32_t backlog;
 
-	if( p_report->y <= TOP_THRESHOLD_JOYSTICK ) {
-		matrix[0] &= 0x1F;
-		matrix[1] &= 0x1F;
+	//	肫ĂȂړʂ MOUSE_BACKLOG_LIMIT 𒴂Ȃ悤ɂ
+	backlog = get_mouse_backlog( (uint32_t) total, sent ) + delta;
+	if( backlog < -MOUSE_BACKLOG_LIMIT ) {
+		backlog = -MOUSE_BACKLOG_LIMIT;
 	}
-	else if( p_report->y >= BOTTOM_THRESHOLD_JOYSTICK ) {
-		matrix[0] &= 0x2F;
-		matrix[1] &= 0x2F;
+	else if( backlog > MOUSE_BACKLOG_LIMIT ) {
+		backlog = MOUSE_BACKLOG_LIMIT;
 	}
+	return (int16_t)( (sent + (uint32_t) backlog) & MOUSE_TOTAL_MASK );
+}
 
-	button = p_report->buttons;
-	if( (button & A_BUTTON) != 0 ) {
-		matrix[0] &= 0x3D;
-		matrix[2] &= 0x3D;
-		matrix[4] &= 0x3D;
-	}
-	if( (button & B_BUTTON) != 0 ) {
-		matrix[1] &= 0x3D;
-	}
-	if( (button & C_BUTTON) != 0 ) {
-		matrix[1] &= 0x3E;
-	}
-	if( (button & X_BUTTON) != 0 ) {
-		matrix[3] &= 0x37;
-	}
-	if( (button & Y_BUTTON) != 0 ) {
-		matrix[3] &= 0x2F;
-	}
-	if( (button & Z_BUTTON) != 0 ) {
-		matrix[3] &= 0x1F;
-	}
-	if( (button & START_BUTTON) != 0 ) {
-		matrix[0] &= 0x3E;
-		matrix[2] &= 0x3E;
-		matrix[4] &= 0x3E;
-	}
-	if( (button & MODE_BUTTON) != 0 ) {
-		matrix[3] &= 0x3B;
-	}
-	memcpy( (void*) joymega_matrix, matrix, sizeof(matrix) );
+// --------------------------------------------------------------------
+static void publish_mouse( MSX_PORT_T *p ) {
 
-	#if DEBUG_UART_ON
-		printf( "pos_x = %d\r\n", (int)p_report->x );
-		printf( "pos_y = %d\r\n", (int)p_report->y );
-		printf( "buttons = 0x%02X\r\n", (int)p_report->buttons );
-	#endif
+	p->mouse_published = ((uint32_t) p->mouse_total_x & MOUSE_TOTAL_MASK) | (((uint32_t) p->mouse_total_y & MOUSE_TOTAL_MASK) << 12) |
+		((uint32_t)(p->mouse_button & 3) << 24) | ((uint32_t) p->mouse_resolution << 26);
 }
 
 // --------------------------------------------------------------------
-static void process_mouse_report( hid_mouse_report_t const * report ) {
-	int16_t delta_x;
-	int16_t delta_y;
-	int32_t send_data, last_mouse_button;
-	int d1, d2, d3, d4;
-	static const int reverse_inv4[] = { 3, 1, 2, 0 };
-	static const int reverse16[] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
-	
-	if( mouse_consume_data ) {
-		mouse_consume_data = false;
-		mouse_delta_x = 0;
-		mouse_delta_y = 0;
-	}
-	delta_x = mouse_delta_x - (int16_t) report->x;
-	if( delta_x < -127 ) {
-		delta_x = -127;
-	}
-	else if( delta_x > 127 ) {
-		delta_x = 127;
-	}
+static void process_mouse_report( MSX_PORT_T *p, hid_mouse_report_t const * report ) {
+	int32_t last_mouse_button;
+	uint32_t sent;
 
-	delta_y = mouse_delta_y - (int16_t) report->y;
-	if( delta_y < -127 ) {
-		delta_y = -127;
-	}
-	else if( delta_y > 127 ) {
-		delta_y = 127;
-	}
+	//	mouse_sent  core1 i߂邪AÂlgĂzʂς邾
+	sent = p->mouse_sent;
+	p->mouse_total_x = update_mouse_total( p->mouse_total_x, -(int16_t) report->x, sent );
+	p->mouse_total_y = update_mouse_total( p->mouse_total_y, -(int16_t) report->y, sent >> 12 );
 
-	last_mouse_button = mouse_button;
-	mouse_button = (report->buttons & (MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE));
+	last_mouse_button = p->mouse_button;
+	p->mouse_button = (report->buttons & (MOUSE_BUTTON_RIGHT | MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE));
 
 	//	{^ꂽ𑜓xς
-	if( !(last_mouse_button & MOUSE_BUTTON_MIDDLE) && (mouse_button & MOUSE_BUTTON_MIDDLE) ) {
-		mouse_resolution = (mouse_resolution + 1) & 3;
-	}
-
-	//	Mpf[^
-	send_data = reverse_inv4[ mouse_button & 3 ];
-	switch( mouse_resolution ) {
-	default:
-	case 0:
-		d1 = reverse16[((delta_x     ) >> 4) & 0x0F ];
-		d2 = reverse16[ (delta_x     )       & 0x0F ];
-		d3 = reverse16[((delta_y     ) >> 4) & 0x0F ];
-		d4 = reverse16[ (delta_y     )       & 0x0F ];
-		break;
-	case 1:
-		d1 = reverse16[((delta_x     ) >> 4) & 0x0F ];
-		d2 = reverse16[ (delta_x     )       & 0x0F ];
-		d3 = reverse16[((delta_y >> 1) >> 4) & 0x0F ];
-		d4 = reverse16[ (delta_y >> 1)       & 0x0F ];
-		break;
-	case 2:
-		d1 = reverse16[((delta_x >> 1) >> 4) & 0x0F ];
-		d2 = reverse16[ (delta_x >> 1)       & 0x0F ];
-		d3 = reverse16[((delta_y >> 1) >> 4) & 0x0F ];
-		d4 = reverse16[ (delta_y >> 1)       & 0x0F ];
-		break;
-	case 3:
-		d1 = reverse16[((delta_x >> 1) >> 4) & 0x0F ];
-		d2 = reverse16[ (delta_x >> 1)       & 0x0F ];
-		d3 = reverse16[((delta_y >> 2) >> 4) & 0x0F ];
-		d4 = reverse16[ (delta_y >> 2)       & 0x0F ];
-		break;
-	}
-	send_data = send_data | (d1 << 4) | (d2 << 8) | (d3 << 12) | (d4 << 16);
-
-	//	r͖ʓ|Ȃ̂ŏȗ (^^;
-	mouse_delta_x = delta_x;
-	mouse_delta_y = delta_y;
-	mouse_current_data = send_data;
+	if( !(last_mouse_button & MOUSE_BUTTON_MIDDLE) && (p->mouse_button & MOUSE_BUTTON_MIDDLE) ) {
+		p->mouse_resolution = (p->mouse_resolution + 1) & 3;
+	}
+
+	//	Mpf[^ core1 ]̊Jnɍ
+	publish_mouse( p );
 }
 
 // --------------------------------------------------------------------
 int main(void) {
+	int port;
 
 	initialization();
 	multicore_launch_core1( response_core );
 
 	for( ;; ) {
 		tuh_task();
+		for( port = 0; port < MSX_PORTS; port++ ) {
+			joymega_pio_task( &msx_port[ port ] );
+		}
 		led_blinking_task();
+		#if MOUSE_TIMING_STATISTICS
+			mouse_timing_dump_task();
+		#endif
 	}
 	return 0;
 }
 
+// --------------------------------------------------------------------
+//	foCX蓖Ăꂽ|[gT
+//	input:
+//		dev_addr, instance ... foCX
+//	output:
+//		|[gB蓖ĂĂȂ NULLB
+//
+static MSX_PORT_T *find_port( uint8_t dev_addr, uint8_t instance ) {
+	int port;
+
+	for( port = 0; port < MSX_PORTS; port++ ) {
+		if( msx_port[ port ].dev_addr == dev_addr && msx_port[ port ].instance == instance ) {
+			return &msx_port[ port ];
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------------------------------------------
+//	󂢂Ă|[gɃfoCX蓖Ă
+//	output:
+//		|[gB󂢂ĂȂ NULLB
+//
+static MSX_PORT_T *assign_port( uint8_t dev_addr, uint8_t instance ) {
+	MSX_PORT_T *p;
+
+	p = find_port( 0, 0 );
+	if( p != NULL ) {
+		p->dev_addr = dev_addr;
+		p->instance = instance;
+	}
+	return p;
+}
+
+// --------------------------------------------------------------------
+//	|[g󂯂 ({^ׂ͂ėԂɂȂ)
+//
+static void release_port( MSX_PORT_T *p ) {
+
+	set_process_mode( p, 0 );	//	joypad_mode
+	update_autofire( p, 0 );
+	p->has_program = false;
+	p->dev_addr = 0;
+	p->instance = 0;
+}
+
 // --------------------------------------------------------------------
 //	HIDڑꂽƂɌĂяoR[obN
 //
 //	Callback to be called when a gamepad is connected.
 //
 void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len ) {
+	MSX_PORT_T *p;
 
 	// Interface protocol (hid_interface_protocol_enum_t)
 	uint8_t const itf_protocol = tuh_hid_interface_protocol( dev_addr, instance );
@@ -650,18 +1007,39 @@ void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* desc_r
 	// By default host stack will use activate boot protocol on supported interface.
 	// Therefore for this simple example, we only need to parse generic report descriptor (with built-in parser)
 	if( itf_protocol == HID_ITF_PROTOCOL_NONE ) {
-		hid_info[instance].report_count = tuh_hid_parse_report_descriptor(hid_info[instance].report_info, MAX_REPORT, desc_report, desc_len);
-		process_mode = 0;	//	joypad_mode
+		uint16_t vid = 0, pid = 0;
+		const GAMEPAD_PROFILE_T *p_profile;
+		static GAMEPAD_PROGRAM_T program;
+
+		tuh_vid_pid_get( dev_addr, &vid, &pid );
+		p_profile = gamepad_map_find_profile( gamepad_profiles, sizeof(gamepad_profiles) / sizeof(gamepad_profiles[0]), vid, pid );
+		//	Q[pbhł͂ȂC^tF[X (L[{[h̃fBAL[Ȃ) ɂ̓|[g蓖ĂȂ
+		if( gamepad_map_compile( desc_report, desc_len, p_profile, &program ) ) {
+			p = assign_port( dev_addr, instance );
+			if( p != NULL ) {
+				p->program = program;
+				p->has_program = true;
+				set_process_mode( p, 0 );	//	joypad_mode
+			}
+			#if DEBUG_UART_ON
+				printf( "gamepad %04X:%04X program %d ops, port %d\r\n", vid, pid, program.op_count, (p != NULL) ? (int)(p - msx_port) + 1 : 0 );
+			#endif
+		}
 	}
 	else if( itf_protocol == HID_ITF_PROTOCOL_MOUSE ) {
-		process_mode = 1;	//	mouse_mode
-		mouse_delta_x = 0;
-		mouse_delta_y = 0;
-		mouse_button = 0;
-		mouse_resolution = 0;
-	}
-	else {
-		process_mode = 0;	//	joypad_mode
+		p = assign_port( dev_addr, instance );
+		if( p != NULL ) {
+			//	Õ}EX̑肫ĂȂړʂ̂Ă
+			p->mouse_total_x = (int16_t)( p->mouse_sent & MOUSE_TOTAL_MASK );
+			p->mouse_total_y = (int16_t)( (p->mouse_sent >> 12) & MOUSE_TOTAL_MASK );
+			p->mouse_button = 0;
+			p->mouse_resolution = 0;
+			publish_mouse( p );
+			set_process_mode( p, 1 );	//	mouse_mode
+		}
+		#if DEBUG_UART_ON
+			printf( "mouse port %d\r\n", (p != NULL) ? (int)(p - msx_port) + 1 : 0 );
+		#endif
 	}
 
 	// request to receive report
@@ -679,66 +1057,35 @@ void tuh_hid_mount_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* desc_r
 //	Callback to be called when the gamepad is disconnected.
 //
 void tuh_hid_umount_cb( uint8_t dev_addr, uint8_t instance ) {
+	MSX_PORT_T *p;
 
-	(void) dev_addr;
-	(void) instance;
 	#if DEBUG_UART_ON
 		printf( "tuh_hid_umount_cb( %d, %d );\n", dev_addr, instance );
 	#endif
 
-	process_mode = 0;	//	joypad_mode
+	p = find_port( dev_addr, instance );
+	if( p != NULL ) {
+		release_port( p );
+	}
 }
 
 // --------------------------------------------------------------------
-void process_generic_report( uint8_t instance, uint8_t const* report, uint16_t len ) {
+void process_generic_report( MSX_PORT_T *p, uint8_t const* report, uint16_t len ) {
+	uint64_t clear;
 
-	uint8_t const rpt_count = hid_info[instance].report_count;
-	tuh_hid_report_info_t* rpt_info_arr = hid_info[instance].report_info;
-	tuh_hid_report_info_t* rpt_info = NULL;
-
-	if( rpt_count == 1 && rpt_info_arr[0].report_id == 0 ) {
-		// Simple report without report ID as 1st byte
-		rpt_info = &rpt_info_arr[0];
-	}
-	else {
-		// Composite report, 1st byte is report ID, data starts from 2nd byte
-		uint8_t const rpt_id = report[0];
-
-		// Find report id in the arrray
-		for( uint8_t i = 0; i < rpt_count; i++ ) {
-			if( rpt_id == rpt_info_arr[i].report_id ) {
-				rpt_info = &rpt_info_arr[i];
-				break;
-			}
-		}
-		report++;
-		len--;
-	}
-
-	if( rpt_info == NULL ) {
-		#if DEBUG_UART_ON
-			printf("Couldn't find the report info for this report !\r\n");
-		#endif
+	if( !p->has_program ) {
 		return;
 	}
-
-	if( rpt_info->usage_page == HID_USAGE_PAGE_DESKTOP ) {
-		switch( rpt_info->usage ) {
-		case HID_USAGE_DESKTOP_GAMEPAD:
-			process_gamepad_report( (hid_gamepad_report_t const*) report );
-			break;
-		case HID_USAGE_DESKTOP_JOYSTICK:
-			process_joystick_report( (my_hid_joystick_report_t const*) report );
-			break;
-		default:
-			printf( "generic usage: %02X\r\n", rpt_info->usage );
-			break;
-		}
+	if( !gamepad_map_run( &p->program, report, len, &clear ) ) {
+		//	̃vÕ|[gł͂Ȃ
+		return;
 	}
+	update_autofire( p, clear );
 }
 
 // --------------------------------------------------------------------
 void tuh_hid_report_received_cb( uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len ) {
+	MSX_PORT_T *p;
 
 	uint8_t const itf_protocol = tuh_hid_interface_protocol( dev_addr, instance );
 
@@ -746,14 +1093,15 @@ void tuh_hid_report_received_cb( uint8_t dev_addr, uint8_t instance, uint8_t con
 		printf( "tuh_hid_report_received_cb( %d, %d, %p, %d )\n", dev_addr, instance, report, len );
 	#endif
 
-	if( itf_protocol == HID_ITF_PROTOCOL_KEYBOARD ) {
-		//	none
+	p = find_port( dev_addr, instance );
+	if( p == NULL ) {
+		//	|[g蓖ĂĂȂ
 	}
 	else if( itf_protocol == HID_ITF_PROTOCOL_MOUSE ) {
-		process_mouse_report( (hid_mouse_report_t const*) report );
+		process_mouse_report( p, (hid_mouse_report_t const*) report );
 	}
 	else {
-		process_generic_report( instance, report, len );
+		process_generic_report( p, report, len );
 	}
 
 	// continue to request to receive report
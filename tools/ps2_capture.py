@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# coding=utf-8
+# --------------------------------------------------------------------
+#	PS/2 capture analyzer for SX|2 indicator
+#
+#	Build sx2_indicator with PS2DEV_CAPTURE=1, and save the UART output
+#	into a file. This script reads the "PS2CAP" lines in it.
+#
+#	usage:
+#		ps2_capture.py <log file>				... statistics
+#		ps2_capture.py <log file> --dump		... all bytes with time
+#		ps2_capture.py <log file> --corpus		... transactions without time
+#
+#	The --corpus output has no time, so it can be compared (diff) between
+#	two versions of the firmware. The transactions are split by the idle
+#	time (TRANSACTION_GAP).
+#	firmware/sx2_indicator/host_test/u2p_replay sends the host bytes of the
+#	corpus to u2p built for the PC, and compares the responses. (Capture it
+#	without the USB mouse and gamepad.)
+# --------------------------------------------------------------------
+
+import sys
+
+# --------------------------------------------------------------------
+def read_capture( file_name ):
+	blocks = []
+	block = []
+	try:
+		with open( file_name, 'rt', errors='replace' ) as file:
+			for line in file:
+				words = line.split()
+				if len( words ) == 0 or words[0] != 'PS2CAP':
+					continue
+				if len( words ) == 2 and words[1] == 'END':
+					blocks.append( block )
+					block = []
+					continue
+				block.extend( int( w, 16 ) for w in words[1:] )
+	except:
+		print( "ERROR: Cannot read the '%s'." % file_name )
+		exit( 1 )
+	if len( block ) != 0:
+		blocks.append( block )
+	return blocks
+
+# --------------------------------------------------------------------
+#	Decode the records into [ ( time[us], is_from_host, data ), ... ]
+#	The time continues over the blocks. (The gap of dump is included.)
+#
+def decode( blocks ):
+	events = []
+	time = 0
+	for block in blocks:
+		i = 0
+		while i < len( block ):
+			value = 0
+			shift = 0
+			while True:
+				d = block[i]
+				i = i + 1
+				value = value | ((d & 0x7F) << shift)
+				shift = shift + 7
+				if (d & 0x80) == 0:
+					break
+			if i >= len( block ):
+				print( "WARNING: Broken record at the end of block." )
+				break
+			time = time + (value >> 1)
+			events.append( ( time, (value & 1) != 0, block[i] ) )
+			i = i + 1
+	return events
+
+# --------------------------------------------------------------------
+#	Split the events into transactions. A transaction starts at a HOST byte
+#	after the idle time longer than TRANSACTION_GAP.
+#
+TRANSACTION_GAP = 5000		# [us]
+
+def split_transactions( events ):
+	transactions = []
+	current = None
+	last_time = None
+	for event in events:
+		if event[1] and (current is None or (event[0] - last_time) > TRANSACTION_GAP):
+			current = []
+			transactions.append( current )
+		if current is not None:
+			current.append( event )
+		last_time = event[0]
+	return transactions
+
+# --------------------------------------------------------------------
+def percentile( values, p ):
+	if len( values ) == 0:
+		return 0
+	values = sorted( values )
+	return values[ min( len( values ) - 1, int( len( values ) * p / 100 ) ) ]
+
+# --------------------------------------------------------------------
+def statistics( events ):
+	if len( events ) == 0:
+		print( "No record." )
+		return
+	duration = events[-1][0] - events[0][0]
+	host_bytes = sum( 1 for e in events if e[1] )
+	print( "Records        : %d (HOST %d, device %d)" % ( len( events ), host_bytes, len( events ) - host_bytes ) )
+	print( "Duration       : %.3f sec" % ( duration / 1000000 ) )
+
+	#	0xEB turnaround: HOST 0xEB to the first device byte (0xFA)
+	#	0xEB cycle: 0xEB to the next 0xEB
+	turnaround = []
+	poll_times = []
+	for i in range( len( events ) ):
+		if not events[i][1] or events[i][2] != 0xEB:
+			continue
+		poll_times.append( events[i][0] )
+		for j in range( i + 1, len( events ) ):
+			if not events[j][1]:
+				turnaround.append( events[j][0] - events[i][0] )
+				break
+	cycle = [ poll_times[i + 1] - poll_times[i] for i in range( len( poll_times ) - 1 ) ]
+	if duration > 0:
+		print( "Polls          : %d (%.1f polls/sec)" % ( len( poll_times ), len( poll_times ) * 1000000 / duration ) )
+		print( "Throughput     : %.1f bytes/sec" % ( len( events ) * 1000000 / duration ) )
+	if len( turnaround ) != 0:
+		print( "0xEB turnaround: p50 %d us, p99 %d us, max %d us" % ( percentile( turnaround, 50 ), percentile( turnaround, 99 ), max( turnaround ) ) )
+	if len( cycle ) != 0:
+		print( "0xEB cycle     : p50 %d us, p99 %d us, max %d us" % ( percentile( cycle, 50 ), percentile( cycle, 99 ), max( cycle ) ) )
+
+	#	Gap between the bytes in the same direction
+	gaps = [ events[i][0] - events[i - 1][0] for i in range( 1, len( events ) ) if events[i][1] == events[i - 1][1] ]
+	if len( gaps ) != 0:
+		print( "Byte gap       : p50 %d us, p99 %d us" % ( percentile( gaps, 50 ), percentile( gaps, 99 ) ) )
+
+# --------------------------------------------------------------------
+def dump( events ):
+	for event in events:
+		print( "%12d %s %02X" % ( event[0], "H>" if event[1] else "<I", event[2] ) )
+
+# --------------------------------------------------------------------
+def corpus( events ):
+	for transaction in split_transactions( events ):
+		host = ' '.join( "%02X" % e[2] for e in transaction if e[1] )
+		device = ' '.join( "%02X" % e[2] for e in transaction if not e[1] )
+		print( "H> %s" % host )
+		print( "<I %s" % device )
+
+# --------------------------------------------------------------------
+def usage():
+	print( "Usage> ps2_capture.py <log file> [--dump|--corpus]" )
+
+# --------------------------------------------------------------------
+if __name__ == "__main__":
+	if len( sys.argv ) < 2:
+		usage()
+		exit( 1 )
+	events = decode( read_capture( sys.argv[1] ) )
+	if len( sys.argv ) == 2:
+		statistics( events )
+	elif sys.argv[2] == '--dump':
+		dump( events )
+	elif sys.argv[2] == '--corpus':
+		corpus( events )
+	else:
+		usage()
+		exit( 1 )